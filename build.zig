@@ -530,10 +530,13 @@ const BuildMode = enum {
 const BuildContext = struct {
     b: *std.Build,
     enable_tracy: bool,
+    libfuzzer: bool,
     build_mode: BuildMode,
     lipo_steps: std.StringHashMap(*LipoStep),
     master_step: *std.Build.Step,
     test_step: *std.Build.Step,
+    fuzz_step: *std.Build.Step,
+    parser_bench_step: *std.Build.Step,
     optimise: std.builtin.OptimizeMode,
     external_build_resources_subdir: ?[]const u8,
 };
@@ -858,10 +861,17 @@ pub fn build(b: *std.Build) void {
     var build_context: BuildContext = .{
         .b = b,
         .enable_tracy = enable_tracy,
+        .libfuzzer = b.option(
+            bool,
+            "libfuzzer",
+            "Build the parser fuzzers as libraries without main(), for linking with -fsanitize=fuzzer",
+        ) orelse false,
         .build_mode = build_mode,
         .lipo_steps = std.StringHashMap(*LipoStep).init(b.allocator),
         .master_step = b.step("compile", "Compile all"),
         .test_step = b.step("test", "Run tests"),
+        .fuzz_step = b.step("fuzz", "Run the file parser fuzzers"),
+        .parser_bench_step = b.step("bench-parsers", "Run the file parser throughput benchmark"),
         .optimise = switch (build_mode) {
             .development => std.builtin.OptimizeMode.Debug,
             .performance_profiling, .production => std.builtin.OptimizeMode.ReleaseSafe,
@@ -1263,6 +1273,7 @@ pub fn build(b: *std.Build) void {
             const library_path = "src";
 
             const generic_source_files = .{
+                library_path ++ "/utils/arena_usage.cpp",
                 library_path ++ "/utils/debug/debug.cpp",
                 library_path ++ "/utils/directory_listing/directory_listing.cpp",
                 library_path ++ "/utils/leak_detecting_allocator.cpp",
@@ -1482,9 +1493,12 @@ pub fn build(b: *std.Build) void {
                     plugin_path ++ "/plugin_instance.cpp",
                     plugin_path ++ "/presets_folder.cpp",
                     plugin_path ++ "/processing/audio_utils.cpp",
+                    plugin_path ++ "/processing/coefficient_tables.cpp",
                     plugin_path ++ "/processing/midi.cpp",
+                    plugin_path ++ "/processing/polyphase_upsampler.cpp",
                     plugin_path ++ "/processing/volume_fade.cpp",
                     plugin_path ++ "/processor.cpp",
+                    plugin_path ++ "/processor_golden_tests.cpp",
                     plugin_path ++ "/sample_library_loader.cpp",
                     plugin_path ++ "/scanned_folder.cpp",
                     plugin_path ++ "/voices.cpp",
@@ -2351,6 +2365,63 @@ pub fn build(b: *std.Build) void {
             build_context.test_step.dependOn(&run_tests.step);
         }
 
+        if (build_context.build_mode != .production) {
+            const parser_fuzzer_path = "src/parser_fuzzer";
+
+            // One executable per parser, each with a libFuzzer-compatible entry point. With -Dlibfuzzer, each
+            // is a static library without main() instead, since libFuzzer provides main().
+            const fuzz_targets = [_][]const u8{ "Mdata", "Lua", "Flac", "Wav", "JsonPreset", "BinaryState" };
+            for (fuzz_targets) |fuzz_target| {
+                const fuzzer_name = b.fmt("fuzz_{s}", .{fuzz_target});
+                const fuzzer = if (build_context.libfuzzer)
+                    b.addStaticLibrary(.{ .name = fuzzer_name, .target = target, .optimize = build_context.optimise })
+                else
+                    b.addExecutable(.{ .name = fuzzer_name, .target = target, .optimize = build_context.optimise });
+                var flags = std.ArrayList([]const u8).init(b.allocator);
+                flags.appendSlice(cpp_fp_flags) catch @panic("OOM");
+                flags.append(b.fmt("-DFLOE_FUZZ_TARGET={s}", .{fuzz_target})) catch @panic("OOM");
+                if (build_context.libfuzzer) flags.append("-DFLOE_LIBFUZZER=1") catch @panic("OOM");
+                fuzzer.addCSourceFiles(.{
+                    .files = &.{parser_fuzzer_path ++ "/parser_fuzzer.cpp"},
+                    .flags = flags.items,
+                });
+                fuzzer.addCSourceFiles(.{
+                    .files = &.{parser_fuzzer_path ++ "/parser_fuzz_targets.cpp"},
+                    .flags = cpp_fp_flags,
+                });
+                fuzzer.addConfigHeader(build_config_step);
+                fuzzer.addIncludePath(b.path("src"));
+                fuzzer.addIncludePath(b.path("src/plugin"));
+                fuzzer.linkLibrary(plugin);
+                applyUniversalSettings(&build_context, fuzzer);
+                b.getInstallStep().dependOn(&b.addInstallArtifact(fuzzer, .{ .dest_dir = install_subfolder }).step);
+
+                if (!build_context.libfuzzer) {
+                    const run_fuzzer = b.addRunArtifact(fuzzer);
+                    run_fuzzer.addArgs(&.{ "--iterations=5000", "--max-total-seconds=30" });
+                    build_context.fuzz_step.dependOn(&run_fuzzer.step);
+                }
+            }
+
+            const parser_bench = b.addExecutable(.{
+                .name = "parser_throughput",
+                .target = target,
+                .optimize = build_context.optimise,
+            });
+            parser_bench.addCSourceFiles(.{ .files = &.{
+                parser_fuzzer_path ++ "/parser_throughput.cpp",
+                parser_fuzzer_path ++ "/parser_fuzz_targets.cpp",
+            }, .flags = cpp_fp_flags });
+            parser_bench.addConfigHeader(build_config_step);
+            parser_bench.addIncludePath(b.path("src"));
+            parser_bench.addIncludePath(b.path("src/plugin"));
+            parser_bench.linkLibrary(plugin);
+            applyUniversalSettings(&build_context, parser_bench);
+            join_compile_commands.step.dependOn(&parser_bench.step);
+            b.getInstallStep().dependOn(&b.addInstallArtifact(parser_bench, .{ .dest_dir = install_subfolder }).step);
+            build_context.parser_bench_step.dependOn(&b.addRunArtifact(parser_bench).step);
+        }
+
         build_context.master_step.dependOn(&join_compile_commands.step);
     }
 
@@ -30,10 +30,17 @@ struct Bitset {
         return result;
     }
 
+    // Cost is proportional to the number of set bits rather than the size of the bitset.
     template <typename Function>
     void ForEachSetBit(Function&& function) const {
-        for (auto const i : Range(k_bits))
-            if (Get(i)) function(i);
+        for (auto const element_index : Range(k_num_elements)) {
+            auto element = parts[element_index];
+            while (element) {
+                auto const bit_index = (usize)__builtin_ctzll(element);
+                function((element_index * k_bits_per_element) + bit_index);
+                element &= element - 1;
+            }
+        }
     }
 
     constexpr void SetToValue(usize bit, bool value) {
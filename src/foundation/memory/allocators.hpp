@@ -408,6 +408,37 @@ HandleBumpShrink(Span<u8> allocation, usize required_bytes, u8* stack_data, usiz
     return {allocation.data, required_bytes};
 }
 
+// Optional telemetry for ArenaAllocators. Give an arena one of these via TrackUsage() and it will record its
+// peak usage, how many regions it needed and how many allocations it served. The same stats can be merged
+// across arenas of the same kind (e.g. an arena per job) to build up a history, from which
+// RecommendedInitialSize() gives a first region size that's less likely to overflow. Not thread-safe.
+struct ArenaUsageStats {
+    void Merge(ArenaUsageStats const& other) {
+        peak_used = Max(peak_used, other.peak_used);
+        num_allocations += other.num_allocations;
+        num_frees += other.num_frees;
+        num_resizes += other.num_resizes;
+        num_regions += other.num_regions;
+        num_overflow_regions += other.num_overflow_regions;
+        num_arenas += other.num_arenas;
+    }
+
+    // If we have no history then the guess is all we have to go on. Otherwise we use the peak, but never go
+    // below the guess: arenas typically hold memory that scales with things we don't know about here.
+    usize RecommendedInitialSize(usize guess) const {
+        if (!num_arenas) return guess;
+        return Max(guess, peak_used);
+    }
+
+    usize peak_used {}; // highest ArenaAllocator::TotalHandedOut()
+    u64 num_allocations {};
+    u64 num_frees {};
+    u64 num_resizes {};
+    u64 num_regions {}; // allocations from the child allocator
+    u64 num_overflow_regions {}; // regions that were needed because the current one was full
+    u64 num_arenas {};
+};
+
 // A basic arena allocator that allows for a convenient way to free all of the data at once in the destructor.
 // Essentially fixed size buffers are allocated using the given child Allocator when needed. If
 // the allocation fits inside the buffer then the cursor is incremented. Or if not, a new region is allocated
@@ -450,11 +481,15 @@ struct ArenaAllocator : public Allocator {
         first = other.first;
         last = other.last;
         current_region_cursor = other.current_region_cursor;
+        used_in_previous_regions = other.used_in_previous_regions;
         minimum_bytes_per_region = other.minimum_bytes_per_region;
+        usage_stats = other.usage_stats;
 
         other.first = {};
         other.last = {};
         other.current_region_cursor = {};
+        other.used_in_previous_regions = {};
+        other.usage_stats = {};
     }
 
     ArenaAllocator& operator=(ArenaAllocator&& other) {
@@ -463,18 +498,31 @@ struct ArenaAllocator : public Allocator {
         first = other.first;
         last = other.last;
         current_region_cursor = other.current_region_cursor;
+        used_in_previous_regions = other.used_in_previous_regions;
         minimum_bytes_per_region = other.minimum_bytes_per_region;
         child_allocator = other.child_allocator;
+        usage_stats = other.usage_stats;
 
         other.first = {};
         other.last = {};
         other.current_region_cursor = {};
+        other.used_in_previous_regions = {};
+        other.usage_stats = {};
 
         return *this;
     }
 
     NON_COPYABLE(ArenaAllocator);
 
+    // Start recording into the given stats. Regions that already exist are counted.
+    void TrackUsage(ArenaUsageStats& stats) {
+        usage_stats = &stats;
+        ++stats.num_arenas;
+        for (auto region = first; region != nullptr; region = region->next)
+            ++stats.num_regions;
+        UpdatePeakUsage();
+    }
+
     // Don't free the result
     Span<char> CloneNullTerminated(String s) {
         auto result = AllocateExactSizeUninitialised<char>(s.size + 1);
@@ -491,11 +539,14 @@ struct ArenaAllocator : public Allocator {
             case AllocatorCommand::Allocate: {
                 auto const& cmd = command_union.Get<AllocateCommand>();
 
+                if (usage_stats) ++usage_stats->num_allocations;
+
                 auto current_region_header = first ? first : CreateAndPrependRegionToList(cmd.size, 0);
                 while (true) {
                     if (auto allocation = HandleBumpAllocation(current_region_header->BufferView(),
                                                                current_region_cursor,
                                                                cmd)) {
+                        UpdatePeakUsage();
                         return *allocation;
                     }
 
@@ -509,6 +560,7 @@ struct ArenaAllocator : public Allocator {
             case AllocatorCommand::Free: {
                 auto const& cmd = command_union.Get<FreeCommand>();
                 ASSERT(first);
+                if (usage_stats) ++usage_stats->num_frees;
                 HandleBumpFree(cmd.allocation, first->BufferData(), current_region_cursor);
                 return {};
             }
@@ -516,10 +568,14 @@ struct ArenaAllocator : public Allocator {
             case AllocatorCommand::Resize: {
                 auto const& cmd = command_union.Get<ResizeCommand>();
                 ASSERT(first);
+                if (usage_stats) ++usage_stats->num_resizes;
 
                 if (cmd.new_size > cmd.allocation.size) {
-                    if (auto allocation = TryGrowingInPlace(first->BufferView(), current_region_cursor, cmd))
+                    if (auto allocation =
+                            TryGrowingInPlace(first->BufferView(), current_region_cursor, cmd)) {
+                        UpdatePeakUsage();
                         return *allocation;
+                    }
 
                     return ResizeUsingNewAllocation(cmd, k_max_alignment);
                 } else if (cmd.new_size < cmd.allocation.size) {
@@ -545,12 +601,14 @@ struct ArenaAllocator : public Allocator {
         first = nullptr;
         last = nullptr;
         current_region_cursor = 0;
+        used_in_previous_regions = 0;
     }
 
     void ResetCurrentRegionCursor() { current_region_cursor = 0; }
 
     void ResetCursorAndConsolidateRegions() {
         if (first == nullptr) return;
+        used_in_previous_regions = 0;
         if (first == last) {
             current_region_cursor = 0;
             return;
@@ -583,6 +641,9 @@ struct ArenaAllocator : public Allocator {
         first = new_region;
         last = new_region;
         current_region_cursor = 0;
+
+        // The regions were replaced by a new allocation from the child allocator.
+        if (usage_stats) ++usage_stats->num_regions;
     }
 
     usize TryShrinkTotalUsed(usize size) {
@@ -612,6 +673,16 @@ struct ArenaAllocator : public Allocator {
         return result;
     }
 
+    // The bytes given out since the last reset, including alignment padding. Unlike TotalUsed(), the unused
+    // end of a region that was left behind for a new one isn't counted.
+    usize TotalHandedOut() const { return used_in_previous_regions + current_region_cursor; }
+
+    // private
+    void UpdatePeakUsage() {
+        if (!usage_stats) return;
+        usage_stats->peak_used = Max(usage_stats->peak_used, TotalHandedOut());
+    }
+
     // private
     Region* CreateAndPrependRegionToList(usize size, usize previous_size) {
         auto const memory_region_size = (usize)Max<s64>((s64)minimum_bytes_per_region,
@@ -627,6 +698,12 @@ struct ArenaAllocator : public Allocator {
         auto new_region = CheckedPointerCast<Region*>(data.data);
         new_region->size = data.size;
 
+        if (first) used_in_previous_regions += current_region_cursor;
+        if (usage_stats) {
+            ++usage_stats->num_regions;
+            if (first) ++usage_stats->num_overflow_regions;
+        }
+
         DoublyLinkedListPrepend(*this, new_region);
 
         current_region_cursor = 0;
@@ -637,7 +714,9 @@ struct ArenaAllocator : public Allocator {
     Region* first {}; // AKA current
     Region* last {};
     usize current_region_cursor {};
+    usize used_in_previous_regions {};
     Allocator& child_allocator;
+    ArenaUsageStats* usage_stats {};
 };
 
 // If there is no fallback allocator then there is no need to call Free().
@@ -287,6 +287,22 @@ ErrorCodeOr<void> RecursiveDirectoryIterator::Increment() {
 ErrorCodeOr<bool> DeleteDirectoryIfMacBundle(String) { return false; }
 #endif
 
+#ifndef __linux__
+struct BatchedFileReader {};
+ErrorCodeOr<BatchedFileReader*> CreateBatchedFileReader(u32) {
+    return ErrnoErrorCode(ENOSYS, "batched file reads are Linux-only");
+}
+bool DestroyBatchedFileReader(BatchedFileReader*) { return true; }
+void QueueBatchedRead(BatchedFileReader&, BatchedFileRead const&) { PanicIfReached(); }
+ErrorCodeOr<bool> WaitForBatchedReads(BatchedFileReader&, BatchedReadCallback) { return false; }
+
+ErrorCodeOr<FileDiskLocation> DiskLocation(File&, u64) {
+    return ErrnoErrorCode(ENOSYS, "disk locations are Linux-only");
+}
+
+ErrorCodeOr<void> EvictFileFromPageCache(String) { return k_success; }
+#endif
+
 ErrorCodeOr<DirectoryWatcher> CreateDirectoryWatcher(Allocator& a) {
     DirectoryWatcher result {
         .allocator = a,
@@ -106,6 +106,64 @@ ErrorCodeOr<void> ReadSectionOfFileAndWriteToOtherFile(File& file_to_read_from,
                                                        usize size,
                                                        String filename_to_write_to);
 
+// Reads sections of files with many reads in flight at once rather than one blocking read at a time, so that
+// the OS and the drive can schedule them together. Only available on Linux, where it uses io_uring.
+// Elsewhere, or if the kernel doesn't allow io_uring, CreateBatchedFileReader() fails and you should read the
+// usual way. Use a reader from one thread at a time.
+struct BatchedFileReader;
+
+struct BatchedFileRead {
+    File& file; // must stay open until the read is reported
+    u64 offset;
+    Span<u8> buffer; // not empty, and valid until the read is reported; it's filled completely
+    uintptr user_data;
+};
+
+// queue_depth is the maximum number of reads the kernel is given at once. Large reads are split into pieces,
+// each of which counts separately.
+ErrorCodeOr<BatchedFileReader*> CreateBatchedFileReader(u32 queue_depth);
+
+// Waits for any reads still in flight so that their buffers can be freed afterwards. Returns false if the
+// kernel couldn't be waited on: the reads may still write to their buffers, so the buffers must be leaked.
+bool DestroyBatchedFileReader(BatchedFileReader* reader);
+
+// Nothing is submitted until WaitForBatchedReads.
+void QueueBatchedRead(BatchedFileReader& reader, BatchedFileRead const& read);
+
+// Submits queued reads, keeping up to queue_depth in flight, and waits until at least one read has finished.
+// The callback is called for each finished read, successful or not. Returns false if there was nothing to
+// wait for. If this returns an error the reader can't be used again: call DestroyBatchedFileReader() before
+// freeing the buffers of unreported reads.
+using BatchedReadCallback = FunctionRef<void(uintptr user_data, ErrorCodeOr<void> result)>;
+ErrorCodeOr<bool> WaitForBatchedReads(BatchedFileReader& reader, BatchedReadCallback callback);
+
+// Where a byte of a file is stored, as far as the OS will say, so that reads can be issued in the order the
+// drive holds them rather than the order they were asked for. Files are told apart by device and file ID (the
+// inode), which most filesystems allocate near the file's data. When the filesystem reports it, using FIEMAP,
+// the byte's address on the device is given too. Only available on Linux.
+struct FileDiskLocation {
+    u64 device;
+    u64 file_id;
+    u64 offset_in_file;
+    Optional<u64> physical_offset;
+};
+
+ErrorCodeOr<FileDiskLocation> DiskLocation(File& file, u64 offset_in_file);
+
+// Physical addresses are only comparable on the same device. Reads without one go after those with one,
+// ordered by file ID.
+inline bool DiskLocationLessThan(FileDiskLocation const& a, FileDiskLocation const& b) {
+    if (a.device != b.device) return a.device < b.device;
+    if (a.physical_offset.HasValue() != b.physical_offset.HasValue()) return a.physical_offset.HasValue();
+    if (a.physical_offset) return *a.physical_offset < *b.physical_offset;
+    if (a.file_id != b.file_id) return a.file_id < b.file_id;
+    return a.offset_in_file < b.offset_in_file;
+}
+
+// Asks the OS to forget any cached contents of the file, so that the next read comes from the drive. Unsaved
+// changes are written first. For measuring cold-start performance; it does nothing where unsupported.
+ErrorCodeOr<void> EvictFileFromPageCache(String path);
+
 // Returned paths will use whatever the OS's path separator. And they never have a trailing path seporator.
 
 using PathArena = ArenaAllocatorWithInlineStorage<2000>;
@@ -7,12 +7,18 @@
 #include <fts.h>
 #include <ftw.h>
 #include <link.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <linux/io_uring.h>
 #include <linux/limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -112,6 +118,313 @@ static ErrorCodeOr<ssize> CopyFile(char const* source, char const* destination)
     return result;
 }
 
+// We talk to io_uring directly rather than through liburing: we only need reads, and it avoids a dependency.
+struct BatchedFileReader {
+    // A piece of a BatchedFileRead. Pieces are resubmitted after a short read.
+    struct Piece {
+        u32 read_index;
+        int fd;
+        u64 offset;
+        Span<u8> buffer;
+    };
+
+    struct PendingRead {
+        uintptr user_data;
+        u32 num_unfinished_pieces;
+        Optional<ErrorCode> error;
+    };
+
+    static constexpr usize k_max_piece_size = Mb(1);
+
+    int ring_fd = -1;
+    Span<u8> sq_ring_memory {};
+    Span<u8> cq_ring_memory {};
+    Span<u8> sqes_memory {};
+
+    u32* sq_head {};
+    u32* sq_tail {};
+    u32 sq_mask {};
+    u32* sq_array {};
+    io_uring_sqe* sqes {};
+
+    u32* cq_head {};
+    u32* cq_tail {};
+    u32 cq_mask {};
+    io_uring_cqe* cqes {};
+
+    u32 queue_depth {};
+    u32 num_in_flight {};
+    DynamicArray<PendingRead> reads {Malloc::Instance()};
+    DynamicArray<Piece> pieces {Malloc::Instance()}; // index is the SQE user_data
+    DynamicArray<u32> unsubmitted_pieces {Malloc::Instance()};
+    usize next_unsubmitted_piece {};
+    DynamicArray<u32> free_piece_indices {Malloc::Instance()};
+};
+
+static int IoUringSetup(u32 entries, io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int IoUringEnter(int ring_fd, u32 to_submit, u32 min_complete, u32 flags) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+static void UnmapRing(BatchedFileReader& r) {
+    if (r.sqes_memory.size) munmap(r.sqes_memory.data, r.sqes_memory.size);
+    if (r.cq_ring_memory.size && r.cq_ring_memory.data != r.sq_ring_memory.data)
+        munmap(r.cq_ring_memory.data, r.cq_ring_memory.size);
+    if (r.sq_ring_memory.size) munmap(r.sq_ring_memory.data, r.sq_ring_memory.size);
+    if (r.ring_fd != -1) close(r.ring_fd);
+}
+
+ErrorCodeOr<BatchedFileReader*> CreateBatchedFileReader(u32 queue_depth) {
+    ASSERT(queue_depth);
+    io_uring_params params {};
+    auto const ring_fd = IoUringSetup(queue_depth, &params);
+    // ENOSYS for old kernels, EPERM if io_uring is disabled by sysctl or a sandbox.
+    if (ring_fd < 0) return FilesystemErrnoErrorCode(errno, "io_uring_setup");
+
+    auto r = Malloc::Instance().New<BatchedFileReader>();
+    r->ring_fd = ring_fd;
+    auto const fail = [r](ErrorCode e) -> ErrorCode {
+        UnmapRing(*r);
+        Malloc::Instance().Delete(r);
+        return e;
+    };
+
+    // IORING_OP_READ arrived in the same kernel version (5.6) as this feature flag; there's no direct way to
+    // ask for it without probing.
+    if (!(params.features & IORING_FEAT_RW_CUR_POS))
+        return fail(FilesystemErrnoErrorCode(ENOSYS, "io_uring without IORING_OP_READ"));
+
+    auto map = [ring_fd](usize size, u64 offset) -> ErrorCodeOr<Span<u8>> {
+        auto const mem =
+            mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, (off_t)offset);
+        if (mem == MAP_FAILED) return FilesystemErrnoErrorCode(errno, "mmap io_uring");
+        return Span<u8> {(u8*)mem, size};
+    };
+
+    auto sq_ring_size = params.sq_off.array + (params.sq_entries * sizeof(u32));
+    auto cq_ring_size = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+    auto const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) sq_ring_size = cq_ring_size = Max(sq_ring_size, cq_ring_size);
+
+    {
+        auto const o = map(sq_ring_size, IORING_OFF_SQ_RING);
+        if (o.HasError()) return fail(o.Error());
+        r->sq_ring_memory = o.Value();
+    }
+    if (single_mmap) {
+        r->cq_ring_memory = r->sq_ring_memory;
+    } else {
+        auto const o = map(cq_ring_size, IORING_OFF_CQ_RING);
+        if (o.HasError()) return fail(o.Error());
+        r->cq_ring_memory = o.Value();
+    }
+    {
+        auto const o = map(params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+        if (o.HasError()) return fail(o.Error());
+        r->sqes_memory = o.Value();
+    }
+
+    auto const sq = r->sq_ring_memory.data;
+    r->sq_head = (u32*)(sq + params.sq_off.head);
+    r->sq_tail = (u32*)(sq + params.sq_off.tail);
+    r->sq_mask = *(u32*)(sq + params.sq_off.ring_mask);
+    r->sq_array = (u32*)(sq + params.sq_off.array);
+    r->sqes = (io_uring_sqe*)r->sqes_memory.data;
+
+    auto const cq = r->cq_ring_memory.data;
+    r->cq_head = (u32*)(cq + params.cq_off.head);
+    r->cq_tail = (u32*)(cq + params.cq_off.tail);
+    r->cq_mask = *(u32*)(cq + params.cq_off.ring_mask);
+    r->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // The completion queue is at least as big as the submission queue, so it can't overflow while we keep no
+    // more than sq_entries in flight.
+    r->queue_depth = Min(queue_depth, params.sq_entries);
+    return r;
+}
+
+void QueueBatchedRead(BatchedFileReader& r, BatchedFileRead const& read) {
+    ASSERT(read.buffer.size);
+    auto const fd = fileno((FILE*)read.file.NativeFileHandle());
+    auto const read_index = (u32)r.reads.size;
+    dyn::Append(r.reads, {.user_data = read.user_data, .num_unfinished_pieces = 0, .error = {}});
+
+    for (usize pos = 0; pos < read.buffer.size; pos += BatchedFileReader::k_max_piece_size) {
+        BatchedFileReader::Piece const piece {
+            .read_index = read_index,
+            .fd = fd,
+            .offset = read.offset + pos,
+            .buffer = read.buffer.SubSpan(pos, BatchedFileReader::k_max_piece_size),
+        };
+        u32 piece_index;
+        if (r.free_piece_indices.size) {
+            piece_index = r.free_piece_indices[r.free_piece_indices.size - 1];
+            dyn::Pop(r.free_piece_indices);
+            r.pieces[piece_index] = piece;
+        } else {
+            piece_index = (u32)r.pieces.size;
+            dyn::Append(r.pieces, piece);
+        }
+        dyn::Append(r.unsubmitted_pieces, piece_index);
+        ++r.reads[read_index].num_unfinished_pieces;
+    }
+}
+
+static void FillSubmissionQueue(BatchedFileReader& r) {
+    auto tail = *r.sq_tail;
+    while (r.num_in_flight < r.queue_depth && r.next_unsubmitted_piece != r.unsubmitted_pieces.size) {
+        auto const piece_index = r.unsubmitted_pieces[r.next_unsubmitted_piece++];
+        auto const& piece = r.pieces[piece_index];
+
+        auto const sqe_index = tail & r.sq_mask;
+        auto& sqe = r.sqes[sqe_index];
+        sqe = {};
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = piece.fd;
+        sqe.off = piece.offset;
+        sqe.addr = (u64)(uintptr)piece.buffer.data;
+        sqe.len = (u32)piece.buffer.size;
+        sqe.user_data = piece_index;
+        r.sq_array[sqe_index] = sqe_index;
+
+        ++tail;
+        ++r.num_in_flight;
+    }
+    if (r.next_unsubmitted_piece == r.unsubmitted_pieces.size) {
+        dyn::Clear(r.unsubmitted_pieces);
+        r.next_unsubmitted_piece = 0;
+    }
+    __atomic_store_n(r.sq_tail, tail, __ATOMIC_RELEASE);
+}
+
+// Returns true if the piece is finished, otherwise it's been queued again to read the rest.
+static bool HandleCompletion(BatchedFileReader& r, u32 piece_index, s32 result) {
+    auto& piece = r.pieces[piece_index];
+    auto& read = r.reads[piece.read_index];
+    if (result == -EINTR || result == -EAGAIN) {
+        dyn::Append(r.unsubmitted_pieces, piece_index);
+        return false;
+    }
+    if (result < 0) {
+        if (!read.error) read.error = FilesystemErrnoErrorCode(-result, "io_uring read");
+        return true;
+    }
+    if (result == 0) {
+        // The file is shorter than the caller expected.
+        if (!read.error) read.error = FilesystemErrnoErrorCode(EIO, "io_uring read: unexpected end of file");
+        return true;
+    }
+    if ((usize)result < piece.buffer.size) {
+        piece.offset += (u64)result;
+        piece.buffer = piece.buffer.SubSpan((usize)result);
+        dyn::Append(r.unsubmitted_pieces, piece_index);
+        return false;
+    }
+    return true;
+}
+
+ErrorCodeOr<bool> WaitForBatchedReads(BatchedFileReader& r, BatchedReadCallback callback) {
+    if (!r.num_in_flight && r.next_unsubmitted_piece == r.unsubmitted_pieces.size) return false;
+
+    FillSubmissionQueue(r);
+    while (true) {
+        // Includes anything the kernel didn't take last time.
+        auto const to_submit = *r.sq_tail - __atomic_load_n(r.sq_head, __ATOMIC_ACQUIRE);
+        if (IoUringEnter(r.ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS) >= 0) break;
+        if (errno != EINTR && errno != EAGAIN) return FilesystemErrnoErrorCode(errno, "io_uring_enter");
+    }
+
+    auto head = *r.cq_head;
+    auto const tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        auto const& cqe = r.cqes[head & r.cq_mask];
+        auto const piece_index = (u32)cqe.user_data;
+        --r.num_in_flight;
+        if (!HandleCompletion(r, piece_index, cqe.res)) continue;
+
+        auto const read_index = r.pieces[piece_index].read_index;
+        dyn::Append(r.free_piece_indices, piece_index);
+        auto& read = r.reads[read_index];
+        if (--read.num_unfinished_pieces == 0) {
+            if (read.error)
+                callback(read.user_data, *read.error);
+            else
+                callback(read.user_data, k_success);
+        }
+    }
+    __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+
+    if (!r.num_in_flight && r.next_unsubmitted_piece == r.unsubmitted_pieces.size) {
+        dyn::Clear(r.reads);
+        dyn::Clear(r.pieces);
+        dyn::Clear(r.free_piece_indices);
+    }
+    return true;
+}
+
+bool DestroyBatchedFileReader(BatchedFileReader* r) {
+    // Closing the ring doesn't wait for reads that are already with the kernel, so we must see every one of
+    // them complete before anyone frees their buffers.
+    while (r->num_in_flight) {
+        auto const ret = IoUringEnter(r->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+            // We can't find out when the kernel is done with the buffers. Leave the ring as it is and tell
+            // the caller to leak the buffers rather than have the kernel write into freed memory.
+            return false;
+        }
+        auto const head = *r->cq_head;
+        auto const tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        r->num_in_flight -= tail - head;
+        __atomic_store_n(r->cq_head, tail, __ATOMIC_RELEASE);
+    }
+    UnmapRing(*r);
+    Malloc::Instance().Delete(r);
+    return true;
+}
+
+ErrorCodeOr<FileDiskLocation> DiskLocation(File& file, u64 offset_in_file) {
+    auto const fd = fileno((FILE*)file.NativeFileHandle());
+    struct stat info = {};
+    if (fstat(fd, &info) != 0) return FilesystemErrnoErrorCode(errno, "fstat");
+    FileDiskLocation result {
+        .device = (u64)info.st_dev,
+        .file_id = (u64)info.st_ino,
+        .offset_in_file = offset_in_file,
+        .physical_offset = nullopt,
+    };
+
+    // Not every filesystem supports FIEMAP, and data that hasn't been written out yet has no address, so
+    // neither is an error: we just don't know the physical offset.
+    alignas(fiemap) u8 buffer[sizeof(fiemap) + sizeof(fiemap_extent)] {};
+    auto& map = *(fiemap*)buffer;
+    map.fm_start = offset_in_file;
+    map.fm_length = 1;
+    map.fm_extent_count = 1;
+    if (ioctl(fd, FS_IOC_FIEMAP, &map) == 0 && map.fm_mapped_extents == 1) {
+        auto const& extent = *(fiemap_extent const*)(buffer + sizeof(fiemap));
+        if (!(extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) &&
+            offset_in_file >= extent.fe_logical)
+            result.physical_offset = extent.fe_physical + (offset_in_file - extent.fe_logical);
+    }
+    return result;
+}
+
+ErrorCodeOr<void> EvictFileFromPageCache(String path) {
+    PathArena temp_path_allocator;
+    auto const fd = open(NullTerminated(path, temp_path_allocator), O_RDONLY);
+    if (fd == -1) return FilesystemErrnoErrorCode(errno, "open");
+    DEFER { close(fd); };
+    // Only pages that match what's on the drive can be dropped.
+    if (fdatasync(fd) != 0) return FilesystemErrnoErrorCode(errno, "fdatasync");
+    if (auto const result = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED); result != 0)
+        return FilesystemErrnoErrorCode(result, "posix_fadvise");
+    return k_success;
+}
+
 ErrorCodeOr<void> CopyFile(String from, String to, ExistingDestinationHandling existing) {
     PathArena temp_path_allocator;
     auto from_nt = NullTerminated(from, temp_path_allocator);
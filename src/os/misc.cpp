@@ -10,6 +10,7 @@
 #include <string.h> // strerror
 
 #include "os/threading.hpp"
+#include "utils/debug/debug.hpp"
 
 static constexpr ErrorCodeCategory k_errno_category {
     .category_id = "PX",
@@ -48,3 +49,122 @@ Mutex& StdStreamMutex(StdStream stream) {
     }
     PanicIfReached();
 }
+
+namespace page_cache {
+
+struct SizeClass {
+    Atomic<void*> slots[k_slots_per_size_class] {};
+};
+
+struct Cache {
+    SizeClass size_classes[k_num_size_classes] {};
+    Atomic<usize> retained_bytes {0};
+    Atomic<usize> peak_retained_bytes {0};
+    Atomic<u64> num_allocations {0};
+    Atomic<u64> num_frees {0};
+    Atomic<u64> num_cache_hits {0};
+    Atomic<u64> num_os_allocations {0};
+    Atomic<u64> num_os_frees {0};
+};
+
+// constant-initialised, and everything in it is trivially destructible
+static Cache g_cache {};
+
+static Optional<usize> SizeClassIndex(usize span_size) {
+    auto const page_size = GetSystemStats().page_size;
+    for (auto const i : Range(k_num_size_classes))
+        if (span_size == k_size_class_num_pages[i] * page_size) return i;
+    return nullopt;
+}
+
+usize SpanSize(usize bytes) {
+    auto const page_size = GetSystemStats().page_size;
+    auto const num_pages = (bytes + page_size - 1) / page_size;
+    for (auto const class_num_pages : k_size_class_num_pages)
+        if (num_pages <= class_num_pages) return class_num_pages * page_size;
+    return num_pages * page_size;
+}
+
+void* Allocate(usize span_size, usize num_used_bytes) {
+    ASSERT(num_used_bytes <= span_size);
+    g_cache.num_allocations.FetchAdd(1, MemoryOrder::Relaxed);
+
+    if (auto const index = SizeClassIndex(span_size)) {
+        for (auto& slot : g_cache.size_classes[*index].slots) {
+            if (slot.Load(MemoryOrder::Relaxed) == nullptr) continue;
+            if (auto ptr = slot.Exchange(nullptr, MemoryOrder::Acquire)) {
+                g_cache.retained_bytes.FetchSub(span_size, MemoryOrder::Relaxed);
+                g_cache.num_cache_hits.FetchAdd(1, MemoryOrder::Relaxed);
+                // Pages from the OS are zeroed, and users of PageAllocator may have come to rely on it. Only
+                // what the caller uses needs clearing though, which for big spans is often much less.
+                __builtin_memset(ptr, 0, num_used_bytes);
+                TracyAlloc(ptr, span_size);
+                return ptr;
+            }
+        }
+    }
+
+    g_cache.num_os_allocations.FetchAdd(1, MemoryOrder::Relaxed);
+    auto ptr = AllocatePages(span_size);
+    if (ptr) TracyAlloc(ptr, span_size);
+    return ptr;
+}
+
+void Free(void* ptr, usize span_size) {
+    g_cache.num_frees.FetchAdd(1, MemoryOrder::Relaxed);
+    TracyFree(ptr); // whether it's retained or not, it's no longer in use
+
+    if (auto const index = SizeClassIndex(span_size)) {
+        auto const retained = g_cache.retained_bytes.AddFetch(span_size, MemoryOrder::Relaxed);
+        if (retained <= k_max_retained_bytes) {
+            for (auto& slot : g_cache.size_classes[*index].slots) {
+                void* expected = nullptr;
+                if (slot.CompareExchangeStrong(expected,
+                                               ptr,
+                                               MemoryOrder::Release,
+                                               MemoryOrder::Relaxed)) {
+                    auto peak = g_cache.peak_retained_bytes.Load(MemoryOrder::Relaxed);
+                    while (retained > peak &&
+                           !g_cache.peak_retained_bytes.CompareExchangeWeak(peak,
+                                                                            retained,
+                                                                            MemoryOrder::Relaxed,
+                                                                            MemoryOrder::Relaxed)) {
+                    }
+                    return;
+                }
+            }
+        }
+        g_cache.retained_bytes.FetchSub(span_size, MemoryOrder::Relaxed);
+    }
+
+    g_cache.num_os_frees.FetchAdd(1, MemoryOrder::Relaxed);
+    FreePages(ptr, span_size);
+}
+
+void ReleaseAll() {
+    auto const page_size = GetSystemStats().page_size;
+    for (auto const i : Range(k_num_size_classes)) {
+        auto const span_size = k_size_class_num_pages[i] * page_size;
+        for (auto& slot : g_cache.size_classes[i].slots) {
+            if (auto ptr = slot.Exchange(nullptr, MemoryOrder::Acquire)) {
+                g_cache.retained_bytes.FetchSub(span_size, MemoryOrder::Relaxed);
+                g_cache.num_os_frees.FetchAdd(1, MemoryOrder::Relaxed);
+                FreePages(ptr, span_size);
+            }
+        }
+    }
+}
+
+Stats GetStats() {
+    return {
+        .num_allocations = g_cache.num_allocations.Load(MemoryOrder::Relaxed),
+        .num_frees = g_cache.num_frees.Load(MemoryOrder::Relaxed),
+        .num_cache_hits = g_cache.num_cache_hits.Load(MemoryOrder::Relaxed),
+        .num_os_allocations = g_cache.num_os_allocations.Load(MemoryOrder::Relaxed),
+        .num_os_frees = g_cache.num_os_frees.Load(MemoryOrder::Relaxed),
+        .retained_bytes = g_cache.retained_bytes.Load(MemoryOrder::Relaxed),
+        .peak_retained_bytes = g_cache.peak_retained_bytes.Load(MemoryOrder::Relaxed),
+    };
+}
+
+} // namespace page_cache
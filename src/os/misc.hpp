@@ -27,12 +27,52 @@ void OpenUrlInBrowser(String url);
 
 void* AllocatePages(usize bytes);
 void FreePages(void* ptr, usize bytes);
-void TryShrinkPages(void* ptr, usize old_size, usize new_size);
+// Gives the pages past new_size back to the OS. Returns false if it couldn't, in which case the span is
+// unchanged.
+bool TryShrinkPages(void* ptr, usize old_size, usize new_size);
+
+// A process-wide cache of recently freed page spans that sits between PageAllocator and the OS. Spans are
+// rounded up to a size class so that a freed span can be handed straight back out for a similar request without
+// a syscall. Everything is lock-free so it's fine to use from any thread. Spans larger than the biggest size
+// class skip the cache entirely, and the total retained is bounded by k_max_retained_bytes. The part of a span
+// that the caller uses is zeroed when it's handed back out, so that it's the same as fresh pages from the OS.
+namespace page_cache {
+
+constexpr u16 k_size_class_num_pages[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+constexpr usize k_num_size_classes = ArraySize(k_size_class_num_pages);
+constexpr usize k_slots_per_size_class = 16;
+constexpr usize k_max_retained_bytes = Mb(16);
+
+struct Stats {
+    u64 num_allocations;
+    u64 num_frees;
+    u64 num_cache_hits;
+    u64 num_os_allocations;
+    u64 num_os_frees;
+    usize retained_bytes;
+    usize peak_retained_bytes;
+};
 
-// Allocate whole pages at a time - often 4kb each; this is the smallest size that the OS gives out.
-class PageAllocator final : public Allocator {
-    static usize AlignUpToPageSize(usize size) { return AlignForward(size, GetSystemStats().page_size); }
+// The number of bytes that will actually be mapped for a request of the given size. Always a whole number of
+// pages.
+usize SpanSize(usize bytes);
+
+// span_size must be the result of SpanSize(). At least the first num_used_bytes are zeroed; a recycled span
+// can have old data after that.
+void* Allocate(usize span_size, usize num_used_bytes);
+void Free(void* ptr, usize span_size);
+
+// Returns all retained spans to the OS.
+void ReleaseAll();
+
+Stats GetStats();
 
+} // namespace page_cache
+
+// Allocate whole pages at a time - often 4kb each; this is the smallest size that the OS gives out. Freed pages
+// go into page_cache rather than straight back to the OS. Allocations are zero-initialised; memory added by
+// Resize() might not be.
+class PageAllocator final : public Allocator {
   public:
     Span<u8> DoCommand(AllocatorCommandUnion const& command_union) {
         CheckAllocatorCommandIsValid(command_union);
@@ -42,10 +82,11 @@ class PageAllocator final : public Allocator {
                 auto const& cmd = command_union.Get<AllocateCommand>();
 
                 Span<u8> result;
-                auto const request_page_size = AlignUpToPageSize(cmd.size);
-                auto mem = AllocatePages(request_page_size);
+                auto const span_size = page_cache::SpanSize(cmd.size);
+                auto mem =
+                    page_cache::Allocate(span_size, cmd.allow_oversized_result ? span_size : cmd.size);
                 if (mem == nullptr) Panic("out of memory");
-                result = {(u8*)mem, request_page_size};
+                result = {(u8*)mem, span_size};
 
                 ASSERT(__builtin_align_up(result.data, cmd.alignment) == result.data);
 
@@ -56,22 +97,42 @@ class PageAllocator final : public Allocator {
                 auto const& cmd = command_union.Get<FreeCommand>();
                 if (cmd.allocation.size == 0) return {};
 
-                FreePages(cmd.allocation.data, AlignUpToPageSize(cmd.allocation.size));
+                page_cache::Free(cmd.allocation.data, page_cache::SpanSize(cmd.allocation.size));
                 return {};
             }
 
             case AllocatorCommand::Resize: {
                 auto const& cmd = command_union.Get<ResizeCommand>();
 
-                if (cmd.new_size < cmd.allocation.size) {
-                    TryShrinkPages(cmd.allocation.data, AlignUpToPageSize(cmd.allocation.size), cmd.new_size);
-                    return {cmd.allocation.data, cmd.new_size};
-                } else if (cmd.new_size > cmd.allocation.size) {
+                auto const old_span_size = page_cache::SpanSize(cmd.allocation.size);
+                auto const new_span_size = page_cache::SpanSize(cmd.new_size);
+
+                if (new_span_size == old_span_size) {
+                    // The span that we already have is big enough.
+                    return {cmd.allocation.data, cmd.allow_oversize_result ? new_span_size : cmd.new_size};
+                } else if (new_span_size < old_span_size) {
+                    // The span is only of the smaller size class if the OS actually took its end back.
+                    if (TryShrinkPages(cmd.allocation.data, old_span_size, new_span_size)) {
+                        return {cmd.allocation.data,
+                                cmd.allow_oversize_result ? new_span_size : cmd.new_size};
+                    }
+
+                    auto const new_allocation = Allocate({
+                        .size = cmd.new_size,
+                        .alignment = k_max_alignment,
+                        .allow_oversized_result = cmd.allow_oversize_result,
+                    });
+                    if (cmd.move_memory_handler.function)
+                        cmd.move_memory_handler.function({.context = cmd.move_memory_handler.context,
+                                                          .destination = new_allocation.data,
+                                                          .source = cmd.allocation.data,
+                                                          .num_bytes = cmd.new_size});
+                    Free(cmd.allocation);
+                    return new_allocation;
+                } else {
                     // IMPROVE: can the OS grow the page?
 
                     return ResizeUsingNewAllocation(cmd, k_max_alignment);
-                } else {
-                    return cmd.allocation;
                 }
             }
         }
@@ -21,33 +21,29 @@
 
 void* AllocatePages(usize bytes) {
     auto p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
-    TracyAlloc(p, bytes);
     if (p == MAP_FAILED) return nullptr;
     return p;
 }
 
-void FreePages(void* ptr, usize bytes) {
-    TracyFree(ptr);
-    munmap(ptr, bytes);
-}
+void FreePages(void* ptr, usize bytes) { munmap(ptr, bytes); }
 
 int CurrentProcessId() { return getpid(); }
 
-void TryShrinkPages(void* ptr, usize old_size, usize new_size) {
-    TracyFree(ptr);
+bool TryShrinkPages(void* ptr, usize old_size, usize new_size) {
     auto const page_size = GetSystemStats().page_size;
     auto const current_num_pages = old_size / page_size;
-    auto const new_num_pages = (new_size == 0) ? 0 : ((new_size / page_size) + 1);
+    auto const new_num_pages = (new_size + page_size - 1) / page_size;
     if (current_num_pages != new_num_pages) {
         auto const num_pages = current_num_pages - new_num_pages;
         Span<u8> const unused_pages {(u8*)ptr + new_num_pages * page_size, page_size * num_pages};
         ASSERT(ContainsPointer(unused_pages, unused_pages.data));
         ASSERT(ContainsPointer(unused_pages, &Last(unused_pages)));
 
-        auto result = munmap(unused_pages.data, unused_pages.size);
-        ASSERT(result == 0, "munmap failed");
+        if (munmap(unused_pages.data, unused_pages.size) != 0) return false;
     }
+    TracyFree(ptr);
     TracyAlloc(ptr, new_size);
+    return true;
 }
 
 void StdPrint(StdStream stream, String str) {
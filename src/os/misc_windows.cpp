@@ -64,23 +64,30 @@ DynamicArrayInline<char, 64> OperatingSystemName() {
 }
 
 void* AllocatePages(usize bytes) {
-    auto p = VirtualAlloc(nullptr, (DWORD)bytes, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-    TracyAlloc(p, bytes);
-    return p;
+    return VirtualAlloc(nullptr, (DWORD)bytes, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
 }
 
 void FreePages(void* ptr, usize bytes) {
     (void)bytes; // VirtualFree requires the size to be 0 when MEM_RELEASE is used
-    TracyFree(ptr);
     auto result = VirtualFree(ptr, 0, MEM_RELEASE);
     ASSERT(result != 0, "VirtualFree failed");
 }
 
-void TryShrinkPages(void* ptr, usize old_size, usize new_size) {
-    (void)ptr;
-    (void)old_size;
-    (void)new_size;
-    // IMPROVE: actually shrink the memory
+bool TryShrinkPages(void* ptr, usize old_size, usize new_size) {
+    // A reservation can't be made smaller, but the pages at its end can be decommitted. FreePages() still
+    // releases the whole reservation.
+    auto const page_size = GetSystemStats().page_size;
+    auto const current_num_pages = old_size / page_size;
+    auto const new_num_pages = (new_size + page_size - 1) / page_size;
+    if (current_num_pages != new_num_pages) {
+        if (!VirtualFree((u8*)ptr + (new_num_pages * page_size),
+                         (current_num_pages - new_num_pages) * page_size,
+                         MEM_DECOMMIT))
+            return false;
+    }
+    TracyFree(ptr);
+    TracyAlloc(ptr, new_size);
+    return true;
 }
 
 int CurrentProcessId() { return _getpid(); }
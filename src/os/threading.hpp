@@ -42,7 +42,53 @@ void YieldThisThread();
 
 u64 CurrentThreadID();
 
-void SetCurrentThreadPriorityRealTime();
+enum class ThreadPriorityClass : u8 {
+    Normal,
+    Background, // Throughput work that can wait: SCHED_BATCH, utility QoS, or below-normal priority.
+    Idle, // Only runs when nothing else wants the CPU: SCHED_IDLE, background QoS, or idle priority.
+    RealTime, // Audio callbacks: SCHED_RR, a macOS time constraint, or time-critical. Often needs privileges.
+    Count,
+};
+
+constexpr String ToString(ThreadPriorityClass c) {
+    switch (c) {
+        case ThreadPriorityClass::Normal: return "normal";
+        case ThreadPriorityClass::Background: return "background";
+        case ThreadPriorityClass::Idle: return "idle";
+        case ThreadPriorityClass::RealTime: return "realtime";
+        case ThreadPriorityClass::Count: break;
+    }
+    return {};
+}
+
+struct ThreadSchedulingPolicy {
+    ThreadPriorityClass priority {ThreadPriorityClass::Normal};
+    // Deprioritised rather than idle I/O, so that reads still make progress when something else is hammering
+    // the drive.
+    bool low_io_priority {};
+    // Bit N allows logical CPU N. When setting, 0 leaves the affinity as it is. Not supported on macOS, where
+    // it reads back as 0.
+    u64 cpu_affinity_mask {};
+};
+
+// Applies as much of the policy as the OS allows; the first part that fails is returned as the error, and
+// the rest is still attempted. Use CurrentThreadSchedulingPolicy() to find out what actually took effect.
+ErrorCodeOr<void> SetCurrentThreadSchedulingPolicy(ThreadSchedulingPolicy const& policy);
+
+// Read back from the OS.
+ThreadSchedulingPolicy CurrentThreadSchedulingPolicy();
+
+namespace fmt {
+
+// For logs, e.g. "background, low I/O priority, CPUs 0xc".
+PUBLIC ErrorCodeOr<void> CustomValueToString(Writer writer, ThreadSchedulingPolicy value, FormatOptions) {
+    TRY(writer.WriteChars(ToString(value.priority)));
+    if (value.low_io_priority) TRY(writer.WriteChars(", low I/O priority"_s));
+    if (value.cpu_affinity_mask) TRY(fmt::FormatToWriter(writer, ", CPUs 0x{x}", value.cpu_affinity_mask));
+    return k_success;
+}
+
+} // namespace fmt
 
 constexpr static usize k_max_thread_name_size = 16;
 void SetThreadName(String name);
@@ -4,10 +4,12 @@
 #include <errno.h>
 #include <linux/futex.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include "misc.hpp"
 #include "threading.hpp"
 
 // The Semaphore class is based on Jeff Preshing's Semaphore class
@@ -114,3 +116,86 @@ void WakeWaitingThreads(Atomic<u32>& v, NumWaitingThreads waiters) {
         PanicIfReached();
     }
 }
+
+// glibc doesn't wrap ioprio_get/ioprio_set, so these are from linux/ioprio.h. IOPRIO_WHO_PROCESS with a
+// thread ID affects just that thread.
+constexpr int k_ioprio_who_process = 1;
+constexpr int k_ioprio_class_shift = 13;
+constexpr int k_ioprio_class_best_effort = 2;
+constexpr int k_ioprio_lowest_best_effort_level = 7;
+
+// A moderate SCHED_RR priority rather than the maximum (99), which would put us above the kernel's own
+// threaded IRQ handlers (50) and the audio server's threads, and at the same level as watchdogs. It's also
+// within the limit RealtimeKit grants by default.
+constexpr int k_realtime_priority = 10;
+
+ErrorCodeOr<void> SetCurrentThreadSchedulingPolicy(ThreadSchedulingPolicy const& policy) {
+    ErrorCodeOr<void> result = k_success;
+    auto const thread_id = (pid_t)syscall(SYS_gettid);
+
+    {
+        struct sched_param params {};
+        int sched_policy = SCHED_OTHER;
+        switch (policy.priority) {
+            case ThreadPriorityClass::Normal: sched_policy = SCHED_OTHER; break;
+            case ThreadPriorityClass::Background: sched_policy = SCHED_BATCH; break;
+            case ThreadPriorityClass::Idle: sched_policy = SCHED_IDLE; break;
+            case ThreadPriorityClass::RealTime:
+                sched_policy = SCHED_RR;
+                params.sched_priority = Min(k_realtime_priority, sched_get_priority_max(SCHED_RR));
+                break;
+            case ThreadPriorityClass::Count: PanicIfReached();
+        }
+        if (auto const ret = pthread_setschedparam(pthread_self(), sched_policy, &params); ret != 0)
+            result = ErrnoErrorCode(ret, "pthread_setschedparam");
+    }
+
+    {
+        // Class 'none' means the I/O priority follows the CPU niceness, which is the default.
+        auto const ioprio = policy.low_io_priority ? ((k_ioprio_class_best_effort << k_ioprio_class_shift) |
+                                                      k_ioprio_lowest_best_effort_level)
+                                                   : 0;
+        if (syscall(SYS_ioprio_set, k_ioprio_who_process, thread_id, ioprio) != 0 && !result.HasError())
+            result = ErrnoErrorCode(errno, "ioprio_set");
+    }
+
+    if (policy.cpu_affinity_mask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (auto const cpu : Range(64))
+            if (policy.cpu_affinity_mask & (1ull << cpu)) CPU_SET(cpu, &cpus);
+        if (auto const ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            ret != 0 && !result.HasError())
+            result = ErrnoErrorCode(ret, "pthread_setaffinity_np");
+    }
+
+    return result;
+}
+
+ThreadSchedulingPolicy CurrentThreadSchedulingPolicy() {
+    ThreadSchedulingPolicy result {};
+
+    int sched_policy;
+    struct sched_param params {};
+    if (pthread_getschedparam(pthread_self(), &sched_policy, &params) == 0) {
+        switch (sched_policy & ~SCHED_RESET_ON_FORK) {
+            case SCHED_BATCH: result.priority = ThreadPriorityClass::Background; break;
+            case SCHED_IDLE: result.priority = ThreadPriorityClass::Idle; break;
+            case SCHED_RR:
+            case SCHED_FIFO: result.priority = ThreadPriorityClass::RealTime; break;
+            default: result.priority = ThreadPriorityClass::Normal; break;
+        }
+    }
+
+    auto const ioprio = syscall(SYS_ioprio_get, k_ioprio_who_process, (pid_t)syscall(SYS_gettid));
+    result.low_io_priority = ioprio == ((k_ioprio_class_best_effort << k_ioprio_class_shift) |
+                                        k_ioprio_lowest_best_effort_level);
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0)
+        for (auto const cpu : Range(64))
+            if (CPU_ISSET(cpu, &cpus)) result.cpu_affinity_mask |= 1ull << cpu;
+
+    return result;
+}
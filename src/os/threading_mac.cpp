@@ -3,9 +3,14 @@
 
 #include <errno.h>
 #include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
 #include <pthread.h>
+#include <pthread/qos.h>
 #include <semaphore.h>
+#include <sys/resource.h>
 
+#include "misc.hpp"
 #include "threading.hpp"
 
 // This is based on Zig's futex
@@ -87,3 +92,81 @@ WaitResult WaitIfValueIsExpected(Atomic<u32>& value, u32 expected, Optional<u32>
     }
     return WaitResult::WokenOrSpuriousOrNotExpected;
 }
+
+ErrorCodeOr<void> SetCurrentThreadSchedulingPolicy(ThreadSchedulingPolicy const& policy) {
+    ErrorCodeOr<void> result = k_success;
+
+    if (policy.priority == ThreadPriorityClass::RealTime) {
+        // macOS gives audio threads a time-constraint policy rather than a POSIX real-time one; SCHED_RR
+        // would replace it with something the scheduler treats worse. Without knowing the callback period,
+        // ask for a short slice with no fixed period, as is usual for audio threads that aren't CoreAudio's.
+        mach_timebase_info_data_t timebase {};
+        mach_timebase_info(&timebase);
+        auto const ms_to_abs_time = ((f64)timebase.denom / (f64)timebase.numer) * 1'000'000;
+        constexpr f64 k_time_quantum_ms = 2.9;
+        thread_time_constraint_policy_data_t constraints {
+            .period = 0,
+            .computation = (u32)(ms_to_abs_time * k_time_quantum_ms * 0.75),
+            .constraint = (u32)(ms_to_abs_time * k_time_quantum_ms * 0.85),
+            .preemptible = 0,
+        };
+        if (auto const ret = thread_policy_set(pthread_mach_thread_np(pthread_self()),
+                                               THREAD_TIME_CONSTRAINT_POLICY,
+                                               (thread_policy_t)&constraints,
+                                               THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+            ret != KERN_SUCCESS)
+            result = ErrnoErrorCode(EPERM, "thread_policy_set");
+    } else {
+        auto qos = QOS_CLASS_DEFAULT;
+        switch (policy.priority) {
+            case ThreadPriorityClass::Normal: qos = QOS_CLASS_DEFAULT; break;
+            case ThreadPriorityClass::Background: qos = QOS_CLASS_UTILITY; break;
+            case ThreadPriorityClass::Idle: qos = QOS_CLASS_BACKGROUND; break;
+            case ThreadPriorityClass::RealTime:
+            case ThreadPriorityClass::Count: PanicIfReached();
+        }
+        if (auto const ret = pthread_set_qos_class_self_np(qos, 0); ret != 0)
+            result = ErrnoErrorCode(ret, "pthread_set_qos_class_self_np");
+    }
+
+    if (setiopolicy_np(IOPOL_TYPE_DISK,
+                       IOPOL_SCOPE_THREAD,
+                       policy.low_io_priority ? IOPOL_UTILITY : IOPOL_DEFAULT) != 0 &&
+        !result.HasError())
+        result = ErrnoErrorCode(errno, "setiopolicy_np");
+
+    // macOS has no way to pin threads to CPUs; cpu_affinity_mask is ignored.
+
+    return result;
+}
+
+ThreadSchedulingPolicy CurrentThreadSchedulingPolicy() {
+    ThreadSchedulingPolicy result {};
+
+    thread_time_constraint_policy_data_t constraints {};
+    mach_msg_type_number_t count = THREAD_TIME_CONSTRAINT_POLICY_COUNT;
+    boolean_t get_default = false;
+    int sched_policy;
+    struct sched_param params {};
+    if (thread_policy_get(pthread_mach_thread_np(pthread_self()),
+                          THREAD_TIME_CONSTRAINT_POLICY,
+                          (thread_policy_t)&constraints,
+                          &count,
+                          &get_default) == KERN_SUCCESS &&
+        !get_default) {
+        result.priority = ThreadPriorityClass::RealTime;
+    } else if (pthread_getschedparam(pthread_self(), &sched_policy, &params) == 0 &&
+               (sched_policy == SCHED_RR || sched_policy == SCHED_FIFO)) {
+        result.priority = ThreadPriorityClass::RealTime;
+    } else {
+        switch (qos_class_self()) {
+            case QOS_CLASS_UTILITY: result.priority = ThreadPriorityClass::Background; break;
+            case QOS_CLASS_BACKGROUND: result.priority = ThreadPriorityClass::Idle; break;
+            default: result.priority = ThreadPriorityClass::Normal; break;
+        }
+    }
+
+    result.low_io_priority = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD) == IOPOL_UTILITY;
+
+    return result;
+}
@@ -13,14 +13,6 @@ void YieldThisThread() { sched_yield(); }
 
 u64 CurrentThreadID() { return (u64)(uintptr)pthread_self(); }
 
-void SetCurrentThreadPriorityRealTime() {
-    struct sched_param params = {};
-    params.sched_priority = sched_get_priority_max(SCHED_RR);
-    // IMPROVE: warn about the error somehow
-    auto ret = pthread_setschedparam(pthread_self(), SCHED_RR, &params);
-    (void)ret;
-}
-
 Mutex::Mutex() { pthread_mutex_init(&mutex.As<pthread_mutex_t>(), nullptr); }
 Mutex::~Mutex() { pthread_mutex_destroy(&mutex.As<pthread_mutex_t>()); }
 void Mutex::Lock() { pthread_mutex_lock(&mutex.As<pthread_mutex_t>()); }
@@ -13,6 +13,7 @@
 
 #include "foundation/foundation.hpp"
 
+#include "misc_windows.hpp"
 #include "threading.hpp"
 
 // The Semaphore class is based on Jeff Preshing's Semaphore class
@@ -67,8 +68,69 @@ void WakeWaitingThreads(Atomic<u32>& v, NumWaitingThreads num_waiters) {
 
 u64 CurrentThreadID() { return (u64)(uintptr_t)GetCurrentThreadId(); }
 
-void SetCurrentThreadPriorityRealTime() {
-    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+// Windows has no way to query background mode, so we remember it.
+static thread_local bool g_thread_in_background_mode {};
+
+ErrorCodeOr<void> SetCurrentThreadSchedulingPolicy(ThreadSchedulingPolicy const& policy) {
+    ErrorCodeOr<void> result = k_success;
+    auto const thread = GetCurrentThread();
+
+    // Background mode is the only documented way to lower a thread's I/O priority. It lowers the CPU
+    // priority too, so it goes first and SetThreadPriority below has the last say.
+    if (policy.low_io_priority != g_thread_in_background_mode) {
+        if (SetThreadPriority(thread,
+                              policy.low_io_priority ? THREAD_MODE_BACKGROUND_BEGIN
+                                                     : THREAD_MODE_BACKGROUND_END)) {
+            g_thread_in_background_mode = policy.low_io_priority;
+        } else {
+            result = Win32ErrorCode(GetLastError(), "SetThreadPriority background mode");
+        }
+    }
+
+    int priority = THREAD_PRIORITY_NORMAL;
+    switch (policy.priority) {
+        case ThreadPriorityClass::Normal: priority = THREAD_PRIORITY_NORMAL; break;
+        case ThreadPriorityClass::Background: priority = THREAD_PRIORITY_BELOW_NORMAL; break;
+        case ThreadPriorityClass::Idle: priority = THREAD_PRIORITY_IDLE; break;
+        case ThreadPriorityClass::RealTime: priority = THREAD_PRIORITY_TIME_CRITICAL; break;
+        case ThreadPriorityClass::Count: PanicIfReached();
+    }
+    if (!SetThreadPriority(thread, priority) && !result.HasError())
+        result = Win32ErrorCode(GetLastError(), "SetThreadPriority");
+
+    if (policy.cpu_affinity_mask)
+        if (!SetThreadAffinityMask(thread, (DWORD_PTR)policy.cpu_affinity_mask) && !result.HasError())
+            result = Win32ErrorCode(GetLastError(), "SetThreadAffinityMask");
+
+    return result;
+}
+
+ThreadSchedulingPolicy CurrentThreadSchedulingPolicy() {
+    ThreadSchedulingPolicy result {};
+    auto const thread = GetCurrentThread();
+
+    switch (GetThreadPriority(thread)) {
+        case THREAD_PRIORITY_BELOW_NORMAL:
+        case THREAD_PRIORITY_LOWEST: result.priority = ThreadPriorityClass::Background; break;
+        case THREAD_PRIORITY_IDLE: result.priority = ThreadPriorityClass::Idle; break;
+        case THREAD_PRIORITY_HIGHEST:
+        case THREAD_PRIORITY_TIME_CRITICAL: result.priority = ThreadPriorityClass::RealTime; break;
+        default: result.priority = ThreadPriorityClass::Normal; break;
+    }
+
+    result.low_io_priority = g_thread_in_background_mode;
+
+    // There's no GetThreadAffinityMask; setting it returns the previous value, which we then put back.
+    DWORD_PTR process_mask;
+    DWORD_PTR system_mask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        if (auto const previous = SetThreadAffinityMask(thread, process_mask)) {
+            SetThreadAffinityMask(thread, previous);
+            result.cpu_affinity_mask = (u64)previous;
+        }
+    }
+
+    return result;
 }
 
 Thread::Thread() {}
@@ -0,0 +1,419 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "parser_fuzz_targets.hpp"
+
+#include "foundation/foundation.hpp"
+#include "os/filesystem.hpp"
+#include "os/misc.hpp"
+#include "utils/logger/logger.hpp"
+#include "utils/reader.hpp"
+
+#include "plugin/common/common_errors.hpp"
+#include "plugin/sample_library/audio_file.hpp"
+#include "plugin/sample_library/sample_library.hpp"
+#include "plugin/state/state_coding.hpp"
+
+// Much lower than normal so that a non-terminating script is reported as a timeout rather than a hang.
+constexpr sample_lib::Options k_fuzz_lua_options {
+    .max_memory_allowed = Mb(32),
+    .max_seconds_allowed = 0.25,
+};
+
+static ErrorCodeOr<void> DecodeBinaryState(StateSnapshot& state, Span<u8 const> data) {
+    usize pos = 0;
+    return CodeState(state,
+                     CodeStateOptions {
+                         .mode = CodeStateOptions::Mode::Decode,
+                         .read_or_write_data = [&](void* out, usize bytes) -> ErrorCodeOr<void> {
+                             if (bytes > data.size - pos) return ErrorCode {CommonError::FileFormatIsInvalid};
+                             CopyMemory(out, data.data + pos, bytes);
+                             pos += bytes;
+                             return k_success;
+                         },
+                         .source = StateSource::PresetFile,
+                         .abbreviated_read = false,
+                     });
+}
+
+int FuzzParser(ParserFuzzTarget target, Span<u8 const> data) {
+    // Reused for every input: fuzzing runs millions of inputs and we don't want to measure the OS allocator.
+    static ArenaAllocator result_arena {PageAllocator::Instance()};
+    static ArenaAllocator scratch_arena {PageAllocator::Instance()};
+    DEFER {
+        result_arena.ResetCursorAndConsolidateRegions();
+        scratch_arena.ResetCursorAndConsolidateRegions();
+    };
+
+    auto reader = Reader::FromMemory(data);
+    switch (target) {
+        case ParserFuzzTarget::Mdata: {
+            auto const _ = sample_lib::ReadMdata(reader, "fuzz.mdata", result_arena, scratch_arena);
+            break;
+        }
+        case ParserFuzzTarget::Lua: {
+            auto const _ =
+                sample_lib::ReadLua(reader, "fuzz.lua", result_arena, scratch_arena, k_fuzz_lua_options);
+            break;
+        }
+        case ParserFuzzTarget::Flac: {
+            auto const _ = DecodeAudioFile(reader, "fuzz.flac", result_arena);
+            break;
+        }
+        case ParserFuzzTarget::Wav: {
+            auto const _ = DecodeAudioFile(reader, "fuzz.wav", result_arena);
+            break;
+        }
+        case ParserFuzzTarget::JsonPreset: {
+            StateSnapshot state {};
+            auto const _ = DecodeJsonState(state, scratch_arena, {(char const*)data.data, data.size});
+            break;
+        }
+        case ParserFuzzTarget::BinaryState: {
+            StateSnapshot state {};
+            auto const _ = DecodeBinaryState(state, data);
+            break;
+        }
+        case ParserFuzzTarget::Count: PanicIfReached(); break;
+    }
+    return 0;
+}
+
+// Generated inputs
+// ==========================================================================================================
+
+static void AppendLe(DynamicArray<u8>& buf, u32 value, u32 num_bytes) {
+    for (auto const i : Range(num_bytes))
+        dyn::Append(buf, (u8)(value >> (i * 8)));
+}
+
+static void AppendChars(DynamicArray<u8>& buf, String chars) { dyn::AppendSpan(buf, chars.ToByteSpan()); }
+
+// A valid 16-bit stereo WAV header followed by a huge number of empty chunks before the data.
+static Span<u8 const> WavWithManyChunks(ArenaAllocator& arena) {
+    constexpr u32 k_num_chunks = 100000;
+    DynamicArray<u8> buf {arena};
+    AppendChars(buf, "RIFF");
+    AppendLe(buf, 4 + (8 + 16) + (k_num_chunks * 8) + (8 + 8), 4);
+    AppendChars(buf, "WAVE");
+    AppendChars(buf, "fmt ");
+    AppendLe(buf, 16, 4);
+    AppendLe(buf, 1, 2); // PCM
+    AppendLe(buf, 2, 2);
+    AppendLe(buf, 44100, 4);
+    AppendLe(buf, 44100 * 4, 4);
+    AppendLe(buf, 4, 2);
+    AppendLe(buf, 16, 2);
+    for (auto _ : Range(k_num_chunks)) {
+        AppendChars(buf, "JUNK");
+        AppendLe(buf, 0, 4);
+    }
+    AppendChars(buf, "data");
+    AppendLe(buf, 8, 4);
+    AppendLe(buf, 0, 4);
+    AppendLe(buf, 0, 4);
+    return buf.ToOwnedSpan();
+}
+
+// A WAV whose data chunk claims far more bytes than the file has.
+static Span<u8 const> WavWithOversizedData(ArenaAllocator& arena) {
+    DynamicArray<u8> buf {arena};
+    AppendChars(buf, "RIFF");
+    AppendLe(buf, 0xfffffff0, 4);
+    AppendChars(buf, "WAVE");
+    AppendChars(buf, "fmt ");
+    AppendLe(buf, 16, 4);
+    AppendLe(buf, 1, 2);
+    AppendLe(buf, 1, 2);
+    AppendLe(buf, 44100, 4);
+    AppendLe(buf, 44100 * 2, 4);
+    AppendLe(buf, 2, 2);
+    AppendLe(buf, 16, 2);
+    AppendChars(buf, "data");
+    AppendLe(buf, 0xffffff00, 4);
+    AppendLe(buf, 0x12345678, 4);
+    return buf.ToOwnedSpan();
+}
+
+// A FLAC STREAMINFO block that promises audio that never comes.
+static Span<u8 const> FlacWithoutFrames(ArenaAllocator& arena) {
+    DynamicArray<u8> buf {arena};
+    AppendChars(buf, "fLaC");
+    dyn::Append(buf, (u8)0x80); // last metadata block, STREAMINFO
+    AppendLe(buf, 0x220000, 3); // 34 bytes, big-endian
+    dyn::AppendSpan(buf,
+                    Array<u8, 34> {
+                        0x10, 0x00, 0x10, 0x00, // block sizes: 4096
+                        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // frame sizes: unknown
+                        0x0a, 0xc4, 0x42, // 44100 Hz, 2 channels
+                        0xf0, 0x00, 0x0f, 0x42, 0x40, // 16 bits, 1000000 frames
+                    }
+                        .Items());
+    return buf.ToOwnedSpan();
+}
+
+static Span<u8 const> NestedJson(ArenaAllocator& arena) {
+    constexpr u32 k_depth = 200;
+    DynamicArray<u8> buf {arena};
+    AppendChars(buf, "{\"params\":");
+    for (auto _ : Range(k_depth))
+        dyn::Append(buf, (u8)'[');
+    for (auto _ : Range(k_depth))
+        dyn::Append(buf, (u8)']');
+    dyn::Append(buf, (u8)'}');
+    return buf.ToOwnedSpan();
+}
+
+static ErrorCodeOr<Span<u8 const>> EncodeBinaryState(StateSnapshot const& state, ArenaAllocator& arena) {
+    DynamicArray<u8> buf {arena};
+    TRY(CodeState(const_cast<StateSnapshot&>(state),
+                  CodeStateOptions {
+                      .mode = CodeStateOptions::Mode::Encode,
+                      .read_or_write_data = [&](void* data, usize bytes) -> ErrorCodeOr<void> {
+                          dyn::AppendSpan(buf, Span<u8 const> {(u8 const*)data, bytes});
+                          return k_success;
+                      },
+                      .source = StateSource::PresetFile,
+                      .abbreviated_read = false,
+                  }));
+    return buf.ToOwnedSpan();
+}
+
+// Seed corpus
+// ==========================================================================================================
+
+static ErrorCodeOr<void> AppendFiles(DynamicArray<Span<u8 const>>& corpus,
+                                     ArenaAllocator& arena,
+                                     String folder,
+                                     String wildcard) {
+    for (auto const path : TRY(GetFilesRecursive(arena, folder, wildcard))) {
+        auto const data = TRY(ReadEntireFile(path, arena));
+        dyn::Append(corpus, data.ToByteSpan());
+    }
+    return k_success;
+}
+
+ErrorCodeOr<Span<Span<u8 const>>>
+ParserSeedCorpus(ParserFuzzTarget target, String test_files_folder, ArenaAllocator& arena) {
+    DynamicArray<Span<u8 const>> corpus {arena};
+    auto const audio_folder = path::Join(arena, Array {test_files_folder, "audio"_s});
+    auto const libraries_folder = path::Join(arena, Array {test_files_folder, "libraries"_s});
+    auto const presets_folder = path::Join(arena, Array {test_files_folder, "presets"_s});
+
+    switch (target) {
+        case ParserFuzzTarget::Mdata: {
+            TRY(AppendFiles(corpus, arena, libraries_folder, "*.mdata"));
+            // Truncations find the paths that trust the header's sizes.
+            auto const num_files = corpus.size;
+            for (auto const i : Range(num_files)) {
+                dyn::Append(corpus, corpus[i].SubSpan(0, corpus[i].size / 2));
+                dyn::Append(corpus, corpus[i].SubSpan(0, Min<usize>(corpus[i].size, 64)));
+            }
+            break;
+        }
+        case ParserFuzzTarget::Lua: {
+            TRY(AppendFiles(corpus, arena, libraries_folder, "*.lua"));
+            for (auto const code : Array {
+                     "while true do end"_s,
+                     "local function f(n) return f(n + 1) + 1 end return f(0)"_s,
+                     "local t = {} for i = 1, 1e9 do t[i] = string.rep('x', 1000) end"_s,
+                     "return floe.new_library({})"_s,
+                 })
+                dyn::Append(corpus, code.ToByteSpan());
+            break;
+        }
+        case ParserFuzzTarget::Flac: {
+            TRY(AppendFiles(corpus, arena, test_files_folder, "*.flac"));
+            dyn::Append(corpus, FlacWithoutFrames(arena));
+            break;
+        }
+        case ParserFuzzTarget::Wav: {
+            TRY(AppendFiles(corpus, arena, audio_folder, "*.wav"));
+            dyn::Append(corpus, WavWithManyChunks(arena));
+            dyn::Append(corpus, WavWithOversizedData(arena));
+            break;
+        }
+        case ParserFuzzTarget::JsonPreset: {
+            TRY(AppendFiles(corpus, arena, presets_folder, "*.mirage-*"));
+            dyn::Append(corpus, NestedJson(arena));
+            break;
+        }
+        case ParserFuzzTarget::BinaryState: {
+            // There are no binary presets in the repo, so we make them from the legacy ones.
+            DynamicArray<Span<u8 const>> json_presets {arena};
+            TRY(AppendFiles(json_presets, arena, presets_folder, "*.mirage-*"));
+            for (auto const json : json_presets) {
+                StateSnapshot state {};
+                if (DecodeJsonState(state, arena, {(char const*)json.data, json.size}).HasError()) continue;
+                auto const binary = TRY(EncodeBinaryState(state, arena));
+                dyn::Append(corpus, binary);
+                dyn::Append(corpus, binary.SubSpan(0, binary.size / 3));
+            }
+            break;
+        }
+        case ParserFuzzTarget::Count: PanicIfReached(); break;
+    }
+
+    return corpus.ToOwnedSpan();
+}
+
+Optional<String> FindTestFilesFolder(ArenaAllocator& arena) {
+    auto const exe_path = CurrentExecutablePath(arena);
+    if (exe_path.HasError()) return nullopt;
+
+    auto dir = String(exe_path.Value());
+    constexpr usize k_max_folder_heirarchy = 20;
+    for (auto _ : Range(k_max_folder_heirarchy)) {
+        auto const opt_dir = path::Directory(dir);
+        if (!opt_dir) break;
+        dir = *opt_dir;
+        auto const candidate = path::Join(arena, Array {dir, "test_files"_s});
+        if (auto const o = GetFileType(candidate); o.HasValue() && o.Value() == FileType::Directory)
+            return candidate;
+    }
+    return nullopt;
+}
+
+// Standalone driver
+// ==========================================================================================================
+
+static void Mutate(DynamicArray<u8>& data, u64& seed) {
+    constexpr usize k_max_size = Mb(4);
+    constexpr Array<u32, 7> k_interesting_values {0, 1, 0x7f, 0x80, 0xffff, 0x7fffffff, 0xffffffff};
+
+    auto const num_mutations = RandomIntInRange<u32>(seed, 1, 4);
+    for (auto _ : Range(num_mutations)) {
+        if (data.size == 0) {
+            dyn::Append(data, (u8)RandomIntInRange<u32>(seed, 0, 255));
+            continue;
+        }
+        auto const pos = RandomIntInRange<usize>(seed, 0, data.size - 1);
+        switch (RandomIntInRange<u32>(seed, 0, 6)) {
+            case 0: data[pos] ^= (u8)(1u << RandomIntInRange<u32>(seed, 0, 7)); break;
+            case 1: data[pos] = (u8)RandomElement(k_interesting_values.Items(), seed); break;
+            case 2: {
+                auto const value = RandomElement(k_interesting_values.Items(), seed);
+                for (auto const i : Range(Min<usize>(4, data.size - pos)))
+                    data[pos + i] = (u8)(value >> (i * 8));
+                break;
+            }
+            case 3: {
+                auto const size = RandomIntInRange<usize>(seed, 1, Min<usize>(data.size - pos, 256));
+                dyn::Remove(data, pos, size);
+                break;
+            }
+            case 4: {
+                if (data.size >= k_max_size) break;
+                auto const size = RandomIntInRange<usize>(seed, 1, Min<usize>(data.size - pos, 256));
+                Array<u8, 256> chunk;
+                CopyMemory(chunk.data, data.data + pos, size);
+                auto const insert_pos = RandomIntInRange<usize>(seed, 0, data.size);
+                dyn::InsertSpan(data, insert_pos, Span<u8 const> {chunk.data, size});
+                break;
+            }
+            case 5: {
+                if (data.size >= k_max_size) break;
+                auto const size = RandomIntInRange<u32>(seed, 1, 16);
+                for (auto _ : Range(size))
+                    dyn::Insert(data, pos, (u8)RandomIntInRange<u32>(seed, 0, 255));
+                break;
+            }
+            case 6: dyn::Resize(data, pos); break;
+        }
+    }
+}
+
+int RunStandaloneFuzzer(ParserFuzzTarget target, int argc, char** argv) {
+    StartupCrashHandler();
+    DEFER { ShutdownCrashHandler(); };
+
+    ArenaAllocator arena {PageAllocator::Instance()};
+    auto const target_name = k_parser_fuzz_target_names[ToInt(target)];
+
+    u64 iterations = 20000;
+    u64 seed = SeedFromTime();
+    f64 max_seconds_per_input = 3;
+    f64 max_total_seconds = 60;
+    DynamicArray<String> input_files {arena};
+    for (auto const arg : Args(argc, argv, false)) {
+        if (StartsWithSpan(arg, "--iterations="_s))
+            iterations = ParseInt(arg.SubSpan(13), ParseIntBase::Decimal).ValueOr(iterations);
+        else if (StartsWithSpan(arg, "--seed="_s))
+            seed = (u64)ParseInt(arg.SubSpan(7), ParseIntBase::Decimal).ValueOr((s64)seed);
+        else if (StartsWithSpan(arg, "--max-seconds-per-input="_s))
+            max_seconds_per_input = (f64)ParseInt(arg.SubSpan(24), ParseIntBase::Decimal).ValueOr(3);
+        else if (StartsWithSpan(arg, "--max-total-seconds="_s))
+            max_total_seconds = (f64)ParseInt(arg.SubSpan(20), ParseIntBase::Decimal).ValueOr(60);
+        else if (StartsWith(arg, '-')) {
+            stdout_log.ErrorLn("Unknown option: {}", arg);
+            return 1;
+        } else
+            dyn::Append(input_files, arg);
+    }
+
+    DynamicArray<Span<u8 const>> corpus {arena};
+    if (input_files.size) {
+        // Reproducing: run just the given files, like libFuzzer does.
+        iterations = 0;
+        for (auto const path : input_files) {
+            auto const data = ReadEntireFile(path, arena);
+            if (data.HasError()) {
+                stdout_log.ErrorLn("Failed to read {}: {}", path, data.Error());
+                return 1;
+            }
+            dyn::Append(corpus, data.Value().ToByteSpan());
+        }
+    } else {
+        auto const test_files = FindTestFilesFolder(arena);
+        if (!test_files) {
+            stdout_log.ErrorLn("Cannot find the test_files folder");
+            return 1;
+        }
+        auto const seeds = ParserSeedCorpus(target, *test_files, arena);
+        if (seeds.HasError()) {
+            stdout_log.ErrorLn("Failed to create the seed corpus: {}", seeds.Error());
+            return 1;
+        }
+        dyn::AppendSpan(corpus, seeds.Value());
+    }
+    if (!corpus.size) dyn::Append(corpus, Span<u8 const> {});
+
+    stdout_log.InfoLn("Fuzzing {}: {} seed inputs, {} iterations, --seed={}",
+                      target_name,
+                      corpus.size,
+                      iterations,
+                      seed);
+
+    f64 slowest_seconds = 0;
+    auto run = [&](Span<u8 const> input, u64 iteration) {
+        Stopwatch const stopwatch;
+        FuzzParser(target, input);
+        auto const seconds = stopwatch.SecondsElapsed();
+        slowest_seconds = Max(slowest_seconds, seconds);
+        if (seconds <= max_seconds_per_input) return true;
+
+        auto const path = fmt::Format(arena, "slow-unit-{}-{}", target_name, iteration);
+        auto const _ = WriteFile(path, input);
+        stdout_log.ErrorLn("Input took {.2} s, saved to {}", seconds, path);
+        return false;
+    };
+
+    for (auto const [index, input] : Enumerate<u64>(corpus))
+        if (!run(input, index)) return 1;
+
+    Stopwatch const total_stopwatch;
+    DynamicArray<u8> mutated {arena};
+    u64 iterations_done = 0;
+    for (; iterations_done != iterations; ++iterations_done) {
+        if (total_stopwatch.SecondsElapsed() > max_total_seconds) break;
+        dyn::Assign(mutated, RandomElement(corpus.Items(), seed));
+        Mutate(mutated, seed);
+        if (!run(mutated, corpus.size + iterations_done)) return 1;
+    }
+
+    stdout_log.InfoLn("Fuzzing {} done: {} iterations, slowest input {.3} s",
+                      target_name,
+                      iterations_done,
+                      slowest_seconds);
+    return 0;
+}
@@ -0,0 +1,45 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+
+// Every parser that reads files from the user's drive, wrapped so that it can be fed arbitrary bytes. Used by
+// the libFuzzer-compatible entry points in parser_fuzzer.cpp and by the throughput benchmark.
+
+enum class ParserFuzzTarget : u8 {
+    Mdata,
+    Lua,
+    Flac,
+    Wav,
+    JsonPreset,
+    BinaryState,
+    Count,
+};
+
+constexpr auto k_parser_fuzz_target_names = Array {
+    "mdata"_s,
+    "lua"_s,
+    "flac"_s,
+    "wav"_s,
+    "json-preset"_s,
+    "binary-state"_s,
+};
+static_assert(k_parser_fuzz_target_names.size == ToInt(ParserFuzzTarget::Count));
+
+// Runs the parser on the data, ignoring whether it succeeds. Always returns 0, as libFuzzer requires.
+int FuzzParser(ParserFuzzTarget target, Span<u8 const> data);
+
+// Inputs to start from: the matching files in the repo's test_files folder plus some generated inputs that
+// are known to stress the parser, such as huge chunk counts or non-terminating Lua. Allocated in the arena.
+ErrorCodeOr<Span<Span<u8 const>>>
+ParserSeedCorpus(ParserFuzzTarget target, String test_files_folder, ArenaAllocator& arena);
+
+// Searches upwards from the executable, the same as the tests do.
+Optional<String> FindTestFilesFolder(ArenaAllocator& arena);
+
+// A minimal replacement for libFuzzer's driver so that the targets can run without a libFuzzer runtime.
+// Runs every seed (or just the files given on the command line), then random mutations of the seeds. Fails
+// if any input takes longer than --max-seconds-per-input, saving it to the working directory. Other options:
+// --iterations, --max-total-seconds, and --seed to reproduce a run.
+int RunStandaloneFuzzer(ParserFuzzTarget target, int argc, char** argv);
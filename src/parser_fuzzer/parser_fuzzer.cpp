@@ -0,0 +1,25 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// One of these is built per parser with FLOE_FUZZ_TARGET set to a ParserFuzzTarget. By default main() is our
+// own driver. To fuzz with libFuzzer, build with -Dlibfuzzer=true, which sets FLOE_LIBFUZZER=1 so that
+// there's no main() and each fuzzer is a static library, then link that with -fsanitize=fuzzer so that
+// libFuzzer provides main().
+
+#include "foundation/foundation.hpp"
+
+#include "parser_fuzz_targets.hpp"
+
+#ifndef FLOE_FUZZ_TARGET
+#error "FLOE_FUZZ_TARGET must be defined"
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(u8 const* data, usize size) {
+    return FuzzParser(ParserFuzzTarget::FLOE_FUZZ_TARGET, {data, size});
+}
+
+#if !FLOE_LIBFUZZER
+int main(int argc, char** argv) {
+    return RunStandaloneFuzzer(ParserFuzzTarget::FLOE_FUZZ_TARGET, argc, argv);
+}
+#endif
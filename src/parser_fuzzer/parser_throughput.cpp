@@ -0,0 +1,98 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Runs each parser over its seed corpus and reports the throughput and the slowest single input, so that
+// slow-path regressions show up as numbers rather than as hangs in production.
+
+#include "foundation/foundation.hpp"
+#include "os/misc.hpp"
+#include "utils/logger/logger.hpp"
+
+#include "parser_fuzz_targets.hpp"
+
+constexpr f64 k_min_seconds_per_input = 0.05;
+constexpr u32 k_max_runs_per_input = 1000;
+
+struct ParserThroughput {
+    usize num_inputs;
+    usize total_bytes;
+    f64 total_seconds; // average time per input, summed
+    f64 worst_seconds;
+    usize worst_input_index;
+    usize worst_input_size;
+};
+
+static ParserThroughput MeasureThroughput(ParserFuzzTarget target, Span<Span<u8 const> const> corpus) {
+    ParserThroughput result {.num_inputs = corpus.size};
+    for (auto const [index, input] : Enumerate(corpus)) {
+        f64 seconds = 0;
+        f64 worst_run = 0;
+        u32 num_runs = 0;
+        while (num_runs == 0 || (seconds < k_min_seconds_per_input && num_runs < k_max_runs_per_input)) {
+            Stopwatch const stopwatch;
+            FuzzParser(target, input);
+            auto const run_seconds = stopwatch.SecondsElapsed();
+            seconds += run_seconds;
+            worst_run = Max(worst_run, run_seconds);
+            ++num_runs;
+        }
+
+        result.total_bytes += input.size;
+        result.total_seconds += seconds / num_runs;
+        if (worst_run > result.worst_seconds) {
+            result.worst_seconds = worst_run;
+            result.worst_input_index = index;
+            result.worst_input_size = input.size;
+        }
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    StartupCrashHandler();
+    DEFER { ShutdownCrashHandler(); };
+
+    ArenaAllocator arena {PageAllocator::Instance()};
+
+    Optional<String> only_target {};
+    for (auto const arg : Args(argc, argv, false)) {
+        if (StartsWithSpan(arg, "--target="_s)) {
+            only_target = arg.SubSpan(9);
+        } else {
+            stdout_log.ErrorLn("Usage: {} [--target=<name>]", FromNullTerminated(argv[0]));
+            return 1;
+        }
+    }
+
+    auto const test_files = FindTestFilesFolder(arena);
+    if (!test_files) {
+        stdout_log.ErrorLn("Cannot find the test_files folder");
+        return 1;
+    }
+
+    for (auto const target_index : Range(ToInt(ParserFuzzTarget::Count))) {
+        auto const target = (ParserFuzzTarget)target_index;
+        auto const name = k_parser_fuzz_target_names[target_index];
+        if (only_target && *only_target != name) continue;
+
+        auto const corpus = ParserSeedCorpus(target, *test_files, arena);
+        if (corpus.HasError()) {
+            stdout_log.ErrorLn("{}: failed to create the corpus: {}", name, corpus.Error());
+            return 1;
+        }
+
+        auto const t = MeasureThroughput(target, corpus.Value());
+        auto const mb_per_second =
+            t.total_seconds > 0 ? ((f64)t.total_bytes / (f64)Mb(1)) / t.total_seconds : 0.0;
+        stdout_log.InfoLn("{}: {} inputs, {} bytes, {.2} MB/s, worst input #{} ({} bytes) {.3} ms",
+                          name,
+                          t.num_inputs,
+                          t.total_bytes,
+                          mb_per_second,
+                          t.worst_input_index,
+                          t.worst_input_size,
+                          t.worst_seconds * 1000);
+    }
+
+    return 0;
+}
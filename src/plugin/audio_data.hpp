@@ -11,5 +11,6 @@ struct AudioData {
     u8 channels {};
     f32 sample_rate {};
     u32 num_frames {};
+    u32 onset_frame {}; // first audible frame, less a short margin; set by the loader
     Span<f32 const> interleaved_samples {};
 };
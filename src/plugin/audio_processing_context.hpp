@@ -5,6 +5,7 @@
 #include "foundation/foundation.hpp"
 
 #include "common/constants.hpp"
+#include "processing/coefficient_tables.hpp"
 #include "processing/midi.hpp"
 
 struct MidiNoteState {
@@ -51,4 +52,5 @@ struct AudioProcessingContext {
     u32 process_block_size_max = 512;
     f64 tempo = 120;
     MidiNoteState midi_note_state;
+    CoefficientTables const* coefficient_tables {}; // for sample_rate, shared by every instance
 };
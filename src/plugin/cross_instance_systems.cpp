@@ -5,11 +5,12 @@
 
 #include "foundation/foundation.hpp"
 #include "os/misc.hpp"
+#include "utils/arena_usage.hpp"
 
 #include "settings/settings_file.hpp"
 
 CrossInstanceSystems::CrossInstanceSystems()
-    : arena(PageAllocator::Instance(), Kb(16))
+    : arena(PageAllocator::Instance(), RecommendedArenaSize("cross-instance"_s, Kb(16)))
     , logger(g_log_file)
     , paths(CreateFloePaths(arena))
     , settings(paths)
@@ -27,7 +28,7 @@ CrossInstanceSystems::CrossInstanceSystems()
                 case ScanFolderType::Count: PanicIfReached();
             }
         });
-    thread_pool.Init("Global", {});
+    arena.TrackUsage(arena_usage);
 
     // =========
     bool file_is_new = false;
@@ -42,6 +43,15 @@ CrossInstanceSystems::CrossInstanceSystems()
     ASSERT(settings.settings.gui.window_width != 0);
 
     available_libraries.SetExtraScanFolders(settings.settings.filesystem.extra_libraries_scan_folders);
+
+    // Decoding and scanning are throughput work; they shouldn't take CPU or disk time from the audio threads.
+    ThreadSchedulingPolicy const background_scheduling {
+        .priority = settings.settings.engine.background_thread_priority,
+        .low_io_priority = settings.settings.engine.background_threads_low_io_priority,
+        .cpu_affinity_mask = settings.settings.engine.background_threads_cpu_mask,
+    };
+    thread_pool.Init("Global", {}, background_scheduling);
+    SetSchedulingPolicy(sample_library_loader, background_scheduling);
 }
 
 CrossInstanceSystems::~CrossInstanceSystems() {
@@ -51,4 +61,8 @@ CrossInstanceSystems::~CrossInstanceSystems() {
     }
 
     settings.tracking.filesystem_change_listeners.Remove(folder_settings_listener_id);
+
+    arena.usage_stats = nullptr;
+    RecordArenaUsage("cross-instance"_s, arena_usage);
+    LogArenaUsage(logger);
 }
@@ -17,6 +17,7 @@ struct CrossInstanceSystems {
     ~CrossInstanceSystems();
 
     u64 folder_settings_listener_id;
+    ArenaUsageStats arena_usage {};
     ArenaAllocator arena;
     ThreadsafeErrorNotifications error_notifications {};
     Logger& logger;
@@ -9,6 +9,7 @@
 #include "param.hpp"
 #include "param_info.hpp"
 #include "processing/stereo_audio_frame.hpp"
+#include "processing/volume_fade.hpp"
 #include "smoothed_value_system.hpp"
 
 struct ParamState {
@@ -42,6 +43,39 @@ struct EffectWetDryHelper {
     FloeSmoothedValueSystem::FloatId const m_dry_smoother_id;
 };
 
+// Clearing the delay memory of an effect can take a long time for large buffers at high sample rates. Rather
+// than clear it all in one go when the effect is reset, we clear a chunk at the start of each block. Until
+// the memory is clean the effect outputs what a cleared effect would: its dry signal at the usual gain and no
+// wet signal. After that, the processed output is faded in from that.
+struct EffectTimeSlicedReset {
+    static constexpr usize k_max_bytes_per_block = Kb(256);
+    static constexpr f32 k_fade_in_ms = 10;
+
+    void Begin() { in_progress = true; }
+
+    // audio-thread
+    // clear_chunk(max_bytes) should clear the next chunk of memory and return true when it's all clear. Returns
+    // true if the effect is ready to process audio.
+    template <typename Function>
+    bool Continue(f32 sample_rate, Function&& clear_chunk) {
+        if (!in_progress) return true;
+        if (!clear_chunk(k_max_bytes_per_block)) return false;
+        in_progress = false;
+        fade.ForceSetAsFadeIn(sample_rate, k_fade_in_ms);
+        return true;
+    }
+
+    // audio-thread
+    // cleared is what the effect outputs while its memory is being cleared.
+    StereoAudioFrame FadeIn(StereoAudioFrame processed, StereoAudioFrame cleared) {
+        if (auto const f = fade.GetFade(); f != 1) return LinearInterpolate(f, cleared, processed);
+        return processed;
+    }
+
+    bool in_progress = false;
+    VolumeFade fade {VolumeFade::State::FullVolume};
+};
+
 class EffectLegacyModeHelper;
 
 struct ScratchBuffers {
@@ -12,9 +12,41 @@
 #include "effect.hpp"
 #include "param_info.hpp"
 #include "processing/filters.hpp"
+#include "sample_library/audio_file.hpp"
 #include "sample_library/sample_library.hpp"
 #include "smoothed_value_system.hpp"
 
+constexpr f64 k_convolution_ir_fade_out_seconds = 0.02;
+
+// How much of an IR to convolve with. Convolution cost grows with the IR's length, so we skip the inaudible
+// tail, and also stop at max_ir_ms if that isn't 0. Finding the tail reads the whole IR, but only when a
+// convolver is built from it, which costs more anyway; samples for instruments are never analysed this way.
+inline u32 ConvolutionIrNumFrames(AudioData const& ir, u32 max_ir_ms) {
+    auto num_frames = Min(DetectAudibleLength(ir), ir.num_frames);
+    if (max_ir_ms)
+        num_frames = Min(num_frames, Max((u32)((f64)ir.sample_rate * max_ir_ms / 1000.0), 1u));
+    return num_frames;
+}
+
+// Copies the start of a stereo IR into out, whose size sets the number of frames. If that's less than the
+// whole IR, the end is faded out so that cutting it short doesn't add a click to the reverb's tail.
+inline void CopyTrimmedConvolutionIr(AudioData const& ir, Span<f32> out) {
+    ASSERT(ir.channels == 2);
+    auto const num_frames = (u32)(out.size / 2);
+    ASSERT(num_frames <= ir.num_frames);
+    CopyMemory(out.data, ir.interleaved_samples.data, out.ToByteSpan().size);
+    if (num_frames == ir.num_frames) return;
+
+    auto const fade_frames =
+        Min((u32)((f64)ir.sample_rate * k_convolution_ir_fade_out_seconds), num_frames / 4);
+    for (auto const i : Range(fade_frames)) {
+        auto const frame = num_frames - fade_frames + i;
+        auto const gain = (f32)(fade_frames - i) / (f32)(fade_frames + 1);
+        out[(frame * 2) + 0] *= gain;
+        out[(frame * 2) + 1] *= gain;
+    }
+}
+
 class ConvolutionReverb final : public Effect {
   public:
     ConvolutionReverb(FloeSmoothedValueSystem& s)
@@ -39,6 +71,18 @@ class ConvolutionReverb final : public Effect {
             return result;
         }
 
+        // While the convolver is being cleared we output only the dry part of what it would output.
+        if (!time_sliced_reset.Continue(context.sample_rate, [this](usize max_bytes) {
+                return ContinueZeroingConvolver(max_bytes);
+            })) {
+            for (auto [frame_index, frame] : Enumerate<u32>(io_frames)) {
+                auto const cleared = m_wet_dry.MixStereo(m_smoothed_value_system, frame_index, {}, frame);
+                frame = MixOnOffSmoothing(cleared, frame, frame_index);
+            }
+            result.did_any_processing = true;
+            return result;
+        }
+
         auto input_channels = scratch_buffers.buf1.Channels();
         CopyFramesToSeparateChannels(input_channels, io_frames);
 
@@ -61,7 +105,9 @@ class ConvolutionReverb final : public Effect {
             auto [filter_coeffs, mix] =
                 m_smoothed_value_system.Value(m_filter_coeffs_smoother_id, frame_index);
             wet = Process(m_filter, filter_coeffs, wet * mix);
+            auto const cleared = m_wet_dry.MixStereo(m_smoothed_value_system, frame_index, {}, frame);
             wet = m_wet_dry.MixStereo(m_smoothed_value_system, frame_index, wet, frame);
+            wet = time_sliced_reset.FadeIn(wet, cleared);
 
             if (auto f = m_fade.GetFade(); f != 1) wet = LinearInterpolate(f, frame, wet);
 
@@ -95,6 +141,7 @@ class ConvolutionReverb final : public Effect {
 
         m_remaining_tail_length = 0;
         m_filter = {};
+        time_sliced_reset.in_progress = false; // a new convolver starts off clear
         if (m_convolver)
             m_max_tail_length = (u32)NumFrames(*m_convolver);
         else
@@ -108,7 +155,7 @@ class ConvolutionReverb final : public Effect {
     void ConvolutionIrDataLoaded(AudioData const* audio_data) {
         DeletedUnusedConvolvers();
         if (audio_data)
-            m_desired_convolver.Store(CreateConvolver(*audio_data));
+            m_desired_convolver.Store(CreateConvolver(*audio_data, max_ir_ms));
         else
             m_desired_convolver.Store(nullptr);
     }
@@ -122,19 +169,26 @@ class ConvolutionReverb final : public Effect {
     // [main-thread]
     Optional<sample_lib::IrId> ir_index = nullopt; // May differ to what is actually loaded
 
+    // [main-thread] Limits the length of IRs loaded after it's set, 0 for no limit.
+    u32 max_ir_ms = 0;
+
+    // [audio-thread]
+    EffectTimeSlicedReset time_sliced_reset;
+
   private:
-    static StereoConvolver* CreateConvolver(AudioData const& audio_data) {
+    static StereoConvolver* CreateConvolver(AudioData const& audio_data, u32 max_ir_ms) {
         auto num_channels = audio_data.channels;
-        auto num_frames = audio_data.num_frames;
+        auto num_frames = ConvolutionIrNumFrames(audio_data, max_ir_ms);
 
         ASSERT(num_channels && num_frames);
         ASSERT(num_channels == 2);
 
-        DynamicArray<f32> channel_samples {PageAllocator::Instance()};
-        dyn::Resize(channel_samples, num_frames);
+        DynamicArray<f32> ir_samples {PageAllocator::Instance()};
+        dyn::Resize(ir_samples, num_frames * 2);
+        CopyTrimmedConvolutionIr(audio_data, ir_samples);
 
         auto result = CreateStereoConvolver();
-        Init(*result, audio_data.interleaved_samples.data, (int)num_frames);
+        Init(*result, ir_samples.data, (int)num_frames);
 
         return result;
     }
@@ -163,16 +217,30 @@ class ConvolutionReverb final : public Effect {
     void ResetInternal() override {
         m_filter = {};
 
-        if (m_convolver) Zero(*m_convolver);
+        if (m_convolver) {
+            m_zero_step = 0;
+            time_sliced_reset.Begin();
+        }
 
         m_remaining_tail_length = 0;
     }
 
+    bool ContinueZeroingConvolver(usize max_bytes) {
+        if (!m_convolver) return true;
+        auto const num_steps = NumZeroSteps(*m_convolver);
+        usize bytes_zeroed = 0;
+        while (m_zero_step < num_steps && bytes_zeroed < max_bytes)
+            bytes_zeroed += (usize)ZeroStep(*m_convolver, m_zero_step++);
+        return m_zero_step == num_steps;
+    }
+
     u32 m_remaining_tail_length {};
     u32 m_max_tail_length {};
 
     VolumeFade m_fade {VolumeFade::State::FullVolume};
 
+    int m_zero_step {};
+
     StereoConvolver* m_convolver {}; // audio-thread only
 
     static constexpr uintptr k_desired_convolver_consumed = 1; // must be an invalid pointer
@@ -12,7 +12,10 @@ class Delay final : public Effect {
     Delay(FloeSmoothedValueSystem& s) : Effect(s, EffectType::Delay), delay(vitfx::delay::Create()) {}
     ~Delay() override { vitfx::delay::Destroy(delay); }
 
-    void ResetInternal() override { vitfx::delay::HardReset(*delay); }
+    void ResetInternal() override {
+        vitfx::delay::BeginHardReset(*delay);
+        time_sliced_reset.Begin();
+    }
 
     virtual void PrepareToPlay(AudioProcessingContext const& context) override {
         vitfx::delay::SetSampleRate(*delay, (int)context.sample_rate);
@@ -20,9 +23,19 @@ class Delay final : public Effect {
 
     bool ProcessBlock(Span<StereoAudioFrame> io_frames,
                       ScratchBuffers scratch_buffers,
-                      AudioProcessingContext const&) override {
+                      AudioProcessingContext const& context) override {
         if (!ShouldProcessBlock()) return false;
 
+        // While the memory is being cleared we output only the dry part of what the delay would output.
+        auto const dry_gain = vitfx::DryGain(params[ToInt(vitfx::delay::Params::Mix)]);
+        if (!time_sliced_reset.Continue(context.sample_rate, [this](usize max_bytes) {
+                return vitfx::delay::ContinueHardReset(*delay, (int)(max_bytes / sizeof(f32)));
+            })) {
+            for (auto [frame_index, frame] : Enumerate<u32>(io_frames))
+                frame = MixOnOffSmoothing(frame * dry_gain, frame, frame_index);
+            return true;
+        }
+
         auto wet = scratch_buffers.buf1.Interleaved();
         wet.size = io_frames.size;
         CopyMemory(wet.data, io_frames.data, io_frames.size * sizeof(StereoAudioFrame));
@@ -45,8 +58,10 @@ class Delay final : public Effect {
             pos += chunk_size;
         }
 
-        for (auto const frame_index : Range((u32)io_frames.size))
-            io_frames[frame_index] = MixOnOffSmoothing(wet[frame_index], io_frames[frame_index], frame_index);
+        for (auto [frame_index, frame] : Enumerate<u32>(io_frames)) {
+            auto const processed = time_sliced_reset.FadeIn(wet[frame_index], frame * dry_gain);
+            frame = MixOnOffSmoothing(processed, frame, frame_index);
+        }
 
         return true;
     }
@@ -137,6 +152,7 @@ class Delay final : public Effect {
     }
 
     vitfx::delay::Delay* delay {};
+    EffectTimeSlicedReset time_sliced_reset;
     SyncedTimes synced_time_l {};
     SyncedTimes synced_time_r {};
     f32 free_time_hz_l {};
@@ -28,6 +28,7 @@ struct EffectInfo {
     String name;
     u8 id;
     ParamIndex on_param_index;
+    ParameterModule module; // the second module part of all of this effect's params
 };
 
 consteval auto CreateEffectInfos() {
@@ -42,6 +43,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Distortion",
                     .id = 1, // never change
                     .on_param_index = ParamIndex::DistortionOn,
+                    .module = ParameterModule::Distortion,
                 };
                 break;
             case EffectType::BitCrush:
@@ -51,6 +53,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Bit Crush",
                     .id = 2, // never change
                     .on_param_index = ParamIndex::BitCrushOn,
+                    .module = ParameterModule::Bitcrush,
                 };
                 break;
             case EffectType::Compressor:
@@ -59,6 +62,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Compressor",
                     .id = 3, // never change
                     .on_param_index = ParamIndex::CompressorOn,
+                    .module = ParameterModule::Compressor,
                 };
                 break;
             case EffectType::FilterEffect:
@@ -68,6 +72,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Filter",
                     .id = 4, // never change
                     .on_param_index = ParamIndex::FilterOn,
+                    .module = ParameterModule::Filter,
                 };
                 break;
             case EffectType::StereoWiden:
@@ -76,6 +81,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Stereo Widen",
                     .id = 5, // never change
                     .on_param_index = ParamIndex::StereoWidenOn,
+                    .module = ParameterModule::StereoWiden,
                 };
                 break;
             case EffectType::Chorus:
@@ -85,6 +91,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Chorus",
                     .id = 6, // never change
                     .on_param_index = ParamIndex::ChorusOn,
+                    .module = ParameterModule::Chorus,
                 };
                 break;
             case EffectType::Reverb:
@@ -94,6 +101,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Reverb",
                     .id = 7, // never change
                     .on_param_index = ParamIndex::ReverbOn,
+                    .module = ParameterModule::Reverb,
                 };
                 break;
             case EffectType::Delay:
@@ -103,6 +111,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Delay",
                     .id = 11, // never change
                     .on_param_index = ParamIndex::DelayOn,
+                    .module = ParameterModule::Delay,
                 };
                 break;
             case EffectType::ConvolutionReverb:
@@ -112,6 +121,7 @@ consteval auto CreateEffectInfos() {
                     .name = "Convol Reverb",
                     .id = 10, // never change
                     .on_param_index = ParamIndex::ConvolutionReverbOn,
+                    .module = ParameterModule::ConvolutionReverb,
                 };
                 break;
             case EffectType::Phaser:
@@ -120,6 +130,7 @@ consteval auto CreateEffectInfos() {
                     .name = "New Phaser",
                     .id = 9, // never change
                     .on_param_index = ParamIndex::PhaserOn,
+                    .module = ParameterModule::Phaser,
                 };
                 break;
 
@@ -11,7 +11,10 @@ class Reverb final : public Effect {
     Reverb(FloeSmoothedValueSystem& s) : Effect(s, EffectType::Reverb), reverb(vitfx::reverb::Create()) {}
     ~Reverb() override { vitfx::reverb::Destroy(reverb); }
 
-    void ResetInternal() override { vitfx::reverb::HardReset(*reverb); }
+    void ResetInternal() override {
+        vitfx::reverb::BeginHardReset(*reverb);
+        time_sliced_reset.Begin();
+    }
 
     virtual void PrepareToPlay(AudioProcessingContext const& context) override {
         vitfx::reverb::SetSampleRate(*reverb, (int)context.sample_rate);
@@ -19,9 +22,19 @@ class Reverb final : public Effect {
 
     bool ProcessBlock(Span<StereoAudioFrame> io_frames,
                       ScratchBuffers scratch_buffers,
-                      AudioProcessingContext const&) override {
+                      AudioProcessingContext const& context) override {
         if (!ShouldProcessBlock()) return false;
 
+        // While the memory is being cleared we output only the dry part of what the reverb would output.
+        auto const dry_gain = vitfx::DryGain(params[ToInt(vitfx::reverb::Params::Mix)]);
+        if (!time_sliced_reset.Continue(context.sample_rate, [this](usize max_bytes) {
+                return vitfx::reverb::ContinueHardReset(*reverb, (int)(max_bytes / sizeof(f32)));
+            })) {
+            for (auto [frame_index, frame] : Enumerate<u32>(io_frames))
+                frame = MixOnOffSmoothing(frame * dry_gain, frame, frame_index);
+            return true;
+        }
+
         auto wet = scratch_buffers.buf1.Interleaved();
         wet.size = io_frames.size;
         CopyMemory(wet.data, io_frames.data, io_frames.size * sizeof(StereoAudioFrame));
@@ -44,8 +57,10 @@ class Reverb final : public Effect {
             pos += chunk_size;
         }
 
-        for (auto const frame_index : Range((u32)io_frames.size))
-            io_frames[frame_index] = MixOnOffSmoothing(wet[frame_index], io_frames[frame_index], frame_index);
+        for (auto [frame_index, frame] : Enumerate<u32>(io_frames)) {
+            auto const processed = time_sliced_reset.FadeIn(wet[frame_index], frame * dry_gain);
+            frame = MixOnOffSmoothing(processed, frame, frame_index);
+        }
 
         return true;
     }
@@ -79,5 +94,6 @@ class Reverb final : public Effect {
     }
 
     vitfx::reverb::Reverb* reverb {};
+    EffectTimeSlicedReset time_sliced_reset;
     f32 params[ToInt(vitfx::reverb::Params::Count)] {};
 };
@@ -445,7 +445,9 @@ struct DrawContext {
     }
 
     Vector<Font*> font_stack;
-    u64 image_id_counter {1};
+    // Shared by every context: the GUI can outlive a context and keep ImageIDs from it, and those must not
+    // match textures in the one that replaces it. Only used from the main thread.
+    static inline u64 image_id_counter {1};
 
     struct IdAndTexture {
         ImageID id;
@@ -7,6 +7,7 @@
 #include "utils/debug/debug.hpp"
 #include "utils/logger/logger.hpp"
 
+#include "tests/framework.hpp"
 #include "tracy/Tracy.hpp"
 
 ErrorCodeOr<void> GuiPlatform::InitGraphics(void* object_needed_for_device) {
@@ -16,6 +17,7 @@ ErrorCodeOr<void> GuiPlatform::InitGraphics(void* object_needed_for_device) {
     display_ratio = GetDisplayRatio();
     SetStateChanged("Init graphics");
     currently_updating = false;
+    ++counters.graphics_inits;
 
     return k_success;
 }
@@ -30,6 +32,34 @@ void GuiPlatform::DestroyGraphics() {
     }
 }
 
+void GuiPlatform::SetVisible(bool visible) {
+    if (visible) {
+        hidden_since = nullopt;
+        graphics_released = false;
+        SetGUIDirty();
+    } else if (!hidden_since) {
+        hidden_since = TimePoint::Now();
+    }
+    SetWindowVisible(visible);
+}
+
+void GuiPlatform::ReleaseGraphicsIfHiddenLongEnough(TimePoint now) {
+    if (!hidden_since || graphics_released) return;
+    if (now - *hidden_since < k_hidden_gui_release_graphics_seconds) return;
+    ReleaseGraphics();
+    graphics_released = true;
+    ++counters.graphics_releases;
+}
+
+void GuiPlatform::PollFromHost() {
+    if (IsHidden()) {
+        ++counters.host_polls_skipped_while_hidden;
+        ReleaseGraphicsIfHiddenLongEnough(TimePoint::Now());
+        return;
+    }
+    PollAndUpdate();
+}
+
 void GuiPlatform::WindowWasResized(UiSize new_size) {
     window_size = new_size;
     if (!graphics_ctx) return;
@@ -171,6 +201,15 @@ bool GuiPlatform::CheckForTimerRedraw() {
     return redraw_needed;
 }
 
+bool GuiPlatform::HandleRedrawTimer() {
+    ++counters.timer_callbacks;
+    if (IsHidden()) {
+        ++counters.timer_callbacks_while_hidden;
+        return false;
+    }
+    return CheckForTimerRedraw();
+}
+
 void GuiPlatform::Update() {
     ZoneScopedN("GUI Update");
 
@@ -178,6 +217,12 @@ void GuiPlatform::Update() {
     currently_updating = true;
     DEFER { currently_updating = false; };
 
+    // Nothing should be asking for an update while hidden, but some OSes still send expose events.
+    if (IsHidden()) {
+        ++counters.updates_while_hidden;
+        return;
+    }
+
     if (!platform_state_changed) SetStateChanged("OS required");
     platform_state_changed = false;
 
@@ -285,3 +330,207 @@ void GuiPlatform::Update() {
     cursor_prev = cursor_pos;
     time_at_last_paint = TimePoint::Now();
 }
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+// Offers no extensions and ignores every request.
+static clap_host const k_gui_test_host {
+    .clap_version = CLAP_VERSION,
+    .host_data = nullptr,
+    .name = "Tests",
+    .vendor = "Floe",
+    .url = "",
+    .version = "1",
+    .get_extension = [](clap_host const*, char const*) -> void const* { return nullptr; },
+    .request_restart = [](clap_host const*) {},
+    .request_process = [](clap_host const*) {},
+    .request_callback = [](clap_host const*) {},
+};
+
+// Behaves like a windowing library: while its redraw timer is running, every poll fires the timer and
+// redraws if asked to. There's no real window or graphics context. The release timer is started and stopped
+// at the same points as the pugl backend's.
+struct FakeGuiPlatform : GuiPlatform {
+    FakeGuiPlatform(GUI_PLATFORM_ARGS) : GuiPlatform(GUI_PLATFORM_FORWARD_ARGS) {}
+
+    void* OpenWindow() override {
+        is_window_open = true;
+        return this;
+    }
+    bool CloseWindow() override {
+        is_window_open = false;
+        return true;
+    }
+    void* GetWindow() override { return this; }
+    void PollAndUpdate() override {
+        if (timer_running && HandleRedrawTimer()) Update();
+    }
+    void SetParent(clap_window_t const*) override {}
+    void SetWindowVisible(bool visible) override {
+        if (visible && !has_graphics) {
+            has_graphics = true;
+            ++counters.graphics_inits;
+        }
+        timer_running = visible;
+        release_timer_running = !visible && has_graphics;
+    }
+    void ReleaseGraphics() override {
+        has_graphics = false;
+        release_timer_running = false;
+    }
+    bool SetSize(UiSize) override { return true; }
+    bool SetClipboard(String, String) override { return false; }
+    bool RequestClipboardPaste() override { return false; }
+
+    // What the pugl backend does when its release timer fires.
+    void FireReleaseTimer(TimePoint now) {
+        if (release_timer_running) ReleaseGraphicsIfHiddenLongEnough(now);
+    }
+
+    bool timer_running {};
+    bool release_timer_running {};
+    bool has_graphics {};
+};
+
+TEST_CASE(TestGuiPlatformHiddenEditor) {
+    FloePaths const paths {};
+    SettingsFile settings {paths};
+    FakeGuiPlatform platform {k_gui_test_host, []() {}, tester.log, settings};
+
+    platform.OpenWindow();
+    platform.SetVisible(true);
+    CHECK(platform.has_graphics);
+
+    constexpr u32 k_num_polls = 100;
+    auto poll = [&]() {
+        for (auto _ : Range(k_num_polls)) {
+            platform.SetGUIDirty();
+            platform.PollFromHost();
+        }
+    };
+
+    SUBCASE("no timer callbacks or updates while hidden") {
+        poll();
+        CHECK_EQ(platform.counters.timer_callbacks, (u64)k_num_polls);
+
+        platform.SetVisible(false);
+        auto const timer_callbacks = platform.counters.timer_callbacks;
+        poll();
+        CHECK_EQ(platform.counters.timer_callbacks, timer_callbacks);
+        CHECK_EQ(platform.counters.timer_callbacks_while_hidden, 0u);
+        CHECK_EQ(platform.counters.updates_while_hidden, 0u);
+        CHECK_EQ(platform.counters.host_polls_skipped_while_hidden, (u64)k_num_polls);
+
+        // Even if something does fire the timer, it mustn't redraw.
+        CHECK(!platform.HandleRedrawTimer());
+        CHECK_EQ(platform.counters.timer_callbacks_while_hidden, 1u);
+        platform.Update();
+        CHECK_EQ(platform.counters.updates_while_hidden, 1u);
+
+        platform.SetVisible(true);
+        poll();
+        CHECK_EQ(platform.counters.timer_callbacks, timer_callbacks + k_num_polls + 1);
+    }
+
+    SUBCASE("graphics are released after the grace period and recreated when shown") {
+        platform.SetVisible(false);
+        auto const hidden_at = TimePoint::Now();
+
+        platform.ReleaseGraphicsIfHiddenLongEnough(hidden_at + (k_hidden_gui_release_graphics_seconds / 2));
+        CHECK(platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_releases, 0u);
+
+        platform.ReleaseGraphicsIfHiddenLongEnough(hidden_at + k_hidden_gui_release_graphics_seconds + 1);
+        CHECK(!platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_releases, 1u);
+
+        // Only once per hide.
+        platform.ReleaseGraphicsIfHiddenLongEnough(hidden_at + k_hidden_gui_release_graphics_seconds + 2);
+        CHECK_EQ(platform.counters.graphics_releases, 1u);
+
+        platform.SetVisible(true);
+        CHECK(platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_inits, 2u);
+        CHECK(!platform.IsHidden());
+
+        // Shown again, so the release mustn't happen however long ago it was hidden.
+        platform.ReleaseGraphicsIfHiddenLongEnough(hidden_at + k_hidden_gui_release_graphics_seconds * 10);
+        CHECK(platform.has_graphics);
+    }
+
+    SUBCASE("show, hide, release timer, show") {
+        CHECK(!platform.release_timer_running);
+
+        platform.SetVisible(false);
+        CHECK(!platform.timer_running);
+        CHECK(platform.release_timer_running);
+        auto const hidden_at = *platform.hidden_since;
+
+        platform.FireReleaseTimer(hidden_at + (k_hidden_gui_release_graphics_seconds / 2));
+        CHECK(platform.has_graphics);
+        CHECK(platform.release_timer_running);
+
+        platform.FireReleaseTimer(hidden_at + k_hidden_gui_release_graphics_seconds + 0.1);
+        CHECK(!platform.has_graphics);
+        CHECK(!platform.release_timer_running);
+        CHECK_EQ(platform.counters.graphics_releases, 1u);
+
+        platform.SetVisible(true);
+        CHECK(platform.has_graphics);
+        CHECK(platform.timer_running);
+        CHECK(!platform.release_timer_running);
+        CHECK_EQ(platform.counters.graphics_inits, 2u);
+
+        auto const timer_callbacks = platform.counters.timer_callbacks;
+        poll();
+        CHECK_EQ(platform.counters.timer_callbacks, timer_callbacks + k_num_polls);
+
+        // Hidden and shown again before the timer fires: showing stops it, so nothing is released.
+        platform.SetVisible(false);
+        platform.SetVisible(true);
+        CHECK(!platform.release_timer_running);
+        platform.FireReleaseTimer(hidden_at + k_hidden_gui_release_graphics_seconds * 10);
+        CHECK(platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_releases, 1u);
+    }
+
+    SUBCASE("host polls release graphics after the grace period") {
+        platform.SetVisible(false);
+        platform.PollFromHost();
+        CHECK(platform.has_graphics);
+
+        // Pretend it was hidden longer ago rather than waiting.
+        platform.hidden_since = *platform.hidden_since + -(k_hidden_gui_release_graphics_seconds + 1);
+        platform.PollFromHost();
+        CHECK(!platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_releases, 1u);
+        CHECK_EQ(platform.counters.host_polls_skipped_while_hidden, 2u);
+
+        platform.SetVisible(true);
+        CHECK(platform.has_graphics);
+        CHECK_EQ(platform.counters.graphics_inits, 2u);
+        auto const timer_callbacks = platform.counters.timer_callbacks;
+        poll();
+        CHECK_EQ(platform.counters.timer_callbacks, timer_callbacks + k_num_polls);
+    }
+
+    SUBCASE("hiding twice doesn't restart the grace period") {
+        platform.SetVisible(false);
+        auto const hidden_since = *platform.hidden_since;
+        platform.SetVisible(false);
+        CHECK_EQ(platform.hidden_since->Raw(), hidden_since.Raw());
+    }
+
+    platform.CloseWindow();
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeGuiPlatformTests) { REGISTER_TEST(TestGuiPlatformHiddenEditor); }
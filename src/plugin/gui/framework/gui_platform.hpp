@@ -12,6 +12,10 @@
 
 static constexpr int k_gui_platform_timer_hz = 60;
 
+// How long the editor has to stay hidden before its graphics context, font atlas and textures are released.
+// Hosts often hide and reshow quickly when switching tabs, so we don't release straight away.
+static constexpr f64 k_hidden_gui_release_graphics_seconds = 10;
+
 enum KeyCodes {
     KeyCodeTab,
     KeyCodeLeftArrow,
@@ -80,6 +84,15 @@ struct GuiUpdateRequirements {
     CursorType cursor_type = CursorType::Default;
 };
 
+struct GuiPlatformCounters {
+    u64 timer_callbacks {};
+    u64 timer_callbacks_while_hidden {};
+    u64 updates_while_hidden {};
+    u64 host_polls_skipped_while_hidden {};
+    u32 graphics_inits {};
+    u32 graphics_releases {};
+};
+
 #define GUI_PLATFORM_ARGS                                                                                    \
     const clap_host &host, TrivialFixedSizeFunction<16, void()>&&update, Logger &logger,                     \
         SettingsFile &settings
@@ -97,13 +110,26 @@ struct GuiPlatform {
     virtual void PollAndUpdate() {}
     virtual void SetParent(clap_window_t const* window) = 0;
     virtual bool SetTransient(clap_window_t const*) { return false; }
-    virtual void SetVisible(bool visible) = 0;
+    // Must stop the redraw timer when hiding, and recreate the graphics if they were released when showing.
+    virtual void SetWindowVisible(bool visible) = 0;
+    // Only called while hidden. Frees the graphics context and everything on the GPU.
+    virtual void ReleaseGraphics() = 0;
     virtual bool SetSize(UiSize new_size) = 0;
     virtual bool SetClipboard(String mime_type, String data) = 0;
     virtual bool RequestClipboardPaste() = 0;
 
     void SetGUIDirty() { gui_update_requirements.mark_gui_dirty = true; }
 
+    // While hidden there are no timer callbacks or GUI updates, and after
+    // k_hidden_gui_release_graphics_seconds the graphics are released. The Gui object is kept, so showing
+    // again only has to recreate the GPU side of things.
+    void SetVisible(bool visible);
+    bool IsHidden() const { return hidden_since.HasValue(); }
+    void ReleaseGraphicsIfHiddenLongEnough(TimePoint now);
+
+    // For the host's timer and fd callbacks.
+    void PollFromHost();
+
     bool ShiftJustPressed() { return key_shift && !key_shift_prev; }
     bool ShiftJustReleased() { return !key_shift && key_shift_prev; }
     bool CtrlJustPressed() { return key_ctrl && !key_ctrl_prev; }
@@ -155,6 +181,7 @@ struct GuiPlatform {
     bool HandleKeyPressed(KeyCodes code, bool is_down);
     bool HandleInputChar(int character);
     bool CheckForTimerRedraw();
+    bool HandleRedrawTimer();
 
     void Update();
 
@@ -202,6 +229,7 @@ struct GuiPlatform {
     int update_guicall_count {}; // update gui is sometimes called 2 times in one frame
     bool is_window_open {};
     f32 display_ratio {};
+    GuiPlatformCounters counters {};
 
     bool currently_updating {};
 
@@ -222,6 +250,8 @@ struct GuiPlatform {
     f32 update_prev_time {};
 #endif
     TimePoint time_at_last_paint {};
+    Optional<TimePoint> hidden_since {};
+    bool graphics_released {};
     bool platform_state_changed {};
     char const* platform_state_changed_reason = "";
     bool key_ctrl_prev {};
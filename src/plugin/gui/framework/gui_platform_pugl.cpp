@@ -19,6 +19,7 @@ static int g_counter = 0;
 PuglWorld* g_world {};
 
 constexpr uintptr_t k_timer_id = 200;
+constexpr uintptr_t k_release_graphics_timer_id = 201;
 
 // TODO(1.0): go over the API docs and review usage
 // TODO(1.0): add error handling
@@ -86,6 +87,7 @@ struct PuglPlatform : public GuiPlatform {
     bool CloseWindow() override {
         if (realised) {
             puglStopTimer(view, k_timer_id);
+            puglStopTimer(view, k_release_graphics_timer_id);
             puglUnrealize(view);
             realised = false;
         }
@@ -116,7 +118,7 @@ struct PuglPlatform : public GuiPlatform {
         puglSetTransientParent(view, (uintptr_t)window->ptr);
         return true;
     }
-    void SetVisible(bool visible) override {
+    void SetWindowVisible(bool visible) override {
         if (visible) {
             if (!realised) {
                 if (auto const status = puglRealize(view); status != PUGL_SUCCESS) {
@@ -124,15 +126,28 @@ struct PuglPlatform : public GuiPlatform {
                     DebugLn("puglRealize failed: {}", FromNullTerminated(status_error));
                     TODO("handle error");
                 }
-                if (auto const status = puglStartTimer(view, k_timer_id, 1.0 / (f64)k_gui_platform_timer_hz);
-                    status != PUGL_SUCCESS) {
-                    TODO("handle error");
-                }
                 realised = true;
             }
+            puglStopTimer(view, k_release_graphics_timer_id);
+            if (auto const status = puglStartTimer(view, k_timer_id, 1.0 / (f64)k_gui_platform_timer_hz);
+                status != PUGL_SUCCESS) {
+                TODO("handle error");
+            }
             puglShow(view, PUGL_SHOW_PASSIVE);
-        } else
+        } else {
+            puglStopTimer(view, k_timer_id);
+            if (realised)
+                puglStartTimer(view, k_release_graphics_timer_id, k_hidden_gui_release_graphics_seconds);
             puglHide(view);
+        }
+    }
+    void ReleaseGraphics() override {
+        if (!realised) return;
+        // Unrealising sends PUGL_UNREALIZE, which destroys the graphics context. The view itself stays, so
+        // SetWindowVisible(true) can realise it again with the same parent and size.
+        puglStopTimer(view, k_release_graphics_timer_id);
+        puglUnrealize(view);
+        realised = false;
     }
     bool SetSize(UiSize new_size) override {
         DebugLn("SetSize: {}x{}", new_size.width, new_size.height);
@@ -265,7 +280,9 @@ struct PuglPlatform : public GuiPlatform {
             case PUGL_CLIENT:
             case PUGL_TIMER: {
                 if (event->timer.id == k_timer_id) {
-                    if (platform.CheckForTimerRedraw()) puglPostRedisplay(view);
+                    if (platform.HandleRedrawTimer()) puglPostRedisplay(view);
+                } else if (event->timer.id == k_release_graphics_timer_id) {
+                    platform.ReleaseGraphicsIfHiddenLongEnough(TimePoint::Now());
                 }
                 break;
             }
@@ -280,6 +280,20 @@ static void BoxBlur(u8 const* in, u8* out, int width, int height, int radius) {
     }
 }
 
+static void KeepCpuCopyOfPixels(Span<u8>& copy, u8 const* rgba, UiSize size) {
+    if (copy.size) Malloc::Instance().Free(copy);
+    copy = Malloc::Instance().Clone(Span<u8 const> {rgba, (usize)size.width * size.height * 4});
+}
+
+// The ImageID from the released context still knows its size.
+static bool RecreateImageFromCpuCopy(Gui* g, Optional<graphics::ImageID>& id, Span<u8> pixels) {
+    if (!id || !pixels.size || pixels.size != (usize)id->size.width * id->size.height * 4) return false;
+    auto const outcome = g->gui_platform.graphics_ctx->CreateImageID(pixels.data, id->size, 4);
+    if (outcome.HasError()) return false;
+    id = outcome.Value();
+    return true;
+}
+
 LibraryImages LoadLibraryBackgroundAndIconIfNeeded(Gui* g, sample_lib::Library const& lib) {
     // IMPROVE: this function is very confused as to what int types it's using
     auto& ctx = g->gui_platform.graphics_ctx;
@@ -293,16 +307,21 @@ LibraryImages LoadLibraryBackgroundAndIconIfNeeded(Gui* g, sample_lib::Library c
     }
     auto& imgs = g->library_images[*opt_index];
 
-    auto const reload_icon = !ctx->ImageIdIsValid(imgs.icon) && !imgs.icon_missing;
-    auto const reload_background = !ctx->ImageIdIsValid(imgs.background) && !imgs.background_missing;
+    auto const reload_icon = !ctx->ImageIdIsValid(imgs.icon) && !imgs.icon_missing &&
+                             !RecreateImageFromCpuCopy(g, imgs.icon, imgs.icon_pixels);
+    auto const reload_background = !ctx->ImageIdIsValid(imgs.background) && !imgs.background_missing &&
+                                   !RecreateImageFromCpuCopy(g, imgs.background, imgs.background_pixels);
     auto const reload_blurred_background =
-        !ctx->ImageIdIsValid(imgs.blurred_background) && !imgs.background_missing;
+        !ctx->ImageIdIsValid(imgs.blurred_background) && !imgs.background_missing &&
+        !RecreateImageFromCpuCopy(g, imgs.blurred_background, imgs.blurred_background_pixels);
 
     if (reload_icon) {
-        if (auto icon_pixels = ImagePixelsFromLibrary(g, lib, LibraryImageType::Icon))
+        if (auto icon_pixels = ImagePixelsFromLibrary(g, lib, LibraryImageType::Icon)) {
             imgs.icon = CopyPixelsToGpuLoadedImage(g, icon_pixels.Value());
-        else
+            KeepCpuCopyOfPixels(imgs.icon_pixels, icon_pixels->data, icon_pixels->size);
+        } else {
             imgs.icon_missing = true;
+        }
     }
 
     if (reload_background || reload_blurred_background) {
@@ -366,6 +385,7 @@ LibraryImages LoadLibraryBackgroundAndIconIfNeeded(Gui* g, sample_lib::Library c
                         g->logger.ErrorLn("Failed to create background image texture: {}", error);
                         return graphics::ImageID {};
                     });
+            KeepCpuCopyOfPixels(imgs.background_pixels, background_rgba, background_size);
         }
 
         if (reload_blurred_background) {
@@ -513,6 +533,7 @@ LibraryImages LoadLibraryBackgroundAndIconIfNeeded(Gui* g, sample_lib::Library c
                         g->logger.ErrorLn("Failed to create blurred background texture: {}", error);
                         return graphics::ImageID {};
                     });
+            KeepCpuCopyOfPixels(imgs.blurred_background_pixels, blurred_image_buffer.data, blur_img_size);
         }
     }
 
@@ -687,6 +708,8 @@ Gui::Gui(GuiPlatform& platform, PluginInstance& plugin)
     editor.imgui = &imgui;
     imgui.user_callback_data = this;
 
+    scratch_arena.TrackUsage(scratch_arena_usage);
+
     layout.Reserve(2048);
 
     m_window_size_listener_id =
@@ -711,6 +734,13 @@ Gui::~Gui() {
     }
 
     plugin.shared_data.settings.tracking.window_size_change_listeners.Remove(m_window_size_listener_id);
+
+    for (auto& imgs : library_images)
+        for (auto pixels : Array {imgs.icon_pixels, imgs.background_pixels, imgs.blurred_background_pixels})
+            if (pixels.size) Malloc::Instance().Free(pixels);
+
+    scratch_arena.usage_stats = nullptr;
+    RecordArenaUsage("gui-frame"_s, scratch_arena_usage);
 }
 
 bool Tooltip(Gui* g, imgui::Id id, Rect r, char const* fmt, ...);
@@ -837,13 +867,10 @@ void GUIUpdate(Gui* g) {
 
     bool show_error_popup = false;
     for (auto& errs : Array {&g->plugin.error_notifications, &g->plugin.shared_data.error_notifications}) {
-        for (auto& e : errs->items) {
-            if (e.TryRetain()) {
-                e.Release();
-                show_error_popup = true;
-                break;
-            }
-        }
+        if (errs->HasErrors()) show_error_popup = true;
+        if (auto const num_dropped = errs->TakeNumNewlyDropped())
+            g->logger.WarningLn("{} error notifications were dropped, too many errors were already showing",
+                                num_dropped);
     }
 
     if (show_error_popup && !imgui.IsPopupOpen(GetStandaloneID(StandaloneWindowsLoadError))) {
@@ -867,13 +894,11 @@ void GUIUpdate(Gui* g) {
 
     auto outcome = WriteSettingsFileIfChanged(g->settings);
     if (outcome.HasError()) {
-        auto item = g->plugin.error_notifications.NewError();
-        item->value = {
+        g->plugin.error_notifications.AddOrUpdateError({
             .title = "Failed to save settings file"_s,
             .message = g->settings.paths.settings_write_path,
             .error_code = outcome.Error(),
             .id = U64FromChars("savesets"),
-        };
-        g->plugin.error_notifications.AddOrUpdateError(item);
+        });
     }
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 #include "foundation/foundation.hpp"
+#include "utils/arena_usage.hpp"
 
 #include "framework/draw_list.hpp"
 #include "framework/gui_imgui.hpp"
@@ -43,6 +44,12 @@ struct LibraryImages {
     Optional<graphics::ImageID> blurred_background {};
     bool icon_missing {};
     bool background_missing {};
+
+    // CPU copies of the finished RGBA pixels, owned by Gui::library_images. If the graphics are released
+    // while the editor is hidden we can recreate the textures from these without decoding and blurring again.
+    Span<u8> icon_pixels {};
+    Span<u8> background_pixels {};
+    Span<u8> blurred_background_pixels {};
 };
 
 struct DraggingFX {
@@ -125,7 +132,8 @@ struct Gui {
     void OpenDialog(DialogType type);
 
     PageAllocator page_allocator;
-    ArenaAllocator scratch_arena {page_allocator};
+    ArenaUsageStats scratch_arena_usage {};
+    ArenaAllocator scratch_arena {page_allocator, RecommendedArenaSize("gui-frame"_s, 0)};
 
     bool show_purchasable_libraries = false;
     bool show_news = false;
@@ -179,11 +179,15 @@ void DoErrorsStandalone(Gui* g) {
 
             for (auto errors :
                  Array {&g->plugin.error_notifications, &g->plugin.shared_data.error_notifications}) {
-                for (auto it = errors->items.begin(); it != errors->items.end(); ++it) {
-                    auto e_ptr = it->TryRetain();
-                    if (!e_ptr) continue;
-                    DEFER { it->Release(); };
-                    auto& e = *e_ptr;
+                errors->ForEach([&](ThreadsafeErrorNotifications::Item const& e) {
+                    // divider line
+                    if (num_errors != 0) {
+                        y_pos += (f32)error_window_gap_after_desc;
+                        auto line_r = Rect {0, y_pos, imgui.Width(), 1};
+                        imgui.RegisterAndConvertRect(&line_r);
+                        imgui.graphics->AddLine(line_r.Min(), line_r.Max(), text_style.main_cols.reg);
+                        y_pos += (f32)error_window_divider_spacing_y;
+                    }
 
                     imgui.PushID((int)e.id);
                     DEFER { imgui.PopID(); };
@@ -259,23 +263,14 @@ void DoErrorsStandalone(Gui* g) {
 
                         if (do_button("Dismiss")) {
                             errors->RemoveError(e.id);
-                            continue;
+                            return;
                         }
                     }
 
                     y_pos += (f32)error_window_button_h;
 
-                    // divider line
-                    if (it->next.Load(MemoryOrder::Relaxed) != nullptr) {
-                        y_pos += (f32)error_window_gap_after_desc;
-                        auto line_r = Rect {0, y_pos, imgui.Width(), 1};
-                        imgui.RegisterAndConvertRect(&line_r);
-                        imgui.graphics->AddLine(line_r.Min(), line_r.Max(), text_style.main_cols.reg);
-                        y_pos += (f32)error_window_divider_spacing_y;
-                    }
-
                     ++num_errors;
-                }
+                });
             }
         }
 
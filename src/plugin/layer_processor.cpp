@@ -15,6 +15,7 @@
 #include "processing/synced_timings.hpp"
 #include "processing/volume_fade.hpp"
 #include "sample_library/sample_library.hpp"
+#include "tests/framework.hpp"
 #include "voices.hpp"
 
 static void UpdateLoopPointsForVoices(LayerProcessor& layer, VoicePool& voice_pool) {
@@ -136,203 +137,218 @@ void PrepareToPlay(LayerProcessor& layer, ArenaAllocator& allocator, AudioProces
 void OnParamChange(LayerProcessor& layer,
                    AudioProcessingContext const& context,
                    VoicePool& voice_pool,
-                   ChangedLayerParams changed_params) {
+                   ChangedLayerParams changed_params,
+                   LayerParamGroups changed_groups) {
     f32 const sample_rate = context.sample_rate;
     auto& vmst = layer.voice_controller;
 
     // Main controls
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::VelocityMapping))
-        SetVelocityMapping(layer, p->ValueAsInt<param_values::VelocityMappingMode>());
-
-    if (auto p = changed_params.Param(LayerParamIndex::Volume))
-        layer.smoothed_value_system.SetVariableLength(layer.vol_smoother_id, p->ProjectedValue(), 3, 30, 1);
-
-    if (auto p = changed_params.Param(LayerParamIndex::Pan))
-        layer.smoothed_value_system.SetVariableLength(vmst.pan_pos_smoother_id,
-                                                      p->ProjectedValue(),
-                                                      3,
-                                                      30,
-                                                      2);
-
-    {
-        bool set_tune = false;
-        if (auto p = changed_params.Param(LayerParamIndex::TuneSemitone)) {
-            layer.tune_semitone = (f32)p->ValueAsInt<int>();
-            set_tune = true;
-        }
-        if (auto p = changed_params.Param(LayerParamIndex::TuneCents)) {
-            layer.tune_cents = p->ProjectedValue();
-            set_tune = true;
-        }
-        if (set_tune) {
-            auto const tune = layer.tune_semitone + (layer.tune_cents / 100.0f);
-            layer.voice_controller.tune = tune;
-            for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
-                SetVoicePitch(v, vmst.tune, sample_rate);
+    if (changed_groups.Get(ToInt(LayerParamGroup::Main))) {
+        if (auto p = changed_params.Param(LayerParamIndex::Volume))
+            layer.smoothed_value_system.SetVariableLength(layer.vol_smoother_id,
+                                                          p->ProjectedValue(),
+                                                          3,
+                                                          30,
+                                                          1);
+
+        if (auto p = changed_params.Param(LayerParamIndex::Pan))
+            layer.smoothed_value_system.SetVariableLength(vmst.pan_pos_smoother_id,
+                                                          p->ProjectedValue(),
+                                                          3,
+                                                          30,
+                                                          2);
+
+        {
+            bool set_tune = false;
+            if (auto p = changed_params.Param(LayerParamIndex::TuneSemitone)) {
+                layer.tune_semitone = (f32)p->ValueAsInt<int>();
+                set_tune = true;
+            }
+            if (auto p = changed_params.Param(LayerParamIndex::TuneCents)) {
+                layer.tune_cents = p->ProjectedValue();
+                set_tune = true;
+            }
+            if (set_tune) {
+                auto const tune = layer.tune_semitone + (layer.tune_cents / 100.0f);
+                layer.voice_controller.tune = tune;
+                for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
+                    SetVoicePitch(v, vmst.tune, sample_rate);
+            }
         }
     }
 
     constexpr f32 k_min_envelope_ms = 0.2f;
     // Volume envelope
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::VolEnvOn)) vmst.vol_env_on = p->ValueAsBool();
-    if (auto p = changed_params.Param(LayerParamIndex::VolumeAttack))
-        layer.voice_controller.vol_env.SetAttackSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
-                                                            1000.0f * sample_rate,
-                                                        2.0f);
-    if (auto p = changed_params.Param(LayerParamIndex::VolumeDecay))
-        layer.voice_controller.vol_env.SetDecaySamples(Max(k_min_envelope_ms, p->ProjectedValue()) / 1000.0f *
-                                                           sample_rate,
-                                                       0.1f);
-    if (auto p = changed_params.Param(LayerParamIndex::VolumeSustain))
-        layer.voice_controller.vol_env.SetSustainAmp(p->ProjectedValue());
-
-    if (auto p = changed_params.Param(LayerParamIndex::VolumeRelease))
-        layer.voice_controller.vol_env.SetReleaseSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
-                                                             1000.0f * sample_rate,
-                                                         0.1f);
+    if (changed_groups.Get(ToInt(LayerParamGroup::VolEnv))) {
+        if (auto p = changed_params.Param(LayerParamIndex::VolEnvOn)) vmst.vol_env_on = p->ValueAsBool();
+        if (auto p = changed_params.Param(LayerParamIndex::VolumeAttack))
+            layer.voice_controller.vol_env.SetAttackSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                                1000.0f * sample_rate,
+                                                            2.0f);
+        if (auto p = changed_params.Param(LayerParamIndex::VolumeDecay))
+            layer.voice_controller.vol_env.SetDecaySamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                               1000.0f * sample_rate,
+                                                           0.1f);
+        if (auto p = changed_params.Param(LayerParamIndex::VolumeSustain))
+            layer.voice_controller.vol_env.SetSustainAmp(p->ProjectedValue());
+
+        if (auto p = changed_params.Param(LayerParamIndex::VolumeRelease))
+            layer.voice_controller.vol_env.SetReleaseSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                                 1000.0f * sample_rate,
+                                                             0.1f);
+    }
 
     // Filter
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::FilterEnvAmount))
-        vmst.fil_env_amount = p->ProjectedValue();
-    if (auto p = changed_params.Param(LayerParamIndex::FilterAttack))
-        layer.voice_controller.fil_env.SetAttackSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
-                                                            1000.0f * sample_rate,
-                                                        2.0f);
-    if (auto p = changed_params.Param(LayerParamIndex::FilterDecay))
-        layer.voice_controller.fil_env.SetDecaySamples(Max(k_min_envelope_ms, p->ProjectedValue()) / 1000.0f *
-                                                           sample_rate,
-                                                       0.1f);
-    if (auto p = changed_params.Param(LayerParamIndex::FilterSustain))
-        layer.voice_controller.fil_env.SetSustainAmp(p->ProjectedValue());
-    if (auto p = changed_params.Param(LayerParamIndex::FilterRelease))
-        layer.voice_controller.fil_env.SetReleaseSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
-                                                             1000.0f * sample_rate,
-                                                         0.1f);
-    if (auto p = changed_params.Param(LayerParamIndex::FilterCutoff)) {
-        vmst.sv_filter_cutoff_linear = sv_filter::HzToLinear(p->ProjectedValue());
-        for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
-            SetFilterCutoff(v, vmst.sv_filter_cutoff_linear);
-    }
-    if (auto p = changed_params.Param(LayerParamIndex::FilterResonance)) {
-        vmst.sv_filter_resonance = sv_filter::SkewResonance(p->ProjectedValue());
-        for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
-            SetFilterRes(v, vmst.sv_filter_resonance);
-    }
-    if (auto p = changed_params.Param(LayerParamIndex::FilterOn)) {
-        vmst.filter_on = p->ValueAsBool();
-        for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
-            SetFilterOn(v, vmst.filter_on);
-    }
-    if (auto p = changed_params.Param(LayerParamIndex::FilterType)) {
-        sv_filter::Type sv_type {};
-        // Remapping enum values like this allows us to separate values that cannot change (the parameter
-        // value), with values that we have more control over (DSP code)
-        switch (p->ValueAsInt<param_values::LayerFilterType>()) {
-            case param_values::LayerFilterType::Lowpass: sv_type = sv_filter::Type::Lowpass; break;
-            case param_values::LayerFilterType::Bandpass: sv_type = sv_filter::Type::Bandpass; break;
-            case param_values::LayerFilterType::Highpass: sv_type = sv_filter::Type::Highpass; break;
-            case param_values::LayerFilterType::UnitGainBandpass:
-                sv_type = sv_filter::Type::UnitGainBandpass;
-                break;
-            case param_values::LayerFilterType::BandShelving: sv_type = sv_filter::Type::BandShelving; break;
-            case param_values::LayerFilterType::Notch: sv_type = sv_filter::Type::Notch; break;
-            case param_values::LayerFilterType::Allpass: sv_type = sv_filter::Type::Allpass; break;
-            case param_values::LayerFilterType::Peak: sv_type = sv_filter::Type::Peak; break;
-            case param_values::LayerFilterType::Count: PanicIfReached(); break;
+    if (changed_groups.Get(ToInt(LayerParamGroup::Filter))) {
+        if (auto p = changed_params.Param(LayerParamIndex::FilterEnvAmount))
+            vmst.fil_env_amount = p->ProjectedValue();
+        if (auto p = changed_params.Param(LayerParamIndex::FilterAttack))
+            layer.voice_controller.fil_env.SetAttackSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                                1000.0f * sample_rate,
+                                                            2.0f);
+        if (auto p = changed_params.Param(LayerParamIndex::FilterDecay))
+            layer.voice_controller.fil_env.SetDecaySamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                               1000.0f * sample_rate,
+                                                           0.1f);
+        if (auto p = changed_params.Param(LayerParamIndex::FilterSustain))
+            layer.voice_controller.fil_env.SetSustainAmp(p->ProjectedValue());
+        if (auto p = changed_params.Param(LayerParamIndex::FilterRelease))
+            layer.voice_controller.fil_env.SetReleaseSamples(Max(k_min_envelope_ms, p->ProjectedValue()) /
+                                                                 1000.0f * sample_rate,
+                                                             0.1f);
+        if (auto p = changed_params.Param(LayerParamIndex::FilterCutoff)) {
+            vmst.sv_filter_cutoff_linear = sv_filter::HzToLinear(p->ProjectedValue());
+            for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
+                SetFilterCutoff(v, vmst.sv_filter_cutoff_linear);
+        }
+        if (auto p = changed_params.Param(LayerParamIndex::FilterResonance)) {
+            vmst.sv_filter_resonance = sv_filter::SkewResonance(p->ProjectedValue());
+            for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
+                SetFilterRes(v, vmst.sv_filter_resonance);
+        }
+        if (auto p = changed_params.Param(LayerParamIndex::FilterOn)) {
+            vmst.filter_on = p->ValueAsBool();
+            for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
+                SetFilterOn(v, vmst.filter_on);
+        }
+        if (auto p = changed_params.Param(LayerParamIndex::FilterType)) {
+            sv_filter::Type sv_type {};
+            // Remapping enum values like this allows us to separate values that cannot change (the parameter
+            // value), with values that we have more control over (DSP code)
+            switch (p->ValueAsInt<param_values::LayerFilterType>()) {
+                case param_values::LayerFilterType::Lowpass: sv_type = sv_filter::Type::Lowpass; break;
+                case param_values::LayerFilterType::Bandpass: sv_type = sv_filter::Type::Bandpass; break;
+                case param_values::LayerFilterType::Highpass: sv_type = sv_filter::Type::Highpass; break;
+                case param_values::LayerFilterType::UnitGainBandpass:
+                    sv_type = sv_filter::Type::UnitGainBandpass;
+                    break;
+                case param_values::LayerFilterType::BandShelving:
+                    sv_type = sv_filter::Type::BandShelving;
+                    break;
+                case param_values::LayerFilterType::Notch: sv_type = sv_filter::Type::Notch; break;
+                case param_values::LayerFilterType::Allpass: sv_type = sv_filter::Type::Allpass; break;
+                case param_values::LayerFilterType::Peak: sv_type = sv_filter::Type::Peak; break;
+                case param_values::LayerFilterType::Count: PanicIfReached(); break;
+            }
+            vmst.filter_type = sv_type;
         }
-        vmst.filter_type = sv_type;
     }
 
     // Midi
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::MidiTranspose))
-        layer.midi_transpose = p->ValueAsInt<int>();
-    if (auto p = changed_params.Param(LayerParamIndex::Keytrack)) vmst.no_key_tracking = !p->ValueAsBool();
+    if (changed_groups.Get(ToInt(LayerParamGroup::Midi))) {
+        if (auto p = changed_params.Param(LayerParamIndex::VelocityMapping))
+            SetVelocityMapping(layer, p->ValueAsInt<param_values::VelocityMappingMode>());
+        if (auto p = changed_params.Param(LayerParamIndex::MidiTranspose))
+            layer.midi_transpose = p->ValueAsInt<int>();
+        if (auto p = changed_params.Param(LayerParamIndex::Keytrack))
+            vmst.no_key_tracking = !p->ValueAsBool();
+        if (auto p = changed_params.Param(LayerParamIndex::CC64Retrigger))
+            layer.sustain_pedal_retrigger = p->ValueAsBool();
+        if (auto p = changed_params.Param(LayerParamIndex::Monophonic)) layer.monophonic = p->ValueAsBool();
+    }
 
     // LFO
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::LfoShape)) {
-        vmst.lfo.shape = p->ValueAsInt<param_values::LfoShape>();
-        for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
-            UpdateLFOWaveform(v);
-    }
-    if (auto p = changed_params.Param(LayerParamIndex::LfoAmount)) vmst.lfo.amount = p->ProjectedValue();
-    if (auto p = changed_params.Param(LayerParamIndex::LfoDestination))
-        layer.voice_controller.lfo.dest = p->ValueAsInt<param_values::LfoDestination>();
-    if (auto p = changed_params.Param(LayerParamIndex::LfoOn))
-        layer.voice_controller.lfo.on = p->ValueAsBool();
-
-    {
-        bool update_voice_controller_times = false;
-        if (auto p = changed_params.Param(LayerParamIndex::LfoRateTempoSynced)) {
-            layer.lfo_synced_time = p->ValueAsInt<param_values::LfoSyncedRate>();
-            update_voice_controller_times = true;
-        }
-        if (auto p = changed_params.Param(LayerParamIndex::LfoRateHz)) {
-            layer.lfo_unsynced_hz = p->ProjectedValue();
-            update_voice_controller_times = true;
-        }
-        if (auto p = changed_params.Param(LayerParamIndex::LfoSyncSwitch)) {
-            layer.lfo_is_synced = p->ValueAsBool();
-            update_voice_controller_times = true;
+    if (changed_groups.Get(ToInt(LayerParamGroup::Lfo))) {
+        if (auto p = changed_params.Param(LayerParamIndex::LfoShape)) {
+            vmst.lfo.shape = p->ValueAsInt<param_values::LfoShape>();
+            for (auto& v : voice_pool.EnumerateActiveLayerVoices(layer.voice_controller))
+                UpdateLFOWaveform(v);
         }
-        if (update_voice_controller_times) {
-            if (layer.lfo_is_synced) {
-                SyncedTimes synced_time {};
-                // Remapping enum values like this allows us to separate values that cannot change (the
-                // parameter value), with values that we have more control over (DSP code)
-                switch (layer.lfo_synced_time) {
-                    case param_values::LfoSyncedRate::_1_64T: synced_time = SyncedTimes::_1_64T; break;
-                    case param_values::LfoSyncedRate::_1_64: synced_time = SyncedTimes::_1_64; break;
-                    case param_values::LfoSyncedRate::_1_64D: synced_time = SyncedTimes::_1_64D; break;
-                    case param_values::LfoSyncedRate::_1_32T: synced_time = SyncedTimes::_1_32T; break;
-                    case param_values::LfoSyncedRate::_1_32: synced_time = SyncedTimes::_1_32; break;
-                    case param_values::LfoSyncedRate::_1_32D: synced_time = SyncedTimes::_1_32D; break;
-                    case param_values::LfoSyncedRate::_1_16T: synced_time = SyncedTimes::_1_16T; break;
-                    case param_values::LfoSyncedRate::_1_16: synced_time = SyncedTimes::_1_16; break;
-                    case param_values::LfoSyncedRate::_1_16D: synced_time = SyncedTimes::_1_16D; break;
-                    case param_values::LfoSyncedRate::_1_8T: synced_time = SyncedTimes::_1_8T; break;
-                    case param_values::LfoSyncedRate::_1_8: synced_time = SyncedTimes::_1_8; break;
-                    case param_values::LfoSyncedRate::_1_8D: synced_time = SyncedTimes::_1_8D; break;
-                    case param_values::LfoSyncedRate::_1_4T: synced_time = SyncedTimes::_1_4T; break;
-                    case param_values::LfoSyncedRate::_1_4: synced_time = SyncedTimes::_1_4; break;
-                    case param_values::LfoSyncedRate::_1_4D: synced_time = SyncedTimes::_1_4D; break;
-                    case param_values::LfoSyncedRate::_1_2T: synced_time = SyncedTimes::_1_2T; break;
-                    case param_values::LfoSyncedRate::_1_2: synced_time = SyncedTimes::_1_2; break;
-                    case param_values::LfoSyncedRate::_1_2D: synced_time = SyncedTimes::_1_2D; break;
-                    case param_values::LfoSyncedRate::_1_1T: synced_time = SyncedTimes::_1_1T; break;
-                    case param_values::LfoSyncedRate::_1_1: synced_time = SyncedTimes::_1_1; break;
-                    case param_values::LfoSyncedRate::_1_1D: synced_time = SyncedTimes::_1_1D; break;
-                    case param_values::LfoSyncedRate::_2_1T: synced_time = SyncedTimes::_2_1T; break;
-                    case param_values::LfoSyncedRate::_2_1: synced_time = SyncedTimes::_2_1; break;
-                    case param_values::LfoSyncedRate::_2_1D: synced_time = SyncedTimes::_2_1D; break;
-                    case param_values::LfoSyncedRate::_4_1T: synced_time = SyncedTimes::_4_1T; break;
-                    case param_values::LfoSyncedRate::_4_1: synced_time = SyncedTimes::_4_1; break;
-                    case param_values::LfoSyncedRate::_4_1D: synced_time = SyncedTimes::_4_1D; break;
-                    case param_values::LfoSyncedRate::Count: PanicIfReached(); break;
+        if (auto p = changed_params.Param(LayerParamIndex::LfoAmount)) vmst.lfo.amount = p->ProjectedValue();
+        if (auto p = changed_params.Param(LayerParamIndex::LfoDestination))
+            layer.voice_controller.lfo.dest = p->ValueAsInt<param_values::LfoDestination>();
+        if (auto p = changed_params.Param(LayerParamIndex::LfoOn))
+            layer.voice_controller.lfo.on = p->ValueAsBool();
+
+        {
+            bool update_voice_controller_times = false;
+            if (auto p = changed_params.Param(LayerParamIndex::LfoRateTempoSynced)) {
+                layer.lfo_synced_time = p->ValueAsInt<param_values::LfoSyncedRate>();
+                update_voice_controller_times = true;
+            }
+            if (auto p = changed_params.Param(LayerParamIndex::LfoRateHz)) {
+                layer.lfo_unsynced_hz = p->ProjectedValue();
+                update_voice_controller_times = true;
+            }
+            if (auto p = changed_params.Param(LayerParamIndex::LfoSyncSwitch)) {
+                layer.lfo_is_synced = p->ValueAsBool();
+                update_voice_controller_times = true;
+            }
+            if (update_voice_controller_times) {
+                if (layer.lfo_is_synced) {
+                    SyncedTimes synced_time {};
+                    // Remapping enum values like this allows us to separate values that cannot change (the
+                    // parameter value), with values that we have more control over (DSP code)
+                    switch (layer.lfo_synced_time) {
+                        case param_values::LfoSyncedRate::_1_64T: synced_time = SyncedTimes::_1_64T; break;
+                        case param_values::LfoSyncedRate::_1_64: synced_time = SyncedTimes::_1_64; break;
+                        case param_values::LfoSyncedRate::_1_64D: synced_time = SyncedTimes::_1_64D; break;
+                        case param_values::LfoSyncedRate::_1_32T: synced_time = SyncedTimes::_1_32T; break;
+                        case param_values::LfoSyncedRate::_1_32: synced_time = SyncedTimes::_1_32; break;
+                        case param_values::LfoSyncedRate::_1_32D: synced_time = SyncedTimes::_1_32D; break;
+                        case param_values::LfoSyncedRate::_1_16T: synced_time = SyncedTimes::_1_16T; break;
+                        case param_values::LfoSyncedRate::_1_16: synced_time = SyncedTimes::_1_16; break;
+                        case param_values::LfoSyncedRate::_1_16D: synced_time = SyncedTimes::_1_16D; break;
+                        case param_values::LfoSyncedRate::_1_8T: synced_time = SyncedTimes::_1_8T; break;
+                        case param_values::LfoSyncedRate::_1_8: synced_time = SyncedTimes::_1_8; break;
+                        case param_values::LfoSyncedRate::_1_8D: synced_time = SyncedTimes::_1_8D; break;
+                        case param_values::LfoSyncedRate::_1_4T: synced_time = SyncedTimes::_1_4T; break;
+                        case param_values::LfoSyncedRate::_1_4: synced_time = SyncedTimes::_1_4; break;
+                        case param_values::LfoSyncedRate::_1_4D: synced_time = SyncedTimes::_1_4D; break;
+                        case param_values::LfoSyncedRate::_1_2T: synced_time = SyncedTimes::_1_2T; break;
+                        case param_values::LfoSyncedRate::_1_2: synced_time = SyncedTimes::_1_2; break;
+                        case param_values::LfoSyncedRate::_1_2D: synced_time = SyncedTimes::_1_2D; break;
+                        case param_values::LfoSyncedRate::_1_1T: synced_time = SyncedTimes::_1_1T; break;
+                        case param_values::LfoSyncedRate::_1_1: synced_time = SyncedTimes::_1_1; break;
+                        case param_values::LfoSyncedRate::_1_1D: synced_time = SyncedTimes::_1_1D; break;
+                        case param_values::LfoSyncedRate::_2_1T: synced_time = SyncedTimes::_2_1T; break;
+                        case param_values::LfoSyncedRate::_2_1: synced_time = SyncedTimes::_2_1; break;
+                        case param_values::LfoSyncedRate::_2_1D: synced_time = SyncedTimes::_2_1D; break;
+                        case param_values::LfoSyncedRate::_4_1T: synced_time = SyncedTimes::_4_1T; break;
+                        case param_values::LfoSyncedRate::_4_1: synced_time = SyncedTimes::_4_1; break;
+                        case param_values::LfoSyncedRate::_4_1D: synced_time = SyncedTimes::_4_1D; break;
+                        case param_values::LfoSyncedRate::Count: PanicIfReached(); break;
+                    }
+                    vmst.lfo.time_hz = (f32)(1.0 / (SyncedTimeToMs(context.tempo, synced_time) / 1000.0));
+                } else {
+                    vmst.lfo.time_hz = layer.lfo_unsynced_hz;
                 }
-                vmst.lfo.time_hz = (f32)(1.0 / (SyncedTimeToMs(context.tempo, synced_time) / 1000.0));
-            } else {
-                vmst.lfo.time_hz = layer.lfo_unsynced_hz;
+                UpdateVoiceLfoTimes(layer, voice_pool, context);
             }
-            UpdateVoiceLfoTimes(layer, voice_pool, context);
         }
-    }
 
-    if (auto p = changed_params.Param(LayerParamIndex::CC64Retrigger))
-        layer.sustain_pedal_retrigger = p->ValueAsBool();
-
-    if (auto p = changed_params.Param(LayerParamIndex::LfoRestart))
-        layer.lfo_restart_mode = p->ValueAsInt<param_values::LfoRestartMode>();
-
-    if (auto p = changed_params.Param(LayerParamIndex::Monophonic)) layer.monophonic = p->ValueAsBool();
+        if (auto p = changed_params.Param(LayerParamIndex::LfoRestart))
+            layer.lfo_restart_mode = p->ValueAsInt<param_values::LfoRestartMode>();
+    }
 
     // Loop
     // =======================================================================================================
-    {
+    if (changed_groups.Get(ToInt(LayerParamGroup::Loop))) {
         bool update_loop_info = false;
         if (auto p = changed_params.Param(LayerParamIndex::LoopStart)) {
             vmst.loop.start = p->ProjectedValue();
@@ -384,11 +400,16 @@ void OnParamChange(LayerProcessor& layer,
 
     // EQ
     // =======================================================================================================
-    if (auto p = changed_params.Param(LayerParamIndex::EqOn))
-        layer.eq_bands.SetOn(layer.smoothed_value_system, p->ValueAsBool());
-
-    for (auto const eq_band_index : Range(k_num_layer_eq_bands))
-        layer.eq_bands.OnParamChange(eq_band_index, changed_params, layer.smoothed_value_system, sample_rate);
+    if (changed_groups.Get(ToInt(LayerParamGroup::Eq))) {
+        if (auto p = changed_params.Param(LayerParamIndex::EqOn))
+            layer.eq_bands.SetOn(layer.smoothed_value_system, p->ValueAsBool());
+
+        for (auto const eq_band_index : Range(k_num_layer_eq_bands))
+            layer.eq_bands.OnParamChange(eq_band_index,
+                                         changed_params,
+                                         layer.smoothed_value_system,
+                                         sample_rate);
+    }
 }
 
 //
@@ -471,7 +492,11 @@ static void TriggerVoicesIfNeeded(LayerProcessor& layer,
                 (!region.trigger.round_robin_index || *region.trigger.round_robin_index == rr_pos) &&
                 region.trigger.event == trigger_event) {
 
-                VoiceStartParams::SamplerParams::Region reg {.region = region, .audio_data = *audio_data};
+                VoiceStartParams::SamplerParams::Region reg {
+                    .region = region,
+                    .audio_data = *audio_data,
+                    .baked_loop = inst->baked_loops.size ? inst->baked_loops[i] : nullptr,
+                };
                 reg.amp = velocity_volume_modifier;
                 dyn::Append(sampler_params.voice_sample_params, reg);
             }
@@ -633,9 +658,10 @@ ProcessResult ProcessLayer(LayerProcessor& layer,
         return result;
     }
 
+    layer.eq_bands.Process(layer.smoothed_value_system, ToStereoFramesSpan(buffer.data, num_frames));
+
     for (auto const i : Range(num_frames)) {
         StereoAudioFrame frame(buffer.data, i);
-        frame = layer.eq_bands.Process(layer.smoothed_value_system, frame, i);
 
         frame *= layer.smoothed_value_system.Value(layer.vol_smoother_id, i) *
                  layer.smoothed_value_system.Value(layer.mute_solo_mix_smoother_id, i);
@@ -663,7 +689,214 @@ ProcessResult ProcessLayer(LayerProcessor& layer,
 }
 
 void ResetLayerAudioProcessing(LayerProcessor& layer) {
-    for (auto& b : layer.eq_bands.eq_bands)
-        b.eq_data = {};
+    layer.eq_bands.Reset();
     layer.inst_change_fade.ForceSetFullVolume();
 }
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+struct EqTester {
+    EqTester(ArenaAllocator& arena) {
+        smoothing_system.PrepareToPlay(k_block_size, k_sample_rate, arena);
+        smoothing_system.HardSet(eq.eq_mix_smoother_id, 1);
+    }
+
+    void SetBand(u32 band, rbj_filter::Params params) {
+        params.fs = k_sample_rate;
+        smoothing_system.Set(eq.eq_bands[band].eq_coeffs_smoother_id, params);
+    }
+
+    // The way the bands were processed before they were combined: each band separately, one frame at a time.
+    void ProcessReference(Span<StereoAudioFrame> frames) {
+        for (auto [frame_index, frame] : Enumerate<u32>(frames)) {
+            for (auto const band : Range(k_num_layer_eq_bands)) {
+                auto const [coeffs, mix] =
+                    smoothing_system.Value(eq.eq_bands[band].eq_coeffs_smoother_id, frame_index);
+                frame = rbj_filter::Process(reference_data[band], coeffs, frame * mix);
+            }
+        }
+    }
+
+    static constexpr u32 k_block_size = 256;
+    static constexpr f32 k_sample_rate = 44100;
+    FloeSmoothedValueSystem smoothing_system;
+    EqBands eq {smoothing_system};
+    Array<rbj_filter::StereoData, k_num_layer_eq_bands> reference_data {};
+};
+
+// The magnitude response of a biquad at a frequency in cycles per sample.
+static f64 BiquadMagnitude(rbj_filter::Coeffs const& c, f64 frequency) {
+    auto const w = maths::k_tau<f64> * frequency;
+    auto const num_re = (f64)c.b0 + ((f64)c.b1 * Cos(w)) + ((f64)c.b2 * Cos(2 * w));
+    auto const num_im = -(((f64)c.b1 * Sin(w)) + ((f64)c.b2 * Sin(2 * w)));
+    auto const den_re = 1 + ((f64)c.a1 * Cos(w)) + ((f64)c.a2 * Cos(2 * w));
+    auto const den_im = -(((f64)c.a1 * Sin(w)) + ((f64)c.a2 * Sin(2 * w)));
+    return Sqrt(((num_re * num_re) + (num_im * num_im)) / ((den_re * den_re) + (den_im * den_im)));
+}
+
+TEST_CASE(TestLayerEqCascade) {
+    auto& t = *tester.scratch_arena.New<EqTester>(tester.scratch_arena);
+    constexpr auto k_block_size = EqTester::k_block_size;
+
+    constexpr rbj_filter::Params k_band1 {
+        .type = rbj_filter::Type::Peaking,
+        .fc = 300,
+        .q = 2,
+        .peak_gain = 9,
+    };
+    constexpr rbj_filter::Params k_band2 {
+        .type = rbj_filter::Type::HighShelf,
+        .fc = 5000,
+        .q = 0.7f,
+        .peak_gain = -6,
+    };
+
+    auto process_blocks = [&](Span<StereoAudioFrame> frames, bool reference) {
+        for (usize pos = 0; pos < frames.size; pos += k_block_size) {
+            auto const block = frames.SubSpan(pos, k_block_size);
+            t.smoothing_system.ProcessBlock((u32)block.size);
+            if (reference)
+                t.ProcessReference(block);
+            else
+                t.eq.Process(t.smoothing_system, block);
+        }
+    };
+
+    auto seed = SeedFromTime();
+    auto make_noise = [&](u32 num_frames) {
+        auto frames = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(num_frames);
+        for (auto& f : frames)
+            f = {RandomFloat01<f32>(seed) - 0.5f, RandomFloat01<f32>(seed) - 0.5f};
+        return frames;
+    };
+
+    SUBCASE("frequency response is the product of the two bands") {
+        t.SetBand(0, k_band1);
+        t.SetBand(1, k_band2);
+        t.smoothing_system.ResetAll();
+
+        constexpr u32 k_num_frames = k_block_size * 64;
+        auto impulse = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames);
+        for (auto& f : impulse)
+            f = {};
+        impulse[0] = {1, 1};
+        process_blocks(impulse, false);
+
+        auto const coeffs1 = rbj_filter::Coefficients({.type = k_band1.type,
+                                                       .fs = EqTester::k_sample_rate,
+                                                       .fc = k_band1.fc,
+                                                       .q = k_band1.q,
+                                                       .peak_gain = k_band1.peak_gain});
+        auto const coeffs2 = rbj_filter::Coefficients({.type = k_band2.type,
+                                                       .fs = EqTester::k_sample_rate,
+                                                       .fc = k_band2.fc,
+                                                       .q = k_band2.q,
+                                                       .peak_gain = k_band2.peak_gain});
+
+        f64 worst_db = 0;
+        for (auto const hz : Array {30.0, 100.0, 300.0, 1000.0, 3000.0, 5000.0, 10000.0, 18000.0}) {
+            CAPTURE(hz);
+            auto const frequency = hz / (f64)EqTester::k_sample_rate;
+            f64 re = 0;
+            f64 im = 0;
+            for (auto const [i, f] : Enumerate(impulse)) {
+                REQUIRE_EQ(f.l, f.r);
+                re += (f64)f.l * Cos(maths::k_tau<f64> * frequency * (f64)i);
+                im -= (f64)f.l * Sin(maths::k_tau<f64> * frequency * (f64)i);
+            }
+            auto const measured_db = 20 * Log10(Sqrt((re * re) + (im * im)));
+            auto const expected_db =
+                20 * Log10(BiquadMagnitude(coeffs1, frequency) * BiquadMagnitude(coeffs2, frequency));
+            worst_db = Max(worst_db, Fabs(measured_db - expected_db));
+            CHECK_LT(Fabs(measured_db - expected_db), 0.01);
+        }
+        tester.log.DebugLn("EQ cascade response within {} dB of the two bands' product", worst_db);
+    }
+
+    SUBCASE("matches the per-frame filters") {
+        t.SetBand(0, k_band1);
+        t.SetBand(1, k_band2);
+        t.smoothing_system.ResetAll();
+
+        constexpr u32 k_num_frames = k_block_size * 40;
+        auto const input = make_noise(k_num_frames);
+        auto cascade = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames);
+        auto reference = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames);
+        CopyMemory(cascade.data, input.data, input.ToByteSpan().size);
+        CopyMemory(reference.data, input.data, input.ToByteSpan().size);
+
+        // Process the same blocks both ways, changing the parameters part-way through so that the
+        // coefficients are smoothed.
+        f32 steady_difference = 0;
+        f32 smoothing_difference = 0;
+        for (u32 pos = 0; pos < k_num_frames; pos += k_block_size) {
+            if (pos == k_block_size * 10) {
+                t.SetBand(0, {.type = rbj_filter::Type::Peaking, .fc = 2000, .q = 1, .peak_gain = -12});
+                t.SetBand(1, {.type = rbj_filter::Type::HighShelf, .fc = 8000, .q = 1, .peak_gain = 6});
+            }
+            t.smoothing_system.ProcessBlock(k_block_size);
+            auto const smoothing = t.smoothing_system.IsSmoothing(t.eq.eq_bands[0].eq_coeffs_smoother_id);
+            t.eq.Process(t.smoothing_system, cascade.SubSpan(pos, k_block_size));
+            t.ProcessReference(reference.SubSpan(pos, k_block_size));
+            for (auto const i : Range(pos, pos + k_block_size)) {
+                auto const difference =
+                    Max(Abs(cascade[i].l - reference[i].l), Abs(cascade[i].r - reference[i].r));
+                auto& worst = smoothing ? smoothing_difference : steady_difference;
+                worst = Max(worst, difference);
+            }
+        }
+        tester.log.DebugLn("EQ cascade vs per-frame filters: max difference {} steady, {} while smoothing",
+                           steady_difference,
+                           smoothing_difference);
+        CHECK_LT(steady_difference, 1e-4f);
+        // The filter forms only give the same result for fixed coefficients, but they should stay close.
+        CHECK_LT(smoothing_difference, 0.01f);
+    }
+
+    SUBCASE("flat bands are skipped") {
+        t.SetBand(0, {.type = rbj_filter::Type::Peaking, .fc = 1000, .q = 1, .peak_gain = 0});
+        t.SetBand(1, {.type = rbj_filter::Type::LowShelf, .fc = 200, .q = 1, .peak_gain = 0});
+        t.smoothing_system.ResetAll();
+
+        auto const input = make_noise(k_block_size * 4);
+        auto output = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(input.size);
+        CopyMemory(output.data, input.data, input.ToByteSpan().size);
+        process_blocks(output, false);
+        CHECK(MemoryIsEqual(output.data, input.data, input.ToByteSpan().size));
+    }
+
+    SUBCASE("two active bands benchmark") {
+        t.SetBand(0, k_band1);
+        t.SetBand(1, k_band2);
+        t.smoothing_system.ResetAll();
+
+        constexpr u32 k_num_blocks = 20000;
+        auto frames = make_noise(k_block_size);
+        f32 sum = 0;
+        for (auto const reference : Array {true, false}) {
+            Stopwatch const stopwatch;
+            for (auto _ : Range(k_num_blocks)) {
+                process_blocks(frames, reference);
+                sum += frames[0].l;
+            }
+            tester.log.DebugLn("Layer EQ, {}: {.2} ms for {} blocks of {} frames",
+                               reference ? "per-frame filters"_s : "cascade"_s,
+                               stopwatch.MillisecondsElapsed(),
+                               k_num_blocks,
+                               k_block_size);
+        }
+        CHECK(Abs(sum) < LargestRepresentableValue<f32>());
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeLayerProcessorTests) { REGISTER_TEST(TestLayerEqCascade); }
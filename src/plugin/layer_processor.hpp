@@ -7,6 +7,7 @@
 #include "audio_processing_context.hpp"
 #include "instrument_type.hpp"
 #include "param.hpp"
+#include "param_dependencies.hpp"
 #include "param_info.hpp"
 #include "processing/adsr.hpp"
 #include "processing/filters.hpp"
@@ -19,11 +20,6 @@
 struct EqBand {
     EqBand(FloeSmoothedValueSystem& s) : eq_coeffs_smoother_id(s.CreateFilterSmoother()) {}
 
-    StereoAudioFrame Process(FloeSmoothedValueSystem& s, StereoAudioFrame in, u32 frame_index) {
-        auto [coeffs, mix] = s.Value(eq_coeffs_smoother_id, frame_index);
-        return rbj_filter::Process(eq_data, coeffs, in * mix);
-    }
-
     void OnParamChange(ChangedLayerParams changed_params,
                        f32 sample_rate,
                        FloeSmoothedValueSystem& s,
@@ -74,7 +70,6 @@ struct EqBand {
     }
 
     FloeSmoothedValueSystem::FilterId const eq_coeffs_smoother_id;
-    rbj_filter::StereoData eq_data {};
     rbj_filter::Params eq_params {};
 };
 
@@ -90,18 +85,66 @@ struct EqBands {
 
     void SetOn(FloeSmoothedValueSystem& s, bool on) { s.Set(eq_mix_smoother_id, on ? 1.0f : 0.0f, 4); }
 
-    StereoAudioFrame Process(FloeSmoothedValueSystem& s, StereoAudioFrame in, u32 frame_index) {
-        StereoAudioFrame result = in;
-        if (auto mix = s.Value(eq_mix_smoother_id, frame_index); mix != 0) {
-            for (auto& eq_band : eq_bands)
-                result = eq_band.Process(s, result, frame_index);
-            if (mix != 1) result = LinearInterpolate(mix, in, result);
+    // Both bands are processed together by one cascade over the whole block.
+    void Process(FloeSmoothedValueSystem& s, Span<StereoAudioFrame> frames) {
+        static_assert(k_num_layer_eq_bands == 2);
+        if (!frames.size) return;
+        auto const num_frames = (u32)frames.size;
+
+        auto const mix_smoothing = s.IsSmoothing(eq_mix_smoother_id, 0);
+        if (!mix_smoothing && s.TargetValue(eq_mix_smoother_id) == 0) {
+            cascade = {};
+            return;
+        }
+
+        auto const& band1 = eq_bands[0];
+        auto const& band2 = eq_bands[1];
+        auto const coeffs_smoothing = s.IsSmoothing(band1.eq_coeffs_smoother_id) ||
+                                      s.IsSmoothing(band2.eq_coeffs_smoother_id);
+        if (!mix_smoothing && !coeffs_smoothing &&
+            rbj_filter::IsFlat(s.Value(band1.eq_coeffs_smoother_id, 0).coeffs) &&
+            rbj_filter::IsFlat(s.Value(band2.eq_coeffs_smoother_id, 0).coeffs) &&
+            cascade.StateIsNegligible()) {
+            // Once a flat filter has settled its state is all zeros in this form, so we can carry on from
+            // here at any time.
+            cascade = {};
+            return;
         }
-        return result;
+
+        // The second band is a frame behind the first, so it uses the previous frame's values.
+        rbj_filter::StereoCascade::Coeffs coeffs;
+        f32x4 gain;
+        auto const update_coeffs = [&](u32 band1_frame, u32 band2_frame) {
+            auto const [coeffs1, mix1] = s.Value(band1.eq_coeffs_smoother_id, band1_frame);
+            auto const [coeffs2, mix2] = s.Value(band2.eq_coeffs_smoother_id, band2_frame);
+            coeffs = rbj_filter::StereoCascade::CombineCoeffs(coeffs1, coeffs2);
+            gain = {mix1, mix1, mix2, mix2};
+        };
+
+        auto const output = [&](u32 frame_index, f32x4 out) {
+            StereoAudioFrame result {out[2], out[3]};
+            if (mix_smoothing) {
+                auto const mix = s.Value(eq_mix_smoother_id, frame_index);
+                result = LinearInterpolate(mix, frames[frame_index], result);
+            }
+            frames[frame_index] = result;
+        };
+
+        update_coeffs(0, 0);
+        cascade.StepFirstOnly(coeffs, frames[0], gain);
+        for (u32 frame_index = 1; frame_index < num_frames; ++frame_index) {
+            if (coeffs_smoothing) update_coeffs(frame_index, frame_index - 1);
+            output(frame_index - 1, cascade.Step(coeffs, frames[frame_index], gain));
+        }
+        if (coeffs_smoothing) update_coeffs(num_frames - 1, num_frames - 1);
+        output(num_frames - 1, cascade.StepSecondOnly(coeffs, gain));
     }
 
+    void Reset() { cascade = {}; }
+
     InitialisedArray<EqBand, k_num_layer_eq_bands> eq_bands;
     FloeSmoothedValueSystem::FloatId const eq_mix_smoother_id;
+    rbj_filter::StereoCascade cascade {};
 };
 
 // audio-thread data that voices use to control their sound
@@ -249,7 +292,8 @@ void SetTempo(LayerProcessor& layer, VoicePool& voice_pool, AudioProcessingConte
 void OnParamChange(LayerProcessor& layer,
                    AudioProcessingContext const& context,
                    VoicePool& voice_pool,
-                   ChangedLayerParams changed_params);
+                   ChangedLayerParams changed_params,
+                   LayerParamGroups changed_groups);
 bool ChangeInstrumentIfNeededAndReset(LayerProcessor& layer, VoicePool& voice_pool);
 void PrepareToPlay(LayerProcessor& layer, ArenaAllocator& allocator, AudioProcessingContext const& context);
 
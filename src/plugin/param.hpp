@@ -49,6 +49,11 @@ class ChangedParamsTemplate {
 
     bool Changed(IndexType index) const { return m_changed.Get((int)index); }
 
+    template <typename Function>
+    void ForEachChanged(Function&& function) const {
+        m_changed.ForEachSetBit([&function](usize index) { function((IndexType)index); });
+    }
+
     auto Params() { return m_params; }
 
   private:
@@ -0,0 +1,100 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+#pragma once
+
+#include "foundation/foundation.hpp"
+
+#include "effects/effect_infos.hpp"
+#include "param_info.hpp"
+
+// On the audio-thread, each parameter is read by exactly one handler. This table is generated at
+// compile-time from the modules in param_info.hpp so that when a parameter changes we can dispatch straight
+// to that handler rather than have every layer and every effect probe the whole changed-params bitset.
+
+// The sections of a layer's OnParamChange.
+enum class LayerParamGroup : u8 {
+    Main,
+    Loop,
+    VolEnv,
+    Filter,
+    Lfo,
+    Eq,
+    Midi,
+    Count,
+};
+
+constexpr auto k_num_layer_param_groups = ToInt(LayerParamGroup::Count);
+using LayerParamGroups = Bitset<k_num_layer_param_groups>;
+
+enum class ParamConsumerType : u8 {
+    Master,
+    MuteSolo,
+    Layer,
+    Effect,
+};
+
+struct ParamConsumer {
+    ParamConsumerType type;
+    u8 index; // layer index for MuteSolo and Layer, EffectType for Effect
+    LayerParamGroup layer_group;
+};
+
+consteval auto CreateParamConsumers() {
+    Array<ParamConsumer, k_num_parameters> result {};
+    for (auto const& info : k_param_infos) {
+        auto& consumer = result[ToInt(info.index)];
+        switch (info.module_parts[0]) {
+            case ParameterModule::Master: consumer = {.type = ParamConsumerType::Master}; break;
+
+            case ParameterModule::Layer1:
+            case ParameterModule::Layer2:
+            case ParameterModule::Layer3: {
+                auto const layer_info = *LayerParamInfoFromGlobalIndex(info.index);
+                if (layer_info.param == LayerParamIndex::Mute || layer_info.param == LayerParamIndex::Solo) {
+                    consumer = {.type = ParamConsumerType::MuteSolo, .index = (u8)layer_info.layer_num};
+                    break;
+                }
+
+                consumer = {.type = ParamConsumerType::Layer, .index = (u8)layer_info.layer_num};
+                switch (info.module_parts[1]) {
+                    case ParameterModule::None: consumer.layer_group = LayerParamGroup::Main; break;
+                    case ParameterModule::Loop: consumer.layer_group = LayerParamGroup::Loop; break;
+                    case ParameterModule::VolEnv: consumer.layer_group = LayerParamGroup::VolEnv; break;
+                    case ParameterModule::Filter: consumer.layer_group = LayerParamGroup::Filter; break;
+                    case ParameterModule::Lfo: consumer.layer_group = LayerParamGroup::Lfo; break;
+                    case ParameterModule::Eq: consumer.layer_group = LayerParamGroup::Eq; break;
+                    case ParameterModule::Midi: consumer.layer_group = LayerParamGroup::Midi; break;
+                    default: throw "layer param module has no group";
+                }
+                break;
+            }
+
+            case ParameterModule::Effect: {
+                bool found = false;
+                for (auto const i : Range(k_num_effect_types)) {
+                    if (k_effect_info[i].module == info.module_parts[1]) {
+                        consumer = {.type = ParamConsumerType::Effect, .index = (u8)i};
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) throw "effect param module has no effect";
+                break;
+            }
+
+            default: throw "param has no consumer";
+        }
+    }
+
+    for (auto const i : Range(k_num_effect_types)) {
+        auto const& on_param = result[ToInt(k_effect_info[i].on_param_index)];
+        if (on_param.type != ParamConsumerType::Effect || on_param.index != i)
+            throw "effect on-param must belong to the effect";
+    }
+
+    return result;
+}
+
+constexpr auto k_param_consumers = CreateParamConsumers();
+
+constexpr ParamConsumer const& ParamConsumerFor(ParamIndex index) { return k_param_consumers[ToInt(index)]; }
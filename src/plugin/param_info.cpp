@@ -215,6 +215,14 @@ Optional<DynamicArrayInline<char, 128>> ParameterInfo::LinearValueToString(f32 l
     return fmt::FormatInline<k_size>("{.1}", value);
 }
 
+Optional<String> ParamValueStringCache::LinearValueToString(ParamIndex index, f32 linear_value) {
+    auto& entry = entries[ToInt(index)];
+    if (!entry || entry->linear_value != linear_value)
+        entry = Entry {linear_value, k_param_infos[ToInt(index)].LinearValueToString(linear_value)};
+    if (!entry->str) return nullopt;
+    return String {*entry->str};
+}
+
 String ParamMenuText(ParamIndex index, f32 value) {
     auto const menu_items = ParameterMenuItems(index);
     ASSERT(menu_items.size);
@@ -452,7 +460,93 @@ TEST_CASE(TestLegacyConversion) {
     return k_success;
 }
 
+TEST_CASE(TestParamValueStringCache) {
+    auto seed = SeedFromTime();
+    auto const random_value = [&](ParameterInfo const& info) {
+        auto const v = info.linear_range.min + (RandomFloat01<f32>(seed) * info.linear_range.Delta());
+        if (info.value_type == ParamValueType::Float) return v;
+        return Trunc(v);
+    };
+
+    SUBCASE("gives the same strings as formatting directly") {
+        ParamValueStringCache cache;
+        for (auto const round : Range(3)) {
+            (void)round;
+            for (auto const& info : k_param_infos) {
+                auto const value = random_value(info);
+                for (auto const repeat : Range(2)) {
+                    (void)repeat;
+                    auto const cached = cache.LinearValueToString(info.index, value);
+                    auto const direct = info.LinearValueToString(value);
+                    REQUIRE_EQ(cached.HasValue(), direct.HasValue());
+                    if (direct) CHECK_EQ(*cached, String {*direct});
+                }
+            }
+        }
+    }
+
+    SUBCASE("full sweep benchmark") {
+        // A host refreshing a generic editor or its automation lanes for every param of every instance, with
+        // only a few params changing between sweeps.
+        constexpr u32 k_num_instances = 100;
+        constexpr u32 k_num_sweeps = 10;
+        constexpr u32 k_changes_per_sweep = 4;
+
+        auto caches = tester.scratch_arena.NewMultiple<ParamValueStringCache>(k_num_instances);
+        auto values = tester.scratch_arena.AllocateExactSizeUninitialised<Array<f32, k_num_parameters>>(
+            k_num_instances);
+        for (auto& instance_values : values)
+            for (auto const& info : k_param_infos)
+                instance_values[ToInt(info.index)] = random_value(info);
+
+        f64 direct_seconds = 0;
+        f64 cached_seconds = 0;
+        usize num_chars = 0;
+        for (auto _ : Range(k_num_sweeps)) {
+            for (auto& instance_values : values) {
+                for (auto const change : Range(k_changes_per_sweep)) {
+                    (void)change;
+                    auto const& info = k_param_infos[RandomIntInRange<u32>(seed, 0, k_num_parameters - 1)];
+                    instance_values[ToInt(info.index)] = random_value(info);
+                }
+            }
+
+            {
+                Stopwatch const stopwatch;
+                for (auto const& instance_values : values)
+                    for (auto const& info : k_param_infos)
+                        if (auto const str = info.LinearValueToString(instance_values[ToInt(info.index)]))
+                            num_chars += str->size;
+                direct_seconds += stopwatch.SecondsElapsed();
+            }
+
+            {
+                Stopwatch const stopwatch;
+                for (auto const [instance_index, instance_values] : Enumerate(values))
+                    for (auto const& info : k_param_infos)
+                        if (auto const str = caches[instance_index].LinearValueToString(
+                                info.index,
+                                instance_values[ToInt(info.index)]))
+                            num_chars += str->size;
+                cached_seconds += stopwatch.SecondsElapsed();
+            }
+        }
+        CHECK_GT(num_chars, 0u);
+
+        auto const num_queries = (f64)(k_num_sweeps * k_num_instances * k_num_parameters);
+        tester.log.DebugLn("Param value strings, {} instances x {} params: {.1} ns per query direct, "
+                           "{.1} ns cached",
+                           k_num_instances,
+                           k_num_parameters,
+                           direct_seconds * 1e9 / num_queries,
+                           cached_seconds * 1e9 / num_queries);
+    }
+
+    return k_success;
+}
+
 TEST_REGISTRATION(FloeParamStringConversionTests) {
     REGISTER_TEST(TestLegacyConversion);
     REGISTER_TEST(TestParamStringConversion);
+    REGISTER_TEST(TestParamValueStringCache);
 }
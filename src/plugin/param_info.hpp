@@ -2207,6 +2207,20 @@ constexpr Optional<ParamIndex> ParamIdToIndex(u32 id) {
 }
 constexpr u32 ParamIndexToId(ParamIndex index) { return k_param_infos[ToInt(index)].id; }
 
+// Hosts ask for the display string of every param over and over to refresh their generic editors and
+// automation lanes, nearly always for the same value as last time. We keep the last string made for each
+// param. The value is part of the key, so a param that has changed just misses. [main-thread]
+struct ParamValueStringCache {
+    // The result is only valid until the next call for the same param.
+    Optional<String> LinearValueToString(ParamIndex index, f32 linear_value);
+
+    struct Entry {
+        f32 linear_value;
+        Optional<DynamicArrayInline<char, 128>> str;
+    };
+    Array<Optional<Entry>, k_num_parameters> entries {};
+};
+
 Span<String const> ParameterMenuItems(ParamIndex param_index);
 
 String ParamMenuText(ParamIndex index, f32 value);
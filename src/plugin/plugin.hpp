@@ -48,6 +48,10 @@ struct PluginCallbacks {
     clap_process_status (*process)(UserObject&, clap_process const& process) =
         [](UserObject&, clap_process const&) -> clap_process_status { return CLAP_PROCESS_SLEEP; };
 
+    // The number of frames the output is delayed by, reported to the host so that it can compensate.
+    // [main-thread & (being-activated | active_state)]
+    u32 (*latency)(UserObject&) = [](UserObject&) -> u32 { return 0; };
+
     // Flushes a set of parameter changes.
     // This method must not be called concurrently to clap_plugin->process().
     //
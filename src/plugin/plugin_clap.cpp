@@ -5,6 +5,7 @@
 #include "utils/debug/debug.hpp"
 
 #include "clap/ext/audio-ports.h"
+#include "clap/ext/latency.h"
 #include "clap/ext/note-ports.h"
 #include "clap/ext/params.h"
 #include "clap/ext/posix-fd-support.h"
@@ -87,6 +88,12 @@ struct FloeInstance {
 
     Optional<PluginInstance> plugin {};
 
+    // The latency reported after the last activation. It depends on the internal sample rate chosen in
+    // activate, so a later activation can change it.
+    Optional<u32> activated_latency {};
+
+    ParamValueStringCache param_value_strings {};
+
 #if FLOE_GUI
     GuiPlatform* gui_platform = nullptr;
     Optional<Gui> gui {};
@@ -318,7 +325,6 @@ clap_plugin_gui const floe_gui {
         auto& floe = *(FloeInstance*)plugin->plugin_data;
         ZoneScopedMessage(floe.trace_config, "gui hide");
         DebugAssertMainThread(floe.host);
-        // IMRPOVE: stop update timers
         floe.gui_platform->SetVisible(false);
         return true;
     },
@@ -368,14 +374,16 @@ clap_plugin_params const floe_params {
     // Fills out_buffer with a null-terminated UTF-8 string that represents the parameter at the
     // given 'value' argument. eg: "2.3 kHz". Returns true on success. The host should always use
     // this to format parameter values before displaying it to the user. [main-thread]
-    .value_to_text =
-        [](clap_plugin_t const*, clap_id param_id, f64 value, char* out_buffer, u32 out_buffer_capacity)
-        -> bool {
+    .value_to_text = [](clap_plugin_t const* plugin,
+                        clap_id param_id,
+                        f64 value,
+                        char* out_buffer,
+                        u32 out_buffer_capacity) -> bool {
+        auto& floe = *(FloeInstance*)plugin->plugin_data;
+        DebugAssertMainThread(floe.host);
         auto const opt_index = ParamIdToIndex(param_id);
         if (!opt_index) return false;
-        auto const index = (usize)*opt_index;
-        auto const& p = k_param_infos[index];
-        auto const str = p.LinearValueToString((f32)value);
+        auto const str = floe.param_value_strings.LinearValueToString(*opt_index, (f32)value);
         if (!str) return false;
         if (out_buffer_capacity < (str->size + 1)) return false;
         CopyMemory(out_buffer, str->data, str->size);
@@ -450,6 +458,18 @@ clap_plugin_audio_ports const floe_audio_ports {
     },
 };
 
+clap_plugin_latency const floe_latency {
+    // Returns the plugin latency in samples.
+    // [main-thread & (being-activated | active)]
+    .get = [](clap_plugin_t const* plugin) -> u32 {
+        ZoneScopedN("clap_plugin_latency get");
+        auto& floe = *(FloeInstance*)plugin->plugin_data;
+        DebugAssertMainThread(floe.host);
+        auto& processor = floe.plugin->processor;
+        return processor.processor_callbacks.latency(processor);
+    },
+};
+
 static constexpr clap_id k_main_note_port_id = 1; // never change this
 
 // The note ports scan has to be done while the plugin is deactivated.
@@ -493,7 +513,7 @@ clap_plugin_timer_support const floe_timer {
 #if FLOE_GUI
             // At the moment we are only ever using timer for GUI stuff, so we don't need to
             // check for specific timer ids.
-            floe.gui_platform->PollAndUpdate();
+            floe.gui_platform->PollFromHost();
 #endif
         },
 };
@@ -515,7 +535,7 @@ clap_plugin_posix_fd_support const floe_posix_fd {
 #if FLOE_GUI
             // At the moment we are only ever using posix fd for GUI stuff, so we don't need to
             // check for specific fd values or flags.
-            floe.gui_platform->PollAndUpdate();
+            floe.gui_platform->PollFromHost();
 #endif
         },
 };
@@ -621,8 +641,22 @@ clap_plugin const floe_plugin {
         if (floe.active) return false;
         auto& processor = floe.plugin->processor;
 
+        // The setting may have changed since the last activation.
+        processor.max_internal_sample_rate.Store(
+            floe.plugin->shared_data.settings.settings.engine.max_internal_sample_rate);
+
         PluginActivateArgs const args {sample_rate, min_frames_count, max_frames_count};
         if (!processor.processor_callbacks.activate(processor, args)) return false;
+
+        auto const latency = processor.processor_callbacks.latency(processor);
+        if (floe.activated_latency && *floe.activated_latency != latency) {
+            // The host is only required to re-query the latency if we tell it it changed.
+            if (auto const host_latency =
+                    (clap_host_latency const*)floe.host.get_extension(&floe.host, CLAP_EXT_LATENCY))
+                host_latency->changed(&floe.host);
+        }
+        floe.activated_latency = latency;
+
         floe.active = true;
         return true;
     },
@@ -723,6 +757,7 @@ clap_plugin const floe_plugin {
         if (NullTermStringsEqual(id, CLAP_EXT_PARAMS)) return &floe_params;
         if (NullTermStringsEqual(id, CLAP_EXT_NOTE_PORTS)) return &floe_note_ports;
         if (NullTermStringsEqual(id, CLAP_EXT_AUDIO_PORTS)) return &floe_audio_ports;
+        if (NullTermStringsEqual(id, CLAP_EXT_LATENCY)) return &floe_latency;
         if (NullTermStringsEqual(id, CLAP_EXT_THREAD_POOL)) return &floe_thread_pool;
         if (NullTermStringsEqual(id, CLAP_EXT_TIMER_SUPPORT)) return &floe_timer;
         if (NullTermStringsEqual(id, CLAP_EXT_POSIX_FD_SUPPORT)) return &floe_posix_fd;
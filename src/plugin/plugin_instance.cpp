@@ -36,6 +36,7 @@ StateSnapshot CurrentStateSnapshot(PluginInstance& plugin) {
         result.insts[i] = plugin.layers[i].desired_instrument;
 
     result.ir_index = plugin.processor.convo.ir_index;
+    result.engine_version = plugin.processor.engine_version.Load();
     for (auto const i : Range(k_num_parameters)) {
         result.param_values[i] = plugin.preset_is_loading ? plugin.latest_snapshot.state.param_values[i]
                                                           : plugin.processor.params[i].LinearValue();
@@ -53,18 +54,41 @@ static void PresetLoadComplete(PluginInstance& plugin) {
     ASSERT(!plugin.pending_sample_lib_request_ids || plugin.pending_sample_lib_request_ids->size == 0);
     plugin.pending_sample_lib_request_ids.Clear();
 
-    for (auto const i : Range(k_num_parameters))
-        plugin.processor.params[i].SetLinearValue(plugin.latest_snapshot.state.param_values[i]);
+    auto const& state = plugin.latest_snapshot.state;
+    auto const diff = plugin.pending_state_diff;
+    plugin.pending_state_diff = {};
+
+    Bitset<k_num_parameters> params_changed {};
+    if (diff.engine_version) {
+        // A different engine version can change how anything sounds so we reload everything.
+        for (auto const i : Range(k_num_parameters))
+            if (plugin.processor.params[i].SetLinearValue(state.param_values[i])) params_changed.Set(i);
+        plugin.processor.desired_effects_order.Store(EncodeEffectsArray(state.fx_order));
+        plugin.processor.engine_version.Store(state.engine_version);
+        plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ReloadAllAudioState);
+    } else {
+        params_changed = SetAllParameterValues(plugin.processor, state.param_values);
+
+        if (diff.fx_order) {
+            plugin.processor.desired_effects_order.Store(EncodeEffectsArray(state.fx_order));
+            plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::FxOrderChanged);
+        }
 
-    plugin.processor.desired_effects_order.Store(EncodeEffectsArray(plugin.latest_snapshot.state.fx_order));
-    plugin.processor.engine_version.Store(plugin.latest_snapshot.state.engine_version);
+        // Sampler instruments and IRs that were loaded as part of this state were installed without notifying
+        // the audio thread so that they all change at the same time: now.
+        for (auto const layer_index : Range((u32)k_num_layers)) {
+            if (diff.insts.Get(layer_index) &&
+                plugin.layers[layer_index].desired_instrument.tag == InstrumentType::Sampler)
+                plugin.processor.events_for_audio_thread.Push(
+                    LayerInstrumentChanged {.layer_index = layer_index});
+        }
+        if (diff.ir && state.ir_index)
+            plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ConvolutionIRChanged);
+    }
 
-    auto const host = &plugin.host;
-    auto const host_params = (clap_host_params const*)host->get_extension(host, CLAP_EXT_PARAMS);
-    if (host_params) host_params->rescan(host, CLAP_PARAM_RESCAN_VALUES);
+    NotifyHostOfParamChanges(plugin.processor, params_changed);
     --plugin.preset_is_loading;
 
-    plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ReloadAllAudioState);
     plugin.host.request_process(&plugin.host);
 }
 
@@ -83,25 +107,38 @@ void ApplyNewState(PluginInstance& plugin,
     plugin.host.request_callback(&plugin.host);
 
     if (state) {
+        // Only the parts that differ from the current state are applied so that switching between similar
+        // states doesn't reload instruments or restart voices unnecessarily.
+        auto const diff = DiffStateSnapshots(CurrentStateSnapshot(plugin), *state);
+
         plugin.pending_sample_lib_request_ids.Emplace();
         plugin.latest_snapshot.state = *state;
 
-        if (source == StateSource::Daw)
+        if (source == StateSource::Daw) {
             for (auto [i, cc] : Enumerate(plugin.processor.param_learned_ccs))
-                cc.AssignBlockwise(plugin.latest_snapshot.state.param_learned_ccs[i]);
+                if (diff.param_learned_ccs.Get(i))
+                    cc.AssignBlockwise(plugin.latest_snapshot.state.param_learned_ccs[i]);
+        }
 
         for (auto [layer_index, i] : Enumerate<u32>(plugin.latest_snapshot.state.insts)) {
+            // An unchanged sampler instrument might have failed to load previously, so we try it again.
+            if (!diff.insts.Get(layer_index) && plugin.layers[layer_index].instrument.tag == i.tag) continue;
+            plugin.pending_state_diff.insts.Set(layer_index);
             auto const async_id = SetInstrument(plugin, layer_index, i);
             if (async_id) dyn::Append(*plugin.pending_sample_lib_request_ids, *async_id);
         }
 
-        auto const async_id = SetConvolutionIr(plugin, plugin.latest_snapshot.state.ir_index);
-        if (async_id) dyn::Append(*plugin.pending_sample_lib_request_ids, *async_id);
+        if (diff.ir) {
+            plugin.pending_state_diff.ir = true;
+            auto const async_id = SetConvolutionIr(plugin, plugin.latest_snapshot.state.ir_index);
+            if (async_id) dyn::Append(*plugin.pending_sample_lib_request_ids, *async_id);
+        }
 
-        if (plugin.pending_sample_lib_request_ids->size == 0)
-            PresetLoadComplete(plugin);
-        else
-            ++plugin.preset_is_loading;
+        plugin.pending_state_diff.fx_order |= diff.fx_order;
+        plugin.pending_state_diff.engine_version |= diff.engine_version;
+
+        ++plugin.preset_is_loading;
+        if (plugin.pending_sample_lib_request_ids->size == 0) PresetLoadComplete(plugin);
     }
 }
 
@@ -128,14 +165,12 @@ void LoadPresetFromFile(PluginInstance& plugin, String path) {
     if (state_outcome.HasValue())
         ApplyNewState(plugin, &state_outcome.Value(), {.name_or_path = path}, StateSource::PresetFile);
     else {
-        auto item = plugin.error_notifications.NewError();
-        item->value = {
+        plugin.error_notifications.AddOrUpdateError({
             .title = "Failed to load preset"_s,
             .message = path,
             .error_code = state_outcome.Error(),
             .id = U64FromChars("statload"),
-        };
-        plugin.error_notifications.AddOrUpdateError(item);
+        });
     }
 }
 
@@ -143,20 +178,20 @@ void SaveCurrentStateToFile(PluginInstance& plugin, String path) {
     if (auto outcome = SavePresetFile(path, CurrentStateSnapshot(plugin)); outcome.Succeeded())
         ApplyNewState(plugin, nullptr, {.name_or_path = path}, StateSource::PresetFile);
     else {
-        auto item = plugin.error_notifications.NewError();
-        item->value = {
+        plugin.error_notifications.AddOrUpdateError({
             .title = "Failed to save preset"_s,
             .message = path,
             .error_code = outcome.Error(),
             .id = U64FromChars("statsave"),
-        };
-        plugin.error_notifications.AddOrUpdateError(item);
+        });
     }
 }
 
 static void
 SetDesiredConvolutionIr(PluginInstance& plugin, AudioData const* audio_data, bool notify_audio_thread) {
     DebugAssertMainThread(plugin.host);
+    // Read for each IR so that a change to the setting applies from the next IR that's loaded.
+    plugin.processor.convo.max_ir_ms = plugin.shared_data.settings.settings.engine.max_convolution_ir_ms;
     plugin.processor.convo.ConvolutionIrDataLoaded(audio_data);
     if (notify_audio_thread) {
         plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ConvolutionIRChanged);
@@ -201,6 +236,34 @@ static void SetDesiredInstrument(PluginInstance& plugin,
     }
 }
 
+static void InstallLoadedAsset(PluginInstance& plugin,
+                               sample_lib_loader::LoadResult const& result,
+                               bool notify_audio_thread) {
+    if (result.result.tag != sample_lib_loader::LoadResult::ResultType::Success) return;
+
+    auto asset_union = result.result.Get<sample_lib_loader::AssetRefUnion>();
+    switch (asset_union.tag) {
+        case sample_lib_loader::AssetType::Instrument: {
+            auto loaded_inst =
+                asset_union.Get<sample_lib_loader::RefCounted<sample_lib_loader::LoadedInstrument>>();
+            for (auto [layer_index, l] : Enumerate<u32>(plugin.layers)) {
+                if (auto i = l.desired_instrument.TryGet<sample_lib::InstrumentId>()) {
+                    if (i->library_name == loaded_inst->instrument.library.name &&
+                        i->inst_name == loaded_inst->instrument.name) {
+                        SetDesiredInstrument(plugin, layer_index, loaded_inst, notify_audio_thread);
+                    }
+                }
+            }
+            break;
+        }
+        case sample_lib_loader::AssetType::Ir: {
+            auto audio_data = asset_union.Get<sample_lib_loader::RefCounted<AudioData>>();
+            SetDesiredConvolutionIr(plugin, &*audio_data, notify_audio_thread);
+            break;
+        }
+    }
+}
+
 static void AssetLoadedJobCompleted(PluginInstance& plugin, sample_lib_loader::LoadResult result) {
     ZoneScoped;
     DebugAssertMainThread(plugin.host);
@@ -221,35 +284,12 @@ static void AssetLoadedJobCompleted(PluginInstance& plugin, sample_lib_loader::L
     });
 
     switch (source) {
-        case ResultSource::OneOff: {
-            if (result.result.tag == sample_lib_loader::LoadResult::ResultType::Success) {
-                auto asset_union = result.result.Get<sample_lib_loader::AssetRefUnion>();
-                switch (asset_union.tag) {
-                    case sample_lib_loader::AssetType::Instrument: {
-                        auto loaded_inst =
-                            asset_union
-                                .Get<sample_lib_loader::RefCounted<sample_lib_loader::LoadedInstrument>>();
-                        for (auto [layer_index, l] : Enumerate<u32>(plugin.layers)) {
-                            if (auto i = l.desired_instrument.TryGet<sample_lib::InstrumentId>()) {
-                                if (i->library_name == loaded_inst->instrument.library.name &&
-                                    i->inst_name == loaded_inst->instrument.name) {
-                                    SetDesiredInstrument(plugin, layer_index, loaded_inst, true);
-                                }
-                            }
-                        }
-                        break;
-                    }
-                    case sample_lib_loader::AssetType::Ir: {
-                        auto audio_data = asset_union.Get<sample_lib_loader::RefCounted<AudioData>>();
-                        SetDesiredConvolutionIr(plugin, &*audio_data, true);
-                        break;
-                    }
-                }
-            }
+        case ResultSource::OneOff: InstallLoadedAsset(plugin, result, true); break;
+        case ResultSource::PartOfPendingStateChange: InstallLoadedAsset(plugin, result, false); break;
+        case ResultSource::LastInPendingStateChange:
+            InstallLoadedAsset(plugin, result, false);
+            PresetLoadComplete(plugin);
             break;
-        }
-        case ResultSource::PartOfPendingStateChange: break;
-        case ResultSource::LastInPendingStateChange: PresetLoadComplete(plugin); break;
     }
 
     plugin.processor.for_main_thread.flags.FetchOr(AudioProcessor::MainThreadCallbackFlagsRedrawGui);
@@ -360,14 +400,15 @@ static void OnMainThread(PluginInstance& plugin, bool& update_gui) {
 
 void SetAllParametersToDefaultValues(PluginInstance& plugin) {
     DebugAssertMainThread(plugin.host);
-    for (auto& p : plugin.processor.params)
-        p.SetLinearValue(p.DefaultLinearValue());
+    Bitset<k_num_parameters> changed {};
+    for (auto const i : Range(k_num_parameters)) {
+        auto& p = plugin.processor.params[i];
+        if (p.SetLinearValue(p.DefaultLinearValue())) changed.Set(i);
+    }
 
     plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ReloadAllAudioState);
-    auto const host = &plugin.host;
-    auto const params = (clap_host_params const*)host->get_extension(host, CLAP_EXT_PARAMS);
-    if (params) params->rescan(host, CLAP_PARAM_RESCAN_VALUES);
-    host->request_process(host);
+    NotifyHostOfParamChanges(plugin.processor, changed);
+    plugin.host.request_process(&plugin.host);
 }
 
 static void ProcessorRandomiseAllParamsInternal(PluginInstance& plugin, bool only_effects) {
@@ -383,10 +424,11 @@ static void ProcessorRandomiseAllParamsInternal(PluginInstance& plugin, bool onl
     RandomNormalDistribution normal_dist {0.5, 0.20};
     RandomNormalDistribution normal_dist_strong {0.5, 0.10};
 
+    Bitset<k_num_parameters> changed {};
     auto SetParam = [&](Parameter &p, f32 v) {
         if (p.info.flags & param_flags::Truncated) v = roundf(v);
         ASSERT(v >= p.info.linear_range.min && v <= p.info.linear_range.max);
-        p.SetLinearValue(v);
+        if (p.SetLinearValue(v)) changed.Set(ToInt(p.info.index));
     };
     auto SetAnyRandom = [&](Parameter &p) {
         SetParam(p, float_gen.GetRandomInRange(seed, p.info.linear_range.min, p.info.linear_range.max));
@@ -658,10 +700,9 @@ static void ProcessorRandomiseAllParamsInternal(PluginInstance& plugin, bool onl
     // IMPROVE: if we have only randomised the effects, then we don't need to trigger an entire state reload
     // including restarting voices.
 
-    const auto host = &plugin.host;
-    const auto host_params = (const clap_host_params *)host->get_extension(host, CLAP_EXT_PARAMS);
-    if (host_params) host_params->rescan(host, CLAP_PARAM_RESCAN_VALUES);
     plugin.processor.events_for_audio_thread.Push(EventForAudioThreadType::ReloadAllAudioState);
+    NotifyHostOfParamChanges(plugin.processor, changed);
+    plugin.host.request_process(&plugin.host);
 #endif
 }
 
@@ -761,14 +802,12 @@ static bool PluginSaveState(PluginInstance& plugin, clap_ostream const& stream)
                              });
 
     if (outcome.HasError()) {
-        auto item = plugin.error_notifications.NewError();
-        item->value = {
+        plugin.error_notifications.AddOrUpdateError({
             .title = "Failed to save state for DAW"_s,
             .message = {},
             .error_code = outcome.Error(),
             .id = U64FromChars("daw save"),
-        };
-        plugin.error_notifications.AddOrUpdateError(item);
+        });
         return false;
     }
     return true;
@@ -797,14 +836,12 @@ static bool PluginLoadState(PluginInstance& plugin, clap_istream const& stream)
                   });
 
     if (outcome.HasError()) {
-        auto item = plugin.error_notifications.NewError();
-        item->value = {
+        plugin.error_notifications.AddOrUpdateError({
             .title = "Failed to load DAW state"_s,
             .message = {},
             .error_code = outcome.Error(),
             .id = U64FromChars("daw load"),
-        };
-        plugin.error_notifications.AddOrUpdateError(item);
+        });
         return false;
     }
 
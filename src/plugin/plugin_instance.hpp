@@ -121,6 +121,7 @@ struct PluginInstance {
         .metadata = {.name_or_path = "Default"},
     };
     int preset_is_loading {};
+    StateSnapshotDiff pending_state_diff {}; // what the pending state change needs to apply
 
     // Presets
     // ========================================================================
@@ -192,24 +192,20 @@ PresetsFolderScanResult FetchOrRescanPresetsFolder(PresetsListing& listing,
                 return ((u64)U32FromChars("pres") << 32) | Hash32(path);
             };
             for (auto& err : errors.folder_errors) {
-                auto item = listing.error_notifications.NewError();
-                item->value = {
+                listing.error_notifications.AddOrUpdateError({
                     .title = "Failed to scan preset folder"_s,
                     .message = err.path,
                     .error_code = err.error,
                     .id = error_id(err.path),
-                };
-                listing.error_notifications.AddOrUpdateError(item);
+                });
             }
             for (auto& err : errors.metadata_errors) {
-                auto item = listing.error_notifications.NewError();
-                item->value = {
+                listing.error_notifications.AddOrUpdateError({
                     .title = "Failed to read preset file"_s,
                     .message = err.path,
                     .error_code = err.error,
                     .id = error_id(err.path),
-                };
-                listing.error_notifications.AddOrUpdateError(item);
+                });
             }
             for (auto& entry : new_listing.Roots())
                 listing.error_notifications.RemoveError(error_id(entry->Path()));
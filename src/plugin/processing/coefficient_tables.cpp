@@ -0,0 +1,151 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "coefficient_tables.hpp"
+
+#include "os/threading.hpp"
+#include "tests/framework.hpp"
+
+#include "filters.hpp"
+
+// A lock-free list that only ever grows. There are only a handful of sample rates in practice and each
+// table is small, so they are never freed.
+static Atomic<CoefficientTables*> g_coefficient_tables {};
+
+static void FillCoefficientTables(CoefficientTables& tables, f32 sample_rate) {
+    tables.sample_rate = sample_rate;
+    tables.next = nullptr;
+
+    auto const max_hz = (f64)sample_rate * 0.49;
+    for (auto const i : Range(tables.svf_g_coeffs.size)) {
+        auto const linear = (f32)i / (f32)CoefficientTables::k_svf_cutoff_table_size;
+        auto const hz = Min((f64)sv_filter::LinearToHz(linear), max_hz);
+        auto const omega = maths::k_pi<f64> * hz / (f64)sample_rate;
+        tables.svf_g_coeffs[i] = (f32)(Sin(omega) / Cos(omega));
+    }
+}
+
+static CoefficientTables const* FindTables(CoefficientTables const* first,
+                                           CoefficientTables const* end,
+                                           f32 sample_rate) {
+    for (auto t = first; t != end; t = t->next)
+        if (t->sample_rate == sample_rate) return t;
+    return nullptr;
+}
+
+CoefficientTables const& CoefficientTablesForSampleRate(f32 sample_rate) {
+    ASSERT(sample_rate > 0);
+
+    auto head = g_coefficient_tables.Load(MemoryOrder::Acquire);
+    if (auto t = FindTables(head, nullptr, sample_rate)) return *t;
+
+    auto new_tables = PageAllocator::Instance().NewUninitialised<CoefficientTables>();
+    FillCoefficientTables(*new_tables, sample_rate);
+
+    auto const searched_up_to = head;
+    while (true) {
+        new_tables->next = head;
+        if (g_coefficient_tables.CompareExchangeWeak(head,
+                                                     new_tables,
+                                                     MemoryOrder::AcquireRelease,
+                                                     MemoryOrder::Acquire))
+            return *new_tables;
+
+        // Another thread added tables while we were building ours, they might be for this sample rate.
+        if (auto t = FindTables(head, searched_up_to, sample_rate)) {
+            PageAllocator::Instance().Delete(new_tables);
+            return *t;
+        }
+    }
+}
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+TEST_CASE(TestCoefficientTables) {
+    SUBCASE("tables are shared per sample rate") {
+        auto const& a = CoefficientTablesForSampleRate(44100);
+        auto const& b = CoefficientTablesForSampleRate(48000);
+        CHECK(&a != &b);
+        CHECK(&CoefficientTablesForSampleRate(44100) == &a);
+        CHECK(&CoefficientTablesForSampleRate(48000) == &b);
+        CHECK_EQ(a.sample_rate, 44100.0f);
+        CHECK_EQ(b.sample_rate, 48000.0f);
+    }
+
+    SUBCASE("svf interpolation error is bounded") {
+        for (auto const sample_rate : Array {44100.0f, 48000.0f, 96000.0f, 192000.0f}) {
+            CAPTURE(sample_rate);
+            auto const& tables = CoefficientTablesForSampleRate(sample_rate);
+
+            f64 max_relative_error = 0;
+            constexpr u32 k_num_points = 100000;
+            for (auto const i : Range(k_num_points + 1)) {
+                auto const linear = (f32)i / (f32)k_num_points;
+                auto const hz = (f64)sv_filter::LinearToHz(linear);
+                auto const omega = maths::k_pi<f64> * hz / (f64)sample_rate;
+                auto const expected = Sin(omega) / Cos(omega);
+                auto const relative_error = Abs((f64)tables.SvfGCoeff(linear) - expected) / expected;
+                max_relative_error = Max(max_relative_error, relative_error);
+            }
+            tester.log.DebugLn("SVF g-coeff table at {} Hz: max relative error {}",
+                               sample_rate,
+                               max_relative_error);
+            CHECK_LT(max_relative_error, 0.001);
+        }
+    }
+
+    SUBCASE("per-voice coefficient cost benchmark") {
+        constexpr f32 k_sample_rate = 44100;
+        auto const& tables = CoefficientTablesForSampleRate(k_sample_rate);
+
+        // A filter with a moving cutoff recalculates its coefficients every frame, for every voice.
+        constexpr u32 k_num_voices = 32;
+        constexpr u32 k_num_frames = 44100;
+        auto seed = SeedFromTime();
+        auto const start_cutoff = RandomFloat01<f32>(seed);
+        auto cutoff_at = [&](u32 voice, u32 frame) {
+            auto const v = start_cutoff + ((f32)voice / k_num_voices) + ((f32)frame / k_num_frames);
+            return v - (f32)(u32)v;
+        };
+
+        sv_filter::CachedHelpers c {};
+        f64 sum = 0;
+
+        Stopwatch stopwatch;
+        for (auto const voice : Range(k_num_voices)) {
+            for (auto const frame : Range(k_num_frames)) {
+                c.Update(k_sample_rate, sv_filter::LinearToHz(cutoff_at(voice, frame)), 0.5f);
+                sum += (f64)c.g_coeff;
+            }
+        }
+        auto const direct_ms = stopwatch.MillisecondsElapsed();
+
+        stopwatch.Reset();
+        for (auto const voice : Range(k_num_voices)) {
+            for (auto const frame : Range(k_num_frames)) {
+                c.UpdateWithGCoeff(tables.SvfGCoeff(cutoff_at(voice, frame)), 0.5f);
+                sum += (f64)c.g_coeff;
+            }
+        }
+        auto const table_ms = stopwatch.MillisecondsElapsed();
+
+        CHECK(Abs(sum) < LargestRepresentableValue<f64>());
+        tester.log.DebugLn("SVF coefficients for {} voices x {} frames: direct {.2} ms, table {.2} ms",
+                           k_num_voices,
+                           k_num_frames,
+                           direct_ms,
+                           table_ms);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterCoefficientTablesTests) { REGISTER_TEST(TestCoefficientTables); }
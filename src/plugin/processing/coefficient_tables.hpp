@@ -0,0 +1,30 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+
+// Coefficients that only depend on the sample rate and a parameter value are the same for every voice and
+// every instance, so rather than each voice computing them from scratch we look them up in tables that are
+// built once per sample rate and then shared read-only for the lifetime of the process.
+struct CoefficientTables {
+    static constexpr u32 k_svf_cutoff_table_size = 1024;
+
+    // The state-variable filter's g coefficient, tan(pi * fc / fs), indexed by the cutoff in the linear space
+    // of sv_filter::LinearToHz.
+    f32 SvfGCoeff(f32 cutoff_linear) const {
+        ASSERT(cutoff_linear >= 0 && cutoff_linear <= 1);
+        auto const scaled = cutoff_linear * (f32)k_svf_cutoff_table_size;
+        auto const index = Min((u32)scaled, k_svf_cutoff_table_size - 1);
+        auto const x = scaled - (f32)index;
+        return svf_g_coeffs[index] + ((svf_g_coeffs[index + 1] - svf_g_coeffs[index]) * x);
+    }
+
+    f32 sample_rate;
+    Array<f32, k_svf_cutoff_table_size + 1> svf_g_coeffs;
+    CoefficientTables* next;
+};
+
+// Thread-safe, but it may allocate and compute a new table so it should not be called from the audio thread.
+// The result is valid for the lifetime of the process.
+CoefficientTables const& CoefficientTablesForSampleRate(f32 sample_rate);
@@ -89,6 +89,74 @@ inline StereoAudioFrame Process(StereoData& d, Coeffs const& c, StereoAudioFrame
 
 inline f32 Process(Filter& f, f32 in) { return Process(f.data, f.coeffs, in); }
 
+// A filter that passes everything unchanged, such as a peak or shelf with 0 dB gain.
+inline bool IsFlat(Coeffs const& c) { return c.b0 == 1 && c.b1 == c.a1 && c.b2 == c.a2; }
+
+// Two filters in series on a stereo signal, run together using SIMD. Each vector has the first filter's left
+// and right channels in lanes 0 and 1, and the second filter's in lanes 2 and 3. The second filter runs one
+// frame behind the first, so that its input (the first filter's output) is always ready. Uses transposed
+// direct form II, which needs just 2 state values per channel.
+struct StereoCascade {
+    struct Coeffs {
+        f32x4 b0, b1, b2, a1, a2;
+    };
+
+    static Coeffs CombineCoeffs(rbj_filter::Coeffs const& first, rbj_filter::Coeffs const& second) {
+        return {
+            .b0 = {first.b0, first.b0, second.b0, second.b0},
+            .b1 = {first.b1, first.b1, second.b1, second.b1},
+            .b2 = {first.b2, first.b2, second.b2, second.b2},
+            .a1 = {first.a1, first.a1, second.a1, second.a1},
+            .a2 = {first.a2, first.a2, second.a2, second.a2},
+        };
+    }
+
+    // Feeds in a new frame to the first filter, and the first filter's previous output to the second. Each
+    // filter's input is scaled by its lanes of gain. Returns the first filter's output for this frame in
+    // lanes 0 and 1, and the second filter's output for the previous frame in lanes 2 and 3.
+    f32x4 Step(Coeffs const& c, StereoAudioFrame in, f32x4 gain) {
+        auto const x = f32x4 {in.l, in.r, y[0], y[1]} * gain;
+        y = (c.b0 * x) + s1;
+        s1 = (c.b1 * x) - (c.a1 * y) + s2;
+        s2 = (c.b2 * x) - (c.a2 * y);
+        return y;
+    }
+
+    // A step that only advances the first filter, for the first frame of a block.
+    void StepFirstOnly(Coeffs const& c, StereoAudioFrame in, f32x4 gain) {
+        auto const prev = *this;
+        Step(c, in, gain);
+        for (auto const lane : Array {2, 3}) {
+            s1[lane] = prev.s1[lane];
+            s2[lane] = prev.s2[lane];
+        }
+    }
+
+    // A step that only advances the second filter, for the frame after the last in a block so that the second
+    // filter catches up. Returns its output in lanes 2 and 3.
+    f32x4 StepSecondOnly(Coeffs const& c, f32x4 gain) {
+        auto const prev = *this;
+        auto const out = Step(c, {}, gain);
+        for (auto const lane : Array {0, 1}) {
+            s1[lane] = prev.s1[lane];
+            s2[lane] = prev.s2[lane];
+            y[lane] = prev.y[lane];
+        }
+        return out;
+    }
+
+    // True if the state has decayed to nothing, so that clearing it wouldn't be heard.
+    bool StateIsNegligible() const {
+        constexpr f32 k_threshold = 1e-8f; // -160 dB
+        for (auto const lane : Range(4))
+            if (Abs(s1[lane]) > k_threshold || Abs(s2[lane]) > k_threshold) return false;
+        return true;
+    }
+
+    f32x4 s1 {}, s2 {};
+    f32x4 y {}; // the last output; the first filter's lanes are the second filter's next input
+};
+
 static Coeffs Coefficients(Params const& p) {
     auto const type = p.type;
     auto const sample_rate = (f64)p.fs;
@@ -433,8 +501,6 @@ inline f32 SkewResonance(f32 percent) {
 
 struct CachedHelpers {
     void Update(f32 sample_rate, f32 cutoff, f32 res, f32 shelf_gain = 2.0f) {
-        auto const q = ResonanceToQ(res);
-
         auto calculate_g_coeff = [](f32 sample_rate, f32 cutoff) {
             auto t = 1.0f / sample_rate;
             auto wa = (2.0f / t) * trig_table_lookup::TanTurns(cutoff * t / 2.0f);
@@ -442,7 +508,14 @@ struct CachedHelpers {
             return g;
         };
 
-        g_coeff = calculate_g_coeff(sample_rate, cutoff);
+        UpdateWithGCoeff(calculate_g_coeff(sample_rate, cutoff), res, shelf_gain);
+    }
+
+    // g is tan(pi * cutoff / sample_rate), typically from CoefficientTables::SvfGCoeff.
+    void UpdateWithGCoeff(f32 g, f32 res, f32 shelf_gain = 2.0f) {
+        auto const q = ResonanceToQ(res);
+
+        g_coeff = g;
         r_coeff = 1.0f / (2.0f * q);
         k_coeff = shelf_gain;
 
@@ -507,16 +580,6 @@ inline void Process(f32 in, f32& out, Data& d, Type type, CachedHelpers const& c
     }
 }
 
-PUBLIC inline void StereoProcess(f32* io, Data* d, Type type, CachedHelpers const& c) {
-    for (auto const i : Range(2))
-        Process(io[i], io[i], d[i], type, c);
-}
-
-inline void StereoProcess(f32 const* dry, f32* out, Data* d, Type type, CachedHelpers const& c) {
-    for (auto const i : Range(2))
-        Process(dry[i], out[i], d[i], type, c);
-}
-
 namespace detail {
 
 constexpr f32 k_projection_exponent = 2.8f;
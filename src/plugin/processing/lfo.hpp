@@ -5,6 +5,46 @@
 
 #include "foundation/foundation.hpp"
 
+namespace detail {
+
+constexpr u32 k_lfo_table_size = 257; // table[0] == table[256] to avoid edge case
+
+// The waveforms are the same for every LFO so they are built once at compile-time and shared.
+consteval auto CreateLfoTables() {
+    Array<Array<f32, k_lfo_table_size>, 5> result {}; // indexed by LFO::Waveform, None is silence
+
+    auto& sine = result[1];
+    for (u32 i = 0; i <= 256; i++)
+        sine[i] = trig_table_lookup::SinTurnsPositive((f32)i / 256.0f);
+
+    auto& triangle = result[2];
+    for (u32 i = 0; i < 64; i++) {
+        triangle[i] = (f32)i / 64.0f;
+        triangle[i + 64] = (64 - (f32)i) / 64.0f;
+        triangle[i + 128] = -(f32)i / 64.0f;
+        triangle[i + 192] = -(64 - (f32)i) / 64.0f;
+    }
+    triangle[256] = 0.0f;
+
+    auto& sawtooth = result[3];
+    for (u32 i = 0; i < 256; i++)
+        sawtooth[i] = 2.0f * ((f32)i / 255.0f) - 1.0f;
+    sawtooth[256] = -1.0f;
+
+    auto& square = result[4];
+    for (u32 i = 0; i < 128; i++) {
+        square[i] = 1.0f;
+        square[i + 128] = -1.0f;
+    }
+    square[256] = 1.0f;
+
+    return result;
+}
+
+constexpr auto k_lfo_tables = CreateLfoTables();
+
+} // namespace detail
+
 struct LFO {
     enum class Waveform { None, Sine, Triangle, Sawtooth, Square };
 
@@ -27,44 +67,12 @@ struct LFO {
     }
 
     void SetWaveform(Waveform w) {
-        switch (w) {
-            case Waveform::Sine: {
-                for (u32 i = 0; i <= 256; i++)
-                    table[i] = trig_table_lookup::SinTurnsPositive((f32)i / 256.0f);
-
-                break;
-            }
-            case Waveform::Triangle: {
-                for (u32 i = 0; i < 64; i++) {
-                    table[i] = (f32)i / 64.0f;
-                    table[i + 64] = (64 - (f32)i) / 64.0f;
-                    table[i + 128] = -(f32)i / 64.0f;
-                    table[i + 192] = -(64 - (f32)i) / 64.0f;
-                }
-                table[256] = 0.0f;
-                break;
-            }
-            case Waveform::Sawtooth: {
-                for (u32 i = 0; i < 256; i++)
-                    table[i] = 2.0f * ((f32)i / 255.0f) - 1.0f;
-                table[256] = -1.0f;
-                break;
-            }
-            case Waveform::Square: {
-                for (u32 i = 0; i < 128; i++) {
-                    table[i] = 1.0f;
-                    table[i + 128] = -1.0f;
-                }
-                table[256] = 1.0f;
-                break;
-            }
-            case Waveform::None: break;
-        }
+        table = detail::k_lfo_tables[ToInt(w)].data;
         waveform = w;
     }
 
     Waveform waveform {Waveform::None};
     u32 phase = 0;
     u32 phase_increment_per_tick = 0;
-    f32 table[257] = {}; // table[0] == table[256] to avoid edge case
+    f32 const* table = detail::k_lfo_tables[ToInt(Waveform::None)].data;
 };
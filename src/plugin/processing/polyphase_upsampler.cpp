@@ -0,0 +1,243 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "polyphase_upsampler.hpp"
+
+#include "tests/framework.hpp"
+
+// About 80 dB of stopband attenuation.
+constexpr f64 k_kaiser_beta = 8.0;
+
+// Zeroth-order modified Bessel function of the first kind, for the Kaiser window.
+static f64 BesselI0(f64 x) {
+    f64 result = 1;
+    f64 term = 1;
+    for (u32 k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        result += term;
+        if (term < result * 1e-17) break;
+    }
+    return result;
+}
+
+void PolyphaseUpsampler::Init(u32 f) {
+    ASSERT(f >= 1 && f <= k_max_factor);
+    factor = f;
+    phase_coeffs = {};
+
+    if (factor != 1) {
+        // The prototype filter has factor * k_taps_per_phase taps centred on tap `centre`. The tap that would
+        // mirror tap 0 falls on a zero of the sinc, so the filter is symmetric and the delay is exactly
+        // `centre` output frames.
+        auto const num_taps = factor * k_taps_per_phase;
+        auto const centre = (f64)(num_taps / 2);
+        auto const window_norm = BesselI0(k_kaiser_beta);
+        for (auto const tap : Range(num_taps)) {
+            auto const x = ((f64)tap - centre) / (f64)factor;
+            auto const sinc = x == 0 ? 1.0 : Sin(maths::k_pi<f64> * x) / (maths::k_pi<f64> * x);
+            auto const r = ((f64)tap - centre) / centre;
+            auto const window = BesselI0(k_kaiser_beta * Sqrt(Max(0.0, 1.0 - (r * r)))) / window_norm;
+            phase_coeffs[tap % factor][tap / factor] = (f32)(sinc * window);
+        }
+
+        // Each phase is its own interpolation filter; give each exactly unity gain at DC.
+        for (auto const phase : Range(factor)) {
+            f64 sum = 0;
+            for (auto const c : phase_coeffs[phase])
+                sum += (f64)c;
+            for (auto& c : phase_coeffs[phase])
+                c = (f32)((f64)c / sum);
+        }
+    }
+
+    Reset();
+}
+
+void PolyphaseUpsampler::Reset() {
+    history = {};
+    history_pos = 0;
+}
+
+void PolyphaseUpsampler::Process(Span<StereoAudioFrame const> in, Span<StereoAudioFrame> out) {
+    ASSERT_HOT(out.size == in.size * factor);
+    if (factor == 1) {
+        CopyMemory(out.data, in.data, in.ToByteSpan().size);
+        return;
+    }
+
+    for (auto const [frame_index, frame] : Enumerate<u32>(in)) {
+        history_pos = (history_pos == 0 ? k_taps_per_phase : history_pos) - 1;
+        history[history_pos] = frame;
+        history[history_pos + k_taps_per_phase] = frame;
+        auto const recent = history.data + history_pos;
+
+        auto output = out.data + (frame_index * factor);
+        for (auto const phase : Range(factor)) {
+            auto const& coeffs = phase_coeffs[phase];
+            f32 l = 0;
+            f32 r = 0;
+            for (auto const tap : Range(k_taps_per_phase)) {
+                l += coeffs[tap] * recent[tap].l;
+                r += coeffs[tap] * recent[tap].r;
+            }
+            output[phase] = {l, r};
+        }
+    }
+}
+
+//=================================================
+//  _______        _
+// |__   __|      | |
+//    | | ___  ___| |_ ___
+//    | |/ _ \/ __| __/ __|
+//    | |  __/\__ \ |_\__ \
+//    |_|\___||___/\__|___/
+//
+//=================================================
+
+// The amplitude of one frequency in the left channel, using a Hann window so that a strong tone doesn't leak
+// into the measurement of a weak one nearby. frequency is in cycles per frame.
+static f64 ToneAmplitude(Span<StereoAudioFrame const> frames, f64 frequency) {
+    f64 re = 0;
+    f64 im = 0;
+    f64 window_sum = 0;
+    for (auto const [i, frame] : Enumerate(frames)) {
+        auto const window = 0.5 - (0.5 * Cos(maths::k_tau<f64> * (f64)i / (f64)(frames.size - 1)));
+        auto const phase = maths::k_tau<f64> * frequency * (f64)i;
+        re += window * (f64)frame.l * Cos(phase);
+        im += window * (f64)frame.l * Sin(phase);
+        window_sum += window;
+    }
+    return 2 * Sqrt((re * re) + (im * im)) / window_sum;
+}
+
+TEST_CASE(TestPolyphaseUpsampler) {
+    constexpr u32 k_num_in_frames = 8192;
+
+    auto upsample_sine = [&](PolyphaseUpsampler& upsampler, f64 frequency) {
+        auto in = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_in_frames);
+        for (auto [i, frame] : Enumerate(in)) {
+            auto const s = (f32)Sin(maths::k_tau<f64> * frequency * (f64)i);
+            frame = {s, s};
+        }
+        auto out = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_in_frames *
+                                                                                          upsampler.factor);
+        upsampler.Reset();
+        upsampler.Process(in, out);
+        // Skip the start, where the filter is still filling.
+        return out.SubSpan(upsampler.LatencyFrames() * 2);
+    };
+
+    constexpr auto k_factors = Array {2u, 3u, 4u};
+
+    SUBCASE("impulse response peaks at the reported latency") {
+        for (auto const factor : k_factors) {
+            CAPTURE(factor);
+            PolyphaseUpsampler upsampler;
+            upsampler.Init(factor);
+
+            auto in = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(64);
+            for (auto& f : in)
+                f = {};
+            in[0] = {1, 1};
+            auto out = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(64 * factor);
+            upsampler.Reset();
+            upsampler.Process(in, out);
+
+            u32 peak_index = 0;
+            for (auto const [i, frame] : Enumerate<u32>(out))
+                if (Abs(frame.l) > Abs(out[peak_index].l)) peak_index = i;
+            CHECK_EQ(peak_index, upsampler.LatencyFrames());
+            CHECK(ApproxEqual(out[peak_index].l, 1.0f, 0.0001f));
+        }
+    }
+
+    SUBCASE("dc passes at unity gain") {
+        for (auto const factor : k_factors) {
+            CAPTURE(factor);
+            PolyphaseUpsampler upsampler;
+            upsampler.Init(factor);
+
+            auto in = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(256);
+            for (auto& f : in)
+                f = {1, -1};
+            auto dc_out = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(256 * factor);
+            upsampler.Reset();
+            upsampler.Process(in, dc_out);
+            for (auto const& frame : dc_out.SubSpan(upsampler.LatencyFrames() * 2)) {
+                REQUIRE(ApproxEqual(frame.l, 1.0f, 0.0001f));
+                REQUIRE(ApproxEqual(frame.r, -1.0f, 0.0001f));
+            }
+        }
+    }
+
+    SUBCASE("passband is flat and images are rejected") {
+        for (auto const factor : k_factors) {
+            CAPTURE(factor);
+            PolyphaseUpsampler upsampler;
+            upsampler.Init(factor);
+
+            f64 worst_passband_db = 0;
+            f64 worst_image_db = -1000;
+            for (f64 frequency = 0.01; frequency <= 0.4; frequency += 0.0137) {
+                CAPTURE(frequency);
+                auto const out = upsample_sine(upsampler, frequency);
+
+                auto const gain_db = 20 * Log10(ToneAmplitude(out, frequency / factor));
+                worst_passband_db = Max(worst_passband_db, Fabs(gain_db));
+                CHECK_LT(Fabs(gain_db), 0.05);
+
+                // Upsampling creates copies of the spectrum either side of each multiple of the input rate.
+                for (auto const multiple : Range(1u, factor)) {
+                    for (auto const image : Array {(f64)multiple - frequency, (f64)multiple + frequency}) {
+                        if (image >= (f64)factor / 2) continue;
+                        auto const image_db = 20 * Log10(Max(ToneAmplitude(out, image / factor), 1e-12));
+                        worst_image_db = Max(worst_image_db, image_db);
+                        CHECK_LT(image_db, -75.0);
+                    }
+                }
+            }
+            tester.log.DebugLn("Upsampling x{}: passband within {.4} dB, worst image {.1} dB",
+                               factor,
+                               worst_passband_db,
+                               worst_image_db);
+        }
+    }
+
+    SUBCASE("output doesn't depend on how the input is split into blocks") {
+        for (auto const factor : k_factors) {
+            CAPTURE(factor);
+            PolyphaseUpsampler upsampler;
+            upsampler.Init(factor);
+
+            constexpr u32 k_num_frames = 1000;
+            auto in = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames);
+            auto seed = SeedFromTime();
+            for (auto& f : in)
+                f = {RandomFloat01<f32>(seed) - 0.5f, RandomFloat01<f32>(seed) - 0.5f};
+
+            auto whole = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames *
+                                                                                              factor);
+            upsampler.Reset();
+            upsampler.Process(in, whole);
+
+            auto blocks = tester.scratch_arena.AllocateExactSizeUninitialised<StereoAudioFrame>(k_num_frames *
+                                                                                               factor);
+            upsampler.Reset();
+            for (u32 pos = 0; pos < k_num_frames;) {
+                auto const size = Min(RandomIntInRange<u32>(seed, 1, 77), k_num_frames - pos);
+                upsampler.Process(in.SubSpan(pos, size), blocks.SubSpan(pos * factor, size * factor));
+                pos += size;
+            }
+
+            for (auto const i : Range(whole.size)) {
+                REQUIRE_EQ(whole[i].l, blocks[i].l);
+                REQUIRE_EQ(whole[i].r, blocks[i].r);
+            }
+        }
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(RegisterPolyphaseUpsamplerTests) { REGISTER_TEST(TestPolyphaseUpsampler); }
@@ -0,0 +1,37 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+
+#include "stereo_audio_frame.hpp"
+
+// Raises the sample rate by a whole-number factor. The images that upsampling creates are removed with a
+// Kaiser-windowed sinc lowpass, split into one short filter per output phase so that no work is spent on the
+// zeros that would otherwise be stuffed between input frames.
+//
+// The passband is flat up to about 0.42 of the input rate, and images of anything in the passband are at
+// least 80 dB down. The filter is linear-phase: the output is delayed by exactly LatencyFrames().
+struct PolyphaseUpsampler {
+    static constexpr u32 k_max_factor = 4;
+    static constexpr u32 k_taps_per_phase = 32;
+
+    // Designs the filter, so not realtime-safe. Also resets.
+    void Init(u32 factor);
+
+    void Reset();
+
+    // out.size must be factor * in.size.
+    void Process(Span<StereoAudioFrame const> in, Span<StereoAudioFrame> out);
+
+    // At the output rate.
+    u32 LatencyFrames() const { return factor == 1 ? 0 : factor * k_taps_per_phase / 2; }
+
+    u32 factor {1};
+    Array<Array<f32, k_taps_per_phase>, k_max_factor> phase_coeffs {};
+
+    // Each frame is written twice so that the most recent k_taps_per_phase frames are always contiguous,
+    // newest first, starting at history_pos.
+    Array<StereoAudioFrame, k_taps_per_phase * 2> history {};
+    u32 history_pos {};
+};
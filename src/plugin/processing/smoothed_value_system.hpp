@@ -55,6 +55,9 @@ class SmoothedValueSystem {
         return m_float_smoothers.IsSmoothing(smoother, frame_index);
     }
 
+    // If not, Value() is the same for every frame of this block.
+    bool IsSmoothing(FilterId smoother) const { return m_processed_filter_this_frame[u16(smoother)]; }
+
     rbj_filter::SmoothedCoefficients::State Value(FilterId smoother, u32 frame_index) const {
         ASSERT(frame_index < m_num_valid_frames);
 
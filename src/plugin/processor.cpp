@@ -3,10 +3,17 @@
 
 #include "processor.hpp"
 
+#include "tests/framework.hpp"
+#include "utils/arena_usage.hpp"
+
+#include "build_resources/embedded_files.h"
 #include "clap/ext/params.h"
 #include "param.hpp"
+#include "param_dependencies.hpp"
 #include "param_info.hpp"
 #include "plugin.hpp"
+#include "processor_test_helpers.hpp"
+#include "sample_library/audio_file.hpp"
 #include "voices.hpp"
 
 bool EffectIsOn(Parameters const& params, Effect* effect) {
@@ -69,51 +76,74 @@ static void HandleMuteSolo(AudioProcessor& processor) {
 }
 
 static void ProcessorOnParamChange(AudioProcessor& processor, ChangedParams changed_params) {
-    if (auto p = changed_params.Param(ParamIndex::MasterVolume)) {
-        processor.smoothed_value_system.SetVariableLength(processor.master_vol_smoother_id,
-                                                          p->ProjectedValue(),
-                                                          2,
-                                                          25,
-                                                          1);
-    }
-
-    if (auto p = changed_params.Param(ParamIndex::MasterDynamics)) {
-        processor.dynamics_value_01 = p->ProjectedValue();
-        for (auto& v : processor.voice_pool.EnumerateActiveVoices())
-            UpdateXfade(v, processor.dynamics_value_01, true);
-    }
-
-    if (auto p = changed_params.Param(ParamIndex::MasterVelocity))
-        processor.velocity_to_volume_01 = p->ProjectedValue();
-
-    {
-        bool mute_or_solo_changed = false;
-        for (auto const layer_index : Range(k_num_layers)) {
-            if (auto p = changed_params.Param(
-                    ParamIndexFromLayerParamIndex((u32)layer_index, LayerParamIndex::Mute))) {
-                processor.mute.SetToValue(layer_index, p->ValueAsBool());
+    // Work out which handlers need to know about the changes so that we only call into those.
+    bool master_changed = false;
+    bool mute_or_solo_changed = false;
+    Bitset<k_num_layers> layers_changed {};
+    Array<LayerParamGroups, k_num_layers> layer_groups_changed {};
+    Bitset<k_num_effect_types> effects_changed {};
+    changed_params.ForEachChanged([&](ParamIndex index) {
+        auto const& consumer = ParamConsumerFor(index);
+        switch (consumer.type) {
+            case ParamConsumerType::Master: master_changed = true; break;
+            case ParamConsumerType::MuteSolo: {
+                auto const layer_param = LayerParamInfoFromGlobalIndex(index)->param;
+                auto const value = processor.params[ToInt(index)].ValueAsBool();
+                if (layer_param == LayerParamIndex::Mute)
+                    processor.mute.SetToValue(consumer.index, value);
+                else
+                    processor.solo.SetToValue(consumer.index, value);
                 mute_or_solo_changed = true;
                 break;
             }
-            if (auto p = changed_params.Param(
-                    ParamIndexFromLayerParamIndex((u32)layer_index, LayerParamIndex::Solo))) {
-                processor.solo.SetToValue(layer_index, p->ValueAsBool());
-                mute_or_solo_changed = true;
+            case ParamConsumerType::Layer:
+                layers_changed.Set(consumer.index);
+                layer_groups_changed[consumer.index].Set(ToInt(consumer.layer_group));
                 break;
-            }
+            case ParamConsumerType::Effect: effects_changed.Set(consumer.index); break;
         }
-        if (mute_or_solo_changed) HandleMuteSolo(processor);
+    });
+
+    if (master_changed) {
+        if (auto p = changed_params.Param(ParamIndex::MasterVolume)) {
+            processor.smoothed_value_system.SetVariableLength(processor.master_vol_smoother_id,
+                                                              p->ProjectedValue(),
+                                                              2,
+                                                              25,
+                                                              1);
+        }
+
+        if (auto p = changed_params.Param(ParamIndex::MasterDynamics)) {
+            processor.dynamics_value_01 = p->ProjectedValue();
+            for (auto& v : processor.voice_pool.EnumerateActiveVoices())
+                UpdateXfade(v, processor.dynamics_value_01, true);
+        }
+
+        if (auto p = changed_params.Param(ParamIndex::MasterVelocity))
+            processor.velocity_to_volume_01 = p->ProjectedValue();
     }
 
-    for (auto [index, l] : Enumerate(processor.layer_processors)) {
-        OnParamChange(l,
-                      processor.audio_processing_context,
-                      processor.voice_pool,
-                      changed_params.Subsection<k_num_layer_parameters>(0 + index * k_num_layer_parameters));
+    if (mute_or_solo_changed) HandleMuteSolo(processor);
+
+    if (layers_changed.AnyValuesSet()) {
+        for (auto [index, l] : Enumerate(processor.layer_processors)) {
+            if (!layers_changed.Get(index)) continue;
+            OnParamChange(
+                l,
+                processor.audio_processing_context,
+                processor.voice_pool,
+                changed_params.Subsection<k_num_layer_parameters>(0 + index * k_num_layer_parameters),
+                layer_groups_changed[index]);
+        }
     }
 
-    for (auto fx : processor.effects_ordered_by_type)
-        fx->OnParamChange(changed_params, processor.audio_processing_context);
+    if (effects_changed.AnyValuesSet()) {
+        for (auto const effect_index : Range(k_num_effect_types))
+            if (effects_changed.Get(effect_index))
+                processor.effects_ordered_by_type[effect_index]->OnParamChange(
+                    changed_params,
+                    processor.audio_processing_context);
+    }
 }
 
 void ParameterJustStartedMoving(AudioProcessor& processor, ParamIndex index) {
@@ -150,6 +180,33 @@ bool SetParameterValue(AudioProcessor& processor, ParamIndex index, f32 value, P
     return changed;
 }
 
+Bitset<k_num_parameters> SetAllParameterValues(AudioProcessor& processor,
+                                               Array<f32, k_num_parameters> const& linear_values) {
+    DebugAssertMainThread(processor.host);
+    Bitset<k_num_parameters> changed {};
+    for (auto const i : Range(k_num_parameters)) {
+        if (processor.params[i].SetLinearValue(linear_values[i])) {
+            changed.Set(i);
+            processor.state_params_changed.Set(i);
+        }
+    }
+
+    if (changed.AnyValuesSet()) {
+        processor.events_for_audio_thread.Push(EventForAudioThreadType::StateParamsChanged);
+        processor.host.request_process(&processor.host);
+    }
+    return changed;
+}
+
+void NotifyHostOfParamChanges(AudioProcessor& processor, Bitset<k_num_parameters> changed) {
+    DebugAssertMainThread(processor.host);
+    if (!changed.AnyValuesSet()) return;
+    processor.params_to_notify_host.OrBlockwise(changed);
+    auto host_params =
+        (clap_host_params const*)processor.host.get_extension(&processor.host, CLAP_EXT_PARAMS);
+    if (host_params) host_params->request_flush(&processor.host);
+}
+
 void MoveEffectToNewSlot(EffectsArray& effects, Effect* effect_to_move, usize slot) {
     if (slot < 0 || slot >= k_num_effect_types) return;
 
@@ -283,26 +340,55 @@ ResetProcessor(AudioProcessor& processor, Bitset<k_num_parameters> processing_ch
         ChangeInstrumentIfNeededAndReset(l, processor.voice_pool);
 }
 
+// The smallest whole-number divisor that brings the host's rate down to the maximum, without taking the
+// engine below a normal sample rate.
+static u32 InternalRateFactor(f64 host_sample_rate, u32 max_internal_sample_rate) {
+    constexpr f64 k_min_internal_sample_rate = 44100;
+    u32 factor = 1;
+    if (!max_internal_sample_rate) return factor;
+    while (factor < PolyphaseUpsampler::k_max_factor &&
+           host_sample_rate / factor > max_internal_sample_rate &&
+           host_sample_rate / (factor + 1) >= k_min_internal_sample_rate)
+        ++factor;
+    return factor;
+}
+
 static bool Activate(AudioProcessor& processor, PluginActivateArgs args) {
     if (args.sample_rate <= 0 || args.max_block_size == 0) {
         PanicIfReached();
         return false;
     }
 
+    auto& internal_rate = processor.internal_rate;
+    internal_rate.factor = InternalRateFactor(args.sample_rate, processor.max_internal_sample_rate.Load());
+    internal_rate.upsampler.Init(internal_rate.factor);
+    internal_rate.pending_start = 0;
+    internal_rate.num_pending = 0;
+    internal_rate.engine_block_offset = 0;
+
     processor.host_thread_pool = HostThreadPool::Create(processor.host);
-    processor.audio_processing_context.process_block_size_max = args.max_block_size;
-    processor.audio_processing_context.sample_rate = (f32)args.sample_rate;
+    processor.audio_processing_context.process_block_size_max =
+        (args.max_block_size + internal_rate.factor - 1) / internal_rate.factor;
+    processor.audio_processing_context.sample_rate = (f32)(args.sample_rate / internal_rate.factor);
+    processor.audio_processing_context.coefficient_tables =
+        &CoefficientTablesForSampleRate(processor.audio_processing_context.sample_rate);
 
     for (auto& fx : processor.effects_ordered_by_type)
         fx->PrepareToPlay(processor.audio_processing_context);
 
+    bool reallocated = false;
     if (Exchange(processor.previous_block_size, processor.audio_processing_context.process_block_size_max) <
         processor.audio_processing_context.process_block_size_max) {
+        reallocated = true;
 
         // We reserve up-front a large allocation so that it's less likely we have to do multiple
-        // calls to the OS. Roughly 1.2MB for a block size of 512.
-        auto const alloc_size = (usize)processor.audio_processing_context.process_block_size_max * 2544;
+        // calls to the OS. Roughly 1.2MB for a block size of 512. If a previous activation needed more than
+        // this then we use that instead.
+        auto const alloc_size = RecommendedArenaSize(
+            "audio-data"_s,
+            (usize)processor.audio_processing_context.process_block_size_max * 2544);
         processor.audio_data_allocator = ArenaAllocator(PageAllocator::Instance(), alloc_size);
+        ScopedArenaUsageRecorder const usage_recorder {"audio-data"_s, processor.audio_data_allocator};
 
         processor.voice_pool.PrepareToPlay(processor.audio_data_allocator,
                                            processor.audio_processing_context);
@@ -319,6 +405,16 @@ static bool Activate(AudioProcessor& processor, PluginActivateArgs args) {
             processor.audio_data_allocator);
     }
 
+    if (internal_rate.factor != 1) {
+        auto const upsampled_size =
+            processor.audio_processing_context.process_block_size_max * internal_rate.factor;
+        if (reallocated || internal_rate.upsampled.size < upsampled_size) {
+            internal_rate.upsampled =
+                processor.audio_data_allocator.AllocateExactSizeUninitialised<StereoAudioFrame>(
+                    upsampled_size);
+        }
+    }
+
     Bitset<k_num_parameters> changed_params;
     changed_params.SetAll();
     ResetProcessor(processor, changed_params, 0);
@@ -327,6 +423,14 @@ static bool Activate(AudioProcessor& processor, PluginActivateArgs args) {
     return true;
 }
 
+// Event times are host frames from the start of the host's block. The engine's block can start part-way into
+// that, after frames that were already rendered in the previous block, and it can run at a lower rate.
+static u32 EngineFrameForEventTime(AudioProcessor const& processor, u32 time) {
+    auto const& internal_rate = processor.internal_rate;
+    if (time <= internal_rate.engine_block_offset) return 0;
+    return (time - internal_rate.engine_block_offset) / internal_rate.factor;
+}
+
 static void ProcessClapNoteOrMidi(AudioProcessor& processor,
                                   clap_event_header const& event,
                                   clap_output_events const& out,
@@ -344,7 +448,10 @@ static void ProcessClapNoteOrMidi(AudioProcessor& processor,
             MidiChannelNote const chan_note {.note = (u7)note.key, .channel = (u4)note.channel};
 
             processor.audio_processing_context.midi_note_state.NoteOn(chan_note, (f32)note.velocity);
-            HandleNoteOn(processor, chan_note, (f32)note.velocity, note.header.time);
+            HandleNoteOn(processor,
+                         chan_note,
+                         (f32)note.velocity,
+                         EngineFrameForEventTime(processor, note.header.time));
             break;
         }
         case CLAP_EVENT_NOTE_OFF: {
@@ -421,7 +528,10 @@ static void ProcessClapNoteOrMidi(AudioProcessor& processor,
                 case MidiMessageType::NoteOn: {
                     processor.audio_processing_context.midi_note_state.NoteOn(message.ChannelNote(),
                                                                               message.Velocity() / 127.0f);
-                    HandleNoteOn(processor, message.ChannelNote(), message.Velocity() / 127.0f, event.time);
+                    HandleNoteOn(processor,
+                                 message.ChannelNote(),
+                                 message.Velocity() / 127.0f,
+                                 EngineFrameForEventTime(processor, event.time));
                     break;
                 }
                 case MidiMessageType::NoteOff: {
@@ -603,6 +713,7 @@ static void ConsumeParamEventsFromGui(AudioProcessor& processor,
             }
             case EventForAudioThreadType::FxOrderChanged:
             case EventForAudioThreadType::ReloadAllAudioState:
+            case EventForAudioThreadType::StateParamsChanged:
             case EventForAudioThreadType::ConvolutionIRChanged:
             case EventForAudioThreadType::LayerInstrumentChanged:
             case EventForAudioThreadType::StartNote:
@@ -610,6 +721,21 @@ static void ConsumeParamEventsFromGui(AudioProcessor& processor,
             case EventForAudioThreadType::RemoveMidiLearn: PanicIfReached();
         }
     }
+
+    processor.params_to_notify_host.ExchangeClearAllBlockwise().ForEachSetBit([&](usize index) {
+        clap_event_param_value event {};
+        event.header.type = CLAP_EVENT_PARAM_VALUE;
+        event.header.size = sizeof(event);
+        event.header.flags = CLAP_EVENT_IS_LIVE | CLAP_EVENT_DONT_RECORD;
+        event.note_id = -1;
+        event.port_index = -1;
+        event.channel = -1;
+        event.key = -1;
+        event.value = (f64)processor.params[index].LinearValue();
+        event.param_id = ParamIndexToId(ParamIndex {(u16)index});
+        // The host's list can be full; try again next time rather than leave the host out of date.
+        if (!out.try_push(&out, (clap_event_header const*)&event)) processor.params_to_notify_host.Set(index);
+    });
 }
 
 static void
@@ -627,15 +753,13 @@ FlushParameterEvents(AudioProcessor& processor, clap_input_events const& in, cla
     }
 }
 
-clap_process_status Process(AudioProcessor& processor, clap_process const& process) {
+// Renders num_sample_frames at the engine's sample rate, handling all of the block's events.
+static clap_process_status ProcessEngine(AudioProcessor& processor,
+                                         clap_process const& process,
+                                         u32 num_sample_frames,
+                                         Span<f32>& interleaved_outputs) {
     ZoneScoped;
-    ASSERT(process.audio_outputs_count == 1);
-
-    if (process.audio_outputs->channel_count != 2) return CLAP_PROCESS_ERROR;
-
     clap_process_status result = CLAP_PROCESS_CONTINUE;
-    auto const num_sample_frames = process.frames_count;
-    auto outputs = process.audio_outputs->data32;
     processor.audio_processing_context.engine_version = processor.engine_version.Load();
 
     // Handle transport changes
@@ -705,6 +829,11 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                     l = true;
                 break;
             }
+            case EventForAudioThreadType::StateParamsChanged: {
+                // No fade needed: these are smoothed like any other param change, and voices keep playing.
+                params_changed |= processor.state_params_changed.ExchangeClearAllBlockwise();
+                break;
+            }
             case EventForAudioThreadType::ConvolutionIRChanged: {
                 mark_convolution_for_fade_out = true;
                 break;
@@ -844,7 +973,7 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
                       processor.audio_processing_context,
                       processor.host_thread_pool ? &processor.host_thread_pool.Value() : nullptr);
 
-    Span<f32> interleaved_outputs {};
+    interleaved_outputs = {};
     bool audio_was_generated_by_voices = false;
     for (auto const i : Range(k_num_layers)) {
         auto const process_result = ProcessLayer(processor.layer_processors[i],
@@ -949,11 +1078,6 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
         result = CLAP_PROCESS_SLEEP;
     }
 
-    //
-    // ======================================================================================================
-    if (outputs)
-        CopyInterleavedToSeparateChannels(outputs[0], outputs[1], interleaved_outputs, num_sample_frames);
-
     // Mark gui dirty
     {
         bool mark_gui_dirty = false;
@@ -969,6 +1093,61 @@ clap_process_status Process(AudioProcessor& processor, clap_process const& proce
     return result;
 }
 
+clap_process_status Process(AudioProcessor& processor, clap_process const& process) {
+    ZoneScoped;
+    ASSERT(process.audio_outputs_count == 1);
+
+    if (process.audio_outputs->channel_count != 2) return CLAP_PROCESS_ERROR;
+
+    auto const num_host_frames = process.frames_count;
+    auto outputs = process.audio_outputs->data32;
+    auto& internal_rate = processor.internal_rate;
+
+    if (internal_rate.factor == 1) {
+        Span<f32> interleaved_outputs {};
+        auto const result = ProcessEngine(processor, process, num_host_frames, interleaved_outputs);
+        if (outputs)
+            CopyInterleavedToSeparateChannels(outputs[0], outputs[1], interleaved_outputs, num_host_frames);
+        return result;
+    }
+
+    auto write_upsampled = [&](u32 host_frame, u32 upsampled_start, u32 num_frames) {
+        if (!outputs) return;
+        CopyInterleavedToSeparateChannels(
+            outputs[0] + host_frame,
+            outputs[1] + host_frame,
+            Span<f32> {(f32*)(internal_rate.upsampled.data + upsampled_start), (usize)num_frames * 2},
+            num_frames);
+    };
+
+    // First, what's left over from the previous block.
+    auto const num_from_previous = Min(internal_rate.num_pending, num_host_frames);
+    write_upsampled(0, internal_rate.pending_start, num_from_previous);
+    internal_rate.pending_start += num_from_previous;
+    internal_rate.num_pending -= num_from_previous;
+    internal_rate.engine_block_offset = num_from_previous;
+
+    // Then render enough engine frames to cover the rest. The engine is called even if that's none, so that
+    // the block's events are still handled.
+    auto const num_remaining = num_host_frames - num_from_previous;
+    auto const num_engine_frames = (num_remaining + internal_rate.factor - 1) / internal_rate.factor;
+    Span<f32> interleaved_outputs {};
+    auto const result = ProcessEngine(processor, process, num_engine_frames, interleaved_outputs);
+
+    if (num_engine_frames) {
+        auto const num_upsampled = num_engine_frames * internal_rate.factor;
+        internal_rate.upsampler.Process(ToStereoFramesSpan(interleaved_outputs.data, num_engine_frames),
+                                        internal_rate.upsampled.SubSpan(0, num_upsampled));
+        write_upsampled(num_from_previous, 0, num_remaining);
+        internal_rate.pending_start = num_remaining;
+        internal_rate.num_pending = num_upsampled - num_remaining;
+    }
+
+    return result;
+}
+
+static u32 Latency(AudioProcessor& processor) { return processor.internal_rate.upsampler.LatencyFrames(); }
+
 static void Reset(AudioProcessor&) {
     // TODO(1.0):
     // - Clears all buffers, performs a full reset of the processing state (filters, oscillators,
@@ -1032,7 +1211,576 @@ AudioProcessor::AudioProcessor(clap_host const& host)
         .deactivate = Deactivate,
         .reset = Reset,
         .process = Process,
+        .latency = Latency,
         .flush_parameter_events = FlushParameterEvents,
         .on_main_thread = OnMainThread,
     };
 }
+
+TEST_CASE(TestProcessorParamDependencies) {
+    SUBCASE("every param is routed to the handler that reads it") {
+        for (auto const& info : k_param_infos) {
+            auto const& consumer = ParamConsumerFor(info.index);
+            if (auto const layer_info = LayerParamInfoFromGlobalIndex(info.index)) {
+                CHECK_EQ(consumer.index, layer_info->layer_num);
+                CHECK(consumer.type == ParamConsumerType::Layer ||
+                      consumer.type == ParamConsumerType::MuteSolo);
+            } else if (info.IsEffectParam()) {
+                CHECK(consumer.type == ParamConsumerType::Effect);
+            } else {
+                CHECK(consumer.type == ParamConsumerType::Master);
+            }
+        }
+
+        CHECK(ParamConsumerFor(ParamIndex::ReverbSize).index == ToInt(EffectType::Reverb));
+        CHECK(ParamConsumerFor(ParamIndex::DelayOn).index == ToInt(EffectType::Delay));
+        CHECK(ParamConsumerFor(ParamIndexFromLayerParamIndex(2, LayerParamIndex::LfoRateHz)).layer_group ==
+              LayerParamGroup::Lfo);
+        CHECK(ParamConsumerFor(ParamIndexFromLayerParamIndex(1, LayerParamIndex::EqGain2)).layer_group ==
+              LayerParamGroup::Eq);
+    }
+
+    SUBCASE("dense automation benchmark") {
+        auto& processor = *tester.scratch_arena.New<AudioProcessor>(k_headless_host);
+        DEFER { processor.~AudioProcessor(); };
+        REQUIRE(processor.processor_callbacks.activate(processor,
+                                                       {
+                                                           .sample_rate = 44100,
+                                                           .min_block_size = 64,
+                                                           .max_block_size = 64,
+                                                       }));
+        DEFER { processor.processor_callbacks.deactivate(processor); };
+
+        constexpr u32 k_num_blocks = 20000;
+        constexpr u32 k_params_per_block = 8;
+        auto seed = SeedFromTime();
+
+        auto run = [&](String name, bool every_param) {
+            f64 seconds_in_dispatch = 0;
+            for (auto _ : Range(k_num_blocks)) {
+                Bitset<k_num_parameters> changed {};
+                if (every_param) {
+                    changed.SetAll();
+                } else {
+                    for (auto const param_num : Range(k_params_per_block)) {
+                        (void)param_num;
+                        auto const index = RandomIntInRange<u32>(seed, 0, k_num_parameters - 1);
+                        auto const& range = k_param_infos[index].linear_range;
+                        processor.params[index].SetLinearValue(range.min +
+                                                               (RandomFloat01<f32>(seed) * range.Delta()));
+                        changed.Set(index);
+                    }
+                }
+
+                Stopwatch const stopwatch;
+                ProcessorOnParamChange(processor, {processor.params.data, changed});
+                seconds_in_dispatch += stopwatch.SecondsElapsed();
+                processor.smoothed_value_system.ProcessBlock(64);
+            }
+            tester.log.DebugLn("Param change dispatch ({}): {.3} us per block",
+                               name,
+                               SecondsToMicroseconds(seconds_in_dispatch) / k_num_blocks);
+        };
+
+        run("8 random params per block"_s, false);
+        run("every param"_s, true);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestEffectResetBlockTime) {
+    constexpr f32 k_sample_rate = 192000;
+    constexpr u32 k_block_size = 64;
+
+    auto& processor = *tester.scratch_arena.New<AudioProcessor>(k_headless_host);
+    DEFER { processor.~AudioProcessor(); };
+    REQUIRE(processor.processor_callbacks.activate(processor,
+                                                   {
+                                                       .sample_rate = k_sample_rate,
+                                                       .min_block_size = k_block_size,
+                                                       .max_block_size = k_block_size,
+                                                   }));
+    DEFER { processor.processor_callbacks.deactivate(processor); };
+
+    auto seed = SeedFromTime();
+
+    // A long IR so that the convolver has a lot of memory to clear.
+    constexpr u32 k_ir_num_frames = (u32)k_sample_rate * 4;
+    auto ir_samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_ir_num_frames * 2);
+    for (auto& s : ir_samples)
+        s = (RandomFloat01<f32>(seed) - 0.5f) * 0.01f;
+    {
+        AudioData const ir {
+            .hash = 1,
+            .channels = 2,
+            .sample_rate = k_sample_rate,
+            .num_frames = k_ir_num_frames,
+            .interleaved_samples = ir_samples,
+        };
+        processor.convo.ConvolutionIrDataLoaded(&ir);
+        processor.convo.SwapConvolversIfNeeded();
+    }
+    DEFER {
+        processor.convo.ConvolutionIrDataLoaded(nullptr);
+        processor.convo.SwapConvolversIfNeeded();
+        processor.convo.DeletedUnusedConvolvers();
+    };
+
+    // The same memory as the effect's convolver, for timing a synchronous reset.
+    auto& convolver_for_comparison = *CreateStereoConvolver();
+    DEFER { DestroyStereoConvolver(&convolver_for_comparison); };
+    Init(convolver_for_comparison, ir_samples.data, (int)k_ir_num_frames);
+
+    // Fully wet, so any dry signal that gets through while the memory is cleared is easy to spot.
+    for (auto const type : Array {EffectType::Reverb, EffectType::Delay, EffectType::ConvolutionReverb})
+        processor.params[ToInt(k_effect_info[ToInt(type)].on_param_index)].SetLinearValue(1);
+    processor.params[ToInt(ParamIndex::ReverbMix)].SetLinearValue(1);
+    processor.params[ToInt(ParamIndex::DelayMix)].SetLinearValue(1);
+    processor.params[ToInt(ParamIndex::ConvolutionReverbDry)].SetLinearValue(0);
+    {
+        Bitset<k_num_parameters> changed;
+        changed.SetAll();
+        ProcessorOnParamChange(processor, {processor.params.data, changed});
+        processor.smoothed_value_system.ResetAll();
+    }
+
+    auto allocate_buffer = [&]() {
+        return (f32*)tester.scratch_arena
+            .Allocate({.size = k_block_size * 2 * sizeof(f32), .alignment = 16, .allow_oversized_result = false})
+            .data;
+    };
+    auto io = ToStereoFramesSpan(allocate_buffer(), k_block_size);
+    ScratchBuffers const scratch_buffers {k_block_size, allocate_buffer(), allocate_buffer()};
+
+    // Returns the peak of the block's output, or nullopt if it's not a valid signal.
+    auto process_block = [&](Effect& fx) -> Optional<f32> {
+        for (auto& frame : io)
+            frame = {RandomFloat01<f32>(seed) - 0.5f, RandomFloat01<f32>(seed) - 0.5f};
+        processor.smoothed_value_system.ProcessBlock(k_block_size);
+        if (fx.type == EffectType::ConvolutionReverb)
+            processor.convo.ProcessBlockConvolution(processor.audio_processing_context,
+                                                    io,
+                                                    scratch_buffers,
+                                                    false);
+        else
+            fx.ProcessBlock(io, scratch_buffers, processor.audio_processing_context);
+        f32 peak = 0;
+        for (auto const& frame : io) {
+            if (!(Abs(frame.l) < 100 && Abs(frame.r) < 100)) return nullopt;
+            peak = Max(peak, Abs(frame.l), Abs(frame.r));
+        }
+        return peak;
+    };
+
+    auto time_synchronous_reset = [&](Effect& fx) {
+        Stopwatch const stopwatch;
+        switch (fx.type) {
+            case EffectType::Reverb: vitfx::reverb::HardReset(*processor.reverb.reverb); break;
+            case EffectType::Delay: vitfx::delay::HardReset(*processor.new_delay.delay); break;
+            case EffectType::ConvolutionReverb: Zero(convolver_for_comparison); break;
+            default: PanicIfReached();
+        }
+        return stopwatch.MicrosecondsElapsed();
+    };
+
+    for (auto fx : Array<Effect*, 3> {&processor.reverb, &processor.new_delay, &processor.convo}) {
+        auto const name = k_effect_info[ToInt(fx->type)].name;
+        CAPTURE(name);
+        auto const& time_sliced_reset = [&]() -> EffectTimeSlicedReset const& {
+            if (fx->type == EffectType::Reverb) return processor.reverb.time_sliced_reset;
+            if (fx->type == EffectType::Delay) return processor.new_delay.time_sliced_reset;
+            return processor.convo.time_sliced_reset;
+        }();
+
+        // Block times are noisy, so for each measurement we take the best of a few trials.
+        constexpr u32 k_num_trials = 3;
+        constexpr u32 k_num_blocks = 400;
+        auto worst_block_us = LargestRepresentableValue<f64>();
+        auto worst_block_us_without_reset = LargestRepresentableValue<f64>();
+        auto synchronous_reset_us = LargestRepresentableValue<f64>();
+
+        for (auto const trial : Range(k_num_trials)) {
+            (void)trial;
+
+            // Fill the effect's memory so that it has something to reset, and time blocks without a reset.
+            f64 trial_worst_block_us_without_reset = 0;
+            f32 peak_without_reset = 0;
+            for (auto const block_index : Range(k_num_blocks)) {
+                Stopwatch const stopwatch;
+                auto const peak = process_block(*fx);
+                trial_worst_block_us_without_reset =
+                    Max(trial_worst_block_us_without_reset, stopwatch.MicrosecondsElapsed());
+                REQUIRE(peak);
+                if (block_index >= k_num_blocks / 2) peak_without_reset = Max(peak_without_reset, *peak);
+            }
+
+            // The reset is done on the audio-thread as part of a block, so we time it as part of that block.
+            f64 trial_worst_block_us = 0;
+            u32 num_clearing_blocks = 0;
+            for (auto const block_index : Range(k_num_blocks)) {
+                Stopwatch const stopwatch;
+                if (block_index == 0) fx->Reset();
+                auto const peak = process_block(*fx);
+                trial_worst_block_us = Max(trial_worst_block_us, stopwatch.MicrosecondsElapsed());
+                REQUIRE(peak);
+
+                if (time_sliced_reset.in_progress) {
+                    // A cleared, fully wet effect is silent.
+                    ++num_clearing_blocks;
+                    CHECK_LT(*peak, 1e-4f);
+                } else if (block_index == num_clearing_blocks) {
+                    // The first processed block is the start of the fade-in, so it can't jump up to the
+                    // effect's full level.
+                    CHECK_LT(*peak, (peak_without_reset * 0.1f) + 1e-4f);
+                }
+            }
+            CHECK(num_clearing_blocks != 0);
+            CHECK(!time_sliced_reset.in_progress);
+
+            worst_block_us = Min(worst_block_us, trial_worst_block_us);
+            worst_block_us_without_reset =
+                Min(worst_block_us_without_reset, trial_worst_block_us_without_reset);
+            synchronous_reset_us = Min(synchronous_reset_us, time_synchronous_reset(*fx));
+        }
+
+        tester.log.DebugLn("{} reset at {} Hz: worst block {.1} us, worst block without a reset {.1} us, "
+                           "synchronous reset {.1} us",
+                           name,
+                           k_sample_rate,
+                           worst_block_us,
+                           worst_block_us_without_reset,
+                           synchronous_reset_us);
+
+        // Spreading the reset across blocks must add much less to any block than doing it all at once would.
+        CHECK_LT(worst_block_us, worst_block_us_without_reset + (synchronous_reset_us / 2));
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestApplyingStateParamChanges) {
+    constexpr u32 k_block_size = 64;
+
+    auto& processor = *tester.scratch_arena.New<AudioProcessor>(k_headless_host);
+    DEFER { processor.~AudioProcessor(); };
+    REQUIRE(processor.processor_callbacks.activate(processor,
+                                                   {
+                                                       .sample_rate = 44100,
+                                                       .min_block_size = k_block_size,
+                                                       .max_block_size = k_block_size,
+                                                   }));
+    DEFER { processor.processor_callbacks.deactivate(processor); };
+
+    HeadlessProcess headless {tester.scratch_arena, k_block_size};
+    auto const& channels = headless.channels;
+
+    auto process_block = [&]() {
+        Process(processor, headless.Block(k_block_size));
+        f32 peak = 0;
+        for (auto const i : Range(k_block_size))
+            peak = Max(peak, Max(Abs(channels[0][i]), Abs(channels[1][i])));
+        return peak;
+    };
+
+    for (auto const layer_index : Range((u32)k_num_layers)) {
+        processor.layer_processors[layer_index].desired_inst.Set(WaveformType::Sine);
+        processor.events_for_audio_thread.Push(LayerInstrumentChanged {.layer_index = layer_index});
+    }
+    for (auto _ : Range(100))
+        process_block();
+    for (auto const key : Array<u7, 3> {60, 64, 67})
+        processor.events_for_audio_thread.Push(GuiNoteClicked {.key = key, .velocity = 0.8f});
+    f32 settled_peak = 0;
+    for (auto _ : Range(100))
+        settled_peak = process_block();
+    REQUIRE(settled_peak > 0.01f);
+    auto const num_voices = processor.voice_pool.num_active_voices.Load();
+    REQUIRE(num_voices != 0);
+
+    // A preset that differs from the current state in only a few params.
+    Array<f32, k_num_parameters> near_identical_state {};
+    for (auto const i : Range(k_num_parameters))
+        near_identical_state[i] = processor.params[i].LinearValue();
+    for (auto const index : Array {ParamIndex::ReverbSize,
+                                   ParamIndex::PhaserFeedback,
+                                   ParamIndexFromLayerParamIndex(0, LayerParamIndex::TuneCents)}) {
+        auto const& range = k_param_infos[ToInt(index)].linear_range;
+        near_identical_state[ToInt(index)] = range.min + (range.Delta() * 0.4f);
+    }
+
+    constexpr u32 k_num_blocks_after_change = 100;
+    struct Result {
+        f64 us;
+        f32 min_peak;
+    };
+    auto measure = [&]() {
+        Result result {.us = 0, .min_peak = LargestRepresentableValue<f32>()};
+        for (auto _ : Range(k_num_blocks_after_change)) {
+            Stopwatch const stopwatch;
+            auto const peak = process_block();
+            result.us += stopwatch.MicrosecondsElapsed();
+            result.min_peak = Min(result.min_peak, peak);
+        }
+        return result;
+    };
+
+    auto const changed = SetAllParameterValues(processor, near_identical_state);
+    CHECK_EQ(changed.NumSet(), (usize)3);
+    auto const diff_result = measure();
+    CHECK(processor.state_params_changed.GetBlockwise().NumSet() == 0);
+    CHECK_EQ(processor.voice_pool.num_active_voices.Load(), num_voices);
+    CHECK(diff_result.min_peak > settled_peak * 0.5f);
+    for (auto const i : Range(k_num_parameters))
+        CHECK_EQ(processor.params[i].LinearValue(), near_identical_state[i]);
+
+    CHECK_EQ(SetAllParameterValues(processor, near_identical_state).NumSet(), (usize)0);
+    CHECK(processor.events_for_audio_thread.PopAll().size == 0);
+
+    // For comparison: the full reload that applying a state used to do.
+    processor.events_for_audio_thread.Push(EventForAudioThreadType::ReloadAllAudioState);
+    auto const reload_result = measure();
+
+    tester.log.DebugLn("Near-identical state, changed params only: {.1} us over {} blocks, min peak {.2}",
+                       diff_result.us,
+                       k_num_blocks_after_change,
+                       diff_result.min_peak);
+    tester.log.DebugLn("Near-identical state, full reload: {.1} us over {} blocks, min peak {.2}",
+                       reload_result.us,
+                       k_num_blocks_after_change,
+                       reload_result.min_peak);
+
+    return k_success;
+}
+
+TEST_CASE(TestNotifyingHostOfParamChanges) {
+    auto& processor = *tester.scratch_arena.New<AudioProcessor>(k_headless_host);
+    DEFER { processor.~AudioProcessor(); };
+
+    DynamicArray<clap_event_param_value> pushed {tester.scratch_arena};
+    HeadlessProcess headless {tester.scratch_arena, 1};
+    auto const collect_param_values = [&](clap_event_header const& event) {
+        if (event.type == CLAP_EVENT_PARAM_VALUE) dyn::Append(pushed, (clap_event_param_value const&)event);
+    };
+    headless.on_output_event = collect_param_values;
+    auto const& in_events = headless.in_events;
+    auto const& out_events = headless.out_events;
+
+    Array<f32, k_num_parameters> state {};
+    for (auto const i : Range(k_num_parameters))
+        state[i] = processor.params[i].LinearValue();
+    auto const changed_params =
+        Array {ParamIndex::ReverbSize, ParamIndexFromLayerParamIndex(1, LayerParamIndex::Volume)};
+    for (auto const index : changed_params) {
+        auto const& range = k_param_infos[ToInt(index)].linear_range;
+        state[ToInt(index)] = range.min + (range.Delta() * 0.3f);
+    }
+
+    NotifyHostOfParamChanges(processor, SetAllParameterValues(processor, state));
+    processor.processor_callbacks.flush_parameter_events(processor, in_events, out_events);
+
+    REQUIRE_EQ(pushed.size, changed_params.size);
+    for (auto const& event : pushed) {
+        auto const index = ParamIdToIndex(event.param_id);
+        REQUIRE(index);
+        CHECK(Contains(changed_params, *index));
+        CHECK_EQ(event.value, (f64)state[ToInt(*index)]);
+        CHECK(event.header.flags & CLAP_EVENT_DONT_RECORD);
+    }
+
+    // Nothing has changed since, so there's nothing to tell the host.
+    dyn::Clear(pushed);
+    NotifyHostOfParamChanges(processor, SetAllParameterValues(processor, state));
+    processor.processor_callbacks.flush_parameter_events(processor, in_events, out_events);
+    CHECK_EQ(pushed.size, (usize)0);
+
+    return k_success;
+}
+
+TEST_CASE(TestInternalSampleRate) {
+    SUBCASE("rate selection") {
+        CHECK_EQ(InternalRateFactor(192000, 0), 1u);
+        CHECK_EQ(InternalRateFactor(48000, 48000), 1u);
+        CHECK_EQ(InternalRateFactor(96000, 48000), 2u);
+        CHECK_EQ(InternalRateFactor(192000, 48000), 4u);
+        CHECK_EQ(InternalRateFactor(176400, 48000), 4u);
+        CHECK_EQ(InternalRateFactor(88200, 48000), 2u);
+        // Never below a normal sample rate, even if the maximum asks for it.
+        CHECK_EQ(InternalRateFactor(96000, 8000), 2u);
+    }
+
+    struct Render {
+        f64 seconds;
+        f32 peak;
+        bool valid;
+    };
+
+    // Renders a 32-voice sine chord at 192 kHz, with the engine at either the host's rate or 48 kHz.
+    auto render = [&](u32 max_internal_sample_rate, bool random_block_sizes) -> Render {
+        constexpr f64 k_sample_rate = 192000;
+        constexpr u32 k_max_block_size = 512;
+        constexpr u32 k_num_frames = (u32)k_sample_rate;
+
+        auto& processor = *tester.scratch_arena.New<AudioProcessor>(k_headless_host);
+        DEFER { processor.~AudioProcessor(); };
+        processor.max_internal_sample_rate.Store(max_internal_sample_rate);
+        REQUIRE(processor.processor_callbacks.activate(processor,
+                                                       {
+                                                           .sample_rate = k_sample_rate,
+                                                           .min_block_size = 1,
+                                                           .max_block_size = k_max_block_size,
+                                                       }));
+        DEFER { processor.processor_callbacks.deactivate(processor); };
+
+        auto const factor = processor.internal_rate.factor;
+        CHECK_EQ(processor.audio_processing_context.sample_rate, (f32)(k_sample_rate / factor));
+        CHECK_EQ(processor.processor_callbacks.latency(processor),
+                 factor == 1 ? 0u : factor * PolyphaseUpsampler::k_taps_per_phase / 2);
+
+        HeadlessProcess headless {tester.scratch_arena, k_max_block_size};
+        auto const& channels = headless.channels;
+
+        processor.layer_processors[0].desired_inst.Set(WaveformType::Sine);
+        processor.events_for_audio_thread.Push(LayerInstrumentChanged {.layer_index = 0});
+        for (auto const i : Range(32u))
+            processor.events_for_audio_thread.Push(GuiNoteClicked {.key = (u7)(36 + i), .velocity = 0.5f});
+
+        Render result {.seconds = 0, .peak = 0, .valid = true};
+        auto seed = SeedFromTime();
+        for (u32 pos = 0; pos < k_num_frames;) {
+            auto const block_size =
+                random_block_sizes ? RandomIntInRange<u32>(seed, 1, k_max_block_size) : k_max_block_size;
+            auto const process = headless.Block(block_size, (s64)pos);
+            Stopwatch const stopwatch;
+            Process(processor, process);
+            result.seconds += stopwatch.SecondsElapsed();
+
+            for (auto const i : Range(block_size)) {
+                for (auto const c : channels) {
+                    if (!(Abs(c[i]) < 100)) result.valid = false;
+                    result.peak = Max(result.peak, Abs(c[i]));
+                }
+            }
+            CHECK_LT(processor.internal_rate.num_pending, factor);
+            pos += block_size;
+        }
+        CHECK_EQ(processor.voice_pool.num_active_voices.Load(), 32u);
+        return result;
+    };
+
+    SUBCASE("odd block sizes") {
+        auto const r = render(48000, true);
+        CHECK(r.valid);
+        CHECK_GT(r.peak, 0.01f);
+    }
+
+    SUBCASE("32 voices at 192 kHz benchmark") {
+        auto const native = render(0, false);
+        auto const decoupled = render(48000, false);
+        CHECK(native.valid);
+        CHECK(decoupled.valid);
+        CHECK_GT(decoupled.peak, 0.01f);
+        tester.log.DebugLn("32 voices, 1 s at 192 kHz: native {.1} ms, engine at 48 kHz {.1} ms ({.2}x)",
+                           native.seconds * 1000,
+                           decoupled.seconds * 1000,
+                           native.seconds / decoupled.seconds);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestConvolutionIrTrimming) {
+    constexpr u32 k_block_size = 256;
+    constexpr u32 k_num_blocks = 500;
+    constexpr u32 k_num_frames = k_block_size * k_num_blocks;
+
+    auto seed = SeedFromTime();
+    auto make_channel = [&]() {
+        return tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames);
+    };
+    Array<Span<f32>, 2> const input {make_channel(), make_channel()};
+    for (auto const& channel : input)
+        for (auto& s : channel)
+            s = (RandomFloat01<f32>(seed) - 0.5f) * 0.5f;
+
+    struct Render {
+        Array<Span<f32>, 2> output;
+        f64 seconds;
+    };
+
+    auto render = [&](AudioData const& ir, u32 num_ir_frames) {
+        auto ir_samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(num_ir_frames * 2);
+        CopyTrimmedConvolutionIr(ir, ir_samples);
+        auto convolver = CreateStereoConvolver();
+        DEFER { DestroyStereoConvolver(convolver); };
+        Init(*convolver, ir_samples.data, (int)num_ir_frames);
+
+        Render result {.output = {make_channel(), make_channel()}};
+        Stopwatch const stopwatch;
+        for (u32 pos = 0; pos < k_num_frames; pos += k_block_size) {
+            Process(*convolver,
+                    input[0].data + pos,
+                    input[1].data + pos,
+                    result.output[0].data + pos,
+                    result.output[1].data + pos,
+                    (int)k_block_size);
+        }
+        result.seconds = stopwatch.SecondsElapsed();
+        return result;
+    };
+
+    for (auto const& embedded : EmbeddedIrs().irs) {
+        auto const name = String {embedded.name.data, embedded.name.size};
+        CAPTURE(name);
+
+        auto reader = Reader::FromMemory({embedded.data, embedded.size});
+        auto ir = REQUIRE_UNWRAP(DecodeAudioFile(reader,
+                                                 String {embedded.filename.data, embedded.filename.size},
+                                                 tester.scratch_arena));
+        auto const trimmed_num_frames = ConvolutionIrNumFrames(ir, 0);
+        CHECK_LTE(trimmed_num_frames, ir.num_frames);
+
+        auto const full = render(ir, ir.num_frames);
+        auto const trimmed = render(ir, trimmed_num_frames);
+
+        // How much the reverb changes, relative to its level.
+        f64 signal = 0;
+        f64 error = 0;
+        for (auto const channel : Range(2u)) {
+            for (auto const i : Range(k_num_frames)) {
+                auto const a = (f64)full.output[channel][i];
+                auto const b = (f64)trimmed.output[channel][i];
+                signal += a * a;
+                error += (a - b) * (a - b);
+            }
+        }
+        auto const error_db = error == 0 ? -1000.0 : 10 * Log10(error / signal);
+
+        tester.log.DebugLn("IR {}: {}/{} frames audible, error {.1} dB, {.2} ms before, {.2} ms after",
+                           name,
+                           trimmed_num_frames,
+                           ir.num_frames,
+                           error_db,
+                           full.seconds * 1000,
+                           trimmed.seconds * 1000);
+        CHECK_LT(error_db, -50.0);
+
+        // A length budget cuts into the audible tail, but always fades out.
+        auto const budget_num_frames = ConvolutionIrNumFrames(ir, 250);
+        CHECK_LTE(budget_num_frames, (u32)(ir.sample_rate / 4) + 1);
+        auto budget_samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(budget_num_frames * 2);
+        CopyTrimmedConvolutionIr(ir, budget_samples);
+        if (budget_num_frames < ir.num_frames) CHECK_LT(Abs(budget_samples[budget_samples.size - 1]), 0.01f);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeProcessorTests) {
+    REGISTER_TEST(TestProcessorParamDependencies);
+    REGISTER_TEST(TestEffectResetBlockTime);
+    REGISTER_TEST(TestApplyingStateParamChanges);
+    REGISTER_TEST(TestNotifyingHostOfParamChanges);
+    REGISTER_TEST(TestInternalSampleRate);
+    REGISTER_TEST(TestConvolutionIrTrimming);
+}
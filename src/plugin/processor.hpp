@@ -26,6 +26,7 @@
 #include "param.hpp"
 #include "param_info.hpp"
 #include "plugin.hpp"
+#include "processing/polyphase_upsampler.hpp"
 #include "processing/smoothed_value_system.hpp"
 #include "processing/volume_fade.hpp"
 #include "voices.hpp"
@@ -36,6 +37,7 @@ enum class EventForAudioThreadType : u8 {
     ParamGestureEnd,
     FxOrderChanged,
     ReloadAllAudioState,
+    StateParamsChanged,
     ConvolutionIRChanged,
     LayerInstrumentChanged,
     StartNote,
@@ -165,10 +167,15 @@ class AtomicBitset {
             block.store(0);
     }
 
+    void OrBlockwise(Bitset<k_bits> other) {
+        for (auto const i : Range(m_data.size))
+            if (other.parts[i]) m_data[i].FetchOr(other.parts[i]);
+    }
+
     Bitset<k_bits> ExchangeClearAllBlockwise() {
         Bitset<k_bits> result;
-        for (auto const i : Range(m_data.Size()))
-            result.Raw()[i] = m_data[i].exchange(0);
+        for (auto const i : Range(m_data.size))
+            result.parts[i] = m_data[i].Exchange(0);
         return result;
     }
 
@@ -202,6 +209,22 @@ struct AudioProcessor {
 
     u32 previous_block_size = 0;
 
+    // If the host's sample rate is above this, the engine runs at the host's rate divided by a whole number
+    // and its output is upsampled, since synthesis gains nothing audible from very high rates. 0 means the
+    // engine always runs at the host's rate. Read on activation.
+    Atomic<u32> max_internal_sample_rate {0};
+
+    struct InternalRate {
+        u32 factor = 1; // host sample rate / engine sample rate
+        PolyphaseUpsampler upsampler {};
+        Span<StereoAudioFrame> upsampled {};
+        // The upsampler makes factor frames for every engine frame so a block can end part-way through them.
+        // These are the host-rate frames not given to the host yet, starting at pending_start in upsampled.
+        u32 pending_start {};
+        u32 num_pending {};
+        u32 engine_block_offset {}; // host frames in the current block before the engine's first frame
+    } internal_rate;
+
     StereoPeakMeter peak_meter = {};
     Optional<HostThreadPool> host_thread_pool;
 
@@ -218,6 +241,13 @@ struct AudioProcessor {
 
     Bitset<k_num_parameters> pending_param_changes;
 
+    // Params changed by applying a new state, consumed on a StateParamsChanged event.
+    AtomicBitset<k_num_parameters> state_params_changed {};
+
+    // Params changed on the main thread that the host hasn't been told about. The next process() or flush()
+    // sends each of them to the host as a value event.
+    AtomicBitset<k_num_parameters> params_to_notify_host {};
+
     enum MainThreadCallbackFlags {
         MainThreadCallbackFlagsRedrawGui = 1 << 0,
         MainThreadCallbackFlagsRescanParameters = 1 << 1,
@@ -272,6 +302,15 @@ struct ParamChangeFlags {
 
 bool SetParameterValue(AudioProcessor& processor, ParamIndex index, f32 value, ParamChangeFlags flags);
 
+// Sets every parameter from a state, but only sends the ones that actually changed to the audio thread. They
+// are applied there like any other param change rather than with a full reload. Returns the changed params.
+Bitset<k_num_parameters> SetAllParameterValues(AudioProcessor& processor,
+                                               Array<f32, k_num_parameters> const& linear_values);
+
+// Tells the host the new values of just these params, rather than asking it to rescan every param's value.
+// Hosts can then keep their own copies up to date without polling.
+void NotifyHostOfParamChanges(AudioProcessor& processor, Bitset<k_num_parameters> changed);
+
 bool IsMidiCCLearnActive(AudioProcessor const& processor);
 void LearnMidiCC(AudioProcessor& processor, ParamIndex param);
 void CancelMidiCCLearn(AudioProcessor& processor);
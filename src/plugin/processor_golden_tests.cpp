@@ -0,0 +1,540 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Golden-output regression tests for the audio engine. A fixed matrix of synthetic instruments, parameter
+// setups, note patterns and automation is rendered through the headless processor and compared against
+// reference renders stored in test_files/golden. Everything is generated, so no sample libraries are
+// needed.
+//
+// A reference file is a 16-byte header followed by the interleaved samples as little-endian IEEE 754 f32,
+// whatever machine wrote it. The header is the magic "FLGR" then, each as a little-endian u32, the format
+// version, the number of channels and the number of frames. Pass --update-golden to the tests executable to
+// record all of them, which is only right after an intentional change to the sound. A case without a
+// reference is skipped with a warning, so a checkout without recorded references still passes; a reference
+// that exists but doesn't match is a failure.
+
+#include "foundation/foundation.hpp"
+#include "os/filesystem.hpp"
+#include "tests/framework.hpp"
+
+#include "param_info.hpp"
+#include "processor.hpp"
+#include "processor_test_helpers.hpp"
+
+constexpr f32 k_golden_sample_rate = 44100;
+constexpr u32 k_golden_num_frames = 44100;
+constexpr u32 k_golden_automation_interval_frames = 256;
+
+struct GoldenParamSetting {
+    ParamIndex index;
+    f32 projected_value;
+};
+
+struct GoldenNote {
+    u32 frame;
+    u32 num_frames;
+    u7 key;
+    f32 velocity;
+};
+
+// A linear ramp across the param's linear range, sent as a param event every
+// k_golden_automation_interval_frames.
+struct GoldenAutomation {
+    ParamIndex index;
+    u32 start_frame;
+    u32 end_frame;
+    f32 start_position;
+    f32 end_position;
+};
+
+struct GoldenCase {
+    String name;
+    Array<Optional<WaveformType>, k_num_layers> layers;
+    Span<GoldenParamSetting const> params;
+    Span<GoldenNote const> notes;
+    Span<GoldenAutomation const> automation;
+    bool synthetic_ir;
+    u32 block_size;
+    f32 tolerance; // maximum absolute difference of any sample
+};
+
+constexpr ParamIndex LayerParam(u32 layer, LayerParamIndex param) {
+    return ParamIndexFromLayerParamIndex(layer, param);
+}
+
+constexpr auto k_golden_chord = Array {
+    GoldenNote {.frame = 0, .num_frames = 30000, .key = 48, .velocity = 1},
+    GoldenNote {.frame = 0, .num_frames = 30000, .key = 55, .velocity = 0.8f},
+    GoldenNote {.frame = 0, .num_frames = 30000, .key = 60, .velocity = 0.6f},
+    GoldenNote {.frame = 0, .num_frames = 30000, .key = 64, .velocity = 0.4f},
+};
+
+// Deliberately not aligned to blocks or voice processing chunks.
+consteval auto CreateGoldenArpeggio() {
+    Array<GoldenNote, 16> notes {};
+    constexpr Array<u7, 4> k_keys {57, 60, 64, 69};
+    for (auto const i : Range((u32)notes.size)) {
+        notes[i] = {
+            .frame = 101 + (i * 2693),
+            .num_frames = 1999,
+            .key = (u7)(k_keys[i % k_keys.size] + ((i / k_keys.size) * 2)),
+            .velocity = 0.5f + ((f32)(i % 3) * 0.25f),
+        };
+    }
+    return notes;
+}
+
+// More notes than there are voices, so voices are stolen.
+consteval auto CreateGoldenCluster() {
+    Array<GoldenNote, k_num_voices + 8> notes {};
+    for (auto const i : Range((u32)notes.size)) {
+        notes[i] = {
+            .frame = i * 397,
+            .num_frames = 20000,
+            .key = (u7)(36 + i),
+            .velocity = 0.7f,
+        };
+    }
+    return notes;
+}
+
+constexpr auto k_golden_arpeggio = CreateGoldenArpeggio();
+constexpr auto k_golden_cluster = CreateGoldenCluster();
+
+static Array<GoldenCase, 6> const& GoldenCases() {
+    static constexpr auto k_layer_shaping = Array {
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::VolEnvOn), 1},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::VolumeAttack), 40},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::VolumeRelease), 200},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::Pan), -0.4f},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::FilterOn), 1},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::FilterCutoff), 900},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::FilterResonance), 0.5f},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::FilterEnvAmount), 0.6f},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::LfoOn), 1},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::LfoSyncSwitch), 0},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::LfoRateHz), 3},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::LfoAmount), 0.8f},
+        GoldenParamSetting {LayerParam(0, LayerParamIndex::LfoDestination),
+                            (f32)ToInt(param_values::LfoDestination::Filter)},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::Pan), 0.5f},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::TuneCents), 7},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::LfoOn), 1},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::LfoSyncSwitch), 0},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::LfoRateHz), 6},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::LfoAmount), 0.5f},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::LfoDestination),
+                            (f32)ToInt(param_values::LfoDestination::Pitch)},
+        GoldenParamSetting {LayerParam(1, LayerParamIndex::EqOn), 1},
+    };
+
+    static constexpr auto k_effects_chain = Array {
+        GoldenParamSetting {ParamIndex::DistortionOn, 1},
+        GoldenParamSetting {ParamIndex::DistortionDrive, 0.4f},
+        GoldenParamSetting {ParamIndex::CompressorOn, 1},
+        GoldenParamSetting {ParamIndex::ChorusOn, 1},
+        GoldenParamSetting {ParamIndex::PhaserOn, 1},
+        GoldenParamSetting {ParamIndex::DelayOn, 1},
+        GoldenParamSetting {ParamIndex::DelayTimeSyncSwitch, 0},
+        GoldenParamSetting {ParamIndex::DelayTimeLMs, 120},
+        GoldenParamSetting {ParamIndex::DelayTimeRMs, 180},
+        GoldenParamSetting {ParamIndex::DelayFeedback, 0.4f},
+        GoldenParamSetting {ParamIndex::ReverbOn, 1},
+        GoldenParamSetting {ParamIndex::ReverbMix, 0.4f},
+        GoldenParamSetting {ParamIndex::StereoWidenOn, 1},
+    };
+
+    static constexpr auto k_convolution = Array {
+        GoldenParamSetting {ParamIndex::ConvolutionReverbOn, 1},
+    };
+
+    static constexpr auto k_sweeps = Array {
+        GoldenAutomation {
+            .index = LayerParam(0, LayerParamIndex::FilterCutoff),
+            .start_frame = 0,
+            .end_frame = 40000,
+            .start_position = 0.2f,
+            .end_position = 0.9f,
+        },
+        GoldenAutomation {
+            .index = LayerParam(1, LayerParamIndex::Volume),
+            .start_frame = 10000,
+            .end_frame = 30000,
+            .start_position = 0.8f,
+            .end_position = 0.1f,
+        },
+        GoldenAutomation {
+            .index = ParamIndex::MasterVolume,
+            .start_frame = 20000,
+            .end_frame = 44000,
+            .start_position = 0.7f,
+            .end_position = 0.3f,
+        },
+    };
+
+    static Array<GoldenCase, 6> const k_cases {
+        GoldenCase {
+            .name = "sine-chord"_s,
+            .layers = {WaveformType::Sine, nullopt, nullopt},
+            .notes = k_golden_chord,
+            .block_size = 64,
+            .tolerance = 1e-4f,
+        },
+        GoldenCase {
+            .name = "layers-shaped-arpeggio"_s,
+            .layers = {WaveformType::Sine, WaveformType::Sine, WaveformType::WhiteNoiseMono},
+            .params = k_layer_shaping,
+            .notes = k_golden_arpeggio,
+            .block_size = 64,
+            .tolerance = 1e-4f,
+        },
+        GoldenCase {
+            .name = "noise-effects-chain"_s,
+            .layers = {WaveformType::WhiteNoiseStereo, nullopt, nullopt},
+            .params = k_effects_chain,
+            .notes = k_golden_chord,
+            .block_size = 128,
+            .tolerance = 1e-3f,
+        },
+        GoldenCase {
+            .name = "voice-stealing"_s,
+            .layers = {WaveformType::Sine, WaveformType::Sine, nullopt},
+            .notes = k_golden_cluster,
+            .block_size = 512,
+            .tolerance = 1e-4f,
+        },
+        GoldenCase {
+            .name = "automation-odd-blocks"_s,
+            .layers = {WaveformType::Sine, WaveformType::WhiteNoiseStereo, nullopt},
+            .params = k_layer_shaping,
+            .notes = k_golden_arpeggio,
+            .automation = k_sweeps,
+            .block_size = 97,
+            .tolerance = 1e-4f,
+        },
+        GoldenCase {
+            .name = "convolution-synthetic-ir"_s,
+            .layers = {WaveformType::Sine, nullopt, nullopt},
+            .params = k_convolution,
+            .notes = k_golden_arpeggio,
+            .synthetic_ir = true,
+            .block_size = 256,
+            .tolerance = 1e-3f,
+        },
+    };
+    return k_cases;
+}
+
+union GoldenEvent {
+    clap_event_header header;
+    clap_event_note note;
+    clap_event_param_value param;
+};
+
+// All of the case's events in time order, with header.time being the frame from the start of the render.
+static Span<GoldenEvent> GoldenEvents(GoldenCase const& c, ArenaAllocator& arena) {
+    DynamicArray<GoldenEvent> events {arena};
+
+    auto param_event = [&](u32 frame, ParamIndex index, f32 linear_value) {
+        GoldenEvent e {};
+        e.param = {
+            .header = {.size = sizeof(clap_event_param_value),
+                       .time = frame,
+                       .space_id = CLAP_CORE_EVENT_SPACE_ID,
+                       .type = CLAP_EVENT_PARAM_VALUE},
+            .param_id = ParamIndexToId(index),
+            .cookie = nullptr,
+            .note_id = -1,
+            .port_index = -1,
+            .channel = -1,
+            .key = -1,
+            .value = (f64)linear_value,
+        };
+        dyn::Append(events, e);
+    };
+
+    auto note_event = [&](u32 frame, u16 type, GoldenNote const& note) {
+        GoldenEvent e {};
+        e.note = {
+            .header = {.size = sizeof(clap_event_note),
+                       .time = frame,
+                       .space_id = CLAP_CORE_EVENT_SPACE_ID,
+                       .type = type},
+            .note_id = -1,
+            .port_index = 0,
+            .channel = 0,
+            .key = note.key,
+            .velocity = (f64)note.velocity,
+        };
+        dyn::Append(events, e);
+    };
+
+    for (auto const& p : c.params)
+        param_event(0, p.index, *k_param_infos[ToInt(p.index)].LineariseValue(p.projected_value, true));
+
+    for (auto const& a : c.automation) {
+        auto const& range = k_param_infos[ToInt(a.index)].linear_range;
+        for (u32 frame = a.start_frame; frame <= a.end_frame; frame += k_golden_automation_interval_frames) {
+            auto const t = (f32)(frame - a.start_frame) / (f32)(a.end_frame - a.start_frame);
+            auto const position = a.start_position + ((a.end_position - a.start_position) * t);
+            param_event(frame, a.index, range.min + (range.Delta() * position));
+        }
+    }
+
+    for (auto const& n : c.notes) {
+        note_event(n.frame, CLAP_EVENT_NOTE_ON, n);
+        note_event(n.frame + n.num_frames, CLAP_EVENT_NOTE_OFF, n);
+    }
+
+    // Stable, so that events at the same frame keep the order they were added in.
+    auto result = events.ToOwnedSpan();
+    for (usize i = 1; i < result.size; ++i)
+        for (usize j = i; j > 0 && result[j - 1].header.time > result[j].header.time; --j)
+            Swap(result[j - 1], result[j]);
+    return result;
+}
+
+struct GoldenRender {
+    Span<f32> interleaved_samples;
+    f64 seconds_to_render;
+};
+
+static GoldenRender RenderGoldenCase(tests::Tester& tester, GoldenCase const& c) {
+    auto& arena = tester.scratch_arena;
+
+    auto& processor = *arena.New<AudioProcessor>(k_headless_host);
+    DEFER { processor.~AudioProcessor(); };
+    REQUIRE(processor.processor_callbacks.activate(processor,
+                                                   {
+                                                       .sample_rate = k_golden_sample_rate,
+                                                       .min_block_size = 1,
+                                                       .max_block_size = c.block_size,
+                                                   }));
+    DEFER { processor.processor_callbacks.deactivate(processor); };
+
+    // The white noise generators are the only randomness in the engine.
+    processor.voice_pool.random_seed = 1;
+
+    for (auto const [layer_index, waveform] : Enumerate<u32>(c.layers)) {
+        if (!waveform) continue;
+        processor.layer_processors[layer_index].desired_inst.Set(*waveform);
+        processor.events_for_audio_thread.Push(LayerInstrumentChanged {.layer_index = layer_index});
+    }
+
+    Span<f32> ir_samples {};
+    if (c.synthetic_ir) {
+        // Exponentially decaying noise from a fixed seed.
+        constexpr u32 k_ir_num_frames = (u32)k_golden_sample_rate / 2;
+        ir_samples = arena.AllocateExactSizeUninitialised<f32>(k_ir_num_frames * 2);
+        u64 seed = 1234;
+        for (auto const frame : Range(k_ir_num_frames)) {
+            auto const decay = Exp(-6.0f * (f32)frame / (f32)k_ir_num_frames);
+            for (auto const channel : Range(2u))
+                ir_samples[(frame * 2) + channel] = (RandomFloat01<f32>(seed) - 0.5f) * decay * 0.1f;
+        }
+    }
+    AudioData const ir {
+        .hash = 1,
+        .channels = 2,
+        .sample_rate = k_golden_sample_rate,
+        .num_frames = (u32)(ir_samples.size / 2),
+        .interleaved_samples = ir_samples,
+    };
+    if (c.synthetic_ir) {
+        processor.convo.ConvolutionIrDataLoaded(&ir);
+        processor.convo.SwapConvolversIfNeeded();
+    }
+    DEFER {
+        if (c.synthetic_ir) {
+            processor.convo.ConvolutionIrDataLoaded(nullptr);
+            processor.convo.SwapConvolversIfNeeded();
+            processor.convo.DeletedUnusedConvolvers();
+        }
+    };
+
+    auto const events = GoldenEvents(c, arena);
+
+    HeadlessProcess headless {arena, c.block_size};
+    auto const& channels = headless.channels;
+
+    auto result = arena.AllocateExactSizeUninitialised<f32>(k_golden_num_frames * 2);
+    DynamicArray<GoldenEvent> events_in_block {arena};
+    DynamicArray<clap_event_header const*> event_headers {arena};
+    usize next_event = 0;
+    f64 seconds_to_render = 0;
+
+    for (u32 block_start = 0; block_start < k_golden_num_frames; block_start += c.block_size) {
+        auto const num_frames = Min(c.block_size, k_golden_num_frames - block_start);
+
+        dyn::Clear(events_in_block);
+        for (; next_event != events.size && events[next_event].header.time < block_start + num_frames;
+             ++next_event) {
+            auto e = events[next_event];
+            e.header.time -= block_start;
+            dyn::Append(events_in_block, e);
+        }
+        dyn::Clear(event_headers);
+        for (auto const& e : events_in_block)
+            dyn::Append(event_headers, &e.header);
+        headless.input_events = event_headers.Items();
+
+        auto const process = headless.Block(num_frames, (s64)block_start);
+        Stopwatch const stopwatch;
+        Process(processor, process);
+        seconds_to_render += stopwatch.SecondsElapsed();
+
+        for (auto const frame : Range(num_frames)) {
+            result[((block_start + frame) * 2) + 0] = channels[0][frame];
+            result[((block_start + frame) * 2) + 1] = channels[1][frame];
+        }
+    }
+
+    return {.interleaved_samples = result, .seconds_to_render = seconds_to_render};
+}
+
+constexpr auto k_golden_file_magic = "FLGR"_s;
+constexpr u32 k_golden_file_version = 1;
+constexpr usize k_golden_file_header_size = 16;
+
+static void AppendLittleEndianU32(DynamicArray<u8>& out, u32 value) {
+    for (auto const byte_index : Range(4u))
+        dyn::Append(out, (u8)(value >> (byte_index * 8)));
+}
+
+static u32 ReadLittleEndianU32(Span<u8 const> bytes) {
+    u32 result = 0;
+    for (auto const byte_index : Range(4u))
+        result |= (u32)bytes[byte_index] << (byte_index * 8);
+    return result;
+}
+
+static Span<u8> EncodeGoldenFile(Span<f32 const> interleaved_samples, ArenaAllocator& arena) {
+    DynamicArray<u8> out {arena};
+    out.Reserve(k_golden_file_header_size + (interleaved_samples.size * sizeof(f32)));
+    dyn::AppendSpan(out, k_golden_file_magic.ToByteSpan());
+    AppendLittleEndianU32(out, k_golden_file_version);
+    AppendLittleEndianU32(out, 2);
+    AppendLittleEndianU32(out, (u32)(interleaved_samples.size / 2));
+    for (auto const sample : interleaved_samples)
+        AppendLittleEndianU32(out, __builtin_bit_cast(u32, sample));
+    return out.ToOwnedSpan();
+}
+
+// Returns nullopt if the file isn't a reference for a stereo render of num_frames.
+static Optional<Span<f32>> DecodeGoldenFile(Span<u8 const> bytes, u32 num_frames, ArenaAllocator& arena) {
+    if (bytes.size != k_golden_file_header_size + ((usize)num_frames * 2 * sizeof(f32))) return nullopt;
+    if (String {(char const*)bytes.data, k_golden_file_magic.size} != k_golden_file_magic) return nullopt;
+    if (ReadLittleEndianU32(bytes.SubSpan(4)) != k_golden_file_version) return nullopt;
+    if (ReadLittleEndianU32(bytes.SubSpan(8)) != 2) return nullopt;
+    if (ReadLittleEndianU32(bytes.SubSpan(12)) != num_frames) return nullopt;
+
+    auto result = arena.AllocateExactSizeUninitialised<f32>((usize)num_frames * 2);
+    for (auto const [i, sample] : Enumerate(result)) {
+        auto const pos = k_golden_file_header_size + (i * sizeof(f32));
+        sample = __builtin_bit_cast(f32, ReadLittleEndianU32(bytes.SubSpan(pos)));
+    }
+    return result;
+}
+
+struct GoldenComparison {
+    f32 max_error;
+    f64 rms_error;
+    Optional<u32> first_differing_frame; // the first frame where the difference exceeds the tolerance
+};
+
+static GoldenComparison CompareWithGolden(Span<f32 const> render, Span<f32 const> golden, f32 tolerance) {
+    ASSERT(render.size == golden.size);
+    GoldenComparison result {.max_error = 0, .rms_error = 0, .first_differing_frame = nullopt};
+    f64 sum_of_squares = 0;
+    for (auto const i : Range(render.size)) {
+        auto const error = Abs(render[i] - golden[i]);
+        result.max_error = Max(result.max_error, error);
+        sum_of_squares += (f64)error * (f64)error;
+        if (!(error <= tolerance) && !result.first_differing_frame)
+            result.first_differing_frame = (u32)(i / 2);
+    }
+    result.rms_error = Sqrt(sum_of_squares / (f64)render.size);
+    return result;
+}
+
+TEST_CASE(TestGoldenRenders) {
+    auto const golden_folder = path::Join(tester.arena, Array {TestFilesFolder(tester), "golden"_s});
+
+    for (auto const& c : GoldenCases()) {
+        CAPTURE(c.name);
+        auto const render = RenderGoldenCase(tester, c);
+        auto const seconds_of_audio = (f64)k_golden_num_frames / (f64)k_golden_sample_rate;
+        tester.log.DebugLn("{}: rendered {.2} s in {.2} ms ({.1}x realtime)",
+                           c.name,
+                           seconds_of_audio,
+                           render.seconds_to_render * 1000,
+                           seconds_of_audio / render.seconds_to_render);
+
+        for (auto const s : render.interleaved_samples)
+            REQUIRE(Abs(s) < 100);
+
+        auto const filename = fmt::Format(tester.scratch_arena, "{}.golden", c.name);
+        auto const golden_path = path::Join(tester.scratch_arena, Array {(String)golden_folder, filename});
+
+        if (tester.update_golden_files) {
+            TRY(CreateDirectory(golden_folder, {.create_intermediate_directories = true}));
+            TRY(WriteFile(golden_path, EncodeGoldenFile(render.interleaved_samples, tester.scratch_arena)));
+            tester.log.InfoLn("{}: recorded golden render {}", c.name, golden_path);
+            continue;
+        }
+
+        auto const golden_bytes = ReadEntireFile(golden_path, tester.scratch_arena);
+        if (golden_bytes.HasError()) {
+            auto const missing = golden_bytes.Error() == FilesystemError::PathDoesNotExist;
+            tests::Check(tester,
+                         false,
+                         missing ? fmt::Format(tester.scratch_arena,
+                                               "skipped {}: no reference render {}; run with --update-golden "
+                                               "to record it",
+                                               c.name,
+                                               golden_path)
+                                 : fmt::Format(tester.scratch_arena,
+                                               "can't read reference render {}: {}",
+                                               golden_path,
+                                               golden_bytes.Error()),
+                         missing ? tests::FailureAction::LogWarningAndContinue
+                                 : tests::FailureAction::FailAndContinue);
+            continue;
+        }
+        auto const golden = DecodeGoldenFile(golden_bytes.Value(), k_golden_num_frames, tester.scratch_arena);
+        if (!golden) {
+            tests::Check(tester,
+                         false,
+                         fmt::Format(tester.scratch_arena,
+                                     "{} isn't a reference for this render; run with --update-golden to "
+                                     "record it",
+                                     golden_path),
+                         tests::FailureAction::FailAndContinue);
+            continue;
+        }
+
+        auto const comparison = CompareWithGolden(render.interleaved_samples, *golden, c.tolerance);
+        tester.log.DebugLn("{}: max error {}, RMS error {}",
+                           c.name,
+                           comparison.max_error,
+                           comparison.rms_error);
+        tests::Check(tester,
+                     !comparison.first_differing_frame,
+                     comparison.first_differing_frame
+                         ? fmt::Format(tester.scratch_arena,
+                                       "{} differs from {}: max error {} (tolerance {}), RMS error {}, first "
+                                       "differing frame {}",
+                                       c.name,
+                                       golden_path,
+                                       comparison.max_error,
+                                       c.tolerance,
+                                       comparison.rms_error,
+                                       *comparison.first_differing_frame)
+                         : MutableString {},
+                     tests::FailureAction::FailAndContinue);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeGoldenRenderTests) { REGISTER_TEST(TestGoldenRenders); }
@@ -0,0 +1,80 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+// Shared by tests that run the engine without a plugin wrapper or a real host.
+
+#pragma once
+#include <clap/host.h>
+#include <clap/process.h>
+
+#include "foundation/foundation.hpp"
+
+// Offers no extensions and ignores every request.
+inline clap_host const k_headless_host {
+    .clap_version = CLAP_VERSION,
+    .host_data = nullptr,
+    .name = "Tests",
+    .vendor = "Floe",
+    .url = "",
+    .version = "1",
+    .get_extension = [](clap_host const*, char const*) -> void const* { return nullptr; },
+    .request_restart = [](clap_host const*) {},
+    .request_process = [](clap_host const*) {},
+    .request_callback = [](clap_host const*) {},
+};
+
+// A stereo output and event lists for calling Process() one block at a time. Set input_events before each
+// block; they're given to the processor as they are, so their times must be relative to the block. Output
+// events are accepted and dropped unless on_output_event is set. The lists point back at this object, so it
+// can't be copied.
+struct HeadlessProcess {
+    HeadlessProcess(ArenaAllocator& arena, u32 max_block_size) {
+        for (auto& c : channels)
+            c = arena.AllocateExactSizeUninitialised<f32>(max_block_size).data;
+    }
+    HeadlessProcess(HeadlessProcess const&) = delete;
+    HeadlessProcess& operator=(HeadlessProcess const&) = delete;
+
+    clap_process Block(u32 num_frames, s64 steady_time = -1) {
+        return {
+            .steady_time = steady_time,
+            .frames_count = num_frames,
+            .transport = nullptr,
+            .audio_inputs = nullptr,
+            .audio_outputs = &output,
+            .audio_inputs_count = 0,
+            .audio_outputs_count = 1,
+            .in_events = &in_events,
+            .out_events = &out_events,
+        };
+    }
+
+    Array<f32*, 2> channels {};
+    Span<clap_event_header const* const> input_events {};
+    FunctionRef<void(clap_event_header const&)> on_output_event {};
+
+    clap_audio_buffer output {
+        .data32 = channels.data,
+        .data64 = nullptr,
+        .channel_count = 2,
+        .latency = 0,
+        .constant_mask = 0,
+    };
+    clap_input_events const in_events {
+        .ctx = this,
+        .size = [](clap_input_events const* list) -> u32 {
+            return (u32)((HeadlessProcess const*)list->ctx)->input_events.size;
+        },
+        .get = [](clap_input_events const* list, u32 index) -> clap_event_header const* {
+            return ((HeadlessProcess const*)list->ctx)->input_events[index];
+        },
+    };
+    clap_output_events const out_events {
+        .ctx = this,
+        .try_push = [](clap_output_events const* list, clap_event_header const* event) {
+            auto const& self = *(HeadlessProcess const*)list->ctx;
+            if (self.on_output_event) self.on_output_event(*event);
+            return true;
+        },
+    };
+};
@@ -11,6 +11,8 @@
 #include "foundation/foundation.hpp"
 #include "tests/framework.hpp"
 
+#include "processing/audio_utils.hpp"
+
 ErrorCodeCategory const audio_file_error_category {
     .category_id = "AUD",
     .message = [](Writer const& writer, ErrorCode code) -> ErrorCodeOr<void> {
@@ -271,13 +273,15 @@ ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, A
             .num_frames = (u32)(num_samples / 2),
             .interleaved_samples = allocator.AllocateExactSizeUninitialised<f32>(num_samples),
         };
-        u32 const sample_pos = 0;
+        usize sample_pos = 0;
         drwav_int16 buffer[2000];
         while (true) {
             auto const num_read = TRY(reader.Read({(u8*)buffer, sizeof(buffer)}));
+            auto const num_samples_read = Min(num_read / sizeof(drwav_int16), num_samples - sample_pos);
             drwav_s16_to_f32((f32*)result.interleaved_samples.data + sample_pos,
                              (drwav_int16 const*)buffer,
-                             num_read);
+                             num_samples_read);
+            sample_pos += num_samples_read;
             if (num_read != sizeof(buffer)) break;
         }
         result.hash =
@@ -291,6 +295,85 @@ ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, A
     return ErrorCode {AudioFileError::NotFlacOrWav};
 }
 
+constexpr f32 k_onset_threshold_relative_to_peak = 0.004f; // about -48 dB
+constexpr f64 k_onset_pre_roll_seconds = 0.001;
+
+u32 DetectOnsetFrame(AudioData const& audio) {
+    ZoneScoped;
+    if (!audio.num_frames || !audio.channels) return 0;
+
+    f32 peak = 0;
+    for (auto const s : audio.interleaved_samples)
+        peak = Max(peak, Fabs(s));
+    if (peak == 0) return 0;
+
+    auto const threshold = Max(peak * k_onset_threshold_relative_to_peak, k_silence_amp_90);
+
+    u32 onset = 0;
+    for (auto const frame : Range(audio.num_frames)) {
+        auto const samples = audio.interleaved_samples.SubSpan(frame * audio.channels, audio.channels);
+        bool audible = false;
+        for (auto const s : samples)
+            if (Fabs(s) >= threshold) audible = true;
+        if (audible) {
+            onset = frame;
+            break;
+        }
+    }
+
+    auto const pre_roll = (u32)((f64)audio.sample_rate * k_onset_pre_roll_seconds);
+    return onset > pre_roll ? onset - pre_roll : 0;
+}
+
+constexpr f64 k_tail_window_seconds = 0.005;
+constexpr f64 k_tail_threshold_relative_to_loudest_window = 1e-7; // power, so -70 dB
+
+u32 DetectAudibleLength(AudioData const& audio) {
+    ZoneScoped;
+    if (!audio.num_frames || !audio.channels) return audio.num_frames;
+
+    auto const window_frames = Max((u32)((f64)audio.sample_rate * k_tail_window_seconds), 1u);
+    auto const num_windows = (audio.num_frames + window_frames - 1) / window_frames;
+
+    // The mean power of the window around its mean, taking the loudest channel.
+    auto const window_power = [&](u32 window) {
+        auto const start = window * window_frames;
+        auto const end = Min(start + window_frames, audio.num_frames);
+        auto const n = (f64)(end - start);
+        f64 power = 0;
+        for (auto const channel : Range(audio.channels)) {
+            f64 sum = 0;
+            f64 sum_of_squares = 0;
+            for (auto frame = start; frame < end; ++frame) {
+                auto const s = (f64)audio.interleaved_samples[(frame * audio.channels) + channel];
+                sum += s;
+                sum_of_squares += s * s;
+            }
+            auto const mean = sum / n;
+            power = Max(power, (sum_of_squares / n) - (mean * mean));
+        }
+        return power;
+    };
+
+    // One pass, measuring each window once. The end is just after the last window that's within the
+    // threshold of the loudest. Whenever a new loudest window is found, the end can't be before it, so the
+    // windows before it need no further thought.
+    f64 loudest = 0;
+    u32 end_window = 0;
+    for (auto const window : Range(num_windows)) {
+        auto const power = window_power(window);
+        if (power > loudest) {
+            loudest = power;
+            end_window = window + 1;
+        } else if (power >= loudest * k_tail_threshold_relative_to_loudest_window) {
+            end_window = window + 1;
+        }
+    }
+    if (loudest == 0) return audio.num_frames;
+
+    return Min(end_window * window_frames, audio.num_frames);
+}
+
 //=================================================
 //  _______        _
 // |__   __|      | |
@@ -335,4 +418,159 @@ TEST_CASE(TestAudioFormats) {
     return k_success;
 }
 
-TEST_REGISTRATION(FloeAudioFormatTests) { REGISTER_TEST(TestAudioFormats); }
+TEST_CASE(TestOnsetDetection) {
+    constexpr f32 k_sample_rate = 44100;
+    constexpr u32 k_num_frames = 4000;
+    auto const pre_roll = (u32)((f64)k_sample_rate * k_onset_pre_roll_seconds);
+
+    auto make_audio = [&](u8 channels, auto sample_at) {
+        auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames * channels);
+        for (auto const frame : Range(k_num_frames))
+            for (auto const channel : Range(channels))
+                samples[(frame * channels) + channel] = sample_at(frame, channel);
+        return AudioData {
+            .channels = channels,
+            .sample_rate = k_sample_rate,
+            .num_frames = k_num_frames,
+            .interleaved_samples = samples,
+        };
+    };
+    auto sine = [](u32 frame) { return Sin((f32)frame * 0.05f); };
+
+    SUBCASE("silence is not trimmed") {
+        CHECK_EQ(DetectOnsetFrame(make_audio(1, [](u32, u32) { return 0.0f; })), 0u);
+    }
+
+    SUBCASE("sound from the start") {
+        CHECK_EQ(DetectOnsetFrame(make_audio(2, [&](u32 frame, u32) { return sine(frame + 1); })), 0u);
+    }
+
+    SUBCASE("silent lead-in") {
+        constexpr u32 k_onset = 1000;
+        auto const audio = make_audio(1, [&](u32 frame, u32) {
+            return frame >= k_onset ? sine(frame - k_onset + 1) : 0.0f;
+        });
+        CHECK_EQ(DetectOnsetFrame(audio), k_onset - pre_roll);
+    }
+
+    SUBCASE("noise floor below the threshold is lead-in") {
+        constexpr u32 k_onset = 2500;
+        auto seed = SeedFromTime();
+        auto const audio = make_audio(1, [&](u32 frame, u32) {
+            if (frame >= k_onset) return 0.8f;
+            return (RandomFloat01<f32>(seed) - 0.5f) * 0.002f;
+        });
+        CHECK_EQ(DetectOnsetFrame(audio), k_onset - pre_roll);
+    }
+
+    SUBCASE("onset in only one channel") {
+        constexpr u32 k_onset = 300;
+        auto const audio = make_audio(2, [&](u32 frame, u32 channel) {
+            return (channel == 1 && frame >= k_onset) ? sine(frame - k_onset + 1) : 0.0f;
+        });
+        CHECK_EQ(DetectOnsetFrame(audio), k_onset - pre_roll);
+    }
+
+    SUBCASE("quiet files use the peak, not an absolute level") {
+        constexpr u32 k_onset = 500;
+        auto const audio = make_audio(1, [&](u32 frame, u32) { return frame >= k_onset ? 0.001f : 0.0f; });
+        CHECK_EQ(DetectOnsetFrame(audio), k_onset - pre_roll);
+    }
+
+    SUBCASE("onset within the pre-roll clamps to the start") {
+        auto const audio = make_audio(1, [&](u32 frame, u32) { return frame >= 10 ? 0.5f : 0.0f; });
+        CHECK_EQ(DetectOnsetFrame(audio), 0u);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestAudibleLengthDetection) {
+    constexpr f32 k_sample_rate = 44100;
+    auto seed = SeedFromTime();
+
+    // Stereo noise that decays exponentially to decay_db at decay_frames, followed by whatever tail is given.
+    auto make_audio = [&](u32 num_frames, u32 decay_frames, f32 decay_db, auto tail_sample) {
+        auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(num_frames * 2);
+        for (auto const frame : Range(num_frames)) {
+            for (auto const channel : Range(2u)) {
+                auto& s = samples[(frame * 2) + channel];
+                if (frame < decay_frames) {
+                    auto const gain = DbToAmp(decay_db * ((f32)frame / (f32)decay_frames));
+                    s = (RandomFloat01<f32>(seed) - 0.5f) * gain;
+                } else {
+                    s = tail_sample();
+                }
+            }
+        }
+        return AudioData {
+            .channels = 2,
+            .sample_rate = k_sample_rate,
+            .num_frames = num_frames,
+            .interleaved_samples = samples,
+        };
+    };
+
+    // The energy that would be lost by trimming, relative to the total.
+    auto trimmed_energy_db = [](AudioData const& audio, u32 audible_num_frames) {
+        f64 total = 0;
+        f64 trimmed = 0;
+        for (auto const [i, s] : Enumerate<u32>(audio.interleaved_samples)) {
+            total += (f64)s * (f64)s;
+            if (i / audio.channels >= audible_num_frames) trimmed += (f64)s * (f64)s;
+        }
+        return trimmed == 0 ? -1000.0 : 10 * Log10(trimmed / total);
+    };
+
+    SUBCASE("sound until the end is not trimmed") {
+        auto const audio = make_audio(20000, 20000, -20, [] { return 0.0f; });
+        CHECK_EQ(DetectAudibleLength(audio), audio.num_frames);
+    }
+
+    SUBCASE("silent audio is not trimmed") {
+        auto const audio = make_audio(5000, 0, 0, [] { return 0.0f; });
+        CHECK_EQ(DetectAudibleLength(audio), audio.num_frames);
+    }
+
+    SUBCASE("silent tail") {
+        constexpr u32 k_decay_frames = 22050;
+        auto const audio = make_audio(k_decay_frames * 3, k_decay_frames, -60, [] { return 0.0f; });
+        auto const length = DetectAudibleLength(audio);
+        CHECK_GT(length, k_decay_frames - 1000);
+        CHECK_LT(length, k_decay_frames + 1000);
+        CHECK_LT(trimmed_energy_db(audio, length), -60.0);
+    }
+
+    SUBCASE("noise floor and dc offset are trimmed") {
+        constexpr u32 k_decay_frames = 30000;
+        auto const audio = make_audio(k_decay_frames * 4, k_decay_frames, -60, [&] {
+            return 0.01f + ((RandomFloat01<f32>(seed) - 0.5f) * DbToAmp(-95.0f));
+        });
+        auto const length = DetectAudibleLength(audio);
+        CHECK_GT(length, k_decay_frames - 2000);
+        CHECK_LT(length, k_decay_frames + 1000);
+    }
+
+    SUBCASE("a long decay is trimmed where it becomes inaudible") {
+        // Decays by 120 dB over the whole length, so the second half is more than 60 dB down.
+        constexpr u32 k_num_frames = (u32)k_sample_rate * 4;
+        auto const audio = make_audio(k_num_frames, k_num_frames, -120, [] { return 0.0f; });
+        auto const length = DetectAudibleLength(audio);
+        CHECK_GT(length, k_num_frames / 2);
+        CHECK_LT(length, k_num_frames * 2 / 3);
+        auto const error_db = trimmed_energy_db(audio, length);
+        tester.log.DebugLn("Long decay trimmed to {} of {} frames, energy lost {.1} dB",
+                           length,
+                           k_num_frames,
+                           error_db);
+        CHECK_LT(error_db, -60.0);
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeAudioFormatTests) {
+    REGISTER_TEST(TestAudioFormats);
+    REGISTER_TEST(TestOnsetDetection);
+    REGISTER_TEST(TestAudibleLengthDetection);
+}
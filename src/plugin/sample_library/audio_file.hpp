@@ -19,3 +19,14 @@ inline ErrorCodeCategory const& ErrorCategoryForEnum(AudioFileError) { return au
 
 // reader is used to get the file data, not the path argument
 ErrorCodeOr<AudioData> DecodeAudioFile(Reader& reader, String filepath_for_id, Allocator& allocator);
+
+// Finds where the sound actually starts, for skipping the silent or near-silent lead-in that many recordings
+// have. The threshold is relative to the peak of the whole file, so this reads all of the audio. Returns a
+// frame slightly before the onset so that the attack isn't clipped, or 0 if the audio is silent.
+u32 DetectOnsetFrame(AudioData const& audio);
+
+// Finds where the sound actually ends, for trimming the silent tail, noise floor or DC offset that recordings
+// and especially impulse responses often have. Works on short windows, each measured around its own mean so
+// that DC doesn't count as sound, and treats windows more than 70 dB below the loudest one as inaudible.
+// Returns num_frames if there's nothing to trim.
+u32 DetectAudibleLength(AudioData const& audio);
@@ -38,6 +38,7 @@ enum class TriggerEvent { NoteOn, NoteOff, Count };
 // start and end can be negative meaning they're indexed from the end of the sample.
 // e.g. -1 == num_frames, -2 == (num_frames - 1), etc.
 struct Loop {
+    bool operator==(Loop const& other) const = default;
     s64 start_frame {};
     s64 end_frame {};
     u32 crossfade_frames {};
@@ -46,12 +47,14 @@ struct Loop {
 
 struct Region {
     struct File {
+        bool operator==(File const& other) const = default;
         String path {};
         u8 root_key {};
         Optional<Loop> loop {};
     };
 
     struct TriggerCriteria {
+        bool operator==(TriggerCriteria const& other) const = default;
         TriggerEvent event {TriggerEvent::NoteOn};
         Range key_range {0, 128};
         Range velocity_range {0, 100};
@@ -59,13 +62,17 @@ struct Region {
     };
 
     struct Options {
+        bool operator==(Options const& other) const = default;
         Optional<Range> timbre_crossfade_region {};
         bool feather_overlapping_velocity_regions {};
+        bool trim_lead_in {}; // start playback at the detected onset rather than frame 0
 
         // private
         Optional<String> auto_map_key_range_group {};
     };
 
+    bool operator==(Region const& other) const = default;
+
     File file {};
     TriggerCriteria trigger {};
     Options options {};
@@ -81,8 +88,10 @@ struct Instrument {
     Optional<String> description {};
     Span<String> tags {};
     String audio_file_path_for_waveform {};
-    Span<Region> regions {};
+    Span<Region> regions {}; // empty until materialised if the library was read with Options::headers_only
     usize regions_allocated_capacity {}; // private
+    u32 num_regions {};
+    u32 index_in_file {}; // private
 
     u32 max_rr_pos {};
 };
@@ -100,9 +109,19 @@ struct MdataSpecifics {
     String string_pool {};
     u64 file_data_pool_offset {}; // byte offset within the whole file
     Span<u8 const> file_data {}; // if the file from in-memory
+
+    // Only kept if the library was read with Options::headers_only, for materialising instruments.
+    Span<mdata::InstrumentInfo> inst_infos {};
+    Span<mdata::ExtendedInstrumentInfo> ex_inst_infos {};
+    u64 sampler_region_infos_offset {}; // byte offset within the whole file
+    u64 sampler_region_infos_size {};
+    u64 file_size {}; // when it was read, to tell if it's changed since
+    s64 file_last_write_time {};
 };
 
-struct LuaSpecifics {};
+struct LuaSpecifics {
+    String source_code {}; // only kept if the library was read with Options::headers_only
+};
 
 using FileFormatSpecifics = TaggedUnion<FileFormat,
                                         TypeAndTag<MdataSpecifics, FileFormat::Mdata>,
@@ -122,10 +141,16 @@ struct Library {
     u64 file_hash {};
     ErrorCodeOr<Reader> (*create_file_reader)(Library const&, String path) {};
     FileFormatSpecifics file_format_specifics;
+    bool headers_only {};
 };
 
-// only honoured by the lua system
 struct Options {
+    // Only record the library and the instrument headers; each instrument's regions are built when it's
+    // passed to MaterialiseInstrument. Libraries can have thousands of instruments, but a session only
+    // uses a few of them.
+    bool headers_only = false;
+
+    // only honoured by the lua system
     usize max_memory_allowed = Mb(128);
     f64 max_seconds_allowed = 20;
 };
@@ -173,8 +198,11 @@ LibraryPtrOrError ReadLua(Reader& reader,
                           ArenaAllocator& scatch_arena,
                           Options options = {});
 
-LibraryPtrOrError
-ReadMdata(Reader& reader, String filepath, ArenaAllocator& result_arena, ArenaAllocator& scratch_arena);
+LibraryPtrOrError ReadMdata(Reader& reader,
+                            String filepath,
+                            ArenaAllocator& result_arena,
+                            ArenaAllocator& scratch_arena,
+                            Options options = {});
 
 inline LibraryPtrOrError Read(Reader& reader,
                               FileFormat format,
@@ -183,12 +211,50 @@ inline LibraryPtrOrError Read(Reader& reader,
                               ArenaAllocator& scatch_arena,
                               Options options = {}) {
     switch (format) {
-        case FileFormat::Mdata: return ReadMdata(reader, filepath, result_arena, scatch_arena);
+        case FileFormat::Mdata: return ReadMdata(reader, filepath, result_arena, scatch_arena, options);
         case FileFormat::Lua: return ReadLua(reader, filepath, result_arena, scatch_arena, options);
     }
     PanicIfReached();
 }
 
+// Instruments materialised with the same cache share the work of reading their library again: a Lua
+// library's script is run once per cache rather than once per instrument. Use one for a batch of instruments,
+// such as a loading pass, and then throw it away. A library that's read again, as happens when it's
+// rescanned, is a different Library so it's never confused with what's cached.
+struct MaterialiseCache {
+    struct LuaLibrary {
+        Library const* headers;
+        Library const* full;
+        LuaLibrary* next;
+    };
+
+    ArenaAllocator arena {PageAllocator::Instance()};
+    LuaLibrary* lua_libraries {};
+};
+
+ErrorCodeOr<Instrument const*>
+MaterialiseMdataInstrument(Instrument const& inst, ArenaAllocator& arena, ArenaAllocator& scratch_arena);
+ErrorCodeOr<Instrument const*> MaterialiseLuaInstrument(Instrument const& inst,
+                                                        ArenaAllocator& arena,
+                                                        ArenaAllocator& scratch_arena,
+                                                        MaterialiseCache* cache);
+
+// Returns the instrument with all of its regions. If the library was read with Options::headers_only, that's
+// a new instrument allocated in arena, which shares the header's strings but not its regions. Otherwise it's
+// the instrument itself.
+inline ErrorCodeOr<Instrument const*> MaterialiseInstrument(Instrument const& inst,
+                                                            ArenaAllocator& arena,
+                                                            ArenaAllocator& scratch_arena,
+                                                            MaterialiseCache* cache = nullptr) {
+    if (!inst.library.headers_only) return &inst;
+    switch (inst.library.file_format_specifics.tag) {
+        case FileFormat::Mdata: return MaterialiseMdataInstrument(inst, arena, scratch_arena);
+        case FileFormat::Lua: return MaterialiseLuaInstrument(inst, arena, scratch_arena, cache);
+    }
+    PanicIfReached();
+    return {};
+}
+
 ErrorCodeOr<void> WriteDocumentedLuaExample(Writer writer);
 
 } // namespace sample_lib
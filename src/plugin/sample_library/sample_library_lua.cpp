@@ -78,6 +78,11 @@ struct LuaState {
     Options const& options;
     TimePoint const start_time;
     String filepath;
+
+    // Set when materialising an instrument of a library that was read with Options::headers_only: the script
+    // is run again but only this instrument keeps its regions.
+    Optional<String> only_regions_of_instrument {};
+    bool discarding_values {}; // interpreting something that isn't kept, so strings go into lua_arena
 };
 
 #define SET_FIELD_VALUE_ARGS                                                                                 \
@@ -234,7 +239,8 @@ static void IterateTableAtTop(LuaState& ctx, auto&& table_pair_callback) {
 }
 
 static String StringFromTop(LuaState& ctx) {
-    return ctx.result_arena.Clone(FromNullTerminated(luaL_checkstring(ctx.lua, -1)));
+    auto& arena = ctx.discarding_values ? ctx.lua_arena : ctx.result_arena;
+    return arena.Clone(FromNullTerminated(luaL_checkstring(ctx.lua, -1)));
 }
 
 template <typename Type>
@@ -384,6 +390,7 @@ struct TableFields<Region::Options> {
         TimbreCrossfadeRegion,
         AutoMapKeyRangeGroup,
         FeatherOverlappingVelocityRegions,
+        TrimLeadIn,
         Count,
     };
 
@@ -439,6 +446,17 @@ struct TableFields<Region::Options> {
                             FIELD_OBJ.feather_overlapping_velocity_regions = lua_toboolean(ctx.lua, -1);
                         },
                 };
+            case Field::TrimLeadIn:
+                return {
+                    .name = "trim_lead_in",
+                    .description_sentence =
+                        "Start playback where the sound becomes audible rather than at the very start of the file. Floe finds this point when the audio file is loaded. Useful for recordings that have a short silence before the sound begins, since that silence delays every note.",
+                    .example = "true",
+                    .default_value = "false",
+                    .lua_type = LUA_TBOOLEAN,
+                    .required = false,
+                    .set = [](SET_FIELD_VALUE_ARGS) { FIELD_OBJ.trim_lead_in = lua_toboolean(ctx.lua, -1); },
+                };
             case Field::Count: break;
         }
         return {};
@@ -959,23 +977,37 @@ static int AddRegion(lua_State* lua) {
     auto instrument = LuaCheckUserdata<Instrument>(lua, 1, UserdataTypes::Instrument);
     luaL_checktype(lua, 2, LUA_TTABLE);
 
-    auto dyn_array = DynamicArray<Region>::FromOwnedSpan(instrument->regions,
-                                                         instrument->regions_allocated_capacity,
-                                                         ctx.result_arena);
-    dyn::Resize(dyn_array, dyn_array.size + 1);
-    instrument->regions_allocated_capacity = dyn_array.Capacity();
-    auto [span, cap] = dyn_array.ToOwnedSpanUnchangedCapacity();
-    instrument->regions = span;
-    instrument->regions_allocated_capacity = cap;
-    auto& region = Last(instrument->regions);
+    auto const keep_region =
+        !ctx.options.headers_only &&
+        (!ctx.only_regions_of_instrument || *ctx.only_regions_of_instrument == instrument->name);
+
+    Region discarded_region {};
+    auto region = &discarded_region;
+    if (keep_region) {
+        auto dyn_array = DynamicArray<Region>::FromOwnedSpan(instrument->regions,
+                                                             instrument->regions_allocated_capacity,
+                                                             ctx.result_arena);
+        dyn::Resize(dyn_array, dyn_array.size + 1);
+        instrument->regions_allocated_capacity = dyn_array.Capacity();
+        auto [span, cap] = dyn_array.ToOwnedSpanUnchangedCapacity();
+        instrument->regions = span;
+        instrument->regions_allocated_capacity = cap;
+        region = &Last(instrument->regions);
+    }
 
-    InterpretTable(ctx, 2, region);
+    // A region that isn't kept is still interpreted so that the script is validated in exactly the same way.
+    ctx.discarding_values = !keep_region;
+    DEFER { ctx.discarding_values = false; };
+    InterpretTable(ctx, 2, *region);
+    ++instrument->num_regions;
 
-    if (instrument->audio_file_path_for_waveform.size == 0)
-        instrument->audio_file_path_for_waveform = region.file.path;
+    if (instrument->audio_file_path_for_waveform.size == 0) {
+        instrument->audio_file_path_for_waveform =
+            keep_region ? region->file.path : ctx.result_arena.Clone(region->file.path);
+    }
 
-    if (region.trigger.round_robin_index)
-        instrument->max_rr_pos = Max(instrument->max_rr_pos, *region.trigger.round_robin_index);
+    if (region->trigger.round_robin_index)
+        instrument->max_rr_pos = Max(instrument->max_rr_pos, *region->trigger.round_robin_index);
 
     return 0;
 }
@@ -1057,11 +1089,12 @@ ErrorCodeOr<u64> LuaHash(Reader& reader) {
     return XXH3_64bits(data.data, data.size);
 }
 
-LibraryPtrOrError ReadLua(Reader& reader,
-                          String lua_filepath,
-                          ArenaAllocator& result_arena,
-                          ArenaAllocator& scratch_arena,
-                          Options options) {
+static LibraryPtrOrError ReadLua(Reader& reader,
+                                 String lua_filepath,
+                                 ArenaAllocator& result_arena,
+                                 ArenaAllocator& scratch_arena,
+                                 Options options,
+                                 Optional<String> only_regions_of_instrument) {
     ASSERT(&result_arena != &scratch_arena);
     auto const scratch_cursor = scratch_arena.TotalUsed();
     DEFER { scratch_arena.TryShrinkTotalUsed(scratch_cursor); };
@@ -1073,6 +1106,7 @@ LibraryPtrOrError ReadLua(Reader& reader,
         .options = options,
         .start_time = TimePoint::Now(),
         .filepath = lua_filepath,
+        .only_regions_of_instrument = only_regions_of_instrument,
     };
 
     static constexpr void* (*k_arena_alloc_fuction)(void*, void*, size_t, size_t) =
@@ -1190,6 +1224,12 @@ LibraryPtrOrError ReadLua(Reader& reader,
             });
         }
 
+        if (options.headers_only) {
+            library->headers_only = true;
+            library->file_format_specifics.Get<LuaSpecifics>().source_code =
+                result_arena.Clone(String {(char const*)lua_source_code.data, lua_source_code.size});
+        }
+
         for (auto [key, inst_ptr] : library->insts_by_name) {
             auto& inst = *inst_ptr;
             struct RegionRef {
@@ -1242,6 +1282,68 @@ LibraryPtrOrError ReadLua(Reader& reader,
     }
 }
 
+LibraryPtrOrError ReadLua(Reader& reader,
+                          String lua_filepath,
+                          ArenaAllocator& result_arena,
+                          ArenaAllocator& scratch_arena,
+                          Options options) {
+    return ReadLua(reader, lua_filepath, result_arena, scratch_arena, options, nullopt);
+}
+
+// Runs the script again from the source that we kept.
+static ErrorCodeOr<Library const*> RunScriptAgain(Library const& library,
+                                                  ArenaAllocator& arena,
+                                                  ArenaAllocator& scratch_arena,
+                                                  Optional<String> only_regions_of_instrument) {
+    auto reader = Reader::FromMemory(library.file_format_specifics.Get<LuaSpecifics>().source_code);
+    auto const outcome = ReadLua(reader, library.path, arena, scratch_arena, {}, only_regions_of_instrument);
+    if (outcome.HasError()) return outcome.Error().code;
+    return outcome.Get<Library*>();
+}
+
+ErrorCodeOr<Instrument const*> MaterialiseLuaInstrument(Instrument const& inst,
+                                                        ArenaAllocator& arena,
+                                                        ArenaAllocator& scratch_arena,
+                                                        MaterialiseCache* cache) {
+    auto const& library = inst.library;
+    ASSERT(library.headers_only);
+
+    // Everything the script creates is thrown away apart from this instrument's regions. Unless there's a
+    // cache: then the script's whole library is kept there for the next instrument of this library.
+    ArenaAllocator script_arena {PageAllocator::Instance()};
+    Library const* script_library {};
+    if (cache) {
+        for (auto l = cache->lua_libraries; l; l = l->next)
+            if (l->headers == &library) script_library = l->full;
+        if (!script_library) {
+            script_library = TRY(RunScriptAgain(library, cache->arena, scratch_arena, nullopt));
+            auto const cached = cache->arena.NewUninitialised<MaterialiseCache::LuaLibrary>();
+            PLACEMENT_NEW(cached) MaterialiseCache::LuaLibrary {.headers = &library, .full = script_library};
+            SinglyLinkedListPrepend(cache->lua_libraries, cached);
+        }
+    } else {
+        script_library = TRY(RunScriptAgain(library, script_arena, scratch_arena, inst.name));
+    }
+
+    auto const script_inst = ({
+        auto i = script_library->insts_by_name.Find(inst.name);
+        if (!i) return ErrorCode {CommonError::NotFound};
+        *i;
+    });
+
+    // The script gave a different result to last time, we can't trust the header.
+    if (script_inst->regions.size != inst.num_regions) return ErrorCode {CommonError::FileFormatIsInvalid};
+
+    auto result = arena.NewUninitialised<Instrument>();
+    PLACEMENT_NEW(result) Instrument(inst);
+    result->regions = arena.ShallowClone(script_inst->regions);
+    for (auto& region : result->regions) {
+        region.file.path = arena.Clone(region.file.path);
+        region.options.auto_map_key_range_group = region.options.auto_map_key_range_group.Clone(arena);
+    }
+    return result;
+}
+
 static LibraryPtrOrError ReadLua(String lua_code,
                                  String lua_filepath,
                                  ArenaAllocator& result_arena,
@@ -1722,6 +1824,164 @@ TEST_CASE(TestAutoMapKeyRange) {
     return k_success;
 }
 
+static String SyntheticLibraryLua(ArenaAllocator& arena, u32 num_instruments, u32 num_regions) {
+    return fmt::FormatStringReplace(arena,
+                                    R"aaa(
+    local library = floe.new_library({
+        name = "Lib",
+        tagline = "tagline",
+        author = "Sam",
+        background_image_path = "",
+        icon_image_path = "",
+    })
+    for i = 1, <NUM_INSTRUMENTS> do
+        local instrument = floe.new_instrument(library, {
+            name = "Inst " .. i,
+            tags = { "tag1" },
+            folders = "Folder " .. (i % 10),
+        })
+        for r = 0, <NUM_REGIONS> - 1 do
+            floe.add_region(instrument, {
+                file = {
+                    path = "Inst " .. i .. "/Sample " .. r .. ".flac",
+                    root_key = (r * 7) % 128,
+                    loop = { 100, 2000 + r, 10, false },
+                },
+                trigger_criteria = {
+                    key_range = { r % 120, (r % 120) + 8 },
+                    velocity_range = { (r % 4) * 25, ((r % 4) * 25) + 25 },
+                    round_robin_index = r % 3,
+                },
+                options = {
+                    auto_map_key_range_group = (i % 2 == 0) and ("group " .. (r % 2)) or nil,
+                },
+            })
+        end
+    end
+    return library
+    )aaa",
+                                    ArrayT<fmt::StringReplacement>({
+                                        {"<NUM_INSTRUMENTS>", fmt::IntToString(num_instruments)},
+                                        {"<NUM_REGIONS>", fmt::IntToString(num_regions)},
+                                    }));
+}
+
+TEST_CASE(TestHeadersOnly) {
+    auto& scratch_arena = tester.scratch_arena;
+
+    SUBCASE("materialised instruments are the same as fully read ones") {
+        auto const lua = SyntheticLibraryLua(scratch_arena, 20, 30);
+
+        ArenaAllocator full_arena {PageAllocator::Instance()};
+        auto const full_r = ReadLua(lua, "test.lua", full_arena, scratch_arena);
+        if (auto err = full_r.TryGet<Error>()) tester.log.ErrorLn("Error: {}, {}", err->code, err->message);
+        REQUIRE(!full_r.Is<Error>());
+        auto const& full = *full_r.Get<Library*>();
+        CHECK(!full.headers_only);
+
+        ArenaAllocator headers_arena {PageAllocator::Instance()};
+        auto const headers_r = ReadLua(lua, "test.lua", headers_arena, scratch_arena, {.headers_only = true});
+        if (auto err = headers_r.TryGet<Error>())
+            tester.log.ErrorLn("Error: {}, {}", err->code, err->message);
+        REQUIRE(!headers_r.Is<Error>());
+        auto const& headers = *headers_r.Get<Library*>();
+        CHECK(headers.headers_only);
+
+        REQUIRE_EQ(headers.insts_by_name.size, full.insts_by_name.size);
+        MaterialiseCache cache {};
+        for (auto [name, full_inst_ptr] : full.insts_by_name) {
+            auto const& full_inst = **full_inst_ptr;
+            CAPTURE(full_inst.name);
+
+            ArenaAllocator inst_arena {PageAllocator::Instance()};
+            auto const same = MaterialiseInstrument(full_inst, inst_arena, scratch_arena);
+            REQUIRE(same.HasValue());
+            CHECK(same.Value() == &full_inst);
+
+            auto const header_ptr = headers.insts_by_name.Find(full_inst.name);
+            REQUIRE(header_ptr);
+            auto const& header = **header_ptr;
+            CHECK(header.regions.size == 0);
+            CHECK_EQ(header.num_regions, full_inst.num_regions);
+            CHECK_EQ(header.max_rr_pos, full_inst.max_rr_pos);
+            CHECK_EQ(header.folders, full_inst.folders);
+            CHECK_EQ(header.audio_file_path_for_waveform, full_inst.audio_file_path_for_waveform);
+
+            for (auto const with_cache : Array {false, true}) {
+                CAPTURE(with_cache);
+                auto const materialised =
+                    MaterialiseInstrument(header, inst_arena, scratch_arena, with_cache ? &cache : nullptr);
+                REQUIRE(materialised.HasValue());
+                auto const& inst = *materialised.Value();
+                CHECK(&inst.library == &headers);
+                CHECK_EQ(inst.name, full_inst.name);
+                REQUIRE_EQ(inst.regions.size, full_inst.regions.size);
+                for (auto const i : ::Range(inst.regions.size))
+                    REQUIRE(inst.regions[i] == full_inst.regions[i]);
+            }
+        }
+
+        // The script was only run once for all of them.
+        REQUIRE(cache.lua_libraries);
+        CHECK(cache.lua_libraries->headers == &headers);
+        CHECK(cache.lua_libraries->next == nullptr);
+    }
+
+    SUBCASE("scan time and memory of a large library") {
+        constexpr u32 k_num_instruments = 1000;
+        constexpr u32 k_num_regions = 40;
+        auto const lua = SyntheticLibraryLua(scratch_arena, k_num_instruments, k_num_regions);
+
+        for (auto const headers_only : Array {false, true}) {
+            ArenaAllocator result_arena {PageAllocator::Instance()};
+            Stopwatch const stopwatch;
+            auto const r =
+                ReadLua(lua, "test.lua", result_arena, scratch_arena, {.headers_only = headers_only});
+            auto const seconds = stopwatch.SecondsElapsed();
+            if (auto err = r.TryGet<Error>()) tester.log.ErrorLn("Error: {}, {}", err->code, err->message);
+            REQUIRE(!r.Is<Error>());
+
+            tester.log.DebugLn("{} read of {} instruments with {} regions each: {.1} ms, {} kB kept",
+                               headers_only ? "Headers-only" : "Full",
+                               k_num_instruments,
+                               k_num_regions,
+                               seconds * 1000,
+                               result_arena.TotalUsed() / 1024);
+
+            if (headers_only) {
+                // A headers-only read still has to run the whole script, so it's no quicker than a full
+                // read; what it saves is the memory that's kept.
+                tester.log.DebugLn("Headers-only Lua reads run the whole script: no scan time is saved");
+
+                auto const& library = *r.Get<Library*>();
+                constexpr u32 k_num_to_materialise = 10;
+                for (auto const with_cache : Array {false, true}) {
+                    ArenaAllocator inst_arena {PageAllocator::Instance()};
+                    MaterialiseCache cache {};
+                    Stopwatch const materialise_stopwatch;
+                    for (auto const i : ::Range(k_num_to_materialise)) {
+                        auto const inst =
+                            library.insts_by_name.Find(fmt::Format(scratch_arena, "Inst {}", i + 1));
+                        REQUIRE(inst);
+                        auto const materialised = MaterialiseInstrument(**inst,
+                                                                        inst_arena,
+                                                                        scratch_arena,
+                                                                        with_cache ? &cache : nullptr);
+                        REQUIRE(materialised.HasValue());
+                    }
+                    tester.log.DebugLn("Materialising {} instruments {}: {.1} ms, {} kB",
+                                       k_num_to_materialise,
+                                       with_cache ? "with a cache" : "without a cache",
+                                       materialise_stopwatch.SecondsElapsed() * 1000,
+                                       inst_arena.TotalUsed() / 1024);
+                }
+            }
+        }
+    }
+
+    return k_success;
+}
+
 TEST_CASE(TestBasicFile) {
     auto& arena = tester.scratch_arena;
     ArenaAllocator result_arena {PageAllocator::Instance()};
@@ -2296,4 +2556,5 @@ TEST_REGISTRATION(FloeLibraryLuaTests) {
     REGISTER_TEST(sample_lib::TestIncorrectParameters);
     REGISTER_TEST(sample_lib::TestErrorHandling);
     REGISTER_TEST(sample_lib::TestAutoMapKeyRange);
+    REGISTER_TEST(sample_lib::TestHeadersOnly);
 }
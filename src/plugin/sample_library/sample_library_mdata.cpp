@@ -55,25 +55,262 @@ static String GetString(Library const& library, mdata::StringInPool s) {
                                        s);
 }
 
+// The string's position comes from the file, so it might not be inside the pool.
+static bool StringIsInPool(Library const& library, mdata::StringInPool s) {
+    return (u64)s.offset + s.size <= library.file_format_specifics.Get<MdataSpecifics>().string_pool.size;
+}
+
+// A file that ends before the data that it says it has is invalid.
+static ErrorCodeOr<void> ReadExactly(Reader& reader, void* out, usize size) {
+    if (TRY(reader.Read(out, size)) != size) return ErrorCode(CommonError::FileFormatIsInvalid);
+    return k_success;
+}
+
+static ErrorCodeOr<Reader> CreateMdataSectionReader(Library const& library, u64 offset, u64 size) {
+    auto const& mdata_info = library.file_format_specifics.Get<MdataSpecifics>();
+    if (mdata_info.file_data.size) {
+        if (offset > mdata_info.file_data.size || size > mdata_info.file_data.size - offset)
+            return ErrorCode(CommonError::FileFormatIsInvalid);
+        return Reader::FromMemory(mdata_info.file_data.SubSpan((usize)offset, (usize)size));
+    } else
+        return Reader::FromFileSection(library.path, offset, size);
+}
+
 static ErrorCodeOr<Reader> CreateMdataFileReader(Library const& library, String library_file_path) {
     auto const mdata_info = library.file_format_specifics.Get<MdataSpecifics>();
     auto f = mdata_info.files_by_path.Find(library_file_path);
     if (!f) return ErrorCode {FilesystemError::PathDoesNotExist};
     auto& file = **f;
 
-    auto const read_pos = mdata_info.file_data_pool_offset + file.offset_in_file_data_pool;
-    ASSERT(file.size_bytes > 0);
+    if (file.size_bytes == 0) return ErrorCode(CommonError::FileFormatIsInvalid);
+    return CreateMdataSectionReader(library,
+                                    mdata_info.file_data_pool_offset + file.offset_in_file_data_pool,
+                                    file.size_bytes);
+}
 
-    if (mdata_info.file_data.size) {
-        ASSERT(mdata_info.file_data.size);
-        return Reader::FromMemory(mdata_info.file_data.SubSpan((usize)read_pos, (usize)file.size_bytes));
-    } else {
-        return Reader::FromFileSection(library.path, read_pos, file.size_bytes);
+// In the MDATA format when velocity-feathering was enabled for an instrument, adjacent velocity layers were
+// automatically made to overlap. We recreate that old behaviour here taking into account that now velocity
+// feathering is a per-region setting.
+static ErrorCodeOr<void> FeatherVelocityLayers(Instrument& inst, ArenaAllocator& scratch_arena) {
+    Sort(inst.regions, [](Region const& a, Region const& b) {
+        return a.trigger.velocity_range.start < b.trigger.velocity_range.start;
+    });
+
+    for (auto const rr_group : ::Range(inst.max_rr_pos + 1)) {
+        DynamicArray<Region*> group {scratch_arena};
+        for (auto& region : inst.regions)
+            if (!region.trigger.round_robin_index || region.trigger.round_robin_index.Value() == rr_group)
+                dyn::Append(group, &region);
+
+        DynamicArray<DynamicArray<Region*>> key_range_bins {scratch_arena};
+        for (auto& region : group) {
+            bool put_in_bin = false;
+            for (auto& bin : key_range_bins) {
+                if (region->trigger.key_range == bin[0]->trigger.key_range) {
+                    dyn::Append(bin, region);
+                    put_in_bin = true;
+                    break;
+                }
+            }
+            if (!put_in_bin) {
+                DynamicArray<Region*> bin {scratch_arena};
+                dyn::Append(bin, region);
+                dyn::Emplace(key_range_bins, Move(bin));
+            }
+        }
+
+        constexpr f32 k_overlap_percent = 0.35f;
+        for (auto& regions : key_range_bins) {
+            if (regions.size == 1) continue;
+
+            // I don't know why this is the case, but some in-development MDATAs have this region range,
+            // let's just skip it for now because library development will transition to the Lua format
+            // anyways.
+            if (regions[0]->trigger.key_range == Range {1, 2}) continue;
+
+            DynamicArray<Range> new_ranges {scratch_arena};
+
+            for (auto const i : ::Range(regions.size)) {
+                auto& region = regions[i];
+
+                Range new_range {region->trigger.velocity_range.start,
+                                 region->trigger.velocity_range.end};
+
+                if (i != 0) {
+                    auto const& prev_region = regions[i - 1];
+                    if (prev_region->trigger.velocity_range.end == region->trigger.velocity_range.start) {
+                        auto const delta =
+                            (u8)(prev_region->trigger.velocity_range.Size() * k_overlap_percent);
+                        if (new_range.start <= delta) return ErrorCode(CommonError::FileFormatIsInvalid);
+                        new_range.start -= delta;
+                    }
+                }
+
+                if (i != (regions.size - 1)) {
+                    auto const& next_region = regions[i + 1];
+                    if (next_region->trigger.velocity_range.start == region->trigger.velocity_range.end) {
+                        auto const delta =
+                            (s8)(next_region->trigger.velocity_range.Size() * k_overlap_percent);
+                        if (new_range.end >= 100) return ErrorCode(CommonError::FileFormatIsInvalid);
+                        new_range.end += delta;
+                    }
+                }
+
+                dyn::Append(new_ranges, new_range);
+            }
+
+            auto regions_it = regions.begin();
+            auto new_ranges_it = new_ranges.begin();
+            for (; regions_it != regions.end() && new_ranges_it != new_ranges.end();
+                 ++regions_it, ++new_ranges_it)
+                (*regions_it)->trigger.velocity_range = *new_ranges_it;
+
+            for (auto const vel : ::Range((u8)100)) {
+                int num = 0;
+                for (auto region : regions)
+                    if (region->trigger.velocity_range.Contains(vel)) ++num;
+                if (num > 2) return ErrorCode(CommonError::FileFormatIsInvalid);
+            }
+        }
+    }
+    return k_success;
+}
+
+// The infos come straight from the file, so every index and count in them is checked before it's used.
+static ErrorCodeOr<void> BuildRegions(Instrument& inst,
+                                      mdata::InstrumentInfo const& i,
+                                      Span<mdata::ExtendedInstrumentInfo const> ex_inst_infos,
+                                      Span<mdata::SamplerRegionInfo const> sampler_region_infos,
+                                      ArenaAllocator& arena,
+                                      ArenaAllocator& scratch_arena) {
+    auto const& mdata_info = inst.library.file_format_specifics.Get<MdataSpecifics>();
+
+    bool velocity_layers_are_feathered =
+        false; // velocity layer feathering used to be instrument wide rather than per-region
+    auto trigger_event = TriggerEvent::NoteOn;
+    auto groups_are_xfade_layers = false;
+    for (auto const& i_ex : ex_inst_infos) {
+        if (i_ex.inst_index == i.index) {
+            if (i_ex.flags & mdata::InstExtendedFlagsGroupsAreXfadeLayers) groups_are_xfade_layers = true;
+            if (i_ex.flags & mdata::InstExtendedFlagsFeatherVelocityLayers)
+                velocity_layers_are_feathered = true;
+            if (i_ex.flags & mdata::InstExtendedFlagsTriggerOnRelease)
+                trigger_event = TriggerEvent::NoteOff;
+        }
+    }
+
+    u32 max_rr_pos = 0;
+
+    if (i.num_groups < 0 || i.num_groups > mdata::k_max_groups_in_inst || i.total_num_regions < 0 ||
+        (usize)i.total_num_regions > sampler_region_infos.size)
+        return ErrorCode(CommonError::FileFormatIsInvalid);
+
+    inst.regions = arena.AllocateExactSizeUninitialised<Region>((usize)i.total_num_regions);
+    usize regions_span_index = 0;
+    for (auto [group_index, group_info] : Enumerate(i.Groups())) {
+        if (group_index != (usize)group_info.index) return ErrorCode(CommonError::FileFormatIsInvalid);
+        // Each round-robin position is a group, so there can't be more of them than there are groups.
+        if (group_info.round_robin_or_xfade_index < mdata::k_no_round_robin_or_xfade ||
+            group_info.round_robin_or_xfade_index >= mdata::k_max_groups_in_inst)
+            return ErrorCode(CommonError::FileFormatIsInvalid);
+
+        for (auto [region_index, region_info] : Enumerate<mdata::Index>(sampler_region_infos)) {
+            if (region_info.inst_info_index != i.index) continue;
+            if (region_info.group_index != group_info.index) continue;
+
+            if (regions_span_index == inst.regions.size) return ErrorCode(CommonError::FileFormatIsInvalid);
+            if (region_info.file_info_index < 0 ||
+                (usize)region_info.file_info_index >= mdata_info.file_infos.size)
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+            auto const file_info = mdata_info.file_infos[(usize)region_info.file_info_index];
+            if (region_info.loop_end > (s32)file_info.num_frames)
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+            if (region_info.root_note < 0 || region_info.low_note < 0 ||
+                region_info.low_note > region_info.high_note || region_info.high_velo < 1 ||
+                region_info.low_velo > region_info.high_velo)
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+            if ((region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopAnyRegion ||
+                 region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopSetRegion) &&
+                (region_info.loop_start < 0 || region_info.loop_start > region_info.loop_end ||
+                 region_info.loop_crossfade < 0))
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+            if (groups_are_xfade_layers && group_info.round_robin_or_xfade_index != 0 &&
+                group_info.round_robin_or_xfade_index != 1)
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+
+            if (!StringIsInPool(inst.library, file_info.virtual_filepath))
+                return ErrorCode(CommonError::FileFormatIsInvalid);
+            auto const file_path = GetString(inst.library, file_info.virtual_filepath);
+            if (i.sampler_region_index_for_gui_waveform == region_index)
+                inst.audio_file_path_for_waveform = file_path;
+
+            if (group_info.round_robin_or_xfade_index > (s32)max_rr_pos)
+                max_rr_pos = CheckedCast<u32>(group_info.round_robin_or_xfade_index);
+
+            inst.regions[regions_span_index++] = Region {
+                .file =
+                    {
+                        .path = file_path,
+                        .root_key = CheckedCast<u8>(region_info.root_note),
+                        .loop = ({
+                            Optional<Loop> l {};
+                            constexpr bool k_ping_pong = false; // MDATA didn't allow ping pong loops
+                            if (region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopAnyRegion ||
+                                region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopSetRegion) {
+                                l = Loop {.start_frame = region_info.loop_start,
+                                          .end_frame = region_info.loop_end,
+                                          .crossfade_frames =
+                                              CheckedCast<u32>(region_info.loop_crossfade),
+                                          .ping_pong = k_ping_pong};
+                            } else if (region_info.looping_mode ==
+                                       mdata::SampleLoopingModeAlwaysLoopWholeRegion)
+                                l = Loop {0, file_info.num_frames, 0, k_ping_pong};
+                            l;
+                        }),
+                    },
+                .trigger =
+                    {
+                        .event = trigger_event,
+                        .key_range = {CheckedCast<u8>(region_info.low_note),
+                                      CheckedCast<u8>((int)region_info.high_note + 1)},
+                        .velocity_range =
+                            ConvertVelocityToStartEndRange(region_info.low_velo, region_info.high_velo),
+                        .round_robin_index = ({
+                            Optional<u32> rr {};
+                            if (!groups_are_xfade_layers &&
+                                group_info.round_robin_or_xfade_index != mdata::k_no_round_robin_or_xfade)
+                                rr = CheckedCast<u32>(group_info.round_robin_or_xfade_index);
+                            rr;
+                        }),
+                    },
+                .options =
+                    {
+                        .timbre_crossfade_region = ({
+                            Optional<Range> r {};
+                            if (groups_are_xfade_layers) {
+                                switch (group_info.round_robin_or_xfade_index) {
+                                    case 0: r = Range {0, 90}; break;
+                                    case 1: r = Range {10, 100}; break;
+                                    default: PanicIfReached();
+                                }
+                            }
+                            r;
+                        }),
+                        .feather_overlapping_velocity_regions = velocity_layers_are_feathered,
+                    },
+            };
+        }
     }
+    if (regions_span_index != inst.regions.size) return ErrorCode(CommonError::FileFormatIsInvalid);
+
+    inst.max_rr_pos = max_rr_pos;
+
+    if (velocity_layers_are_feathered) TRY(FeatherVelocityLayers(inst, scratch_arena));
+    return k_success;
 }
 
 static ErrorCodeOr<Library*>
-ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& reader) {
+ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& reader, Options const& options) {
     static_assert(k_endianness == Endianness::Little);
     reader.pos = 0;
 
@@ -82,27 +319,31 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
     Library {
         .create_file_reader = CreateMdataFileReader,
         .file_format_specifics = MdataSpecifics {},
+        .headers_only = options.headers_only,
     };
     auto& library = *library_ptr;
     auto& mdata_info = library.file_format_specifics.Get<MdataSpecifics>();
 
     {
         mdata::MasterHeader header;
-        TRY(reader.Read(&header, sizeof(mdata::MasterHeader)));
+        TRY(ReadExactly(reader, &header, sizeof(mdata::MasterHeader)));
         if (header.id_magic != mdata::HeaderIdMasterMagic) return ErrorCode(CommonError::FileFormatIsInvalid);
+        if (!Contains(header.name, '\0')) return ErrorCode(CommonError::FileFormatIsInvalid);
         library.name = arena.Clone(header.Name());
         library.minor_version = header.version;
     }
 
     {
         mdata::ChunkHeader info_header;
-        TRY(reader.Read(&info_header, sizeof(mdata::ChunkHeader)));
-        if (info_header.size_bytes_of_following_data == 0) return ErrorCode(CommonError::FileFormatIsInvalid);
+        TRY(ReadExactly(reader, &info_header, sizeof(mdata::ChunkHeader)));
+        if (info_header.size_bytes_of_following_data <= 0 ||
+            (usize)info_header.size_bytes_of_following_data > reader.size - reader.pos)
+            return ErrorCode(CommonError::FileFormatIsInvalid);
         if (info_header.id != mdata::HeaderIdInfoJson) return ErrorCode(CommonError::FileFormatIsInvalid);
 
         DynamicArray<char> json_string {scratch_arena};
         dyn::Resize(json_string, (usize)info_header.size_bytes_of_following_data);
-        TRY(reader.Read(json_string.data, (usize)info_header.size_bytes_of_following_data));
+        TRY(ReadExactly(reader, json_string.data, (usize)info_header.size_bytes_of_following_data));
 
         using namespace json;
 
@@ -144,18 +385,31 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
                             },
                             scratch_arena,
                             {});
-        ASSERT(parsed.Succeeded());
+        if (!parsed.Succeeded()) return ErrorCode(CommonError::FileFormatIsInvalid);
     }
 
     Span<mdata::ExtendedInstrumentInfo> ex_inst_infos {};
     Span<mdata::InstrumentInfo> inst_infos {};
     Span<mdata::SamplerRegionInfo> sampler_region_infos {};
 
+    // When only reading the headers, the instrument infos are kept for materialising and the region infos
+    // are read again from the file at that point.
+    auto& inst_infos_arena = options.headers_only ? arena : scratch_arena;
+
     while (reader.pos < reader.size) {
         mdata::ChunkHeader header;
-        TRY(reader.Read(&header, sizeof(mdata::ChunkHeader)));
+        TRY(ReadExactly(reader, &header, sizeof(mdata::ChunkHeader)));
         if (header.size_bytes_of_following_data <= 0) continue;
         auto const size_bytes_of_following_data = (u64)header.size_bytes_of_following_data;
+        if (size_bytes_of_following_data > reader.size - reader.pos)
+            return ErrorCode(CommonError::FileFormatIsInvalid);
+
+        // The arrays must be whole numbers of their elements, and the strings they refer to must already
+        // have been read.
+        auto const is_array_of = [&](usize element_size, bool uses_string_pool) {
+            return size_bytes_of_following_data % element_size == 0 &&
+                   (!uses_string_pool || mdata_info.string_pool.size != 0);
+        };
 
         switch (header.id) {
             case mdata::HeaderIdInfoJson: {
@@ -166,7 +420,7 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
             case mdata::HeaderIdStringPool: {
                 mdata_info.string_pool =
                     arena.AllocateExactSizeUninitialised<char>(size_bytes_of_following_data);
-                TRY(reader.Read((char*)mdata_info.string_pool.data, size_bytes_of_following_data));
+                TRY(ReadExactly(reader, (char*)mdata_info.string_pool.data, size_bytes_of_following_data));
                 break;
             }
 
@@ -176,48 +430,68 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
             }
 
             case mdata::HeaderIdInstrumentInfoArray: {
-                ASSERT(mdata_info.string_pool.size != 0); // string pool must be first
+                if (!is_array_of(sizeof(mdata::InstrumentInfo), true))
+                    return ErrorCode(CommonError::FileFormatIsInvalid);
                 auto num_insts = size_bytes_of_following_data / sizeof(mdata::InstrumentInfo);
-                inst_infos = scratch_arena.AllocateExactSizeUninitialised<mdata::InstrumentInfo>(num_insts);
-                TRY(reader.Read(inst_infos.data, size_bytes_of_following_data));
+                inst_infos =
+                    inst_infos_arena.AllocateExactSizeUninitialised<mdata::InstrumentInfo>(num_insts);
+                TRY(ReadExactly(reader, inst_infos.data, size_bytes_of_following_data));
+                for (auto const& i : inst_infos)
+                    if (!StringIsInPool(library, i.virtual_filepath) || i.total_num_regions < 0)
+                        return ErrorCode(CommonError::FileFormatIsInvalid);
                 break;
             }
 
             case mdata::HeaderIdExtendedInstrumentInfoArray: {
+                if (!is_array_of(sizeof(mdata::ExtendedInstrumentInfo), false))
+                    return ErrorCode(CommonError::FileFormatIsInvalid);
                 auto num_insts = size_bytes_of_following_data / sizeof(mdata::ExtendedInstrumentInfo);
                 ex_inst_infos =
-                    scratch_arena.AllocateExactSizeUninitialised<mdata::ExtendedInstrumentInfo>(num_insts);
-                TRY(reader.Read(ex_inst_infos.data, size_bytes_of_following_data));
+                    inst_infos_arena.AllocateExactSizeUninitialised<mdata::ExtendedInstrumentInfo>(num_insts);
+                TRY(ReadExactly(reader, ex_inst_infos.data, size_bytes_of_following_data));
                 break;
             }
 
             case mdata::HeaderIdSamplerRegionInfoArray: {
-                ASSERT(mdata_info.string_pool.size != 0); // string pool must be first
+                if (!is_array_of(sizeof(mdata::SamplerRegionInfo), true))
+                    return ErrorCode(CommonError::FileFormatIsInvalid);
                 auto num_samples = size_bytes_of_following_data / sizeof(mdata::SamplerRegionInfo);
 
+                if (options.headers_only) {
+                    mdata_info.sampler_region_infos_offset = reader.pos;
+                    mdata_info.sampler_region_infos_size = num_samples * sizeof(mdata::SamplerRegionInfo);
+                    reader.pos += size_bytes_of_following_data;
+                    break;
+                }
+
                 sampler_region_infos =
                     scratch_arena.AllocateExactSizeUninitialised<mdata::SamplerRegionInfo>(num_samples);
-                TRY(reader.Read(sampler_region_infos.data, size_bytes_of_following_data));
+                TRY(ReadExactly(reader, sampler_region_infos.data, size_bytes_of_following_data));
                 break;
             }
 
             case mdata::HeaderIdFileInfoArray: {
+                if (!is_array_of(sizeof(mdata::FileInfo), true))
+                    return ErrorCode(CommonError::FileFormatIsInvalid);
                 auto num_files = size_bytes_of_following_data / sizeof(mdata::FileInfo);
 
                 mdata_info.file_infos = arena.AllocateExactSizeUninitialised<mdata::FileInfo>(num_files);
-                TRY(reader.Read(mdata_info.file_infos.data, size_bytes_of_following_data));
+                TRY(ReadExactly(reader, mdata_info.file_infos.data, size_bytes_of_following_data));
 
                 for (auto& f : mdata_info.file_infos) {
+                    if (!StringIsInPool(library, f.virtual_filepath) || !StringIsInPool(library, f.name) ||
+                        !StringIsInPool(library, f.name_no_ext))
+                        return ErrorCode(CommonError::FileFormatIsInvalid);
                     auto const path = GetString(library, f.virtual_filepath);
                     if (f.file_type == mdata::FileTypeRawAudioSamples) {
                         // Confusingly, the file extension of raw audio samples was still wav, we amend that
                         // here. There could be various forms of raw samples, but in reality only 1 type was
                         // used.
                         auto ext = path::Extension(path);
-                        ASSERT(ext == ".wav"_s);
-                        ASSERT(f.channels == 2);
-                        ASSERT(f.audio_format == mdata::AudioFileTypeRaw16Pcm);
-                        ASSERT(RoundPositiveFloat(f.sample_rate) == 44100);
+                        if (ext != ".wav"_s || f.channels != 2 ||
+                            f.audio_format != mdata::AudioFileTypeRaw16Pcm ||
+                            !(Fabs(f.sample_rate - 44100) < 0.5f))
+                            return ErrorCode(CommonError::FileFormatIsInvalid);
                         static_assert(".wav"_s.size == k_raw_16_bit_stereo_44100_format_ext.size);
                         CopyStringIntoBufferWithNullTerm(MutableString {(char*)ext.data, ext.size},
                                                          k_raw_16_bit_stereo_44100_format_ext);
@@ -239,14 +513,14 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
                     if (f.file_type == mdata::FileTypeSpecialAudioData) continue;
                     auto const path = GetString(library, f.virtual_filepath);
                     bool const inserted = mdata_info.files_by_path.InsertGrowIfNeeded(arena, path, &f);
-                    ASSERT(inserted);
+                    if (!inserted) return ErrorCode(CommonError::FileFormatIsInvalid);
                 }
 
                 for (auto const& f : mdata_info.file_infos) {
                     if (f.folder_type != mdata::FolderTypeIRs) continue;
                     auto const name = GetString(library, f.name_no_ext);
                     auto const path = GetString(library, f.virtual_filepath);
-                    ASSERT(name.size <= k_max_ir_name_size);
+                    if (name.size > k_max_ir_name_size) return ErrorCode(CommonError::FileFormatIsInvalid);
 
                     auto ir = arena.NewUninitialised<ImpulseResponse>();
                     PLACEMENT_NEW(ir)
@@ -268,6 +542,11 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
         }
     }
 
+    if (options.headers_only) {
+        mdata_info.inst_infos = inst_infos;
+        mdata_info.ex_inst_infos = ex_inst_infos;
+    }
+
     library.insts_by_name = HashTable<String, Instrument*>::Create(arena, inst_infos.size);
     for (auto& i : inst_infos) {
         auto const path = GetString(library, i.virtual_filepath);
@@ -304,226 +583,195 @@ ReadMdataFile(ArenaAllocator& arena, ArenaAllocator& scratch_arena, Reader& read
             .folders = folders.size ? Optional<String>(folders) : nullopt,
         };
 
-        bool velocity_layers_are_feathered =
-            false; // velocity layer feathering used to be instrument wide rather than per-region
-        auto trigger_event = TriggerEvent::NoteOn;
-        auto groups_are_xfade_layers = false;
-        for (auto const& i_ex : ex_inst_infos) {
-            if (i_ex.inst_index == i.index) {
-                if (i_ex.flags & mdata::InstExtendedFlagsGroupsAreXfadeLayers) groups_are_xfade_layers = true;
-                if (i_ex.flags & mdata::InstExtendedFlagsFeatherVelocityLayers)
-                    velocity_layers_are_feathered = true;
-                if (i_ex.flags & mdata::InstExtendedFlagsTriggerOnRelease)
-                    trigger_event = TriggerEvent::NoteOff;
-            }
-        }
+        inst->num_regions = (u32)i.total_num_regions;
+        inst->index_in_file = CheckedCast<u32>(&i - inst_infos.data);
+        if (!options.headers_only)
+            TRY(BuildRegions(*inst, i, ex_inst_infos, sampler_region_infos, arena, scratch_arena));
 
-        u32 max_rr_pos = 0;
-
-        inst->regions = arena.AllocateExactSizeUninitialised<Region>(CheckedCast<usize>(i.total_num_regions));
-        usize regions_span_index = 0;
-        for (auto [group_index, group_info] : Enumerate(i.Groups())) {
-            ASSERT(group_index == (usize)group_info.index);
-
-            for (auto [region_index, region_info] : Enumerate<mdata::Index>(sampler_region_infos)) {
-                if (region_info.inst_info_index != i.index) continue;
-                if (region_info.group_index != group_info.index) continue;
-
-                auto const file_info = mdata_info.file_infos[CheckedCast<usize>(region_info.file_info_index)];
-                ASSERT(region_info.loop_end <= (s32)file_info.num_frames);
-
-                auto const file_path = GetString(library, file_info.virtual_filepath);
-                if (i.sampler_region_index_for_gui_waveform == region_index)
-                    inst->audio_file_path_for_waveform = file_path;
-
-                if (group_info.round_robin_or_xfade_index > (s32)max_rr_pos)
-                    max_rr_pos = CheckedCast<u32>(group_info.round_robin_or_xfade_index);
-
-                inst->regions[regions_span_index++] = Region {
-                    .file =
-                        {
-                            .path = file_path,
-                            .root_key = CheckedCast<u8>(region_info.root_note),
-                            .loop = ({
-                                Optional<Loop> l {};
-                                constexpr bool k_ping_pong = false; // MDATA didn't allow ping pong loops
-                                if (region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopAnyRegion ||
-                                    region_info.looping_mode == mdata::SampleLoopingModeAlwaysLoopSetRegion) {
-                                    l = Loop {.start_frame = region_info.loop_start,
-                                              .end_frame = region_info.loop_end,
-                                              .crossfade_frames =
-                                                  CheckedCast<u32>(region_info.loop_crossfade),
-                                              .ping_pong = k_ping_pong};
-                                } else if (region_info.looping_mode ==
-                                           mdata::SampleLoopingModeAlwaysLoopWholeRegion)
-                                    l = Loop {0, file_info.num_frames, 0, k_ping_pong};
-                                l;
-                            }),
-                        },
-                    .trigger =
-                        {
-                            .event = trigger_event,
-                            .key_range = {CheckedCast<u8>(region_info.low_note),
-                                          CheckedCast<u8>((int)region_info.high_note + 1)},
-                            .velocity_range =
-                                ConvertVelocityToStartEndRange(region_info.low_velo, region_info.high_velo),
-                            .round_robin_index = ({
-                                Optional<u32> rr {};
-                                if (!groups_are_xfade_layers &&
-                                    group_info.round_robin_or_xfade_index != mdata::k_no_round_robin_or_xfade)
-                                    rr = CheckedCast<u32>(group_info.round_robin_or_xfade_index);
-                                rr;
-                            }),
-                        },
-                    .options =
-                        {
-                            .timbre_crossfade_region = ({
-                                Optional<Range> r {};
-                                if (groups_are_xfade_layers) {
-                                    switch (group_info.round_robin_or_xfade_index) {
-                                        case 0: r = Range {0, 90}; break;
-                                        case 1: r = Range {10, 100}; break;
-                                        default: PanicIfReached();
-                                    }
-                                }
-                                r;
-                            }),
-                            .feather_overlapping_velocity_regions = velocity_layers_are_feathered,
-                        },
-                };
-            }
-        }
-        ASSERT((mdata::Index)inst->regions.size == i.total_num_regions);
-
-        inst->max_rr_pos = max_rr_pos;
-
-        ASSERT(name.size <= k_max_instrument_name_size);
+        if (name.size > k_max_instrument_name_size) return ErrorCode(CommonError::FileFormatIsInvalid);
         auto const inserted = library.insts_by_name.InsertWithoutGrowing(name, inst);
         ASSERT(inserted);
     }
 
-    // In the MDATA format when velocity-feathering was enabled for an instrument, adjacent velocity layers
-    // were automatically made to overlap. We recreate that old behaviour here taking into account that now
-    // velocity feathering is a per-region setting.
-    for (auto [key, inst_ptr_ptr] : library.insts_by_name) {
-        auto inst = *inst_ptr_ptr;
-
-        // with MDATA, the velocity feathering feature was instrument-wide rather then per-region so we can
-        // just check the first
-        if (!inst->regions.size || !inst->regions[0].options.feather_overlapping_velocity_regions) continue;
-
-        Sort(inst->regions, [](Region const& a, Region const& b) {
-            return a.trigger.velocity_range.start < b.trigger.velocity_range.start;
-        });
-
-        for (auto const rr_group : ::Range(inst->max_rr_pos + 1)) {
-            DynamicArray<Region*> group {scratch_arena};
-            for (auto& region : inst->regions)
-                if (!region.trigger.round_robin_index || region.trigger.round_robin_index.Value() == rr_group)
-                    dyn::Append(group, &region);
-
-            DynamicArray<DynamicArray<Region*>> key_range_bins {scratch_arena};
-            for (auto& region : group) {
-                bool put_in_bin = false;
-                for (auto& bin : key_range_bins) {
-                    if (region->trigger.key_range == bin[0]->trigger.key_range) {
-                        dyn::Append(bin, region);
-                        put_in_bin = true;
-                        break;
-                    }
-                }
-                if (!put_in_bin) {
-                    DynamicArray<Region*> bin {scratch_arena};
-                    dyn::Append(bin, region);
-                    dyn::Emplace(key_range_bins, Move(bin));
-                }
-            }
-
-            constexpr f32 k_overlap_percent = 0.35f;
-            for (auto& regions : key_range_bins) {
-                if (regions.size == 1) continue;
-
-                // I don't know why this is the case, but some in-development MDATAs have this region range,
-                // let's just skip it for now because library development will transition to the Lua format
-                // anyways.
-                if (regions[0]->trigger.key_range == Range {1, 2}) continue;
-
-                DynamicArray<Range> new_ranges {scratch_arena};
-
-                for (auto const i : ::Range(regions.size)) {
-                    auto& region = regions[i];
-
-                    Range new_range {region->trigger.velocity_range.start,
-                                     region->trigger.velocity_range.end};
-
-                    if (i != 0) {
-                        auto const& prev_region = regions[i - 1];
-                        if (prev_region->trigger.velocity_range.end == region->trigger.velocity_range.start) {
-                            auto const delta =
-                                (u8)(prev_region->trigger.velocity_range.Size() * k_overlap_percent);
-                            ASSERT(new_range.start > delta);
-                            new_range.start -= delta;
-                        }
-                    }
-
-                    if (i != (regions.size - 1)) {
-                        auto const& next_region = regions[i + 1];
-                        if (next_region->trigger.velocity_range.start == region->trigger.velocity_range.end) {
-                            auto const delta =
-                                (s8)(next_region->trigger.velocity_range.Size() * k_overlap_percent);
-                            ASSERT(new_range.end < 100);
-                            new_range.end += delta;
-                        }
-                    }
-
-                    dyn::Append(new_ranges, new_range);
-                }
-
-                auto regions_it = regions.begin();
-                auto new_ranges_it = new_ranges.begin();
-                for (; regions_it != regions.end() && new_ranges_it != new_ranges.end();
-                     ++regions_it, ++new_ranges_it)
-                    (*regions_it)->trigger.velocity_range = *new_ranges_it;
-
-                for (auto const vel : ::Range((u8)100)) {
-                    int num = 0;
-                    for (auto region : regions)
-                        if (region->trigger.velocity_range.Contains(vel)) ++num;
-                    ASSERT(num <= 2);
-                }
-            }
-        }
-    }
-
     return library_ptr;
 }
 
 ErrorCodeOr<u64> MdataHash(Reader& reader) {
     reader.pos = 0;
     mdata::MasterHeader header;
-    TRY(reader.Read(&header, sizeof(mdata::MasterHeader)));
+    TRY(ReadExactly(reader, &header, sizeof(mdata::MasterHeader)));
     if (header.id_magic != mdata::HeaderIdMasterMagic) return ErrorCode(CommonError::FileFormatIsInvalid);
+    if (!Contains(header.name, '\0')) return ErrorCode(CommonError::FileFormatIsInvalid);
     return Hash(header.Name());
 }
 
-LibraryPtrOrError
-ReadMdata(Reader& reader, String filepath, ArenaAllocator& result_arena, ArenaAllocator& scratch_arena) {
+ErrorCodeOr<Instrument const*>
+MaterialiseMdataInstrument(Instrument const& inst, ArenaAllocator& arena, ArenaAllocator& scratch_arena) {
+    auto const& library = inst.library;
+    ASSERT(library.headers_only);
+    auto const& mdata_info = library.file_format_specifics.Get<MdataSpecifics>();
+
+    // The offsets we're about to use are only right for the file as it was when the library was read. If it
+    // has changed since then, the library will be read again; until then it's as good as invalid.
+    if (!mdata_info.file_data.size) {
+        if (TRY(FileSize(library.path)) != mdata_info.file_size ||
+            TRY(LastWriteTime(library.path)) != mdata_info.file_last_write_time)
+            return ErrorCode(CommonError::FileFormatIsInvalid);
+    }
+
+    auto const size = mdata_info.sampler_region_infos_size;
+    auto reader = TRY(CreateMdataSectionReader(library, mdata_info.sampler_region_infos_offset, size));
+    auto sampler_region_infos = scratch_arena.AllocateExactSizeUninitialised<mdata::SamplerRegionInfo>(
+        (usize)size / sizeof(mdata::SamplerRegionInfo));
+    if (TRY(reader.Read(sampler_region_infos.ToByteSpan())) != size)
+        return ErrorCode(CommonError::FileFormatIsInvalid);
+
+    auto result = arena.NewUninitialised<Instrument>();
+    PLACEMENT_NEW(result) Instrument(inst);
+    TRY(BuildRegions(*result,
+                     mdata_info.inst_infos[inst.index_in_file],
+                     mdata_info.ex_inst_infos,
+                     sampler_region_infos,
+                     arena,
+                     scratch_arena));
+    return result;
+}
+
+LibraryPtrOrError ReadMdata(Reader& reader,
+                            String filepath,
+                            ArenaAllocator& result_arena,
+                            ArenaAllocator& scratch_arena,
+                            Options options) {
     auto const scratch_cursor = scratch_arena.TotalUsed();
     DEFER { scratch_arena.TryShrinkTotalUsed(scratch_cursor); };
 
     auto library = ({
-        auto o = ReadMdataFile(result_arena, scratch_arena, reader);
+        auto o = ReadMdataFile(result_arena, scratch_arena, reader, options);
         if (o.HasError()) return Error {o.Error(), {}};
         o.Value();
     });
 
     library->path = String(filepath.Clone(result_arena));
-    if (reader.memory)
-        library->file_format_specifics.Get<MdataSpecifics>().file_data = {reader.memory, reader.size};
+    auto& mdata_info = library->file_format_specifics.Get<MdataSpecifics>();
+    if (reader.memory) {
+        mdata_info.file_data = {reader.memory, reader.size};
+    } else if (options.headers_only) {
+        mdata_info.file_size = reader.size;
+        auto const last_write_time = LastWriteTime(filepath);
+        if (last_write_time.HasError()) return Error {last_write_time.Error(), {}};
+        mdata_info.file_last_write_time = last_write_time.Value();
+    }
 
     return library;
 }
 
+TEST_CASE(TestMdataHeadersOnly) {
+    auto& scratch_arena = tester.scratch_arena;
+    auto const path = path::Join(scratch_arena,
+                                 ConcatArrays(Array {TestFilesFolder(tester)},
+                                              k_repo_subdirs_floe_test_libraries,
+                                              Array {"shared_files_test_lib.mdata"_s}));
+
+    auto const read = [&](ArenaAllocator& result_arena, Options options) -> ErrorCodeOr<Library*> {
+        auto reader = TRY(Reader::FromFile(path));
+        auto const outcome = ReadMdata(reader, path, result_arena, scratch_arena, options);
+        if (outcome.HasError()) return outcome.Error().code;
+        return outcome.Get<Library*>();
+    };
+
+    ArenaAllocator full_arena {PageAllocator::Instance()};
+    auto const& full = *TRY(read(full_arena, {}));
+    ArenaAllocator headers_arena {PageAllocator::Instance()};
+    auto const& headers = *TRY(read(headers_arena, {.headers_only = true}));
+    CHECK(headers.headers_only);
+    CHECK_LT(headers_arena.TotalUsed(), full_arena.TotalUsed());
+
+    REQUIRE(full.insts_by_name.size);
+    REQUIRE_EQ(headers.insts_by_name.size, full.insts_by_name.size);
+    for (auto [name, full_inst_ptr] : full.insts_by_name) {
+        auto const& full_inst = **full_inst_ptr;
+        CAPTURE(full_inst.name);
+
+        auto const header_ptr = headers.insts_by_name.Find(full_inst.name);
+        REQUIRE(header_ptr);
+        auto const& header = **header_ptr;
+        CHECK(header.regions.size == 0);
+        CHECK_EQ(header.num_regions, full_inst.num_regions);
+
+        ArenaAllocator inst_arena {PageAllocator::Instance()};
+        auto const& inst = *TRY(MaterialiseInstrument(header, inst_arena, scratch_arena));
+        CHECK_EQ(inst.max_rr_pos, full_inst.max_rr_pos);
+        CHECK_EQ(inst.audio_file_path_for_waveform, full_inst.audio_file_path_for_waveform);
+        REQUIRE_EQ(inst.regions.size, full_inst.regions.size);
+        for (auto const i : ::Range(inst.regions.size))
+            REQUIRE(inst.regions[i] == full_inst.regions[i]);
+    }
+
+    // The region infos are read again when materialising, so a file that has changed since it was read
+    // mustn't be used.
+    {
+        auto const copy_path =
+            path::Join(scratch_arena, Array {tests::TempFolder(tester), "changed.mdata"_s});
+        TRY(CopyFile(path, copy_path, ExistingDestinationHandling::Overwrite));
+        auto reader = TRY(Reader::FromFile(copy_path));
+        ArenaAllocator copy_arena {PageAllocator::Instance()};
+        auto const outcome = ReadMdata(reader, copy_path, copy_arena, scratch_arena, {.headers_only = true});
+        REQUIRE(!outcome.HasError());
+        auto const& copy = *outcome.Get<Library*>();
+        REQUIRE(copy.insts_by_name.size);
+        auto const& header = **(*copy.insts_by_name.begin()).value_ptr;
+
+        ArenaAllocator inst_arena {PageAllocator::Instance()};
+        CHECK(!MaterialiseInstrument(header, inst_arena, scratch_arena).HasError());
+
+        TRY(AppendFile(copy_path, "changed"_s));
+        auto const materialised = MaterialiseInstrument(header, inst_arena, scratch_arena);
+        REQUIRE(materialised.HasError());
+        CHECK(materialised.Error() == CommonError::FileFormatIsInvalid);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestMdataMalformed) {
+    auto& scratch_arena = tester.scratch_arena;
+    auto const path = path::Join(scratch_arena,
+                                 ConcatArrays(Array {TestFilesFolder(tester)},
+                                              k_repo_subdirs_floe_test_libraries,
+                                              Array {"shared_files_test_lib.mdata"_s}));
+    auto const file = TRY(ReadEntireFile(path, scratch_arena)).ToByteSpan();
+
+    auto const read = [&](Span<u8 const> data) {
+        ArenaAllocator result_arena {PageAllocator::Instance()};
+        auto reader = Reader::FromMemory(data);
+        return ReadMdata(reader, path, result_arena, scratch_arena).HasError();
+    };
+    REQUIRE(!read(file));
+
+    // A file that ends early is invalid wherever it ends, rather than being read past its end.
+    for (auto const size : Array {(usize)0, (usize)10, sizeof(mdata::MasterHeader), (usize)64, file.size / 2})
+        CHECK(read(file.SubSpan(0, size)));
+
+    // Corrupted bytes can be anything, but they mustn't crash us.
+    auto corrupted = scratch_arena.Clone(file);
+    auto seed = (u64)1234;
+    for (auto const attempt : ::Range(200)) {
+        CAPTURE(attempt);
+        CopyMemory(corrupted.data, file.data, file.size);
+        for (auto _ : ::Range(4)) {
+            auto const pos = RandomIntInRange<usize>(seed, 0, file.size - 1);
+            corrupted[pos] = (u8)RandomIntInRange<u32>(seed, 0, 255);
+        }
+        read(corrupted);
+    }
+
+    return k_success;
+}
+
 } // namespace sample_lib
 
-TEST_REGISTRATION(FloeLibraryTests) { REGISTER_TEST(sample_lib::TestConvertVelocityRange); }
+TEST_REGISTRATION(FloeLibraryTests) {
+    REGISTER_TEST(sample_lib::TestConvertVelocityRange);
+    REGISTER_TEST(sample_lib::TestMdataHeadersOnly);
+    REGISTER_TEST(sample_lib::TestMdataMalformed);
+}
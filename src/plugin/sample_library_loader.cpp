@@ -5,15 +5,19 @@
 
 #include "foundation/foundation.hpp"
 #include "os/filesystem.hpp"
+#include "os/misc.hpp"
 #include "os/threading.hpp"
 #include "tests/framework.hpp"
+#include "utils/arena_usage.hpp"
 #include "utils/debug/debug.hpp"
+#include "utils/logger/logger.hpp"
 #include "utils/reader.hpp"
 
 #include "build_resources/embedded_files.h"
 #include "common/common_errors.hpp"
 #include "sample_library/audio_file.hpp"
 #include "sample_library/sample_library.hpp"
+#include "sample_processing.hpp"
 #include "xxhash/xxhash.h"
 
 inline String ToString(EmbeddedString s) { return {s.data, s.size}; }
@@ -103,23 +107,44 @@ ListedInstrument::~ListedInstrument() {
     library_refs.FetchSub(1);
 }
 
+AudioAnalysis detail::FetchOrAnalyseAudio(AudioAnalysisByHash& cache, AudioData const& audio) {
+    auto const cached = cache.Use([&](auto& c) -> Optional<AudioAnalysis> {
+        if (auto const analysis = c.Find(audio.hash)) return *analysis;
+        return nullopt;
+    });
+    if (cached) return *cached;
+
+    AudioAnalysis const analysis {
+        .onset_frame = DetectOnsetFrame(audio),
+    };
+    cache.Use([&](auto& c) { c.Insert(audio.hash, analysis); });
+    return analysis;
+}
+
 struct ThreadPoolContext {
     ThreadPool& pool;
     AtomicCountdown& num_thread_pool_jobs;
     WorkSignaller& completed_signaller;
+    AudioAnalysisByHash& audio_analysis_by_hash;
+    Atomic<bool> const& batched_file_reads;
+    Atomic<bool> const& disk_order_batching;
 };
 
 struct LoadAudioAsyncArgs {
     ListedAudioData& audio_data;
 };
 
+// If file_data is given, it's the whole file already read into memory by the PageAllocator, and it's freed
+// here.
 static void LoadAudioAsync(ListedAudioData& audio_data,
                            sample_lib::Library const& lib,
-                           ThreadPoolContext& thread_pool_ctx) {
+                           ThreadPoolContext& thread_pool_ctx,
+                           Span<u8> file_data = {}) {
     thread_pool_ctx.num_thread_pool_jobs.Increase();
-    thread_pool_ctx.pool.AddJob([&]() {
+    thread_pool_ctx.pool.AddJob([&, file_data]() {
         ZoneScoped;
         DEFER {
+            if (file_data.size) PageAllocator::Instance().Free(file_data);
             thread_pool_ctx.num_thread_pool_jobs.CountDown();
             thread_pool_ctx.completed_signaller.Signal();
         };
@@ -141,7 +166,11 @@ static void LoadAudioAsync(ListedAudioData& audio_data,
 
         ASSERT(audio_data.state.Load() == LoadingState::Loading);
 
-        auto const outcome = [&audio_data, &lib]() -> ErrorCodeOr<AudioData> {
+        auto const outcome = [&audio_data, &lib, file_data]() -> ErrorCodeOr<AudioData> {
+            if (file_data.size) {
+                auto reader = Reader::FromMemory(file_data.ToConstByteSpan());
+                return DecodeAudioFile(reader, audio_data.path, AudioDataAllocator::Instance());
+            }
             auto reader = TRY(lib.create_file_reader(lib, audio_data.path));
             return DecodeAudioFile(reader, audio_data.path, AudioDataAllocator::Instance());
         }();
@@ -149,6 +178,9 @@ static void LoadAudioAsync(ListedAudioData& audio_data,
         LoadingState result;
         if (outcome.HasValue()) {
             audio_data.audio_data = outcome.Value();
+            auto const analysis =
+                FetchOrAnalyseAudio(thread_pool_ctx.audio_analysis_by_hash, audio_data.audio_data);
+            audio_data.audio_data.onset_frame = analysis.onset_frame;
             result = LoadingState::CompletedSucessfully;
         } else {
             audio_data.error = outcome.Error();
@@ -158,10 +190,191 @@ static void LoadAudioAsync(ListedAudioData& audio_data,
     });
 }
 
+constexpr u32 k_batched_read_queue_depth = 64;
+
+// A batch can be a whole session's worth of audio, far more files than we can have open or buffered at once,
+// so each file is only opened when its read is queued.
+constexpr u32 k_max_batched_files_in_flight = k_batched_read_queue_depth * 2;
+
+// Reads all the files with one BatchedFileReader, so that the drive sees lots of requests at once rather than
+// one per thread-pool thread, and hands each file to a decoding job as soon as it has arrived. Runs on a
+// thread-pool thread. Anything that can't be read this way goes through the normal path, which also reports
+// errors.
+static void ReadAudioFilesThenDecode(Span<ListedAudioData* const> audio_datas,
+                                     sample_lib::Library const& lib,
+                                     ThreadPoolContext& thread_pool_ctx) {
+    ZoneScoped;
+    auto reader_outcome = CreateBatchedFileReader(k_batched_read_queue_depth);
+    if (reader_outcome.HasError()) {
+        TracyMessageEx({k_trace_category, k_trace_colour, -1u},
+                       "batched file reads unavailable: {}",
+                       reader_outcome.Error());
+        for (auto d : audio_datas)
+            LoadAudioAsync(*d, lib, thread_pool_ctx);
+        return;
+    }
+    auto& batch_reader = *reader_outcome.Value();
+
+    struct FileToRead {
+        Optional<FileDiskLocation> location;
+        Optional<Reader> reader;
+        Span<u8> data; // non-empty while the read is in flight
+    };
+    auto files = Malloc::Instance().NewMultiple<FileToRead>(audio_datas.size);
+    DEFER { Malloc::Instance().Delete(files); };
+
+    auto order = Malloc::Instance().AllocateExactSizeUninitialised<u32>(audio_datas.size);
+    DEFER { Malloc::Instance().Free(order.ToByteSpan()); };
+    for (auto const index : Range((u32)audio_datas.size))
+        order[index] = index;
+
+    // Jumping back and forth across a large library is slow on spinning and network drives, so read the files
+    // in the order they're stored. Files we can't locate go first: most likely they fail quickly.
+    if (thread_pool_ctx.disk_order_batching.Load(MemoryOrder::Relaxed) && audio_datas.size > 1) {
+        ZoneScopedN("locate files");
+        // If the first few files can't be located, the filesystem can't tell us; don't spend an open on each
+        // of the rest.
+        constexpr u32 k_max_initial_location_failures = 4;
+        u32 num_located = 0;
+        u32 num_failed = 0;
+        for (auto const [index, audio_data] : Enumerate(audio_datas)) {
+            if (!num_located && num_failed == k_max_initial_location_failures) break;
+            auto reader = lib.create_file_reader(lib, audio_data->path);
+            if (reader.HasError() || !reader.Value().file) continue;
+            if (auto const location = DiskLocation(*reader.Value().file, reader.Value().file_base_pos);
+                location.HasValue()) {
+                files[index].location = location.Value();
+                ++num_located;
+            } else {
+                ++num_failed;
+            }
+        }
+        Sort(order, [&](u32 a, u32 b) {
+            auto const& location_a = files[a].location;
+            auto const& location_b = files[b].location;
+            if (!location_a || !location_b) return location_a.HasValue() < location_b.HasValue();
+            return DiskLocationLessThan(*location_a, *location_b);
+        });
+    }
+
+    usize num_queued = 0;
+    u32 num_in_flight = 0;
+    auto queue_more_reads = [&]() {
+        for (; num_queued < order.size && num_in_flight < k_max_batched_files_in_flight; ++num_queued) {
+            auto const index = order[num_queued];
+            auto& audio_data = *audio_datas[index];
+            // A load that has been cancelled since it was requested doesn't need reading; LoadAudioAsync will
+            // finish it off.
+            if (audio_data.state.Load() == LoadingState::PendingLoad) {
+                auto reader = lib.create_file_reader(lib, audio_data.path);
+                if (reader.HasValue() && reader.Value().file && reader.Value().size) {
+                    auto& f = files[index];
+                    f.reader.Emplace(reader.ReleaseValue());
+                    f.data = PageAllocator::Instance().AllocateExactSizeUninitialised<u8>(f.reader->size);
+                    QueueBatchedRead(batch_reader,
+                                     {
+                                         .file = *f.reader->file,
+                                         .offset = f.reader->file_base_pos,
+                                         .buffer = f.data,
+                                         .user_data = index,
+                                     });
+                    ++num_in_flight;
+                    continue;
+                }
+            }
+            LoadAudioAsync(audio_data, lib, thread_pool_ctx);
+        }
+    };
+
+    while (true) {
+        queue_more_reads();
+        auto const outcome = WaitForBatchedReads(batch_reader, [&](uintptr index, ErrorCodeOr<void> result) {
+            auto& f = files[index];
+            f.reader.Clear();
+            if (result.HasError()) {
+                PageAllocator::Instance().Free(f.data);
+                LoadAudioAsync(*audio_datas[index], lib, thread_pool_ctx);
+            } else {
+                LoadAudioAsync(*audio_datas[index], lib, thread_pool_ctx, f.data);
+            }
+            f.data = {};
+            --num_in_flight;
+        });
+        if (outcome.HasError()) {
+            g_log_file.ErrorLn("Sample loading: batched file reads failed: {}", outcome.Error());
+            break;
+        }
+        if (!outcome.Value()) break;
+    }
+
+    auto const drained = DestroyBatchedFileReader(&batch_reader);
+    if (!drained) g_log_file.ErrorLn("Sample loading: couldn't wait for batched file reads, leaking buffers");
+
+    // Only if the reader failed part-way through.
+    for (auto const [index, f] : Enumerate(files)) {
+        if (!f.data.size) continue;
+        if (drained) PageAllocator::Instance().Free(f.data);
+        LoadAudioAsync(*audio_datas[index], lib, thread_pool_ctx);
+    }
+    for (auto const index : order.SubSpan(num_queued))
+        LoadAudioAsync(*audio_datas[index], lib, thread_pool_ctx);
+}
+
+static void LoadAudioAsync(Span<ListedAudioData* const> audio_datas,
+                           sample_lib::Library const& lib,
+                           ThreadPoolContext& thread_pool_ctx) {
+    if (audio_datas.size < 2 || !thread_pool_ctx.batched_file_reads.Load(MemoryOrder::Relaxed)) {
+        for (auto d : audio_datas)
+            LoadAudioAsync(*d, lib, thread_pool_ctx);
+        return;
+    }
+
+    // The job needs its own copy because the caller's goes away.
+    auto const to_read = Malloc::Instance().Clone(audio_datas);
+    thread_pool_ctx.num_thread_pool_jobs.Increase();
+    thread_pool_ctx.pool.AddJob([&lib, &thread_pool_ctx, to_read]() {
+        DEFER {
+            Malloc::Instance().Free(to_read.ToByteSpan());
+            thread_pool_ctx.num_thread_pool_jobs.CountDown();
+            thread_pool_ctx.completed_signaller.Signal();
+        };
+        ReadAudioFilesThenDecode(to_read, lib, thread_pool_ctx);
+    });
+}
+
+// Audio that needs loading from one library. Everything gathered in one pass of the loading thread is loaded
+// as one batch per library, so that the batch can be read in disk order.
+struct LibraryAudioToLoad {
+    sample_lib::Library const& lib;
+    DynamicArray<ListedAudioData*> audio_datas;
+    LibraryAudioToLoad* next = nullptr;
+};
+
+static DynamicArray<ListedAudioData*>& AudioToLoad(IntrusiveSinglyLinkedList<LibraryAudioToLoad>& batches,
+                                                   sample_lib::Library const& lib,
+                                                   ArenaAllocator& arena) {
+    for (auto& batch : batches)
+        if (&batch.lib == &lib) return batch.audio_datas;
+    auto batch = arena.NewUninitialised<LibraryAudioToLoad>();
+    PLACEMENT_NEW(batch)
+    LibraryAudioToLoad {
+        .lib = lib,
+        .audio_datas = DynamicArray<ListedAudioData*> {arena},
+    };
+    SinglyLinkedListPrepend(batches.first, batch);
+    return batch->audio_datas;
+}
+
+static void LoadAudioAsync(IntrusiveSinglyLinkedList<LibraryAudioToLoad>& batches,
+                           ThreadPoolContext& thread_pool_ctx) {
+    for (auto& batch : batches)
+        LoadAudioAsync(batch.audio_datas, batch.lib, thread_pool_ctx);
+    batches.first = nullptr;
+}
+
 // if the audio load is cancelled, or pending-cancel, then queue up a load again
 static void TriggerReloadIfAudioIsCancelled(ListedAudioData& audio_data,
-                                            sample_lib::Library const& lib,
-                                            ThreadPoolContext& thread_pool_ctx,
+                                            DynamicArray<ListedAudioData*>& audio_to_load,
                                             u32 debug_inst_id) {
     auto expected = LoadingState::PendingCancel;
     if (!audio_data.state.CompareExchangeStrong(expected, LoadingState::PendingLoad)) {
@@ -170,7 +383,7 @@ static void TriggerReloadIfAudioIsCancelled(ListedAudioData& audio_data,
             TracyMessageEx({k_trace_category, k_trace_colour, -1u},
                            "instID:{}, reloading CompletedCancelled audio",
                            debug_inst_id);
-            LoadAudioAsync(audio_data, lib, thread_pool_ctx);
+            dyn::Append(audio_to_load, &audio_data);
         } else {
             TracyMessageEx({k_trace_category, k_trace_colour, -1u},
                            "instID:{}, reusing audio which is in state: {}",
@@ -187,14 +400,15 @@ static void TriggerReloadIfAudioIsCancelled(ListedAudioData& audio_data,
            audio_data.state.Load() != LoadingState::PendingCancel);
 }
 
+// Audio that needs loading is added to audio_to_load; pass that to LoadAudioAsync once you have all of it.
 static ListedAudioData* FetchOrCreateAudioData(List<ListedAudioData>& audio_datas,
                                                sample_lib::Library const& lib,
                                                String path,
-                                               ThreadPoolContext& thread_pool_ctx,
+                                               DynamicArray<ListedAudioData*>& audio_to_load,
                                                u32 debug_inst_id) {
     for (auto& d : audio_datas) {
         if (lib.name == d.library_name && d.path == path) {
-            TriggerReloadIfAudioIsCancelled(d, lib, thread_pool_ctx, debug_inst_id);
+            TriggerReloadIfAudioIsCancelled(d, audio_to_load, debug_inst_id);
             return &d;
         }
     }
@@ -210,30 +424,41 @@ static ListedAudioData* FetchOrCreateAudioData(List<ListedAudioData>& audio_data
         .error = {},
     };
 
-    LoadAudioAsync(*audio_data, lib, thread_pool_ctx);
+    dyn::Append(audio_to_load, audio_data);
     return audio_data;
 }
 
-static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
-                                                 List<ListedAudioData>& audio_datas,
-                                                 sample_lib::Instrument const& inst,
-                                                 ThreadPoolContext& thread_pool_ctx) {
+// Audio that needs loading is added to audio_to_load; pass that to LoadAudioAsync once you have all of it.
+static ErrorCodeOr<ListedInstrument*> FetchOrCreateInstrument(LibrariesList::Node& lib_node,
+                                                              List<ListedAudioData>& audio_datas,
+                                                              sample_lib::Instrument const& inst_header,
+                                                              DynamicArray<ListedAudioData*>& audio_to_load,
+                                                              sample_lib::MaterialiseCache& materialise_cache,
+                                                              ArenaAllocator& scratch_arena) {
     auto& lib = lib_node.value;
-    ASSERT(&inst.library == lib.lib);
+    ASSERT(&inst_header.library == lib.lib);
 
     for (auto& i : lib.instruments)
-        if (i.inst.instrument.name == inst.name) {
+        if (i.inst.instrument.name == inst_header.name) {
             for (auto d : i.audio_data_set)
-                TriggerReloadIfAudioIsCancelled(*d, *lib.lib, thread_pool_ctx, i.debug_id);
+                TriggerReloadIfAudioIsCancelled(*d, audio_to_load, i.debug_id);
             return &i;
         }
 
+    // Libraries are read with only their instrument headers, so the regions are built here, into the
+    // instrument's own arena. That way they're freed along with it when it's no longer used.
+    ArenaAllocator arena {PageAllocator::Instance()};
+    auto const& inst =
+        *TRY(sample_lib::MaterialiseInstrument(inst_header, arena, scratch_arena, &materialise_cache));
+
     auto new_inst = lib.instruments.PrependUninitialised();
     PLACEMENT_NEW(new_inst)
     ListedInstrument {
         .inst = {inst},
         .refs = 0u,
         .library_refs = lib_node.reader_uses,
+        .audio_data_set = {},
+        .arena = Move(arena),
     };
     lib_node.reader_uses.FetchAdd(1);
 
@@ -248,7 +473,7 @@ static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
         auto ref_audio_data = FetchOrCreateAudioData(audio_datas,
                                                      *lib.lib,
                                                      region_info.file.path,
-                                                     thread_pool_ctx,
+                                                     audio_to_load,
                                                      new_inst->debug_id);
         audio_data = &ref_audio_data->audio_data;
 
@@ -267,6 +492,40 @@ static ListedInstrument* FetchOrCreateInstrument(LibrariesList::Node& lib_node,
     return new_inst;
 }
 
+// Called once all of the instrument's audio has loaded. The baked loops are owned by the instrument rather
+// than the audio because different regions can use the same file with different loops.
+static void BakeLoopCrossfadesIfNeeded(ListedInstrument& i) {
+    if (i.inst.baked_loops.size) return;
+    ZoneScoped;
+
+    auto const regions = i.inst.instrument.regions;
+    auto baked_loops = i.arena.AllocateExactSizeUninitialised<BakedLoopCrossfade const*>(regions.size);
+    for (auto const region_index : Range(regions.size)) {
+        auto& baked_loop = baked_loops[region_index];
+        baked_loop = nullptr;
+
+        auto const& region = regions[region_index];
+        auto const& audio_data = *i.inst.audio_datas[region_index];
+        if (!region.file.loop) continue;
+
+        auto const loop = NormaliseLoop(*region.file.loop, audio_data.num_frames);
+        if (!CanBakeLoopCrossfade(loop)) continue;
+
+        // Regions often share a file and loop, so reuse an existing bake where we can.
+        for (auto const other_index : Range(region_index)) {
+            auto const other = baked_loops[other_index];
+            if (other && i.inst.audio_datas[other_index] == &audio_data && other->loop == loop) {
+                baked_loop = other;
+                break;
+            }
+        }
+        if (!baked_loop)
+            baked_loop = i.arena.New<BakedLoopCrossfade>(BakeLoopCrossfade(audio_data, loop, i.arena));
+    }
+
+    i.inst.baked_loops = baked_loops;
+}
+
 AvailableLibraries::AvailableLibraries(Span<String const> always_scanned_folders,
                                        ThreadsafeErrorNotifications& error_notifications)
     : error_notifications(error_notifications) {
@@ -451,7 +710,8 @@ static void AddAsyncJob(LibrariesAsyncContext& async_ctx,
     async_ctx.num_uncompleted_jobs.FetchAdd(1, MemoryOrder::AcquireRelease);
     async_ctx.thread_pool.AddJob([&async_ctx, &job = *job, &lib_list]() {
         ZoneNamed(do_job, true);
-        ArenaAllocator scratch_arena {PageAllocator::Instance()};
+        ArenaAllocator scratch_arena {PageAllocator::Instance(), RecommendedArenaSize("library-job"_s, 0)};
+        ScopedArenaUsageRecorder const usage_recorder {"library-job"_s, scratch_arena};
         switch (job.data.tag) {
             case LibrariesAsyncContext::Job::Type::ReadLibrary: {
                 auto& j = *job.data.Get<LibrariesAsyncContext::Job::ReadLibrary*>();
@@ -479,7 +739,12 @@ static void AddAsyncJob(LibrariesAsyncContext& async_ctx,
                     }
 
                     auto lib =
-                        TRY(sample_lib::Read(reader, args.format, path, j.result.arena, scratch_arena));
+                        TRY(sample_lib::Read(reader,
+                                             args.format,
+                                             path,
+                                             j.result.arena,
+                                             scratch_arena,
+                                             {.headers_only = true}));
                     lib->file_hash = file_hash;
                     return lib;
                 };
@@ -663,16 +928,15 @@ static void UpdateAvailableLibraries(AvailableLibraries& libs,
                         auto const error = outcome.GetFromTag<ResultType::Error>();
                         if (error.code == FilesystemError::PathDoesNotExist) return;
 
-                        auto item = libs.error_notifications.NewError();
-                        item->value = {
+                        ThreadsafeErrorNotifications::Item item {
                             .title = "Failed to read library"_s,
                             .message = {},
                             .error_code = error.code,
                             .id = error_id,
                         };
                         if (j.args.path_or_memory.Is<String>())
-                            fmt::Append(item->value.message, "{}\n", j.args.path_or_memory.Get<String>());
-                        if (error.message.size) fmt::Append(item->value.message, "{}\n", error.message);
+                            fmt::Append(item.message, "{}\n", j.args.path_or_memory.Get<String>());
+                        if (error.message.size) fmt::Append(item.message, "{}\n", error.message);
                         libs.error_notifications.AddOrUpdateError(item);
                         break;
                     }
@@ -694,14 +958,12 @@ static void UpdateAvailableLibraries(AvailableLibraries& libs,
                             folder->source == AvailableLibraries::ScanFolder::Source::AlwaysScannedFolder;
                         if (!(is_always_scanned_folder &&
                               j.result.outcome.Error() == FilesystemError::PathDoesNotExist)) {
-                            auto item = libs.error_notifications.NewError();
-                            item->value = {
+                            libs.error_notifications.AddOrUpdateError({
                                 .title = "Failed to scan library folder"_s,
                                 .message = String(path),
                                 .error_code = j.result.outcome.Error(),
                                 .id = folder_error_id,
-                            };
-                            libs.error_notifications.AddOrUpdateError(item);
+                            });
                         }
                         folder->state.Store(AvailableLibraries::ScanFolder::State::ScanFailed,
                                             MemoryOrder::Release);
@@ -962,9 +1224,33 @@ static void CancelLoadingAudioForInstrumentIfPossible(ListedInstrument* i, uintp
                    num_cancelled);
 }
 
+static void ApplyRequestedSchedulingPolicy(LoadingThread& thread) {
+    auto const requested = thread.scheduling_policy.Use([](auto& s) {
+        auto const r = s.requested;
+        s.requested = nullopt;
+        return r;
+    });
+    if (!requested) return;
+
+    auto const outcome = SetCurrentThreadSchedulingPolicy(*requested);
+    if (outcome.HasError())
+        g_log_file.WarningLn("Sample loading thread: couldn't fully apply scheduling policy ({}): {}",
+                             *requested,
+                             outcome.Error());
+    auto const applied = CurrentThreadSchedulingPolicy();
+    g_log_file.InfoLn("Sample loading thread: scheduling: {}", applied);
+    thread.scheduling_policy.Use([&](auto& s) { s.applied = applied; });
+}
+
+// Requests are gathered until none have arrived for the quiet period, or for at most the max.
+constexpr int k_request_gathering_quiet_ms = 10;
+constexpr f64 k_max_request_gathering_ms = 200;
+
 static void LoadingThreadLoop(LoadingThread& thread) {
     ZoneScoped;
-    ArenaAllocator scratch_arena {PageAllocator::Instance(), Kb(128)};
+    ArenaAllocator scratch_arena {PageAllocator::Instance(),
+                                  RecommendedArenaSize("loader-thread"_s, Kb(128))};
+    ScopedArenaUsageRecorder const usage_recorder {"loader-thread"_s, scratch_arena};
     List<ListedAudioData> audio_datas {PageAllocator::Instance()};
     uintptr_t debug_result_id = 0;
 
@@ -977,14 +1263,12 @@ static void LoadingThreadLoop(LoadingThread& thread) {
             watcher.Emplace(watcher_outcome.ReleaseValue());
         } else {
             DebugLn("Failed to create directory watcher: {}", watcher_outcome.Error());
-            auto node = thread.available_libraries.error_notifications.NewError();
-            node->value = {
+            thread.available_libraries.error_notifications.AddOrUpdateError({
                 .title = "Warning: unable to monitor library folders"_s,
                 .message = {},
                 .error_code = watcher_outcome.Error(),
                 .id = error_id,
-            };
-            thread.available_libraries.error_notifications.AddOrUpdateError(node);
+            });
         }
     }
     DEFER {
@@ -1042,10 +1326,14 @@ static void LoadingThreadLoop(LoadingThread& thread) {
             .pool = thread.thread_pool,
             .num_thread_pool_jobs = thread_pool_jobs,
             .completed_signaller = thread.work_signaller,
+            .audio_analysis_by_hash = thread.audio_analysis_by_hash,
+            .batched_file_reads = thread.batched_file_reads,
+            .disk_order_batching = thread.disk_order_batching,
         };
 
         do {
             thread.work_signaller.WaitUntilSignalledOrSpurious(250u);
+            ApplyRequestedSchedulingPolicy(thread);
 
             if (thread.debug_dump_current_state.Exchange(false)) {
                 ZoneNamedN(dump, "dump", true);
@@ -1104,40 +1392,61 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                            thread_pool_jobs.counter.Load());
 
             // consume any incoming requests
-            while (auto queued_request = thread.request_queue.TryPop()) {
-                ZoneNamedN(req, "request", true);
-
-                if (!queued_request->connection.used.Load(MemoryOrder::Relaxed)) continue;
-
-                // Only once we have a request do we initiate the scanning
-                for (auto& n : thread.available_libraries.scan_folders) {
-                    if (auto f = n.TryScoped()) {
-                        auto expected = AvailableLibraries::ScanFolder::State::NotScanned;
-                        f->state.CompareExchangeStrong(
-                            expected,
-                            AvailableLibraries::ScanFolder::State::RescanRequested);
+            auto const consume_requests = [&]() {
+                u32 num_consumed = 0;
+                while (auto queued_request = thread.request_queue.TryPop()) {
+                    ZoneNamedN(req, "request", true);
+
+                    if (!queued_request->connection.used.Load(MemoryOrder::Relaxed)) continue;
+
+                    // Only once we have a request do we initiate the scanning
+                    for (auto& n : thread.available_libraries.scan_folders) {
+                        if (auto f = n.TryScoped()) {
+                            auto expected = AvailableLibraries::ScanFolder::State::NotScanned;
+                            f->state.CompareExchangeStrong(
+                                expected,
+                                AvailableLibraries::ScanFolder::State::RescanRequested);
+                        }
                     }
-                }
 
-                auto pending_result = scratch_arena.NewUninitialised<PendingResult>();
-                PLACEMENT_NEW(pending_result)
-                PendingResult {
-                    .state = PendingResult::State::AwaitingLibrary,
-                    .request = *queued_request,
-                    .debug_id = debug_result_id++,
-                };
-                SinglyLinkedListPrepend(pending_results.first, pending_result);
+                    auto pending_result = scratch_arena.NewUninitialised<PendingResult>();
+                    PLACEMENT_NEW(pending_result)
+                    PendingResult {
+                        .state = PendingResult::State::AwaitingLibrary,
+                        .request = *queued_request,
+                        .debug_id = debug_result_id++,
+                    };
+                    SinglyLinkedListPrepend(pending_results.first, pending_result);
 
-                TracyMessageEx({k_trace_category, k_trace_colour, pending_result->debug_id},
-                               "pending result added");
+                    TracyMessageEx({k_trace_category, k_trace_colour, pending_result->debug_id},
+                                   "pending result added");
+                    ++num_consumed;
+                }
+                return num_consumed;
+            };
+            if (consume_requests() > 1 && thread.disk_order_batching.Load(MemoryOrder::Relaxed)) {
+                // Several requests at once, as when a project or preset is applied, are usually followed
+                // closely by more. Wait for them so that all of their audio can be read as one batch. A
+                // lone request is an interactive change, which shouldn't be delayed.
+                Stopwatch const stopwatch;
+                while (stopwatch.MillisecondsElapsed() < k_max_request_gathering_ms) {
+                    SleepThisThread(k_request_gathering_quiet_ms);
+                    if (!consume_requests()) break;
+                }
             }
 
             UpdateAvailableLibraries(thread.available_libraries, libs_async_ctx, scratch_arena, watcher);
 
             if (!pending_results.Empty()) {
                 // Fill in library
+                IntrusiveSinglyLinkedList<LibraryAudioToLoad> audio_to_load {};
+                sample_lib::MaterialiseCache materialise_cache {};
                 for (auto& pending_result : pending_results) {
                     if (pending_result.state != PendingResult::State::AwaitingLibrary) continue;
+                    DEFER {
+                        if (!thread.disk_order_batching.Load(MemoryOrder::Relaxed))
+                            LoadAudioAsync(audio_to_load, thread_pool_ctx);
+                    };
 
                     auto const library_name = ({
                         String n {};
@@ -1161,14 +1470,13 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                     if (!lib) {
                         if (libs_async_ctx.num_uncompleted_jobs.Load(MemoryOrder::AcquireRelease) == 0) {
                             {
-                                auto item = pending_result.request.connection.error_notifications.NewError();
-                                item->value = {
+                                ThreadsafeErrorNotifications::Item item {
                                     .title = {},
                                     .message = {},
                                     .error_code = CommonError::NotFound,
                                     .id = ThreadsafeErrorNotifications::Id("lib ", library_name),
                                 };
-                                fmt::Append(item->value.title, "{} not found", library_name);
+                                fmt::Append(item.title, "{} not found", library_name);
                                 pending_result.request.connection.error_notifications.AddOrUpdateError(item);
                             }
                             pending_result.state = ErrorCode {CommonError::NotFound};
@@ -1186,8 +1494,30 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                                         .instrument_loading_percents[load_inst.layer_index]
                                         .Store(0);
 
-                                    auto inst =
-                                        FetchOrCreateInstrument(*lib, audio_datas, **i, thread_pool_ctx);
+                                    auto const outcome = FetchOrCreateInstrument(
+                                        *lib,
+                                        audio_datas,
+                                        **i,
+                                        AudioToLoad(audio_to_load, *lib->value.lib, scratch_arena),
+                                        materialise_cache,
+                                        scratch_arena);
+                                    if (outcome.HasError()) {
+                                        {
+                                            ThreadsafeErrorNotifications::Item item {
+                                                .title = {},
+                                                .message = {},
+                                                .error_code = outcome.Error(),
+                                                .id = ThreadsafeErrorNotifications::Id("inst", inst_name),
+                                            };
+                                            fmt::Append(item.title, "Failed to load \"{}\"", inst_name);
+                                            pending_result.request.connection.error_notifications
+                                                .AddOrUpdateError(item);
+                                        }
+                                        pending_result.state = outcome.Error();
+                                        break;
+                                    }
+
+                                    auto inst = outcome.Value();
                                     ASSERT(inst);
 
                                     pending_result.request.connection.desired_inst[load_inst.layer_index] =
@@ -1204,17 +1534,13 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                                         inst_name);
                                 } else {
                                     {
-                                        auto const item =
-                                            pending_result.request.connection.error_notifications.NewError();
-                                        item->value = {
+                                        ThreadsafeErrorNotifications::Item item {
                                             .title = {},
                                             .message = {},
                                             .error_code = CommonError::NotFound,
                                             .id = ThreadsafeErrorNotifications::Id("inst", inst_name),
                                         };
-                                        fmt::Append(item->value.title,
-                                                    "Cannot find instrument \"{}\"",
-                                                    inst_name);
+                                        fmt::Append(item.title, "Cannot find instrument \"{}\"", inst_name);
                                         pending_result.request.connection.error_notifications
                                             .AddOrUpdateError(item);
                                     }
@@ -1228,11 +1554,12 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                                 auto const ir_path = lib->value.lib->irs_by_name.Find(ir.ir_name);
 
                                 if (ir_path) {
-                                    auto audio_data = FetchOrCreateAudioData(audio_datas,
-                                                                             *lib->value.lib,
-                                                                             (*ir_path)->path,
-                                                                             thread_pool_ctx,
-                                                                             999999);
+                                    auto audio_data = FetchOrCreateAudioData(
+                                        audio_datas,
+                                        *lib->value.lib,
+                                        (*ir_path)->path,
+                                        AudioToLoad(audio_to_load, *lib->value.lib, scratch_arena),
+                                        999999);
 
                                     pending_result.state = PendingResult::LoadingAsset {audio_data};
 
@@ -1242,16 +1569,12 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                                         ir.library_name,
                                         ir.ir_name);
                                 } else {
-                                    auto const err =
-                                        pending_result.request.connection.error_notifications.NewError();
-                                    err->value = {
+                                    pending_result.request.connection.error_notifications.AddOrUpdateError({
                                         .title = "Failed to find IR"_s,
                                         .message = String(ir.ir_name),
                                         .error_code = CommonError::NotFound,
                                         .id = ThreadsafeErrorNotifications::Id("ir  ", ir.ir_name),
-                                    };
-                                    pending_result.request.connection.error_notifications.AddOrUpdateError(
-                                        err);
+                                    });
                                     pending_result.state = ErrorCode {CommonError::NotFound};
                                 }
                                 break;
@@ -1259,6 +1582,7 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                         }
                     }
                 }
+                LoadAudioAsync(audio_to_load, thread_pool_ctx);
 
                 // For each inst, check for errors
                 for (auto& pending_result : pending_results) {
@@ -1280,14 +1604,12 @@ static void LoadingThreadLoop(LoadingThread& thread) {
 
                     if (error) {
                         {
-                            auto item = pending_result.request.connection.error_notifications.NewError();
-                            item->value = {
+                            pending_result.request.connection.error_notifications.AddOrUpdateError({
                                 .title = "Failed to load audio"_s,
                                 .message = i->inst.instrument.name,
                                 .error_code = *error,
                                 .id = ThreadsafeErrorNotifications::Id("audi", i->inst.instrument.name),
-                            };
-                            pending_result.request.connection.error_notifications.AddOrUpdateError(item);
+                            });
                         }
 
                         CancelLoadingAudioForInstrumentIfPossible(i, pending_result.debug_id);
@@ -1315,6 +1637,7 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                             n;
                         });
                         if (num_completed == i->audio_data_set.size) {
+                            BakeLoopCrossfadesIfNeeded(*i);
                             pending_result.LoadingPercent().Store(-1);
                             pending_result.state = AssetRefUnion {
                                 RefCounted<LoadedInstrument> {i->inst, i->refs, &thread.work_signaller}};
@@ -1363,15 +1686,13 @@ static void LoadingThreadLoop(LoadingThread& thread) {
                         case LoadingState::CompletedWithError: {
                             auto const ir_index = pending_result.request.request.Get<sample_lib::IrId>();
                             {
-                                auto item = pending_result.request.connection.error_notifications.NewError();
-                                item->value = {
+                                pending_result.request.connection.error_notifications.AddOrUpdateError({
                                     .title = "Failed to load IR"_s,
                                     .message = {},
                                     .error_code = *ir_data.error,
                                     .id = Hash("ir  "_s) + Hash(ir_index.library_name.Items()) +
                                           Hash(ir_index.ir_name.Items()),
-                                };
-                                pending_result.request.connection.error_notifications.AddOrUpdateError(item);
+                                });
                             }
                             pending_result.state = *ir_data.error;
                             break;
@@ -1507,6 +1828,11 @@ void CloseConnection(LoadingThread& thread, Connection& connection) {
     });
 }
 
+void SetSchedulingPolicy(LoadingThread& thread, ThreadSchedulingPolicy const& policy) {
+    thread.scheduling_policy.Use([&](auto& s) { s.requested = policy; });
+    thread.work_signaller.Signal();
+}
+
 RequestId SendLoadRequest(LoadingThread& thread, Connection& connection, LoadRequest const& request) {
     LoadingThread::QueuedRequest const queued_request {
         .id = thread.request_id_counter.FetchAdd(1),
@@ -1840,12 +2166,9 @@ TEST_CASE(TestAssetLoader) {
                                     "Unable to properly test Core library, not expecting error: {}. The test program scans upwards from its executable path for a folder named '{}' and scans that for the core library",
                                     tests::k_build_resources_subdir,
                                     *err);
-                            for (auto& n : fixture.error_notif.items)
-                                if (auto e = n.TryScoped())
-                                    tester.log.DebugLn("Error: {}: {}: {}",
-                                                       e->title,
-                                                       e->message,
-                                                       e->error_code);
+                            fixture.error_notif.ForEach([&](ThreadsafeErrorNotifications::Item const& e) {
+                                tester.log.DebugLn("Error: {}: {}: {}", e.title, e.message, e.error_code);
+                            });
                         },
                 });
         }
@@ -2016,6 +2339,250 @@ TEST_CASE(TestAssetLoader) {
     return k_success;
 }
 
+TEST_CASE(TestSessionOpenLoading) {
+    // A project with an instance for each instrument of a large library, opened with none of the audio in the
+    // page cache.
+    constexpr u32 k_num_instances = 50;
+    constexpr u32 k_num_regions = 16;
+    constexpr usize k_file_size = Kb(64);
+
+    auto& a = tester.scratch_arena;
+    auto const scan_folder = (String)path::Join(a, Array {tests::TempFolder(tester), "session open"_s});
+    auto const lib_folder = (String)path::Join(a, Array {scan_folder, "Session"_s});
+    auto _ =
+        Delete(scan_folder, {.type = DeleteOptions::Type::DirectoryRecursively, .fail_if_not_exists = false});
+
+    constexpr String k_config_lua = R"aaa(
+local library = floe.new_library({
+    name = "Session",
+    tagline = "tagline",
+    author = "Tester",
+    background_image_path = "",
+    icon_image_path = "",
+})
+for i = 1, <NUM_INSTRUMENTS> do
+    local instrument = floe.new_instrument(library, {
+        name = "Inst " .. i,
+        folders = "Folder",
+        tags = {},
+    })
+    for r = 0, <NUM_REGIONS> - 1 do
+        floe.add_region(instrument, {
+            file = {
+                path = "Inst " .. i .. "/Sample " .. r .. ".r16",
+                root_key = r * 8,
+            },
+            trigger_criteria = {
+                key_range = { r * 8, (r * 8) + 8 },
+                velocity_range = { 0, 100 },
+            },
+        })
+    end
+end
+return library
+)aaa"_s;
+    auto const config = fmt::FormatStringReplace(a,
+                                                 k_config_lua,
+                                                 ArrayT<fmt::StringReplacement>({
+                                                     {"<NUM_INSTRUMENTS>", fmt::IntToString(k_num_instances)},
+                                                     {"<NUM_REGIONS>", fmt::IntToString(k_num_regions)},
+                                                 }));
+    TRY(CreateDirectory(lib_folder, {.create_intermediate_directories = true}));
+    TRY(WriteFile(path::Join(a, Array {lib_folder, "config.lua"_s}), config));
+
+    // Written in a random order so that where the files end up on the drive has nothing to do with the order
+    // the instruments are requested in.
+    DynamicArray<String> audio_paths {a};
+    for (auto const inst_index : Range(1u, k_num_instances + 1)) {
+        auto const inst_folder =
+            (String)path::Join(a, Array {lib_folder, (String)fmt::Format(a, "Inst {}", inst_index)});
+        TRY(CreateDirectory(inst_folder, {.create_intermediate_directories = true}));
+        for (auto const region_index : Range(k_num_regions))
+            dyn::Append(
+                audio_paths,
+                path::Join(a, Array {inst_folder, (String)fmt::Format(a, "Sample {}.r16", region_index)}));
+    }
+    auto seed = SeedFromTime();
+    Shuffle(audio_paths, seed);
+    auto contents = a.AllocateExactSizeUninitialised<u8>(k_file_size);
+    for (auto const [file_index, audio_path] : Enumerate<u32>(audio_paths)) {
+        // Different contents for each so that no two have the same hash.
+        for (auto [i, byte] : Enumerate(contents))
+            byte = (u8)((i * 251) + (file_index * 13) + (i >> 11));
+        TRY(WriteFile(audio_path, contents));
+    }
+
+    auto open_session = [&](bool disk_order_batching) {
+        ThreadPool pool;
+        pool.Init("Session open", 8u);
+        ThreadsafeErrorNotifications error_notif {};
+        AvailableLibraries libs {{}, error_notif};
+        libs.SetExtraScanFolders(Array {scan_folder});
+        LoadingThread thread {pool, libs};
+        thread.disk_order_batching.Store(disk_order_batching);
+
+        AtomicCountdown countdown {k_num_instances};
+        Atomic<u32> num_succeeded {0};
+        DynamicArrayInline<Connection*, k_num_instances> connections;
+        for (auto const instance_index : Range(k_num_instances)) {
+            (void)instance_index;
+            dyn::Append(connections, &OpenConnection(thread, error_notif, [&](LoadResult r) {
+                if (r.result.tag == LoadResult::ResultType::Success) num_succeeded.FetchAdd(1);
+                countdown.CountDown();
+            }));
+        }
+        DEFER {
+            for (auto c : connections)
+                CloseConnection(thread, *c);
+        };
+
+        Stopwatch const stopwatch;
+        for (auto const [instance_index, c] : Enumerate<u32>(connections)) {
+            SendLoadRequest(thread,
+                            *c,
+                            InstrumentIdWithLayer {
+                                .id =
+                                    {
+                                        .library_name = "Session"_s,
+                                        .inst_name = (String)fmt::Format(a, "Inst {}", instance_index + 1),
+                                    },
+                                .layer_index = 0,
+                            });
+        }
+        auto const wait_result = countdown.WaitUntilZero(60 * 1000);
+        auto const ms = stopwatch.MillisecondsElapsed();
+        CHECK(wait_result == WaitResult::WokenOrSpuriousOrNotExpected);
+        CHECK_EQ(num_succeeded.Load(), k_num_instances);
+        return ms;
+    };
+
+    // Some filesystems, such as tmpfs, keep the pages anyway.
+    for (auto const& audio_path : audio_paths)
+        TRY(EvictFileFromPageCache(audio_path));
+    auto const separately_ms = open_session(false);
+    for (auto const& audio_path : audio_paths)
+        TRY(EvictFileFromPageCache(audio_path));
+    auto const batched_ms = open_session(true);
+
+    tester.log.DebugLn("Opening a {}-instance session from a cold cache ({} files, {} MB): each request "
+                       "separately {.1} ms, batched in disk order {.1} ms",
+                       k_num_instances,
+                       audio_paths.size,
+                       (audio_paths.size * k_file_size) / Mb(1),
+                       separately_ms,
+                       batched_ms);
+
+    return k_success;
+}
+
+TEST_CASE(TestAudioAnalysisCache) {
+    AudioAnalysisByHash cache {Malloc::Instance()};
+
+    constexpr u32 k_num_frames = 4000;
+    constexpr u32 k_onset = 1500;
+    constexpr u32 k_end = 2500;
+    auto tone = [](u32 frame) { return (frame % 2) ? 0.5f : -0.5f; };
+    auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames);
+    for (auto const frame : Range(k_num_frames))
+        samples[frame] = (frame >= k_onset && frame < k_end) ? tone(frame) : 0.0f;
+    AudioData const audio {
+        .hash = XXH3_64bits(samples.data, samples.ToByteSpan().size),
+        .channels = 1,
+        .sample_rate = 44100,
+        .num_frames = k_num_frames,
+        .interleaved_samples = samples,
+    };
+
+    auto const analysis = FetchOrAnalyseAudio(cache, audio);
+    CHECK_EQ(analysis.onset_frame, DetectOnsetFrame(audio));
+    CHECK_GT(analysis.onset_frame, 0u);
+
+    // Audio with the same hash is assumed to be the same audio, so the result must come from the cache rather
+    // than from analysing these samples, which have no lead-in and no tail.
+    auto other_samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames);
+    for (auto const frame : Range(k_num_frames))
+        other_samples[frame] = tone(frame);
+    auto same_hash = audio;
+    same_hash.interleaved_samples = other_samples;
+    auto const cached = FetchOrAnalyseAudio(cache, same_hash);
+    CHECK_EQ(cached.onset_frame, analysis.onset_frame);
+
+    auto different_hash = same_hash;
+    different_hash.hash = audio.hash + 1;
+    auto const reanalysed = FetchOrAnalyseAudio(cache, different_hash);
+    CHECK_EQ(reanalysed.onset_frame, 0u);
+
+    return k_success;
+}
+
+TEST_CASE(TestBackgroundThreadScheduling) {
+    // Something that an unprivileged process can always do.
+    auto const allowed_cpus = CurrentThreadSchedulingPolicy().cpu_affinity_mask;
+    ThreadSchedulingPolicy const policy {
+        .priority = ThreadPriorityClass::Background,
+        .low_io_priority = true,
+        .cpu_affinity_mask = allowed_cpus & (~allowed_cpus + 1), // the lowest one, or 0 if unsupported
+    };
+    auto check_applied = [&](ThreadSchedulingPolicy const& applied) {
+        CHECK(applied.priority == policy.priority);
+        CHECK_EQ(applied.low_io_priority, policy.low_io_priority);
+        if (policy.cpu_affinity_mask) CHECK_EQ(applied.cpu_affinity_mask, policy.cpu_affinity_mask);
+    };
+
+    SUBCASE("thread pool workers") {
+        constexpr u32 k_num_workers = 3;
+        ThreadPool pool;
+        pool.Init("Sched test", k_num_workers, policy);
+
+        // Every job waits until they've all started, so each one is on a different worker.
+        Atomic<u32> num_started {0};
+        AtomicCountdown num_remaining {k_num_workers};
+        MutexProtected<DynamicArrayInline<ThreadSchedulingPolicy, k_num_workers>> applied {};
+        for (auto _ : Range(k_num_workers)) {
+            pool.AddJob([&]() {
+                num_started.FetchAdd(1);
+                while (num_started.Load() != k_num_workers)
+                    YieldThisThread();
+                auto const p = CurrentThreadSchedulingPolicy();
+                applied.Use([&](auto& a) { dyn::Append(a, p); });
+                num_remaining.CountDown();
+            });
+        }
+        num_remaining.WaitUntilZero();
+
+        applied.Use([&](auto& a) {
+            REQUIRE_EQ(a.size, k_num_workers);
+            for (auto const& p : a)
+                check_applied(p);
+        });
+    }
+
+    SUBCASE("loading thread") {
+        ThreadPool pool;
+        pool.Init("Sched test", 1u);
+        ThreadsafeErrorNotifications error_notif {};
+        AvailableLibraries libs {{}, error_notif};
+        LoadingThread thread {pool, libs};
+
+        SetSchedulingPolicy(thread, policy);
+        Optional<ThreadSchedulingPolicy> applied {};
+        for (auto _ : Range(1000)) {
+            applied = thread.scheduling_policy.Use([](auto& s) { return s.applied; });
+            if (applied) break;
+            SleepThisThread(5);
+        }
+        REQUIRE(applied);
+        check_applied(*applied);
+    }
+
+    return k_success;
+}
+
 } // namespace sample_lib_loader
 
-TEST_REGISTRATION(FloeAssetLoaderTests) { REGISTER_TEST(sample_lib_loader::TestAssetLoader); }
+TEST_REGISTRATION(FloeAssetLoaderTests) {
+    REGISTER_TEST(sample_lib_loader::TestAssetLoader);
+    REGISTER_TEST(sample_lib_loader::TestSessionOpenLoading);
+    REGISTER_TEST(sample_lib_loader::TestAudioAnalysisCache);
+    REGISTER_TEST(sample_lib_loader::TestBackgroundThreadScheduling);
+}
@@ -21,6 +21,8 @@
 // 5. Each asset should not be duplicated in memory
 // 6. Unused assets should be freed
 
+struct BakedLoopCrossfade;
+
 namespace sample_lib_loader {
 
 using RequestId = u64;
@@ -28,6 +30,7 @@ using RequestId = u64;
 struct LoadedInstrument {
     sample_lib::Instrument const& instrument;
     Span<AudioData const*> audio_datas {}; // parallel to instrument.regions
+    Span<BakedLoopCrossfade const*> baked_loops {}; // parallel to instrument.regions, null if not baked
     AudioData const* file_for_gui_waveform {};
 };
 
@@ -149,6 +152,16 @@ struct ListedLibrary {
 
 using LibrariesList = AtomicRefList<ListedLibrary>;
 
+struct AudioAnalysis {
+    u32 onset_frame;
+};
+
+// Analysis reads all of the audio, so results are kept by audio hash. Files that are freed and later
+// reloaded, or that appear in more than one library, are then only analysed once.
+using AudioAnalysisByHash = MutexProtected<DynamicHashTable<u64, AudioAnalysis>>;
+
+AudioAnalysis FetchOrAnalyseAudio(AudioAnalysisByHash& cache, AudioData const& audio);
+
 } // namespace detail
 
 using LoadCompletedCallback = TrivialFixedSizeFunction<40, void(LoadResult)>;
@@ -215,6 +228,15 @@ struct LoadingThread {
     Atomic<u32> num_insts_loaded {};
     Atomic<u32> num_samples_loaded {};
 
+    // Read each batch of audio files together, with many reads in flight, where the OS allows it
+    // (currently only Linux, using io_uring). Otherwise each file is read by the job that decodes it.
+    Atomic<bool> batched_file_reads {true};
+
+    // Gather requests that arrive close together, as when a project opens and every instance asks for its
+    // instruments at once, and batch-read the audio they need in the order it's stored on disk. Otherwise
+    // each request's audio is read as soon as the request arrives.
+    Atomic<bool> disk_order_batching {true};
+
     // internal
     AvailableLibraries& available_libraries;
     ThreadPool& thread_pool;
@@ -225,6 +247,12 @@ struct LoadingThread {
     ThreadsafeQueue<QueuedRequest> request_queue {PageAllocator::Instance()};
     WorkSignaller work_signaller {};
     Atomic<bool> debug_dump_current_state {false};
+    detail::AudioAnalysisByHash audio_analysis_by_hash {Malloc::Instance()};
+    struct SchedulingPolicyState {
+        Optional<ThreadSchedulingPolicy> requested;
+        Optional<ThreadSchedulingPolicy> applied; // read back after applying
+    };
+    MutexProtected<SchedulingPolicyState> scheduling_policy {};
 };
 
 inline void ReleaseAll(Span<RefCounted<sample_lib::Library>> libs) {
@@ -244,6 +272,10 @@ Connection& OpenConnection(LoadingThread& thread,
 
 void CloseConnection(LoadingThread& thread, Connection& connection);
 
+// The loading thread applies this to itself next time it wakes up, and logs the result. The thread pool
+// workers have their own policy, given to ThreadPool::Init.
+void SetSchedulingPolicy(LoadingThread& thread, ThreadSchedulingPolicy const& policy);
+
 // If you send another request while one is already pending with the same connection, the instrument loading
 // of the previous request, with the same layer_index will be aborted if needed.
 RequestId SendLoadRequest(LoadingThread& thread, Connection& connection, LoadRequest const& request);
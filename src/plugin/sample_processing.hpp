@@ -52,6 +52,7 @@ inline void DoStereoLagrangeInterp(f32 const* f0,
 }
 
 struct NormalisedLoop {
+    bool operator==(NormalisedLoop const&) const = default;
     u32 start {};
     u32 end {};
     u32 crossfade {};
@@ -354,6 +355,145 @@ inline void SampleGetData(AudioData const& s,
     r = outs[1];
 }
 
+// A copy of the frames [loop.end - loop.crossfade, loop.end) of a regular (non-ping-pong) loop with the loop
+// crossfade already mixed in. When playing forwards inside the loop, reading these frames instead of the
+// originals means the loop is just a plain wrap from end to start.
+struct BakedLoopCrossfade {
+    NormalisedLoop loop;
+    Span<f32 const> interleaved_samples; // loop.crossfade frames, same channel count as the audio
+};
+
+inline bool CanBakeLoopCrossfade(NormalisedLoop const& loop) { return loop.crossfade && !loop.ping_pong; }
+
+PUBLIC BakedLoopCrossfade
+BakeLoopCrossfade(AudioData const& s, NormalisedLoop const& loop, ArenaAllocator& arena) {
+    ASSERT(CanBakeLoopCrossfade(loop));
+    ASSERT(s.channels == 1 || s.channels == 2);
+
+    auto samples = arena.AllocateExactSizeUninitialised<f32>((usize)loop.crossfade * s.channels);
+    auto const first_frame = loop.end - loop.crossfade;
+    for (auto const i : Range(loop.crossfade)) {
+        // At whole frame positions the interpolation is exact, so this is just the runtime crossfade.
+        f32 l;
+        f32 r;
+        SampleGetData(s, loop, loop_and_reverse_flags::InFirstLoop, (f64)(first_frame + i), l, r);
+        samples[i * s.channels] = l;
+        if (s.channels == 2) samples[(i * 2) + 1] = r;
+    }
+
+    return {.loop = loop, .interleaved_samples = samples};
+}
+
+// The same as SampleGetData for forward playback inside the loop, but reads the crossfade region from the
+// baked copy rather than doing a second interpolation and a crossfade.
+inline void SampleGetDataWithBakedLoop(AudioData const& s,
+                                       BakedLoopCrossfade const& baked,
+                                       f64 frame_pos,
+                                       f32& l,
+                                       f32& r) {
+    auto const& loop = baked.loop;
+    ASSERT(frame_pos >= loop.start && frame_pos < loop.end);
+
+    auto const frame_index = (s64)frame_pos;
+    auto const x = (f32)frame_pos - (f32)frame_index;
+
+    auto const loop_size = (s64)(loop.end - loop.start);
+    auto const xm1 = frame_index - 1;
+    auto const x0 = frame_index;
+    auto x1 = frame_index + 1;
+    auto x2 = frame_index + 2;
+    if (x1 >= loop.end) x1 -= loop_size;
+    if (x2 >= loop.end) x2 -= loop_size;
+
+    auto const baked_first_frame = (s64)(loop.end - loop.crossfade);
+    auto const frame_ptr = [&](s64 frame) {
+        if (frame >= baked_first_frame)
+            return baked.interleaved_samples.data + ((frame - baked_first_frame) * s.channels);
+        return s.interleaved_samples.data + (frame * s.channels);
+    };
+
+    if (s.channels == 1) {
+        DoMonoCubicInterp(frame_ptr(x0), frame_ptr(x1), frame_ptr(x2), frame_ptr(xm1), x, l);
+        r = l;
+    } else {
+        DoStereoLagrangeInterp(frame_ptr(x0), frame_ptr(x1), frame_ptr(x2), frame_ptr(xm1), x, l, r);
+    }
+}
+
+// An inclusive range of frame indices.
+struct SampleFrameRange {
+    usize first;
+    usize last;
+};
+
+// Every frame that SampleGetData may read while the playhead moves frames_to_advance frames on from
+// frame_pos. The interpolation reads from one frame behind the playhead to two frames ahead of it. Near the
+// ends of a loop the playhead wraps (regular loops) or turns around (ping-pong loops), and the crossfade
+// reads from the other end or the mirror image, so up to two more ranges are needed.
+inline DynamicArrayInline<SampleFrameRange, 3> SampleFramesToRead(AudioData const& s,
+                                                                  Optional<NormalisedLoop> const opt_loop,
+                                                                  u32 loop_and_reverse_flags,
+                                                                  f64 frame_pos,
+                                                                  f64 frames_to_advance) {
+    using namespace loop_and_reverse_flags;
+    DynamicArrayInline<SampleFrameRange, 3> result {};
+    auto const add = [&](f64 first, f64 last) {
+        auto const max_frame = (f64)(s.num_frames - 1);
+        dyn::Append(result, {(usize)Clamp(first, 0.0, max_frame), (usize)Clamp(last, 0.0, max_frame)});
+    };
+
+    auto const forwards = !(loop_and_reverse_flags & CurrentlyReversed);
+    auto const first = forwards ? frame_pos - 1 : frame_pos - frames_to_advance - 2;
+    auto const last = forwards ? frame_pos + frames_to_advance + 2 : frame_pos + 1;
+    add(first, last);
+
+    if (auto const loop = opt_loop.NullableValue()) {
+        auto const start = (f64)loop->start;
+        auto const end = (f64)loop->end;
+        auto const crossfade = (f64)loop->crossfade;
+        auto const loop_size = end - start;
+        if (!loop->ping_pong) {
+            if (last - first >= loop_size - crossfade) {
+                // It could wrap more than once, so take all of the loop and the crossfade before it.
+                add(start - crossfade - 2, end + 1);
+            } else {
+                if (last >= end - crossfade) add(first - loop_size, last - loop_size);
+                if (first < start) add(first + loop_size, last + loop_size);
+            }
+        } else {
+            if (last - first >= loop_size - crossfade) {
+                // It could turn around more than once, and a step past one end can take it past the other.
+                auto const span = last - first;
+                add(start - span - crossfade, end + span + crossfade);
+            } else {
+                if (last >= end - crossfade) add((2 * end) - last, (2 * end) - first);
+                if (first <= start + crossfade) add((2 * start) - last, (2 * start) - first);
+            }
+        }
+    }
+
+    return result;
+}
+
+// Asks the CPU to start loading every frame that SampleGetData is going to read while the playhead moves
+// frames_to_advance frames on from frame_pos. Sample data is usually far larger than the caches, so with many
+// voices each chunk would otherwise stall on one cache miss after another as the interpolation walks into new
+// cache lines. Requesting them all up front lets the loads overlap with each other and with the work.
+inline void PrefetchSampleData(AudioData const& s,
+                               Optional<NormalisedLoop> const opt_loop,
+                               u32 loop_and_reverse_flags,
+                               f64 frame_pos,
+                               f64 frames_to_advance) {
+    constexpr uintptr k_cache_line_size = 64;
+    for (auto const range :
+         SampleFramesToRead(s, opt_loop, loop_and_reverse_flags, frame_pos, frames_to_advance)) {
+        auto const begin = (uintptr)(s.interleaved_samples.data + (range.first * s.channels));
+        auto const end = (uintptr)(s.interleaved_samples.data + ((range.last + 1) * s.channels));
+        for (auto p = begin & ~(k_cache_line_size - 1); p < end; p += k_cache_line_size)
+            __builtin_prefetch((void const*)p);
+    }
+}
+
 struct IntRange {
     int lo;
     int hi;
@@ -230,6 +230,34 @@ static bool SetIfMatching(String line, String key, Type& value) {
     return false;
 }
 
+static bool SetIfMatching(String line, String key, ThreadPriorityClass& value) {
+    if (auto value_string = ValueIfKeyMatches(line, key)) {
+        // Real-time is reserved for audio threads.
+        for (auto const c : Array {ThreadPriorityClass::Normal,
+                                   ThreadPriorityClass::Background,
+                                   ThreadPriorityClass::Idle}) {
+            if (IsEqualToCaseInsensitiveAscii(*value_string, ToString(c))) {
+                value = c;
+                break;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+static bool SetCpuMaskIfMatching(String line, String key, u64& value) {
+    if (auto value_string = ValueIfKeyMatches(line, key)) {
+        auto const hex = StartsWithSpan(*value_string, "0x"_s);
+        if (auto o = ParseInt(hex ? value_string->SubSpan(2) : *value_string,
+                              hex ? ParseIntBase::Hexadecimal : ParseIntBase::Decimal);
+            o.HasValue())
+            value = (u64)o.Value();
+        return true;
+    }
+    return false;
+}
+
 static void
 Parse(Settings& content, ArenaAllocator& content_allocator, ArenaAllocator& scratch_arena, String file_data) {
     DynamicArray<String> unknown_lines {scratch_arena};
@@ -308,6 +336,19 @@ Parse(Settings& content, ArenaAllocator& content_allocator, ArenaAllocator& scra
         if (SetIfMatching(line, "high_contrast_gui", content.gui.high_contrast_gui)) continue;
         if (SetIfMatching(line, "sort_libraries_alphabetically", content.gui.sort_libraries_alphabetically))
             continue;
+        if (SetIfMatching(line, "max_internal_sample_rate", content.engine.max_internal_sample_rate))
+            continue;
+        if (SetIfMatching(line, "max_convolution_ir_ms", content.engine.max_convolution_ir_ms)) continue;
+        if (SetIfMatching(line, "background_thread_priority", content.engine.background_thread_priority))
+            continue;
+        if (SetIfMatching(line,
+                          "background_threads_low_io_priority",
+                          content.engine.background_threads_low_io_priority))
+            continue;
+        if (SetCpuMaskIfMatching(line,
+                                 "background_threads_cpu_mask",
+                                 content.engine.background_threads_cpu_mask))
+            continue;
 
         dyn::Append(unknown_lines, line);
     }
@@ -340,6 +381,17 @@ ErrorCodeOr<void> WriteFile(Settings const& data, String path) {
     TRY(fmt::AppendLine(writer, "show_keyboard = {}", data.gui.show_keyboard));
     TRY(fmt::AppendLine(writer, "presets_random_mode = {}", data.gui.presets_random_mode));
     TRY(fmt::AppendLine(writer, "window_width = {}", data.gui.window_width));
+    TRY(fmt::AppendLine(writer, "max_internal_sample_rate = {}", data.engine.max_internal_sample_rate));
+    TRY(fmt::AppendLine(writer, "max_convolution_ir_ms = {}", data.engine.max_convolution_ir_ms));
+    TRY(fmt::AppendLine(writer,
+                        "background_thread_priority = {}",
+                        ToString(data.engine.background_thread_priority)));
+    TRY(fmt::AppendLine(writer,
+                        "background_threads_low_io_priority = {}",
+                        data.engine.background_threads_low_io_priority));
+    TRY(fmt::AppendLine(writer,
+                        "background_threads_cpu_mask = 0x{x}",
+                        data.engine.background_threads_cpu_mask));
 
     for (auto p : data.filesystem.extra_libraries_scan_folders)
         TRY(fmt::AppendLine(writer, "extra_libraries_folder = {}", p));
@@ -504,6 +556,11 @@ sort_libraries_alphabetically = true
 show_keyboard = true
 presets_random_mode = 3
 window_width = 1200
+max_internal_sample_rate = 48000
+max_convolution_ir_ms = 3000
+background_thread_priority = idle
+background_threads_low_io_priority = false
+background_threads_cpu_mask = 0xc
 cc_to_param_id_map = 10:1,3,4
 extra_libraries_folder = {ROOT}Libraries
 extra_libraries_folder = {ROOT}Floe Libraries
@@ -539,6 +596,11 @@ non_existent_key = novalue)foo"_s,
         CHECK_EQ(data.gui.show_tooltips, true);
         CHECK_EQ(data.gui.high_contrast_gui, true);
         CHECK_EQ(data.gui.show_keyboard, true);
+        CHECK_EQ(data.engine.max_internal_sample_rate, 48000u);
+        CHECK_EQ(data.engine.max_convolution_ir_ms, 3000u);
+        CHECK(data.engine.background_thread_priority == ThreadPriorityClass::Idle);
+        CHECK_EQ(data.engine.background_threads_low_io_priority, false);
+        CHECK_EQ(data.engine.background_threads_cpu_mask, 0xcull);
 
         CHECK(data.midi.cc_to_param_mapping);
         CHECK_EQ(data.midi.cc_to_param_mapping->cc_num, 10);
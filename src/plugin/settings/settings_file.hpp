@@ -59,6 +59,24 @@ struct Settings {
         u16 window_width {0};
     } gui;
 
+    struct Engine {
+        // At host sample rates above this, the engine runs at a lower rate and its output is upsampled. 0 to
+        // always run at the host's rate. Read by each instance when the host activates it, so a change
+        // applies from the next activation.
+        u32 max_internal_sample_rate {0};
+
+        // Convolution reverb IRs are faded out and cut short at this length to save CPU. 0 to use the whole
+        // audible part of each IR. Shared by all instances; each reads it when it loads an IR, so a change
+        // applies from the next IR load rather than to the IRs already playing.
+        u32 max_convolution_ir_ms {0};
+
+        // Scheduling for the threads that decode samples and scan folders, so that a heavy preset load
+        // doesn't compete with the host's audio threads.
+        ThreadPriorityClass background_thread_priority {ThreadPriorityClass::Background};
+        bool background_threads_low_io_priority {true};
+        u64 background_threads_cpu_mask {0}; // bit N allows logical CPU N, 0 for any
+    } engine;
+
     // We keep hold of entries in the file that we don't use. Other versions of Floe might still want these
     // so lets keep hold of them, and write them back to the file.
     Span<String> unknown_lines_from_file {};
@@ -1787,7 +1787,84 @@ TEST_CASE(TestLoadingOldFiles) {
     return k_success;
 }
 
+TEST_CASE(TestStateSnapshotDiff) {
+    StateSnapshot a {};
+    for (auto [index, param] : Enumerate(a.param_values))
+        param = k_param_infos[index].default_linear_value;
+    for (auto [i, type] : Enumerate(a.fx_order))
+        type = (EffectType)i;
+    a.insts[0] = sample_lib::InstrumentId {.library_name = "lib"_s, .inst_name = "inst"_s};
+    a.insts[1] = WaveformType::Sine;
+    a.ir_index = sample_lib::IrId {.library_name = "lib"_s, .ir_name = "ir"_s};
+    a.engine_version = k_latest_engine_version;
+
+    auto b = a;
+
+    SUBCASE("identical") { CHECK(!DiffStateSnapshots(a, b).Any()); }
+
+    SUBCASE("params") {
+        b.LinearParam(ParamIndex::MasterVolume) = 0.1f;
+        b.LinearParam(ParamIndex::ReverbSize) = 0.2f;
+        auto const diff = DiffStateSnapshots(a, b);
+        CHECK(diff.Any());
+        CHECK_EQ(diff.params.NumSet(), (usize)2);
+        CHECK(diff.params.Get(ToInt(ParamIndex::MasterVolume)));
+        CHECK(diff.params.Get(ToInt(ParamIndex::ReverbSize)));
+        CHECK(!diff.param_learned_ccs.AnyValuesSet());
+        CHECK(!diff.insts.AnyValuesSet());
+        CHECK(!diff.fx_order && !diff.ir && !diff.engine_version);
+    }
+
+    SUBCASE("learned ccs") {
+        b.param_learned_ccs[ToInt(ParamIndex::ReverbMix)].Set(7);
+        auto const diff = DiffStateSnapshots(a, b);
+        CHECK_EQ(diff.param_learned_ccs.NumSet(), (usize)1);
+        CHECK(diff.param_learned_ccs.Get(ToInt(ParamIndex::ReverbMix)));
+        CHECK(!diff.params.AnyValuesSet());
+    }
+
+    SUBCASE("instruments") {
+        b.insts[0] = sample_lib::InstrumentId {.library_name = "lib"_s, .inst_name = "other"_s};
+        b.insts[1] = WaveformType::WhiteNoiseStereo;
+        b.insts[2] = InstrumentType::None;
+        auto const diff = DiffStateSnapshots(a, b);
+        CHECK(diff.insts.Get(0));
+        CHECK(diff.insts.Get(1));
+        CHECK(!diff.insts.Get(2));
+        CHECK(!diff.params.AnyValuesSet());
+
+        auto c = a;
+        c.insts[0] = InstrumentType::None;
+        CHECK_EQ(DiffStateSnapshots(a, c).insts.NumSet(), (usize)1);
+    }
+
+    SUBCASE("fx order") {
+        Swap(b.fx_order[0], b.fx_order[1]);
+        auto const diff = DiffStateSnapshots(a, b);
+        CHECK(diff.fx_order);
+        CHECK(!diff.ir && !diff.engine_version && !diff.insts.AnyValuesSet());
+    }
+
+    SUBCASE("ir") {
+        b.ir_index = nullopt;
+        CHECK(DiffStateSnapshots(a, b).ir);
+        b.ir_index = sample_lib::IrId {.library_name = "lib"_s, .ir_name = "other"_s};
+        CHECK(DiffStateSnapshots(a, b).ir);
+        CHECK(!DiffStateSnapshots(b, b).ir);
+    }
+
+    SUBCASE("engine version") {
+        b.engine_version = 1;
+        auto const diff = DiffStateSnapshots(a, b);
+        CHECK(diff.engine_version);
+        CHECK(!diff.fx_order && !diff.ir);
+    }
+
+    return k_success;
+}
+
 TEST_REGISTRATION(FloeStateCodingTests) {
+    REGISTER_TEST(TestStateSnapshotDiff);
     REGISTER_TEST(TestLoadingOldFiles);
     REGISTER_TEST(TestBackwardCompat);
     REGISTER_TEST(TestFuzzingJsonState);
@@ -23,6 +23,36 @@ struct StateSnapshot {
     Array<Bitset<128>, k_num_parameters> param_learned_ccs {};
 };
 
+// Which parts of a StateSnapshot differ from another. Applying a new state only needs to touch these parts,
+// so switching between similar presets doesn't have to reload everything.
+struct StateSnapshotDiff {
+    bool Any() const {
+        return params.AnyValuesSet() || param_learned_ccs.AnyValuesSet() || insts.AnyValuesSet() ||
+               fx_order || ir || engine_version;
+    }
+
+    Bitset<k_num_parameters> params {};
+    Bitset<k_num_parameters> param_learned_ccs {};
+    Bitset<k_num_layers> insts {};
+    bool fx_order {};
+    bool ir {};
+    bool engine_version {};
+};
+
+inline StateSnapshotDiff DiffStateSnapshots(StateSnapshot const& a, StateSnapshot const& b) {
+    StateSnapshotDiff result {};
+    for (auto const i : Range(k_num_parameters)) {
+        result.params.SetToValue(i, a.param_values[i] != b.param_values[i]);
+        result.param_learned_ccs.SetToValue(i, a.param_learned_ccs[i] != b.param_learned_ccs[i]);
+    }
+    for (auto const i : Range(k_num_layers))
+        result.insts.SetToValue(i, !(a.insts[i] == b.insts[i]));
+    result.fx_order = a.fx_order != b.fx_order;
+    result.ir = a.ir_index != b.ir_index;
+    result.engine_version = a.engine_version != b.engine_version;
+    return result;
+}
+
 enum class StateSource { PresetFile, Daw };
 
 struct StateSnapshotMetadata {
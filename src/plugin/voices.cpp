@@ -11,49 +11,179 @@
 #include "host_thread_pool.hpp"
 #include "layer_processor.hpp"
 #include "param_info.hpp"
+#include "tests/framework.hpp"
 
 static constexpr u32 k_num_frames_in_voice_processing_chunk = 64;
 
-static void FadeOutVoicesToEnsureMaxActive(VoicePool& pool, AudioProcessingContext const& context) {
-    if (pool.num_active_voices.Load() > k_max_num_active_voices) {
-        auto oldest = LargestRepresentableValue<u64>();
-        Voice* oldest_voice = nullptr;
-        for (auto& v : pool.EnumerateActiveVoices()) {
-            if (v.age < oldest && !v.volume_fade.IsFadingOut()) {
-                oldest = v.age;
-                oldest_voice = &v;
-            }
+// The pitch LFO moves slowly compared to the sample rate, so rather than calling Exp2 for every frame we
+// calculate the pitch multiplier exactly every k_pitch_control_interval frames and interpolate exponentially
+// in between; exponential interpolation is just a geometric progression so it only needs multiplies.
+static constexpr u32 k_pitch_control_interval = 16;
+static constexpr f64 k_pitch_lfo_max_semitones = 1;
+
+// Fills multipliers[0, num_frames) with the pitch ratio multiplier for each LFO amount.
+static void FillPitchLfoMultipliers(f64* multipliers, f32 const* lfo_amounts, f64 semitones, u32 num_frames) {
+    ASSERT(num_frames != 0);
+    ASSERT((usize)multipliers % alignof(f64x2) == 0);
+    auto const multiplier_at = [&](u32 frame) {
+        return Exp2(((f64)lfo_amounts[frame] * semitones) / 12.0);
+    };
+
+    auto const last_frame = num_frames - 1;
+    auto multiplier = multiplier_at(0);
+    u32 frame = 0;
+    while (frame != last_frame) {
+        auto const next_frame = Min(frame + k_pitch_control_interval, last_frame);
+        auto const next_multiplier = multiplier_at(next_frame);
+        auto const step = Pow(next_multiplier / multiplier, 1.0 / (f64)(next_frame - frame));
+
+        f64x2 v {multiplier, multiplier * step};
+        f64x2 const step2 = step * step;
+        for (auto f = frame; f < next_frame; f += 2) {
+            StoreToAligned(&multipliers[f], v);
+            v *= step2;
         }
-        if (oldest_voice) oldest_voice->volume_fade.SetAsFadeOut(context.sample_rate);
+
+        frame = next_frame;
+        multiplier = next_multiplier;
     }
+    multipliers[last_frame] = multiplier;
 }
 
-static Voice& FindVoice(VoicePool& pool, AudioProcessingContext const& context) {
-    FadeOutVoicesToEnsureMaxActive(pool, context);
+ModRoutes ActiveModRoutes(VoiceProcessingController const& controller) {
+    ModRoutes result {};
 
-    for (auto& v : pool.voices)
-        if (!v.is_active) return v;
+    // Routes to the same destination are applied in the order they're added here.
+    if (controller.fil_env_amount != 0) {
+        result.Add({
+            .source = ModSource::FilterEnvelope,
+            .destination = ModDestination::FilterCutoff,
+            .depth = controller.fil_env_amount,
+        });
+    }
+
+    if (controller.lfo.on && controller.lfo.amount != 0) {
+        auto const amount = controller.lfo.amount;
+        switch (controller.lfo.dest) {
+            case param_values::LfoDestination::Volume:
+                result.Add({
+                    .source = ModSource::Lfo,
+                    .destination = ModDestination::Volume,
+                    .depth = amount,
+                });
+                break;
+            case param_values::LfoDestination::Filter:
+                result.Add({
+                    .source = ModSource::Lfo,
+                    .destination = ModDestination::FilterCutoff,
+                    .depth = amount / 2,
+                });
+                break;
+            case param_values::LfoDestination::Pan:
+                result.Add({.source = ModSource::Lfo, .destination = ModDestination::Pan, .depth = amount});
+                break;
+            case param_values::LfoDestination::Pitch:
+                result.Add({.source = ModSource::Lfo, .destination = ModDestination::Pitch, .depth = amount});
+                break;
+            case param_values::LfoDestination::Count: PanicIfReached(); break;
+        }
+    }
+
+    return result;
+}
+
+void ApplyModRoutes(ModRoutes const& routes,
+                    ModDestination destination,
+                    ModSourceBuffers const& sources,
+                    f32* values,
+                    u32 num_frames) {
+    ASSERT(destination != ModDestination::Pitch);
+    for (auto const& route : routes.Routes()) {
+        if (route.destination != destination) continue;
+        auto const source = sources[ToInt(route.source)];
+
+        if (destination == ModDestination::Volume) {
+            // Bipolar, but centred below the unmodulated level so that it never gets louder.
+            auto const offset = Fabs(route.depth) / 2;
+            auto const half_depth = route.depth / 2;
+            for (auto const frame : Range(num_frames))
+                values[frame] = (values[frame] - offset) + (source[frame] * half_depth);
+        } else {
+            for (auto const frame : Range(num_frames))
+                values[frame] += source[frame] * route.depth;
+        }
+    }
+}
 
-    DynamicArrayInline<u16, k_num_voices> voice_indexes {};
-    for (auto [i, index] : Enumerate<u16>(voice_indexes))
-        index = i;
-    Sort(voice_indexes, [&voices = pool.voices](u16 a, u16 b) { return voices[a].age < voices[b].age; });
+VoicePool::VoicePool() {
+    for (auto [index, v] : Enumerate<u8>(voices)) {
+        v.index = index;
+        free_voices.PushBack(*this, v);
+    }
+}
+
+static void FadeOutVoicesToEnsureMaxActive(VoicePool& pool, AudioProcessingContext const& context) {
+    if (pool.num_active_voices.Load() <= k_max_num_active_voices) return;
 
-    auto quietest_gain = 1.0f;
-    auto quietest_voice_index = (u16)-1;
-    for (auto const i : Range(k_num_voices / 4)) {
+    // The active list is oldest first so the first voice that isn't already fading out is the oldest.
+    for (auto i = pool.active_voices.first; i != k_invalid_voice_index; i = pool.voices[i].next) {
         auto& v = pool.voices[i];
-        if (v.current_gain < quietest_gain) {
-            quietest_gain = v.current_gain;
-            quietest_voice_index = (u16)i;
+        if (!v.volume_fade.IsFadingOut()) {
+            v.volume_fade.SetAsFadeOut(context.sample_rate);
+            return;
         }
     }
+}
 
-    auto& result = pool.voices[quietest_voice_index];
-    ASSERT(result.is_active);
+// When every voice is in use we have to steal one. We only consider the oldest few voices so that this is
+// constant-time regardless of how many voices there are. Of those, we want the one whose sudden end would be
+// least noticeable: its current gain, scaled down if it's already on its way out, plus a small bias towards
+// older voices to break ties.
+constexpr u32 k_num_voice_steal_candidates = 8;
+constexpr f32 k_steal_weight_fading_out = 0.25f;
+constexpr f32 k_steal_weight_released = 0.5f;
+constexpr f32 k_steal_weight_held = 1.0f;
+constexpr f32 k_steal_cost_per_age_rank = 0.02f;
+
+static f32 VoiceStealCost(Voice const& v, u32 age_rank) {
+    auto weight = k_steal_weight_held;
+    if (v.volume_fade.IsFadingOut())
+        weight = k_steal_weight_fading_out;
+    else if (v.note_off_count != 0 || v.vol_env.state == adsr::State::Release)
+        weight = k_steal_weight_released;
+    return (Clamp01(v.current_gain) * weight) + ((f32)age_rank * k_steal_cost_per_age_rank);
+}
 
-    EndVoiceInstantly(result);
-    return result;
+static Voice& ChooseVoiceToSteal(VoicePool& pool) {
+    Voice* result = nullptr;
+    auto lowest_cost = LargestRepresentableValue<f32>();
+    u32 age_rank = 0;
+    for (auto i = pool.active_voices.first;
+         i != k_invalid_voice_index && age_rank != k_num_voice_steal_candidates;
+         i = pool.voices[i].next, ++age_rank) {
+        auto& v = pool.voices[i];
+        auto const cost = VoiceStealCost(v, age_rank);
+        if (cost < lowest_cost) {
+            lowest_cost = cost;
+            result = &v;
+        }
+    }
+    ASSERT(result);
+    return *result;
+}
+
+static Voice& FindVoice(VoicePool& pool, AudioProcessingContext const& context) {
+    if (pool.free_voices.Empty()) {
+        auto& stolen = ChooseVoiceToSteal(pool);
+        ASSERT(stolen.is_active);
+        EndVoiceInstantly(stolen);
+    }
+
+    FadeOutVoicesToEnsureMaxActive(pool, context);
+
+    auto result = pool.free_voices.PopFront(pool);
+    ASSERT(result && !result->is_active);
+    return *result;
 }
 
 void UpdateLFOWaveform(Voice& v) {
@@ -269,6 +399,10 @@ void UpdateLoopInfo(Voice& v) {
             }
             case param_values::LoopMode::Count: break;
         }
+
+        sampler.baked_loop = nullptr;
+        if (sampler.loop && sampler.region_baked_loop && sampler.region_baked_loop->loop == *sampler.loop)
+            sampler.baked_loop = sampler.region_baked_loop;
     }
 }
 
@@ -309,7 +443,6 @@ void StartVoice(VoicePool& pool,
     voice.vol_env.Gate(true);
     voice.fil_env.Reset();
     voice.fil_env.Gate(true);
-    voice.age = voice.pool.voice_age_counter++;
     voice.id = voice.pool.voice_id_counter++;
     voice.midi_key_trigger = params.midi_key_trigger;
     voice.note_num = params.note_num;
@@ -341,6 +474,7 @@ void StartVoice(VoicePool& pool,
                 s.amp = s_params.amp;
                 s.sampler.region = &s_params.region;
                 s.sampler.data = &s_params.audio_data;
+                s.sampler.region_baked_loop = s_params.baked_loop;
                 ASSERT(s.sampler.data != nullptr);
 
                 voice.smoothing_system.HardSet(s.pitch_ratio_smoother_id,
@@ -353,6 +487,12 @@ void StartVoice(VoicePool& pool,
                 auto const offs =
                     (f64)(sampler.initial_sample_offset01 * ((f32)s.sampler.data->num_frames - 1));
                 s.pos = offs;
+                if (s.sampler.region->options.trim_lead_in) {
+                    // The offset covers just the audible part so that it still reaches the end.
+                    auto const onset = (f64)s.sampler.data->onset_frame;
+                    s.pos = onset + ((f64)sampler.initial_sample_offset01 *
+                                     ((f64)s.sampler.data->num_frames - 1 - onset));
+                }
                 if (voice.controller->reverse) s.pos = (f64)(s.sampler.data->num_frames - Max(offs, 1.0));
             }
             for (u32 i = voice.num_active_voice_samples; i < k_max_num_voice_samples; ++i)
@@ -383,6 +523,8 @@ void StartVoice(VoicePool& pool,
     }
 
     voice.is_active = true;
+    voice.current_gain = 1;
+    voice.pool.active_voices.PushBack(voice.pool, voice);
     voice.pool.num_active_voices.FetchAdd(1);
     voice.pool.voices_per_midi_note_for_gui[voice.midi_key_trigger.note].FetchAdd(1);
 }
@@ -411,11 +553,8 @@ void VoicePool::PrepareToPlay(ArenaAllocator& arena, AudioProcessingContext cons
         buf = Span<f32> {CheckedPointerCast<f32*>(alloc.data), alloc.size / sizeof(f32)};
     }
 
-    int index = 0;
-    for (auto& v : voices) {
-        v.index = (u8)(index++);
+    for (auto& v : voices)
         v.smoothing_system.PrepareToPlay(k_num_frames_in_voice_processing_chunk, context.sample_rate, arena);
-    }
 }
 
 void NoteOff(VoicePool& pool, VoiceProcessingController& controller, MidiChannelNote note) {
@@ -425,6 +564,8 @@ void NoteOff(VoicePool& pool, VoiceProcessingController& controller, MidiChannel
 
 class ChunkwiseVoiceProcessor {
   public:
+    friend struct PerDestinationModulationReference;
+
     ChunkwiseVoiceProcessor(Voice& voice, AudioProcessingContext const& audio_context)
         : m_filter_coeffs(voice.filter_coeffs)
         , m_filters(voice.filters)
@@ -454,20 +595,22 @@ class ChunkwiseVoiceProcessor {
 
         while (num_frames) {
             u32 const chunk_size = Min(num_frames, k_num_frames_in_voice_processing_chunk);
+            m_voice.current_gain = 1;
 
             m_voice.smoothing_system.ProcessBlock(chunk_size);
+            m_mono = m_voice.pool.mono_voice_processing && SourcesAreAllMono();
 
             UpdateLastValidFrame(chunk_size);
-            FillLFOBuffer(chunk_size);
+            EvaluateModulation(chunk_size);
             FillBufferWithSampleData(chunk_size);
 
             auto num_valid_frames = ApplyVolumeEnvelope(chunk_size);
             UpdateLastValidFrame(num_valid_frames);
             num_valid_frames = ApplyGain(num_valid_frames);
             UpdateLastValidFrame(num_valid_frames);
-            ApplyVolumeLFO(num_valid_frames);
-            ApplyPan(num_valid_frames);
-            ApplyFilter(num_valid_frames);
+            ApplyVolumeModulation(num_valid_frames);
+            ApplyPanAndFilter(num_valid_frames);
+            AdvanceFilterEnvelope(chunk_size, num_valid_frames);
 
             auto const samples_to_write = num_valid_frames * 2;
             CheckSamplesAreValid(0, samples_to_write);
@@ -479,7 +622,7 @@ class ChunkwiseVoiceProcessor {
             if (num_valid_frames != chunk_size || !m_voice.num_active_voice_samples) {
                 // We can't do aligned zero because of frames_before_starting
                 ZeroMemory(write_buffer.ToByteSpan());
-                EndVoiceInstantly(m_voice);
+                m_voice.finished_processing = true;
                 break;
             }
 
@@ -507,8 +650,6 @@ class ChunkwiseVoiceProcessor {
                 .sustain_level = (u16)(Clamp01(m_voice.controller->fil_env.sustain_amount) * (f32)UINT16_MAX),
                 .id = m_voice.id,
             });
-
-            m_voice.current_gain = 1;
         }
 
         return samples_written != 0;
@@ -528,26 +669,6 @@ class ChunkwiseVoiceProcessor {
         m_last_frame_in_odd_num_frames = GetLastFrameInOddNumFrames(chunk_size);
     }
 
-    bool HasPitchLfo() const {
-        return m_voice.controller->lfo.on &&
-               m_voice.controller->lfo.dest == param_values::LfoDestination::Pitch;
-    }
-
-    bool HasPanLfo() const {
-        return m_voice.controller->lfo.on &&
-               m_voice.controller->lfo.dest == param_values::LfoDestination::Pan;
-    }
-
-    bool HasFilterLfo() const {
-        return m_voice.controller->lfo.on &&
-               m_voice.controller->lfo.dest == param_values::LfoDestination::Filter;
-    }
-
-    bool HasVolumeLfo() const {
-        return m_voice.controller->lfo.on &&
-               m_voice.controller->lfo.dest == param_values::LfoDestination::Volume;
-    }
-
     static u32 GetLastFrameInOddNumFrames(u32 const num_frames) {
         return ((num_frames % 2) != 0) ? (num_frames - 1) : UINT32_MAX;
     }
@@ -575,21 +696,72 @@ class ChunkwiseVoiceProcessor {
         CheckSamplesAreValid(pos, 4);
     }
 
-    f64 GetPitchRatio(VoiceSample& w, u32 frame) {
-        auto pitch_ratio = m_voice.smoothing_system.Value(w.pitch_ratio_smoother_id, frame);
-        if (HasPitchLfo()) {
-            static constexpr f64 k_max_semitones = 1;
-            auto const lfo_amp = (f64)m_voice.controller->lfo.amount;
-            auto const pitch_addition_in_semitones =
-                ((f64)m_lfo_amounts[(usize)frame] * lfo_amp * k_max_semitones);
-            pitch_ratio *= Exp2(pitch_addition_in_semitones / 12.0);
+    // Multiplies 2 consecutive frames by a gain each, in whichever layout the chunk is using.
+    void MultiplyFramePair(u32 frame, f32 gain1, f32 gain2) {
+        if (m_mono) {
+            m_mono_buffer[frame] *= gain1;
+            m_mono_buffer[frame + 1] *= gain2;
+        } else {
+            MultiplyVectorToBufferAtPos(frame * 2, f32x4 {gain1, gain1, gain2, gain2});
+        }
+    }
+
+    // A mono source has identical left and right channels until the pan, so voices where every source is mono
+    // are processed with one channel up to there, in m_mono_buffer.
+    bool SourcesAreAllMono() const {
+        for (auto const& s : m_voice.voice_samples) {
+            if (!s.is_active) continue;
+            switch (s.generator) {
+                case InstrumentType::None: break;
+                case InstrumentType::Sampler:
+                    if (s.sampler.data->channels != 1) return false;
+                    break;
+                case InstrumentType::WaveformSynth:
+                    if (s.waveform == WaveformType::WhiteNoiseStereo) return false;
+                    break;
+            }
+        }
+        return true;
+    }
+
+    // Fills m_pitch_ratios for the given voice-sample: its smoothed pitch ratio multiplied by the chunk's
+    // pitch LFO trajectory.
+    void FillPitchRatios(VoiceSample& w, u32 num_frames) {
+        for (auto const frame : Range(num_frames))
+            m_pitch_ratios[frame] = m_voice.smoothing_system.Value(w.pitch_ratio_smoother_id, frame);
+
+        if (m_mod_routes.Modulates(ModDestination::Pitch)) {
+            for (u32 frame = 0; frame < num_frames; frame += 2) {
+                auto const ratios = LoadAlignedToType<f64x2>(&m_pitch_ratios[frame]);
+                auto const multipliers = LoadAlignedToType<f64x2>(&m_pitch_lfo_multipliers[frame]);
+                StoreToAligned(&m_pitch_ratios[frame], ratios * multipliers);
+            }
         }
-        return pitch_ratio;
+    }
+
+    f64 GetPitchRatio(u32 frame) const { return m_pitch_ratios[frame]; }
+
+    // How far the playhead moves over the chunk, given the ratios from FillPitchRatios.
+    f64 PlayheadAdvance(u32 num_frames) const {
+        f64 result = 0;
+        for (auto const frame : Range(num_frames))
+            result += m_pitch_ratios[frame];
+        return result;
     }
 
     bool SampleGetAndInc(VoiceSample& w, u32 frame, f32& out_l, f32& out_r) {
-        SampleGetData(*w.sampler.data, w.sampler.loop, w.sampler.loop_and_reverse_flags, w.pos, out_l, out_r);
-        auto const pitch_ratio = GetPitchRatio(w, frame);
+        using namespace loop_and_reverse_flags;
+        if (w.sampler.baked_loop && (w.sampler.loop_and_reverse_flags & InLoopingRegion) &&
+            !(w.sampler.loop_and_reverse_flags & CurrentlyReversed))
+            SampleGetDataWithBakedLoop(*w.sampler.data, *w.sampler.baked_loop, w.pos, out_l, out_r);
+        else
+            SampleGetData(*w.sampler.data,
+                          w.sampler.loop,
+                          w.sampler.loop_and_reverse_flags,
+                          w.pos,
+                          out_l,
+                          out_r);
+        auto const pitch_ratio = GetPitchRatio(frame);
         return IncrementSamplePlaybackPos(w.sampler.loop,
                                           w.sampler.loop_and_reverse_flags,
                                           w.pos,
@@ -606,7 +778,7 @@ class ChunkwiseVoiceProcessor {
                 out_l *= v;
                 out_r *= v;
             } else {
-                auto const pitch_ratio1 = GetPitchRatio(w, frame);
+                auto const pitch_ratio1 = GetPitchRatio(frame);
                 sample_still_going = IncrementSamplePlaybackPos(w.sampler.loop,
                                                                 w.sampler.loop_and_reverse_flags,
                                                                 w.pos,
@@ -620,6 +792,19 @@ class ChunkwiseVoiceProcessor {
     }
 
     bool AddSampleDataOntoBuffer(VoiceSample& w, u32 num_frames) {
+        if (m_mono) {
+            for (auto const frame : Range(num_frames)) {
+                f32 l {};
+                f32 r {}; // the same as l for a mono source
+                auto const sample_still_going = SampleGetAndIncWithXFade(w, frame, l, r);
+                // A separate statement, like the stereo path, so that it isn't contracted into an FMA.
+                auto const v = l * w.amp;
+                m_mono_buffer[frame] += v;
+                if (!sample_still_going) return false;
+            }
+            return true;
+        }
+
         usize sample_pos = 0;
         for (u32 frame = 0; frame < num_frames; frame += 2) {
             f32 sl1 {};
@@ -644,20 +829,30 @@ class ChunkwiseVoiceProcessor {
         return true;
     }
 
-    void ConvertRandomNumsToWhiteNoiseInBuffer(u32 num_frames) {
-        usize sample_pos = 0;
+    // buffer is 16-byte aligned and processed in whole vectors.
+    static void ConvertRandomNumsToWhiteNoiseInBuffer(f32* buffer, u32 num_samples) {
         f32x4 const randon_num_to_01_scale = 1.0f / (f32)0x7FFF;
         f32x4 const scale = 0.5f * 0.2f;
-        for (u32 frame = 0; frame < num_frames; frame += 2) {
-            auto buf = LoadAlignedToType<f32x4>(&m_buffer[sample_pos]);
+        for (u32 sample_pos = 0; sample_pos < num_samples; sample_pos += 4) {
+            auto buf = LoadAlignedToType<f32x4>(&buffer[sample_pos]);
             buf = ((buf * randon_num_to_01_scale) * 2 - 1) * scale;
-            StoreToAligned(&m_buffer[sample_pos], buf);
-            CheckSamplesAreValid(sample_pos, 4);
-            sample_pos += 4;
+            StoreToAligned(&buffer[sample_pos], buf);
         }
     }
 
+    void ConvertRandomNumsToWhiteNoiseInBuffer(u32 num_frames) {
+        ConvertRandomNumsToWhiteNoiseInBuffer(m_buffer.data, (num_frames + (num_frames % 2)) * 2);
+        CheckSamplesAreValid(0, num_frames * 2);
+    }
+
     void FillBufferWithMonoWhiteNoise(u32 num_frames) {
+        if (m_mono) {
+            for (auto const frame : Range(num_frames))
+                m_mono_buffer[frame] = (f32)FastRand(m_voice.pool.random_seed);
+            ConvertRandomNumsToWhiteNoiseInBuffer(m_mono_buffer.data, AlignForward(num_frames, 4u));
+            return;
+        }
+
         usize sample_pos = 0;
         for (u32 frame = 0; frame < num_frames; frame++) {
             auto const rand = (f32)FastRand(m_voice.pool.random_seed);
@@ -688,12 +883,18 @@ class ChunkwiseVoiceProcessor {
         ZeroChunkBuffer(num_frames);
         for (auto& s : m_voice.voice_samples) {
             if (!s.is_active) continue;
+            FillPitchRatios(s, num_frames);
             switch (s.generator) {
                 case InstrumentType::None: {
                     PanicIfReached();
                     break;
                 }
                 case InstrumentType::Sampler: {
+                    PrefetchSampleData(*s.sampler.data,
+                                       s.sampler.loop,
+                                       s.sampler.loop_and_reverse_flags,
+                                       s.pos,
+                                       PlayheadAdvance(num_frames));
                     if (!AddSampleDataOntoBuffer(s, num_frames)) {
                         s.is_active = false;
                         m_voice.num_active_voice_samples--;
@@ -704,38 +905,44 @@ class ChunkwiseVoiceProcessor {
                 case InstrumentType::WaveformSynth: {
                     switch (s.waveform) {
                         case WaveformType::Sine: {
-                            usize sample_pos = 0;
+                            auto next_sample = [&](u32 frame) {
+                                constexpr NormalisedLoop k_loop {
+                                    .start = 0,
+                                    .end = k_sine_audio_data.num_frames,
+                                    .crossfade = 0,
+                                    .ping_pong = false,
+                                };
+
+                                // IMPROVE: use a technique that doesn't produce so much aliasing for
+                                // waveforms. Here we are just using the same method as the sampler.
+
+                                // The sine is mono so both channels are the same.
+                                f32 l;
+                                f32 r;
+                                SampleGetData(k_sine_audio_data,
+                                              k_loop,
+                                              loop_and_reverse_flags::LoopedManyTimes,
+                                              s.pos,
+                                              l,
+                                              r);
+                                auto const pitch_ratio = GetPitchRatio(frame);
+                                s.pos += pitch_ratio;
+                                if (s.pos >= k_loop.end)
+                                    s.pos = (f64)k_loop.start + (s.pos - (f64)k_loop.end);
+                                return l;
+                            };
+
                             for (u32 frame = 0; frame < num_frames; frame += 2) {
-                                alignas(16) f32 samples[4];
-                                for (auto const i : Range(2)) {
-                                    constexpr NormalisedLoop k_loop {
-                                        .start = 0,
-                                        .end = k_sine_audio_data.num_frames,
-                                        .crossfade = 0,
-                                        .ping_pong = false,
-                                    };
-
-                                    // IMPROVE: use a technique that doesn't produce so much aliasing for
-                                    // waveforms. Here we are just using the same method as the sampler.
-
-                                    SampleGetData(k_sine_audio_data,
-                                                  k_loop,
-                                                  loop_and_reverse_flags::LoopedManyTimes,
-                                                  s.pos,
-                                                  samples[i * 2 + 0],
-                                                  samples[i * 2 + 1]);
-                                    auto const pitch_ratio = GetPitchRatio(s, frame);
-                                    s.pos += pitch_ratio;
-                                    if (s.pos >= k_loop.end)
-                                        s.pos = (f64)k_loop.start + (s.pos - (f64)k_loop.end);
+                                auto const s1 = next_sample(frame);
+                                auto const s2 = next_sample(frame + 1);
+                                if (m_mono) {
+                                    m_mono_buffer[frame] = s1 * s.amp;
+                                    m_mono_buffer[frame + 1] = s2 * s.amp;
+                                } else {
+                                    auto v = f32x4 {s1, s1, s2, s2};
+                                    v *= s.amp;
+                                    CopyVectorToBufferAtPos(frame * 2, v);
                                 }
-
-                                // sl2 and sl2 will be 0 if the second sample was not fetched so there is no
-                                // harm in adding that too
-                                auto v = LoadAlignedToType<f32x4>(samples);
-                                v *= s.amp;
-                                CopyVectorToBufferAtPos(sample_pos, v);
-                                sample_pos += 4;
                             }
 
                             break;
@@ -756,25 +963,14 @@ class ChunkwiseVoiceProcessor {
         }
     }
 
-    void ApplyVolumeLFO(u32 num_frames) {
-        usize sample_pos = 0;
+    void ApplyVolumeModulation(u32 num_frames) {
         f32 v1 = 1;
-        if (HasVolumeLfo()) {
-            for (usize frame = 0; frame < num_frames; frame += 2) {
-                static constexpr f32 k_base = 1;
-                auto const lfo_amp = m_voice.controller->lfo.amount;
-
-                // - (lfo_amp/2) because that sounds better
-                auto const b = k_base - (Fabs(lfo_amp) / 2);
-                auto const half_amp = lfo_amp / 2;
-                v1 = b + m_lfo_amounts[frame] * half_amp;
-                auto const v2 = b + m_lfo_amounts[frame + 1] * half_amp;
-                f32x4 v {v1, v1, v2, v2};
-                v = Min<f32x4>(v, 1.0f);
-                v = Max<f32x4>(v, 0.0f);
-
-                MultiplyVectorToBufferAtPos(sample_pos, v);
-                sample_pos += 4;
+        if (m_mod_routes.Modulates(ModDestination::Volume)) {
+            auto const& volume = m_mod_values[ToInt(ModDestination::Volume)];
+            for (u32 frame = 0; frame < num_frames; frame += 2) {
+                v1 = volume[frame];
+                auto const v2 = volume[frame + 1];
+                MultiplyFramePair(frame, Max(Min(v1, 1.0f), 0.0f), Max(Min(v2, 1.0f), 0.0f));
             }
         }
 
@@ -787,17 +983,12 @@ class ChunkwiseVoiceProcessor {
         auto vol_env_params = m_voice.controller->vol_env;
         DEFER { m_voice.vol_env = vol_env; };
 
-        usize sample_pos = 0;
         f32 env1 {};
         for (u32 frame = 0; frame < num_frames; frame += 2) {
             env1 = vol_env.Process(vol_env_params);
             f32 env2 = 1;
             if (frame != m_last_frame_in_odd_num_frames) env2 = vol_env.Process(vol_env_params);
-            if (env_on) {
-                f32x4 const gain {env1, env1, env2, env2};
-                MultiplyVectorToBufferAtPos(sample_pos, gain);
-            }
-            sample_pos += 4;
+            if (env_on) MultiplyFramePair(frame, env1, env2);
 
             if (env_on && vol_env.IsIdle()) return frame;
         }
@@ -808,7 +999,6 @@ class ChunkwiseVoiceProcessor {
     }
 
     u32 ApplyGain(u32 num_frames) {
-        usize sample_pos = 0;
         f32 fade1 {};
         for (u32 frame = 0; frame < num_frames; frame += 2) {
             fade1 = m_voice.volume_fade.GetFade() * m_voice.aftertouch_multiplier;
@@ -816,9 +1006,7 @@ class ChunkwiseVoiceProcessor {
             if (frame != m_last_frame_in_odd_num_frames)
                 fade2 = m_voice.volume_fade.GetFade() * m_voice.aftertouch_multiplier;
 
-            f32x4 const gain {fade1, fade1, fade2, fade2};
-            MultiplyVectorToBufferAtPos(sample_pos, gain);
-            sample_pos += 4;
+            MultiplyFramePair(frame, fade1, fade2);
 
             if (m_voice.volume_fade.IsSilent()) return frame;
         }
@@ -829,98 +1017,204 @@ class ChunkwiseVoiceProcessor {
     }
 
     void ApplyPan(u32 num_frames) {
+        auto const pan_modulated = m_mod_routes.Modulates(ModDestination::Pan);
+        auto const pan_target =
+            m_voice.controller->smoothing_system.TargetValue(m_voice.controller->pan_pos_smoother_id);
+        auto const& pan = m_mod_values[ToInt(ModDestination::Pan)];
+
         usize sample_pos = 0;
         for (auto const frame : Range(num_frames)) {
-            auto pan_pos = m_voice.controller->smoothing_system.Value(m_voice.controller->pan_pos_smoother_id,
-                                                                      m_frame_index + frame);
-
-            bool pan_changed = pan_pos != m_voice.controller->smoothing_system.TargetValue(
-                                              m_voice.controller->pan_pos_smoother_id);
-            if (HasPanLfo()) {
-                auto const& lfo_amp = m_voice.controller->lfo.amount;
-                pan_pos += (m_lfo_amounts[frame] * lfo_amp);
+            auto pan_pos = pan[frame];
+            bool pan_changed = pan_pos != pan_target;
+            if (pan_modulated) {
                 pan_pos = Clamp(pan_pos, -1.0f, 1.0f);
                 pan_changed = true;
             }
             if (pan_changed) SetEqualPan(m_voice, pan_pos);
-            m_buffer[sample_pos++] *= m_voice.amp_l;
-            m_buffer[sample_pos++] *= m_voice.amp_r;
+            if (m_mono) {
+                // This is where a mono chunk becomes stereo.
+                m_buffer[sample_pos++] = m_mono_buffer[frame] * m_voice.amp_l;
+                m_buffer[sample_pos++] = m_mono_buffer[frame] * m_voice.amp_r;
+            } else {
+                m_buffer[sample_pos++] *= m_voice.amp_l;
+                m_buffer[sample_pos++] *= m_voice.amp_r;
+            }
             CheckSamplesAreValid(sample_pos - 2, 2);
         }
     }
 
-    void ApplyFilter(u32 num_frames) {
-        auto const filter_type = m_voice.controller->filter_type;
+    // Whether the pan gains are equal and stay the same for the whole chunk, as they do for a centred voice.
+    bool PanGainsAreEqualThroughout(u32 num_frames) const {
+        if (m_mod_routes.Modulates(ModDestination::Pan)) return false;
+        if (m_voice.amp_l != m_voice.amp_r) return false;
+        auto const pan_target =
+            m_voice.controller->smoothing_system.TargetValue(m_voice.controller->pan_pos_smoother_id);
+        auto const& pan = m_mod_values[ToInt(ModDestination::Pan)];
+        for (auto const frame : Range(num_frames))
+            if (pan[frame] != pan_target) return false;
+        return true;
+    }
 
-        auto fil_env = m_voice.fil_env;
-        auto fil_env_params = m_voice.controller->fil_env;
-        DEFER { m_voice.fil_env = fil_env; };
+    void ApplyPanAndFilter(u32 num_frames) {
+        // The filter comes after the pan. A mono chunk normally becomes stereo at the pan, but if both
+        // channels would get the same gain and the filter channels are in the same state, the channels would
+        // stay identical through the filter too, so we can filter in mono and duplicate afterwards.
+        if (m_mono && PanGainsAreEqualThroughout(num_frames) &&
+            MemoryIsEqual(&m_filters[0], &m_filters[1], sizeof(m_filters[0]))) {
+            for (auto const frame : Range(num_frames))
+                m_mono_buffer[frame] *= m_voice.amp_l;
+            ApplyFilter<1>(m_mono_buffer.data, num_frames);
+            m_filters[1] = m_filters[0];
+
+            for (auto const frame : Range(num_frames)) {
+                m_buffer[(frame * 2) + 0] = m_mono_buffer[frame];
+                m_buffer[(frame * 2) + 1] = m_mono_buffer[frame];
+            }
+            CheckSamplesAreValid(0, num_frames * 2);
+            return;
+        }
+
+        ApplyPan(num_frames);
+        ApplyFilter<2>(m_buffer.data, num_frames);
+    }
+
+    // buffer has k_num_channels interleaved samples per frame.
+    template <u32 k_num_channels>
+    void ApplyFilter(f32* buffer, u32 num_frames) {
+        auto const filter_type = m_voice.controller->filter_type;
+        auto const& cutoff = m_mod_values[ToInt(ModDestination::FilterCutoff)];
 
         usize sample_pos = 0;
         for (u32 frame = 0; frame < num_frames; frame++) {
-            auto env = fil_env.Process(fil_env_params);
             if (auto filter_mix = m_voice.smoothing_system.Value(m_voice.filter_mix_smoother_id, frame);
                 filter_mix != 0) {
-                m_voice.filter_changed |=
-                    m_voice.smoothing_system.IsSmoothing(m_voice.sv_filter_linear_cutoff_smoother_id,
-                                                         frame) ||
-                    m_voice.smoothing_system.IsSmoothing(m_voice.sv_filter_resonance_smoother_id, frame);
-
-                auto cut =
-                    m_voice.smoothing_system.Value(m_voice.sv_filter_linear_cutoff_smoother_id, frame) +
-                    (env - 0.5f) * m_voice.controller->fil_env_amount;
+                auto const cut = cutoff[frame];
                 auto const res =
                     m_voice.smoothing_system.Value(m_voice.sv_filter_resonance_smoother_id, frame);
 
-                if (HasFilterLfo()) {
-                    m_voice.filter_changed = true;
-                    auto const& lfo_amp = m_voice.controller->lfo.amount;
-                    cut += (m_lfo_amounts[(usize)frame] * lfo_amp) / 2;
-                }
-
-                if (fil_env.state != adsr::State::Sustain && m_voice.controller->fil_env_amount != 0)
-                    m_voice.filter_changed = true;
-
-                if (m_voice.filter_changed) {
-                    cut = sv_filter::LinearToHz(Clamp(cut, 0.0f, 1.0f));
-                    m_filter_coeffs.Update(m_audio_context.sample_rate, cut, res);
+                // The coefficients are a function of just these so we only need to recalculate them when
+                // they change, whatever it is that's changing them.
+                if (m_voice.filter_changed || cut != m_voice.filter_coeffs_cutoff ||
+                    res != m_voice.filter_coeffs_resonance) {
+                    m_filter_coeffs.UpdateWithGCoeff(
+                        m_audio_context.coefficient_tables->SvfGCoeff(Clamp(cut, 0.0f, 1.0f)),
+                        res);
+                    m_voice.filter_coeffs_cutoff = cut;
+                    m_voice.filter_coeffs_resonance = res;
                     m_voice.filter_changed = false;
                 }
 
                 if (filter_mix != 1) {
-                    f32 wet_buf[2];
-                    StereoProcess(&m_buffer[sample_pos],
-                                  wet_buf,
-                                  m_filters.data,
-                                  filter_type,
-                                  m_filter_coeffs);
-
-                    for (auto const i : Range(2u)) {
-                        auto& samp = m_buffer[sample_pos + i];
+                    f32 wet_buf[k_num_channels];
+                    for (auto const i : Range(k_num_channels)) {
+                        sv_filter::Process(buffer[sample_pos + i],
+                                           wet_buf[i],
+                                           m_filters[i],
+                                           filter_type,
+                                           m_filter_coeffs);
+                    }
+
+                    for (auto const i : Range(k_num_channels)) {
+                        auto& samp = buffer[sample_pos + i];
                         samp = samp + filter_mix * (wet_buf[i] - samp);
                     }
                 } else {
-                    StereoProcess(&m_buffer[sample_pos], m_filters.data, filter_type, m_filter_coeffs);
+                    for (auto const i : Range(k_num_channels)) {
+                        auto& samp = buffer[sample_pos + i];
+                        sv_filter::Process(samp, samp, m_filters[i], filter_type, m_filter_coeffs);
+                    }
                 }
 
-                CheckSamplesAreValid(sample_pos, 2);
-                sample_pos += 2;
+                sample_pos += k_num_channels;
             } else {
                 m_voice.filters = {};
             }
         }
     }
 
-    void FillLFOBuffer(u32 num_frames) {
+    void EvaluateModulation(u32 num_frames) {
+        m_mod_routes = ActiveModRoutes(*m_voice.controller);
+
+        // Sources. These advance their state even if nothing is routed from them so that they're in the
+        // right place if a route is added later.
         for (auto const i : Range(num_frames)) {
             auto v = m_voice.lfo.Tick();
             constexpr f32 k_lfo_lowpass_smoothing = 0.9f;
             v = m_voice.lfo_smoother.LowPass(v, k_lfo_lowpass_smoothing);
             m_lfo_amounts[i] = -v;
         }
+        {
+            m_fil_env_at_chunk_end = m_voice.fil_env;
+            auto const& fil_env_params = m_voice.controller->fil_env;
+            for (auto const i : Range(num_frames))
+                m_fil_env_amounts[i] = m_fil_env_at_chunk_end.Process(fil_env_params) - 0.5f;
+        }
+
+        ModSourceBuffers sources {};
+        sources[ToInt(ModSource::Lfo)] = m_lfo_amounts.data;
+        sources[ToInt(ModSource::FilterEnvelope)] = m_fil_env_amounts.data;
+
+        // Destinations.
+        if (m_mod_routes.Modulates(ModDestination::Volume)) {
+            // The volume kernel works in pairs of frames.
+            auto const num_volume_frames = num_frames + (num_frames % 2);
+            auto& volume = m_mod_values[ToInt(ModDestination::Volume)];
+            for (auto const frame : Range(num_volume_frames))
+                volume[frame] = 1;
+            ApplyModRoutes(m_mod_routes, ModDestination::Volume, sources, volume.data, num_volume_frames);
+        }
+
+        {
+            auto& pan = m_mod_values[ToInt(ModDestination::Pan)];
+            auto const& controller = *m_voice.controller;
+            for (auto const frame : Range(num_frames))
+                pan[frame] =
+                    controller.smoothing_system.Value(controller.pan_pos_smoother_id, m_frame_index + frame);
+            ApplyModRoutes(m_mod_routes, ModDestination::Pan, sources, pan.data, num_frames);
+        }
+
+        {
+            auto& cutoff = m_mod_values[ToInt(ModDestination::FilterCutoff)];
+            for (auto const frame : Range(num_frames))
+                cutoff[frame] =
+                    m_voice.smoothing_system.Value(m_voice.sv_filter_linear_cutoff_smoother_id, frame);
+            ApplyModRoutes(m_mod_routes, ModDestination::FilterCutoff, sources, cutoff.data, num_frames);
+        }
+
+        // Pitch routes each make a multiplier trajectory, and they combine by multiplying.
+        bool pitch_multipliers_filled = false;
+        for (auto const& route : m_mod_routes.Routes()) {
+            if (route.destination != ModDestination::Pitch) continue;
+            auto const semitones = (f64)route.depth * k_pitch_lfo_max_semitones;
+            auto const source = sources[ToInt(route.source)];
+            if (!Exchange(pitch_multipliers_filled, true)) {
+                FillPitchLfoMultipliers(m_pitch_lfo_multipliers.data, source, semitones, num_frames);
+            } else {
+                alignas(16) Array<f64, k_num_frames_in_voice_processing_chunk> multipliers;
+                FillPitchLfoMultipliers(multipliers.data, source, semitones, num_frames);
+                for (auto const frame : Range(num_frames))
+                    m_pitch_lfo_multipliers[frame] *= multipliers[frame];
+            }
+        }
+    }
+
+    // The filter envelope is evaluated for the whole chunk before we know how many of its frames are valid,
+    // so the voice's envelope only moves on here, by just the valid frames.
+    void AdvanceFilterEnvelope(u32 chunk_size, u32 num_valid_frames) {
+        if (num_valid_frames == chunk_size) {
+            m_voice.fil_env = m_fil_env_at_chunk_end;
+            return;
+        }
+        auto const& fil_env_params = m_voice.controller->fil_env;
+        for (auto _ : Range(num_valid_frames))
+            m_voice.fil_env.Process(fil_env_params);
     }
 
     void ZeroChunkBuffer(u32 num_frames) {
+        if (m_mono) {
+            SimdZeroAlignedBuffer(m_mono_buffer.data, AlignForward(num_frames, 4u));
+            return;
+        }
         auto num_samples = num_frames * 2;
         num_samples += num_samples % 2;
         SimdZeroAlignedBuffer(m_buffer.data, (usize)num_samples);
@@ -935,9 +1229,18 @@ class ChunkwiseVoiceProcessor {
 
     u32 m_frame_index = 0;
     f32 m_position_for_gui = 0;
+    bool m_mono = false; // this chunk is in m_mono_buffer until the pan
 
+    ModRoutes m_mod_routes {};
     alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk + 1> m_lfo_amounts;
+    alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk + 1> m_fil_env_amounts;
+    adsr::Processor m_fil_env_at_chunk_end {};
+    alignas(16) Array<Array<f32, k_num_frames_in_voice_processing_chunk + 1>, k_num_buffered_mod_destinations>
+        m_mod_values;
+    alignas(16) Array<f64, k_num_frames_in_voice_processing_chunk> m_pitch_lfo_multipliers {};
+    alignas(16) Array<f64, k_num_frames_in_voice_processing_chunk> m_pitch_ratios {};
     alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk * 2 + 2> m_buffer;
+    alignas(16) Array<f32, k_num_frames_in_voice_processing_chunk + 4> m_mono_buffer;
 };
 
 inline void ProcessBuffer(Voice& voice, u32 num_frames, AudioProcessingContext const& context) {
@@ -981,6 +1284,8 @@ Array<Span<f32>, k_num_layers> ProcessVoices(VoicePool& pool,
     Array<Span<f32>, k_num_layers> layer_buffers {};
 
     for (auto& v : pool.voices) {
+        if (v.finished_processing) EndVoiceInstantly(v);
+
         if (v.written_to_buffer_this_block) {
             if constexpr (RUNTIME_SAFETY_CHECKS_ON && PRODUCTION_BUILD) {
                 for (auto const frame : Range(num_frames)) {
@@ -1008,3 +1313,1022 @@ Array<Span<f32>, k_num_layers> ProcessVoices(VoicePool& pool,
 
     return layer_buffers;
 }
+
+struct VoiceAllocationTester {
+    VoiceAllocationTester(ArenaAllocator& arena) : controller(smoothing_system) {
+        smoothing_system.PrepareToPlay(context.process_block_size_max, context.sample_rate, arena);
+        smoothing_system.ResetAll();
+        smoothing_system.ProcessBlock(context.process_block_size_max);
+        pool.PrepareToPlay(arena, context);
+        controller.layer_index = 0;
+    }
+
+    Voice& NoteOn(u7 note) {
+        StartVoice(pool,
+                   controller,
+                   {
+                       .initial_pitch = 0,
+                       .midi_key_trigger = {.note = note, .channel = 0},
+                       .note_num = note,
+                       .note_vel = 1,
+                       .lfo_start_phase = 0,
+                       .num_frames_before_starting = 0,
+                       .params = VoiceStartParams::WaveformParams {.type = WaveformType::Sine, .amp = 1},
+                   },
+                   context);
+        return pool.voices[pool.active_voices.last];
+    }
+
+    // Undo the fade-outs that come from exceeding k_max_num_active_voices so that the test controls the state
+    // of each voice.
+    void ClearFadeOuts() {
+        for (auto& v : pool.voices)
+            v.volume_fade.ForceSetFullVolume();
+    }
+
+    Voice& VoiceByAgeRank(u32 rank) {
+        auto i = pool.active_voices.first;
+        for (auto _ : Range(rank))
+            i = pool.voices[i].next;
+        return pool.voices[i];
+    }
+
+    AudioProcessingContext const context {
+        .sample_rate = 44100,
+        .process_block_size_max = 64,
+        .coefficient_tables = &CoefficientTablesForSampleRate(44100),
+    };
+    FloeSmoothedValueSystem smoothing_system;
+    VoiceProcessingController controller;
+    VoicePool pool;
+};
+
+TEST_CASE(TestVoiceAllocation) {
+    auto& t = *tester.scratch_arena.New<VoiceAllocationTester>(tester.scratch_arena);
+    auto& pool = t.pool;
+
+    SUBCASE("free voices are used before stealing") {
+        Bitset<k_num_voices> used {};
+        for (auto const i : Range(k_num_voices)) {
+            auto& v = t.NoteOn((u7)i);
+            CHECK(!used.Get(v.index));
+            used.Set(v.index);
+        }
+        CHECK(pool.free_voices.Empty());
+        CHECK_EQ(pool.num_active_voices.Load(), k_num_voices);
+
+        // Once there are more than k_max_num_active_voices, each new voice fades out the oldest one.
+        u32 num_fading = 0;
+        for (auto const& v : pool.voices)
+            num_fading += v.volume_fade.IsFadingOut();
+        CHECK_EQ(num_fading, k_num_voices - k_max_num_active_voices - 1);
+        CHECK(t.VoiceByAgeRank(0).volume_fade.IsFadingOut());
+        CHECK(!t.VoiceByAgeRank(k_num_voices - 1).volume_fade.IsFadingOut());
+
+        pool.EndAllVoicesInstantly();
+        CHECK_EQ(pool.num_active_voices.Load(), 0u);
+        CHECK(pool.active_voices.Empty());
+    }
+
+    SUBCASE("an ended voice is reused") {
+        auto& a = t.NoteOn(60);
+        t.NoteOn(61);
+        auto const index = a.index;
+        EndVoiceInstantly(a);
+        auto& b = t.NoteOn(62);
+        CHECK_EQ(b.index, index);
+        CHECK_EQ(pool.active_voices.last, index);
+        pool.EndAllVoicesInstantly();
+    }
+
+    SUBCASE("active list is ordered by age") {
+        auto& a = t.NoteOn(60);
+        auto& b = t.NoteOn(61);
+        auto& c = t.NoteOn(62);
+        EndVoiceInstantly(b);
+        CHECK_EQ(pool.active_voices.first, a.index);
+        CHECK_EQ(a.next, c.index);
+        CHECK_EQ(c.prev, a.index);
+        CHECK_EQ(pool.active_voices.last, c.index);
+        pool.EndAllVoicesInstantly();
+    }
+
+    SUBCASE("stealing order") {
+        for (auto const i : Range(k_num_voices))
+            t.NoteOn((u7)i);
+
+        // All held at the same gain: the oldest is stolen.
+        {
+            t.ClearFadeOuts();
+            auto const oldest = t.VoiceByAgeRank(0).index;
+            auto& v = t.NoteOn(100);
+            CHECK_EQ(v.index, oldest);
+        }
+
+        // A released voice is stolen before older held voices.
+        {
+            t.ClearFadeOuts();
+            auto& released = t.VoiceByAgeRank(3);
+            auto const index = released.index;
+            EndVoice(released);
+            CHECK_EQ(t.NoteOn(100).index, index);
+        }
+
+        // A quiet held voice is stolen before a loud released one.
+        {
+            t.ClearFadeOuts();
+            EndVoice(t.VoiceByAgeRank(1));
+            auto& quiet = t.VoiceByAgeRank(4);
+            quiet.current_gain = 0.1f;
+            auto const index = quiet.index;
+            CHECK_EQ(t.NoteOn(100).index, index);
+        }
+
+        // A voice that is fading out is preferred over a released voice of the same gain.
+        {
+            t.ClearFadeOuts();
+            auto& fading = t.VoiceByAgeRank(5);
+            fading.volume_fade.SetAsFadeOut(t.context.sample_rate);
+            auto const index = fading.index;
+            CHECK_EQ(t.NoteOn(100).index, index);
+        }
+
+        // Only the oldest voices are candidates: a silent voice that has only just started isn't stolen.
+        {
+            t.ClearFadeOuts();
+            auto& newest = t.VoiceByAgeRank(k_num_voices - 1);
+            newest.current_gain = 0;
+            auto const index = newest.index;
+            CHECK_NEQ(t.NoteOn(100).index, index);
+        }
+
+        CHECK_EQ(pool.num_active_voices.Load(), k_num_voices);
+        pool.EndAllVoicesInstantly();
+    }
+
+    SUBCASE("note-on burst benchmark") {
+        constexpr u32 k_num_note_ons = 128;
+        constexpr u32 k_num_runs = 100;
+        f64 total_us = 0;
+        f64 worst_us = 0;
+        for (auto _ : Range(k_num_runs)) {
+            Stopwatch const stopwatch;
+            for (auto const note : Range(k_num_note_ons))
+                t.NoteOn((u7)note);
+            auto const us = stopwatch.MicrosecondsElapsed();
+            total_us += us;
+            worst_us = Max(worst_us, us);
+            CHECK_EQ(pool.num_active_voices.Load(), k_num_voices);
+            pool.EndAllVoicesInstantly();
+        }
+        tester.log.DebugLn("{} simultaneous note-ons: average {.2} us, worst {.2} us",
+                           k_num_note_ons,
+                           total_us / k_num_runs,
+                           worst_us);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestBakedLoopCrossfade) {
+    constexpr u32 k_num_frames = 20000;
+    constexpr NormalisedLoop k_loop {.start = 5000, .end = 15000, .crossfade = 2000, .ping_pong = false};
+
+    auto create_audio = [&](u8 channels) {
+        auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames * channels);
+        for (auto const frame : Range(k_num_frames)) {
+            for (auto const chan : Range(channels)) {
+                auto const t = (f32)frame + ((f32)chan * 100);
+                samples[(frame * channels) + chan] = (0.3f * Sin(t * 0.01f)) + (0.2f * Sin((t * 0.037f) + 1));
+            }
+        }
+        return AudioData {
+            .channels = channels,
+            .sample_rate = 44100,
+            .num_frames = k_num_frames,
+            .interleaved_samples = samples,
+        };
+    };
+
+    SUBCASE("matches the runtime crossfade") {
+        for (auto const channels : Array {(u8)1, (u8)2}) {
+            CAPTURE(channels);
+            auto const audio = create_audio(channels);
+            auto const baked = BakeLoopCrossfade(audio, k_loop, tester.scratch_arena);
+            CHECK(baked.loop == k_loop);
+            CHECK_EQ(baked.interleaved_samples.size, (usize)k_loop.crossfade * channels);
+
+            for (auto const flags : Array {(u32)loop_and_reverse_flags::InFirstLoop,
+                                           (u32)loop_and_reverse_flags::LoopedManyTimes}) {
+                f32 max_difference = 0;
+                for (auto pos = (f64)k_loop.start; pos < k_loop.end; pos += 0.37) {
+                    f32 runtime_l;
+                    f32 runtime_r;
+                    SampleGetData(audio, k_loop, flags, pos, runtime_l, runtime_r);
+                    f32 baked_l;
+                    f32 baked_r;
+                    SampleGetDataWithBakedLoop(audio, baked, pos, baked_l, baked_r);
+                    max_difference = Max(max_difference, Abs(runtime_l - baked_l), Abs(runtime_r - baked_r));
+                }
+                tester.log.DebugLn("{} channels, max difference from runtime crossfade: {}",
+                                   channels,
+                                   max_difference);
+                CHECK_LT(max_difference, 0.01f);
+            }
+        }
+    }
+
+    SUBCASE("looped pad voice benchmark") {
+        // A short loop where most of the playback is inside the crossfade, as is common for pads.
+        constexpr NormalisedLoop k_pad_loop {
+            .start = 8000,
+            .end = 12000,
+            .crossfade = 3000,
+            .ping_pong = false,
+        };
+        constexpr u32 k_num_frames_to_render = 44100 * 10;
+        constexpr f64 k_pitch_ratio = 1.1;
+
+        for (auto const channels : Array {(u8)1, (u8)2}) {
+            auto const audio = create_audio(channels);
+            auto const baked = BakeLoopCrossfade(audio, k_pad_loop, tester.scratch_arena);
+
+            auto render = [&](bool use_baked) {
+                u32 flags = loop_and_reverse_flags::InFirstLoop;
+                f64 pos = k_pad_loop.start;
+                f32 sum = 0;
+                Stopwatch const stopwatch;
+                for (auto _ : Range(k_num_frames_to_render)) {
+                    f32 l;
+                    f32 r;
+                    if (use_baked)
+                        SampleGetDataWithBakedLoop(audio, baked, pos, l, r);
+                    else
+                        SampleGetData(audio, k_pad_loop, flags, pos, l, r);
+                    sum += l + r;
+                    IncrementSamplePlaybackPos(k_pad_loop, flags, pos, k_pitch_ratio, k_num_frames);
+                }
+                auto const ms = stopwatch.MillisecondsElapsed();
+                CHECK(Abs(sum) < LargestRepresentableValue<f32>());
+                return ms;
+            };
+
+            auto const runtime_ms = render(false);
+            auto const baked_ms = render(true);
+            tester.log.DebugLn("{} channels, 10s of looped voice: runtime crossfade {.2} ms, baked {.2} ms",
+                               channels,
+                               runtime_ms,
+                               baked_ms);
+        }
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestSamplePrefetching) {
+    // Each voice plays its own long sample, so between them they read from far more memory than the caches
+    // hold, as with a large multisampled instrument.
+    constexpr u32 k_num_voices = 32;
+    constexpr u32 k_num_frames = 1 << 19;
+    constexpr u32 k_num_chunks = 4000;
+    constexpr u32 k_chunk_frames = k_num_frames_in_voice_processing_chunk;
+
+    auto audio = tester.scratch_arena.AllocateExactSizeUninitialised<AudioData>(k_num_voices);
+    for (auto& a : audio) {
+        auto samples = PageAllocator::Instance().AllocateExactSizeUninitialised<f32>(k_num_frames * 2);
+        for (auto [i, s] : Enumerate(samples))
+            s = Sin((f32)i * 0.001f);
+        a = {.channels = 2, .sample_rate = 44100, .num_frames = k_num_frames, .interleaved_samples = samples};
+    }
+    DEFER {
+        for (auto const& a : audio)
+            PageAllocator::Instance().Free(a.interleaved_samples.ToByteSpan());
+    };
+
+    struct BenchmarkVoice {
+        f64 pos;
+        f64 pitch_ratio;
+        u32 flags;
+        Optional<NormalisedLoop> loop;
+    };
+    auto initial_voices = tester.scratch_arena.AllocateExactSizeUninitialised<BenchmarkVoice>(k_num_voices);
+    auto seed = SeedFromTime();
+    for (auto [voice_index, v] : Enumerate(initial_voices)) {
+        v.flags = RandomIntInRange<u32>(seed, 0, 3) == 0 ? loop_and_reverse_flags::CurrentlyReversed : 0;
+        v.pos = RandomFloat01<f64>(seed) * (k_num_frames - 1);
+        v.pitch_ratio = 0.5 + (RandomFloat01<f64>(seed) * 1.5);
+        v.loop = nullopt;
+
+        // Every other voice plays a short loop, so it wraps or turns around many times. Between them they
+        // cover regular and ping-pong loops, with and without a crossfade.
+        if (voice_index % 2) {
+            constexpr u32 k_loop_frames = 3000;
+            auto const start = RandomIntInRange<u32>(seed, 1000, k_num_frames - k_loop_frames - 1000);
+            v.loop = NormalisedLoop {
+                .start = start,
+                .end = start + k_loop_frames,
+                .crossfade = (voice_index % 4 == 1) ? 500u : 0u,
+                .ping_pong = voice_index % 8 >= 5,
+            };
+            v.pos = (f64)(start + 1 + RandomIntInRange<u32>(seed, 0, k_loop_frames - 2));
+            v.flags = loop_and_reverse_flags::CorrectLoopFlagsIfNeeded(v.flags, *v.loop, v.pos);
+        }
+    }
+
+    auto render = [&](bool prefetch, f64& out_ns_per_frame, f64& out_ticks_per_frame) {
+        auto voices = tester.scratch_arena.ShallowClone(initial_voices);
+        f32 sum = 0;
+        Stopwatch const stopwatch;
+        auto const start_ticks = __builtin_readcyclecounter();
+        for (u32 chunk = 0; chunk < k_num_chunks; ++chunk) {
+            for (auto [voice_index, v] : Enumerate(voices)) {
+                auto const& a = audio[voice_index];
+                if (prefetch) PrefetchSampleData(a, v.loop, v.flags, v.pos, v.pitch_ratio * k_chunk_frames);
+                for (u32 frame = 0; frame < k_chunk_frames; ++frame) {
+                    f32 l;
+                    f32 r;
+                    SampleGetData(a, v.loop, v.flags, v.pos, l, r);
+                    sum += l + r;
+                    if (!IncrementSamplePlaybackPos(v.loop, v.flags, v.pos, v.pitch_ratio, k_num_frames))
+                        v.pos = (v.flags & loop_and_reverse_flags::CurrentlyReversed) ? k_num_frames - 1 : 0;
+                }
+            }
+        }
+        auto const ticks = __builtin_readcyclecounter() - start_ticks;
+        auto const total_frames = (f64)k_num_chunks * k_chunk_frames * k_num_voices;
+        out_ns_per_frame = stopwatch.SecondsElapsed() * 1e9 / total_frames;
+        out_ticks_per_frame = (f64)ticks / total_frames;
+        return sum;
+    };
+
+    f64 plain_ns;
+    f64 plain_ticks;
+    auto const plain_sum = render(false, plain_ns, plain_ticks);
+    f64 prefetch_ns;
+    f64 prefetch_ticks;
+    auto const prefetch_sum = render(true, prefetch_ns, prefetch_ticks);
+
+    // Prefetching is only a hint, it must not change what is read.
+    CHECK_EQ(plain_sum, prefetch_sum);
+
+    tester.log.DebugLn("{} voices over {} MB of samples, per voice-frame: without prefetch {.2} ns "
+                       "({.1} ticks), with prefetch {.2} ns ({.1} ticks)",
+                       k_num_voices,
+                       (k_num_voices * k_num_frames * 2 * sizeof(f32)) / Mb(1),
+                       plain_ns,
+                       plain_ticks,
+                       prefetch_ns,
+                       prefetch_ticks);
+
+    return k_success;
+}
+
+TEST_CASE(TestSampleFramesToRead) {
+    // Every frame outside the ranges is NaN while a chunk is read, so if SampleGetData reads any of them,
+    // even with a weight of 0, its output is NaN.
+    constexpr u32 k_num_frames = 2000;
+    constexpr u32 k_num_reads = 6000;
+
+    struct LoopCase {
+        String name;
+        Optional<NormalisedLoop> loop;
+    };
+    auto const loop = [](u32 start, u32 end, u32 crossfade, bool ping_pong) {
+        return NormalisedLoop {.start = start, .end = end, .crossfade = crossfade, .ping_pong = ping_pong};
+    };
+    LoopCase const loop_cases[] = {
+        {"no loop"_s, nullopt},
+        {"regular"_s, loop(600, 1400, 0, false)},
+        {"regular with crossfade"_s, loop(600, 1400, 150, false)},
+        {"regular from the first frame"_s, loop(0, 700, 0, false)},
+        {"short regular with crossfade"_s, loop(600, 650, 40, false)},
+        {"ping-pong"_s, loop(600, 1400, 0, true)},
+        {"ping-pong with crossfade"_s, loop(600, 1400, 150, true)},
+        {"short ping-pong with crossfade"_s, loop(600, 640, 30, true)},
+    };
+
+    for (auto const channels : Array {(u8)1, (u8)2}) {
+        CAPTURE(channels);
+        auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_frames * channels);
+        for (auto& s : samples)
+            s = __builtin_nanf("");
+        AudioData const audio {
+            .channels = channels,
+            .sample_rate = 44100,
+            .num_frames = k_num_frames,
+            .interleaved_samples = samples,
+        };
+        auto fill_ranges = [&](DynamicArrayInline<SampleFrameRange, 3> const& ranges, f32 value) {
+            for (auto const range : ranges)
+                for (auto const i : Range(range.first * channels, (range.last + 1) * channels))
+                    samples[i] = value;
+        };
+
+        for (auto const& loop_case : loop_cases) {
+            CAPTURE(loop_case.name);
+            for (auto const reversed : Array {false, true}) {
+                CAPTURE(reversed);
+                for (auto const pitch_ratio : Array {0.37, 1.0, 2.41}) {
+                    CAPTURE(pitch_ratio);
+                    for (auto const chunk_frames : Array {1u, 16u, k_num_frames_in_voice_processing_chunk}) {
+                        CAPTURE(chunk_frames);
+                        u32 flags = reversed ? loop_and_reverse_flags::CurrentlyReversed : 0;
+                        f64 pos = reversed ? k_num_frames - 1.3 : 0.3;
+                        u32 num_unprefetched_reads = 0;
+
+                        bool ended = false;
+                        for (u32 chunk = 0; chunk < k_num_reads / chunk_frames && !ended; ++chunk) {
+                            auto const ranges = SampleFramesToRead(audio,
+                                                                   loop_case.loop,
+                                                                   flags,
+                                                                   pos,
+                                                                   pitch_ratio * chunk_frames);
+                            fill_ranges(ranges, 0.5f);
+                            for (u32 frame = 0; frame < chunk_frames; ++frame) {
+                                f32 l;
+                                f32 r;
+                                SampleGetData(audio, loop_case.loop, flags, pos, l, r);
+                                if (__builtin_isnan(l) || __builtin_isnan(r)) ++num_unprefetched_reads;
+                                if (!IncrementSamplePlaybackPos(loop_case.loop,
+                                                                flags,
+                                                                pos,
+                                                                pitch_ratio,
+                                                                k_num_frames)) {
+                                    ended = true;
+                                    break;
+                                }
+                            }
+                            fill_ranges(ranges, __builtin_nanf(""));
+                        }
+
+                        CHECK_EQ(num_unprefetched_reads, 0u);
+                        // The playhead must have gone round the loop, rather than never reaching its end.
+                        if (loop_case.loop) CHECK(flags & loop_and_reverse_flags::LoopedManyTimes);
+                    }
+                }
+            }
+        }
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestPitchTrajectory) {
+    constexpr f32 k_sample_rate = 44100;
+    constexpr f64 k_semitones = 1;
+
+    // An LFO as the voices make it: a table-based sine, lowpassed.
+    auto make_lfo_amounts = [&](u32 num_frames, f32 hz) {
+        auto amounts = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(num_frames);
+        LFO lfo {};
+        lfo.SetWaveform(LFO::Waveform::Sine);
+        lfo.SetRate(k_sample_rate, hz);
+        OnePoleLowPassFilter smoother {};
+        for (auto& a : amounts)
+            a = -smoother.LowPass(lfo.Tick(), 0.9f);
+        return amounts;
+    };
+
+    SUBCASE("matches the per-frame calculation") {
+        for (auto const hz : Array {0.5f, 6.0f, 20.0f}) {
+            CAPTURE(hz);
+            constexpr u32 k_num_chunks = 2000;
+            constexpr u32 k_chunk_size = k_num_frames_in_voice_processing_chunk;
+            auto const lfo_amounts = make_lfo_amounts(k_num_chunks * k_chunk_size, hz);
+
+            f64 max_relative_error = 0;
+            f64 pos_per_frame = 0;
+            f64 pos_trajectory = 0;
+            alignas(16) Array<f64, k_chunk_size> multipliers;
+            for (auto const chunk : Range(k_num_chunks)) {
+                // Odd sizes too, as happens at the end of a block.
+                auto const num_frames = (chunk % 7 == 0) ? 37u : k_chunk_size;
+                auto const chunk_amounts = lfo_amounts.data + (chunk * k_chunk_size);
+                FillPitchLfoMultipliers(multipliers.data, chunk_amounts, k_semitones, num_frames);
+                for (auto const frame : Range(num_frames)) {
+                    auto const expected = Exp2(((f64)chunk_amounts[frame] * k_semitones) / 12.0);
+                    auto const relative_error = Fabs(multipliers[frame] - expected) / expected;
+                    max_relative_error = Max(max_relative_error, relative_error);
+                    pos_per_frame += expected;
+                    pos_trajectory += multipliers[frame];
+                }
+            }
+
+            tester.log.DebugLn("{} Hz LFO: max relative error {}, position drift {} frames over {} frames",
+                               hz,
+                               max_relative_error,
+                               pos_trajectory - pos_per_frame,
+                               pos_per_frame);
+            CHECK_LT(max_relative_error, 1e-4);
+            CHECK_LT(Fabs(pos_trajectory - pos_per_frame), 0.5);
+        }
+    }
+
+    SUBCASE("vibrato on 32 voices benchmark") {
+        auto& t = *tester.scratch_arena.New<VoiceAllocationTester>(tester.scratch_arena);
+        t.controller.vol_env_on = false;
+        t.controller.lfo = {
+            .on = true,
+            .shape = param_values::LfoShape::Sine,
+            .dest = param_values::LfoDestination::Pitch,
+            .amount = 1,
+            .time_hz = 6,
+        };
+        for (auto const note : Range(k_max_num_active_voices))
+            t.NoteOn((u7)(40 + note));
+        CHECK_EQ(t.pool.num_active_voices.Load(), k_max_num_active_voices);
+
+        constexpr u32 k_num_blocks = 2000;
+        auto const block_size = t.context.process_block_size_max;
+        Stopwatch const stopwatch;
+        for (auto _ : Range(k_num_blocks))
+            ProcessVoices(t.pool, block_size, t.context, nullptr);
+        auto const seconds_of_audio = (f64)(k_num_blocks * block_size) / (f64)t.context.sample_rate;
+        tester.log.DebugLn("{} voices with vibrato: {.2} ms to render {.2} s",
+                           k_max_num_active_voices,
+                           stopwatch.MillisecondsElapsed(),
+                           seconds_of_audio);
+        CHECK_EQ(t.pool.num_active_voices.Load(), k_max_num_active_voices);
+        t.pool.EndAllVoicesInstantly();
+    }
+
+    return k_success;
+}
+
+// The per-destination code that the routing matrix replaced, for the tests. It checked the LFO's destination
+// directly and added the filter envelope to the cutoff unconditionally.
+struct PerDestinationModulationReference {
+    // Evaluates the modulation for the voice's next chunk, which starts frame_index frames into the block,
+    // and checks that every value the kernels read is what the per-destination code would have calculated.
+    static void CheckNextChunk(tests::Tester& tester,
+                               Voice& voice,
+                               AudioProcessingContext const& context,
+                               u32 frame_index,
+                               u32 num_frames) {
+        ChunkwiseVoiceProcessor processor {voice, context};
+        processor.m_frame_index = frame_index;
+        voice.smoothing_system.ProcessBlock(num_frames);
+        processor.EvaluateModulation(num_frames);
+        processor.AdvanceFilterEnvelope(num_frames, num_frames);
+
+        auto const& controller = *voice.controller;
+        auto const lfo_amount = controller.lfo.amount;
+        auto const lfo_modulates = [&](param_values::LfoDestination dest) {
+            return controller.lfo.on && controller.lfo.dest == dest;
+        };
+        auto const& lfo = processor.m_lfo_amounts;
+        auto const& mod_values = processor.m_mod_values;
+
+        for (auto const frame : Range(num_frames)) {
+            if (lfo_modulates(param_values::LfoDestination::Volume) && lfo_amount != 0) {
+                auto const b = 1 - (Fabs(lfo_amount) / 2);
+                auto const half_amp = lfo_amount / 2;
+                REQUIRE_EQ(mod_values[ToInt(ModDestination::Volume)][frame], b + lfo[frame] * half_amp);
+            }
+
+            auto pan =
+                controller.smoothing_system.Value(controller.pan_pos_smoother_id, frame_index + frame);
+            if (lfo_modulates(param_values::LfoDestination::Pan)) pan += (lfo[frame] * lfo_amount);
+            REQUIRE_EQ(mod_values[ToInt(ModDestination::Pan)][frame], pan);
+
+            auto cut = voice.smoothing_system.Value(voice.sv_filter_linear_cutoff_smoother_id, frame) +
+                       processor.m_fil_env_amounts[frame] * controller.fil_env_amount;
+            if (lfo_modulates(param_values::LfoDestination::Filter)) cut += (lfo[frame] * lfo_amount) / 2;
+            REQUIRE_EQ(mod_values[ToInt(ModDestination::FilterCutoff)][frame], cut);
+        }
+
+        if (lfo_modulates(param_values::LfoDestination::Pitch) && lfo_amount != 0) {
+            alignas(16) Array<f64, k_num_frames_in_voice_processing_chunk> multipliers;
+            FillPitchLfoMultipliers(multipliers.data,
+                                    lfo.data,
+                                    (f64)lfo_amount * k_pitch_lfo_max_semitones,
+                                    num_frames);
+            for (auto const frame : Range(num_frames))
+                REQUIRE_EQ(processor.m_pitch_lfo_multipliers[frame], multipliers[frame]);
+        }
+    }
+};
+
+TEST_CASE(TestModulationMatrix) {
+    auto& t = *tester.scratch_arena.New<VoiceAllocationTester>(tester.scratch_arena);
+    auto& controller = t.controller;
+
+    SUBCASE("only routes that have an effect are gathered") {
+        controller.fil_env_amount = 0;
+        controller.lfo = {.on = false, .dest = param_values::LfoDestination::Volume, .amount = 1};
+        CHECK_EQ(ActiveModRoutes(controller).num_routes, 0u);
+
+        controller.lfo.on = true;
+        controller.lfo.amount = 0;
+        CHECK_EQ(ActiveModRoutes(controller).num_routes, 0u);
+
+        controller.lfo.amount = 0.5f;
+        struct Mapping {
+            param_values::LfoDestination lfo_dest;
+            ModDestination mod_dest;
+        };
+        for (auto const mapping : Array {
+                 Mapping {param_values::LfoDestination::Volume, ModDestination::Volume},
+                 Mapping {param_values::LfoDestination::Filter, ModDestination::FilterCutoff},
+                 Mapping {param_values::LfoDestination::Pan, ModDestination::Pan},
+                 Mapping {param_values::LfoDestination::Pitch, ModDestination::Pitch},
+             }) {
+            CAPTURE(ToInt(mapping.lfo_dest));
+            controller.lfo.dest = mapping.lfo_dest;
+            auto const routes = ActiveModRoutes(controller);
+            REQUIRE_EQ(routes.num_routes, 1u);
+            CHECK(routes.routes[0].source == ModSource::Lfo);
+            CHECK(routes.routes[0].destination == mapping.mod_dest);
+            CHECK_EQ(routes.destinations.NumSet(), (usize)1);
+        }
+
+        controller.lfo.dest = param_values::LfoDestination::Filter;
+        controller.fil_env_amount = 0.25f;
+        auto const routes = ActiveModRoutes(controller);
+        REQUIRE_EQ(routes.num_routes, 2u);
+        CHECK(routes.routes[0].source == ModSource::FilterEnvelope);
+        CHECK(routes.routes[1].source == ModSource::Lfo);
+        CHECK(routes.Modulates(ModDestination::FilterCutoff));
+        CHECK(!routes.Modulates(ModDestination::Pan));
+    }
+
+    // The matrix replaced hand-written code for each destination; it must produce exactly the same values so
+    // that existing presets sound the same.
+    SUBCASE("matches the per-destination calculations") {
+        constexpr u32 k_num_frames = k_num_frames_in_voice_processing_chunk;
+        auto seed = SeedFromTime();
+        auto random_bipolar = [&]() { return (RandomFloat01<f32>(seed) * 2) - 1; };
+
+        alignas(16) Array<f32, k_num_frames> lfo;
+        alignas(16) Array<f32, k_num_frames> env;
+        alignas(16) Array<f32, k_num_frames> base;
+        alignas(16) Array<f32, k_num_frames> values;
+        for (auto const frame : Range(k_num_frames)) {
+            lfo[frame] = random_bipolar();
+            env[frame] = RandomFloat01<f32>(seed) - 0.5f;
+            base[frame] = RandomFloat01<f32>(seed);
+        }
+        ModSourceBuffers sources {};
+        sources[ToInt(ModSource::Lfo)] = lfo.data;
+        sources[ToInt(ModSource::FilterEnvelope)] = env.data;
+
+        for (auto _ : Range(20)) {
+            auto const lfo_amount = random_bipolar();
+            auto const env_amount = random_bipolar();
+            controller.lfo.on = true;
+            controller.lfo.amount = lfo_amount;
+            controller.fil_env_amount = env_amount;
+
+            controller.lfo.dest = param_values::LfoDestination::Volume;
+            for (auto& v : values)
+                v = 1;
+            ApplyModRoutes(ActiveModRoutes(controller),
+                           ModDestination::Volume,
+                           sources,
+                           values.data,
+                           k_num_frames);
+            for (auto const frame : Range(k_num_frames)) {
+                auto const b = 1 - (Fabs(lfo_amount) / 2);
+                CHECK_EQ(values[frame], b + (lfo[frame] * (lfo_amount / 2)));
+            }
+
+            controller.lfo.dest = param_values::LfoDestination::Pan;
+            values = base;
+            ApplyModRoutes(ActiveModRoutes(controller),
+                           ModDestination::Pan,
+                           sources,
+                           values.data,
+                           k_num_frames);
+            for (auto const frame : Range(k_num_frames))
+                CHECK_EQ(values[frame], base[frame] + (lfo[frame] * lfo_amount));
+
+            controller.lfo.dest = param_values::LfoDestination::Filter;
+            values = base;
+            ApplyModRoutes(ActiveModRoutes(controller),
+                           ModDestination::FilterCutoff,
+                           sources,
+                           values.data,
+                           k_num_frames);
+            for (auto const frame : Range(k_num_frames)) {
+                auto const expected =
+                    (base[frame] + (env[frame] * env_amount)) + ((lfo[frame] * lfo_amount) / 2);
+                CHECK_EQ(values[frame], expected);
+            }
+        }
+    }
+
+    // The values being the same isn't enough: they must also be calculated from the right frames of the
+    // sources and smoothed params. So step a voice through a note, chunk by chunk, through a release and a
+    // pan change, checking the values that the kernels read against the per-destination code.
+    SUBCASE("evaluates the same values as the per-destination code") {
+        auto set_envelope = [](adsr::Params& params, f32 sustain) {
+            params.SetSustainAmp(sustain);
+            params.SetAttackSamples(300, 0.1f);
+            params.SetDecaySamples(2000, 0.1f);
+            params.SetReleaseSamples(1500, 0.1f);
+        };
+        controller.vol_env_on = true;
+        set_envelope(controller.vol_env, 0.7f);
+        set_envelope(controller.fil_env, 0.3f);
+        controller.fil_env_amount = 0.4f;
+        controller.filter_on = true;
+        controller.filter_type = sv_filter::Type::Lowpass;
+        controller.sv_filter_cutoff_linear = 0.5f;
+        controller.sv_filter_resonance = 0.5f;
+
+        constexpr u32 k_num_blocks = 200;
+        constexpr u32 k_note_off_block = 100;
+        constexpr u32 k_pan_change_block = 150;
+        constexpr u7 k_note = 63;
+        auto const block_size = t.context.process_block_size_max;
+
+        auto check_note = [&]() {
+            t.smoothing_system.HardSet(controller.pan_pos_smoother_id, 0.2f);
+            t.smoothing_system.ProcessBlock(block_size);
+            auto& voice = t.NoteOn(k_note);
+            for (auto const block : Range(k_num_blocks)) {
+                if (block == k_note_off_block) NoteOff(t.pool, controller, {.note = k_note, .channel = 0});
+                if (block == k_pan_change_block)
+                    t.smoothing_system.Set(controller.pan_pos_smoother_id, -0.5f, 5);
+                t.smoothing_system.ProcessBlock(block_size);
+                for (u32 frame_index = 0; frame_index < block_size;
+                     frame_index += k_num_frames_in_voice_processing_chunk) {
+                    PerDestinationModulationReference::CheckNextChunk(
+                        tester,
+                        voice,
+                        t.context,
+                        frame_index,
+                        Min(block_size - frame_index, k_num_frames_in_voice_processing_chunk));
+                }
+            }
+            t.pool.EndAllVoicesInstantly();
+        };
+
+        controller.lfo.on = false;
+        check_note();
+
+        for (auto const dest : Array {
+                 param_values::LfoDestination::Volume,
+                 param_values::LfoDestination::Filter,
+                 param_values::LfoDestination::Pan,
+                 param_values::LfoDestination::Pitch,
+             }) {
+            CAPTURE(ToInt(dest));
+            controller.lfo = {
+                .on = true,
+                .shape = param_values::LfoShape::Sine,
+                .dest = dest,
+                .amount = -0.6f,
+                .time_hz = 9,
+            };
+            check_note();
+        }
+    }
+
+    SUBCASE("route evaluation benchmark") {
+        constexpr u32 k_num_frames = k_num_frames_in_voice_processing_chunk;
+        alignas(16) Array<f32, k_num_frames> source {};
+        alignas(16) Array<f32, k_num_frames> values {};
+        ModSourceBuffers sources {};
+        for (auto& s : sources)
+            s = source.data;
+
+        constexpr u32 k_num_chunks = 100000;
+        for (auto const num_routes : Range(ModRoutes::k_max_routes + 1)) {
+            ModRoutes routes {};
+            for (auto const i : Range(num_routes))
+                routes.Add({.source = ModSource::Lfo, .destination = ModDestination::Pan, .depth = (f32)i});
+
+            Stopwatch const stopwatch;
+            for (auto _ : Range(k_num_chunks))
+                ApplyModRoutes(routes, ModDestination::Pan, sources, values.data, k_num_frames);
+            CHECK(Abs(values[0]) < LargestRepresentableValue<f32>());
+            tester.log.DebugLn("{} routes: {.2} ms for {} chunks",
+                               num_routes,
+                               stopwatch.MillisecondsElapsed(),
+                               k_num_chunks);
+        }
+    }
+
+    SUBCASE("32 voices with active routes benchmark") {
+        controller.vol_env_on = false;
+        for (auto const note : Range(k_max_num_active_voices))
+            t.NoteOn((u7)(40 + note));
+
+        constexpr u32 k_num_blocks = 2000;
+        auto const block_size = t.context.process_block_size_max;
+        for (auto const num_routes : Range(3u)) {
+            controller.fil_env_amount = num_routes >= 1 ? 0.5f : 0;
+            controller.lfo = {
+                .on = num_routes >= 2,
+                .shape = param_values::LfoShape::Sine,
+                .dest = param_values::LfoDestination::Filter,
+                .amount = 0.5f,
+                .time_hz = 6,
+            };
+            CHECK_EQ(ActiveModRoutes(controller).num_routes, num_routes);
+
+            Stopwatch const stopwatch;
+            for (auto _ : Range(k_num_blocks))
+                ProcessVoices(t.pool, block_size, t.context, nullptr);
+            tester.log.DebugLn("{} voices, {} routes: {.2} ms",
+                               k_max_num_active_voices,
+                               num_routes,
+                               stopwatch.MillisecondsElapsed());
+            CHECK_EQ(t.pool.num_active_voices.Load(), k_max_num_active_voices);
+        }
+        t.pool.EndAllVoicesInstantly();
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestMonoVoiceProcessing) {
+    auto& t = *tester.scratch_arena.New<VoiceAllocationTester>(tester.scratch_arena);
+    auto& controller = t.controller;
+    controller.vol_env_on = false;
+
+    constexpr u32 k_num_audio_frames = 30000;
+    auto samples = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_audio_frames);
+    for (auto const frame : Range(k_num_audio_frames))
+        samples[frame] = (0.3f * Sin((f32)frame * 0.01f)) + (0.2f * Sin(((f32)frame * 0.037f) + 1));
+    AudioData const audio {
+        .channels = 1,
+        .sample_rate = 44100,
+        .num_frames = k_num_audio_frames,
+        .interleaved_samples = samples,
+    };
+    sample_lib::Region const region {.file = {.root_key = 60}};
+    sample_lib::Region const looped_region {
+        .file =
+            {
+                .root_key = 60,
+                .loop = sample_lib::Loop {.start_frame = 8000, .end_frame = 12000, .crossfade_frames = 3000},
+            },
+    };
+
+    auto sampler_params = [&](sample_lib::Region const& r) {
+        VoiceStartParams::SamplerParams params {};
+        dyn::Append(params.voice_sample_params, {.region = r, .audio_data = audio, .amp = 0.8f});
+        return VoiceStartParams::Params {params};
+    };
+
+    auto set_pan = [&](f32 pan) {
+        t.smoothing_system.HardSet(controller.pan_pos_smoother_id, pan);
+        t.smoothing_system.ProcessBlock(t.context.process_block_size_max);
+    };
+
+    // Renders a voice from a fresh start, including the random seed, so that the two layouts can be compared.
+    constexpr u32 k_num_blocks = 300;
+    auto const block_size = t.context.process_block_size_max;
+    auto render = [&](VoiceStartParams::Params const& params, bool mono) {
+        t.pool.mono_voice_processing = mono;
+        t.pool.random_seed = 1234;
+        StartVoice(t.pool,
+                   controller,
+                   {
+                       .initial_pitch = 0,
+                       .midi_key_trigger = {.note = 63, .channel = 0},
+                       .note_num = 63,
+                       .note_vel = 1,
+                       .lfo_start_phase = 0,
+                       .num_frames_before_starting = 0,
+                       .params = params,
+                   },
+                   t.context);
+
+        auto out = tester.scratch_arena.AllocateExactSizeUninitialised<f32>(k_num_blocks * block_size * 2);
+        for (auto const block : Range(k_num_blocks)) {
+            auto const dest = out.SubSpan(block * block_size * 2, block_size * 2);
+            auto const buffers = ProcessVoices(t.pool, block_size, t.context, nullptr);
+            if (buffers[0].size)
+                CopyMemory(dest.data, buffers[0].data, dest.ToByteSpan().size);
+            else
+                ZeroMemory(dest.ToByteSpan());
+        }
+        t.pool.EndAllVoicesInstantly();
+        return out;
+    };
+
+    // Processing in mono is only an optimisation: the output must be exactly the same as the stereo path.
+    auto check_matches_stereo = [&](VoiceStartParams::Params const& params) {
+        auto const stereo = render(params, false);
+        auto const mono = render(params, true);
+        f32 peak = 0;
+        for (auto const i : Range(stereo.size)) {
+            REQUIRE_EQ(stereo[i], mono[i]);
+            peak = Max(peak, Abs(stereo[i]));
+        }
+        CHECK(peak > 0.01f);
+    };
+
+    SUBCASE("centre pan") {
+        set_pan(0);
+        check_matches_stereo(sampler_params(region));
+    }
+
+    SUBCASE("centre pan with filter") {
+        set_pan(0);
+        controller.filter_on = true;
+        controller.sv_filter_cutoff_linear = 0.4f;
+        controller.sv_filter_resonance = 0.6f;
+        check_matches_stereo(sampler_params(region));
+    }
+
+    SUBCASE("off-centre pan with filter") {
+        set_pan(0.6f);
+        controller.filter_on = true;
+        controller.sv_filter_cutoff_linear = 0.4f;
+        controller.sv_filter_resonance = 0.6f;
+        check_matches_stereo(sampler_params(region));
+    }
+
+    SUBCASE("pan lfo") {
+        set_pan(0);
+        controller.filter_on = true;
+        controller.sv_filter_cutoff_linear = 0.5f;
+        controller.lfo = {
+            .on = true,
+            .shape = param_values::LfoShape::Sine,
+            .dest = param_values::LfoDestination::Pan,
+            .amount = 0.7f,
+            .time_hz = 5,
+        };
+        check_matches_stereo(sampler_params(region));
+    }
+
+    SUBCASE("volume lfo") {
+        set_pan(0);
+        controller.lfo = {
+            .on = true,
+            .shape = param_values::LfoShape::Sine,
+            .dest = param_values::LfoDestination::Volume,
+            .amount = 1,
+            .time_hz = 7,
+        };
+        check_matches_stereo(sampler_params(region));
+    }
+
+    SUBCASE("loop crossfade") {
+        set_pan(0);
+        controller.loop_mode = param_values::LoopMode::InstrumentDefault;
+        check_matches_stereo(sampler_params(looped_region));
+    }
+
+    SUBCASE("waveforms") {
+        set_pan(0.3f);
+        for (auto const type : Array {WaveformType::Sine, WaveformType::WhiteNoiseMono}) {
+            CAPTURE(ToInt(type));
+            check_matches_stereo(VoiceStartParams::WaveformParams {.type = type, .amp = 1});
+        }
+    }
+
+    SUBCASE("mono sampler voices benchmark") {
+        set_pan(0);
+        controller.filter_on = true;
+        controller.sv_filter_cutoff_linear = 0.4f;
+        auto const params = sampler_params(looped_region);
+        controller.loop_mode = param_values::LoopMode::InstrumentDefault;
+
+        for (auto const mono : Array {false, true}) {
+            t.pool.mono_voice_processing = mono;
+            for (auto const note : Range(k_max_num_active_voices)) {
+                StartVoice(t.pool,
+                           controller,
+                           {
+                               .initial_pitch = 0,
+                               .midi_key_trigger = {.note = (u7)(40 + note), .channel = 0},
+                               .note_num = (u7)(40 + note),
+                               .note_vel = 1,
+                               .lfo_start_phase = 0,
+                               .num_frames_before_starting = 0,
+                               .params = params,
+                           },
+                           t.context);
+            }
+
+            constexpr u32 k_num_benchmark_blocks = 2000;
+            Stopwatch const stopwatch;
+            for (auto _ : Range(k_num_benchmark_blocks))
+                ProcessVoices(t.pool, block_size, t.context, nullptr);
+            tester.log.DebugLn("{} mono sampler voices processed in {}: {.2} ms",
+                               k_max_num_active_voices,
+                               mono ? "mono"_s : "stereo"_s,
+                               stopwatch.MillisecondsElapsed());
+            CHECK_EQ(t.pool.num_active_voices.Load(), k_max_num_active_voices);
+            t.pool.EndAllVoicesInstantly();
+        }
+    }
+
+    return k_success;
+}
+
+TEST_REGISTRATION(FloeVoicesTests) {
+    REGISTER_TEST(TestVoiceAllocation);
+    REGISTER_TEST(TestBakedLoopCrossfade);
+    REGISTER_TEST(TestSamplePrefetching);
+    REGISTER_TEST(TestSampleFramesToRead);
+    REGISTER_TEST(TestPitchTrajectory);
+    REGISTER_TEST(TestModulationMatrix);
+    REGISTER_TEST(TestMonoVoiceProcessing);
+}
@@ -55,6 +55,8 @@ struct VoiceSample {
         VoiceSmoothedValueSystem::FloatId const xfade_vol_smoother_id;
         u32 loop_and_reverse_flags {};
         Optional<NormalisedLoop> loop {};
+        BakedLoopCrossfade const* region_baked_loop {}; // from the loader, may not match the current loop
+        BakedLoopCrossfade const* baked_loop {}; // non-null if it matches the current loop
     } sampler;
 
     // if generator == SoundGenerator::WaveformSynth
@@ -63,8 +65,69 @@ struct VoiceSample {
     InstrumentType generator {InstrumentType::WaveformSynth};
 };
 
+// Modulation
+// ==========================================================================================================
+// Sources that change within a chunk are routed to destinations by a small modulation matrix. Once per chunk,
+// a voice gathers the active routes from its controller and evaluates them into one buffer per destination.
+// The audio kernels then just read those buffers. Routes that would have no effect aren't gathered at all.
+
+enum class ModSource : u8 {
+    Lfo,
+    FilterEnvelope,
+    Count,
+};
+
+enum class ModDestination : u8 {
+    Volume,
+    Pan,
+    FilterCutoff,
+    Pitch, // a multiplier trajectory rather than a buffer of values, see FillPitchLfoMultipliers
+    Count,
+};
+
+constexpr auto k_num_mod_sources = ToInt(ModSource::Count);
+constexpr auto k_num_mod_destinations = ToInt(ModDestination::Count);
+constexpr auto k_num_buffered_mod_destinations = ToInt(ModDestination::Pitch);
+
+struct ModRoute {
+    ModSource source;
+    ModDestination destination;
+    f32 depth;
+};
+
+struct ModRoutes {
+    static constexpr u32 k_max_routes = 8;
+
+    void Add(ModRoute route) {
+        ASSERT(num_routes < k_max_routes);
+        routes[num_routes++] = route;
+        destinations.Set(ToInt(route.destination));
+    }
+    Span<ModRoute const> Routes() const { return {routes.data, num_routes}; }
+    bool Modulates(ModDestination destination) const { return destinations.Get(ToInt(destination)); }
+
+    Array<ModRoute, k_max_routes> routes;
+    u32 num_routes {};
+    Bitset<k_num_mod_destinations> destinations {};
+};
+
+using ModSourceBuffers = Array<f32 const*, k_num_mod_sources>;
+
+ModRoutes ActiveModRoutes(VoiceProcessingController const& controller);
+
+// Applies every route to the given (buffered) destination, in the order they were added. The buffer should
+// contain the destination's unmodulated values: 1 for volume, otherwise the smoothed parameter value.
+void ApplyModRoutes(ModRoutes const& routes,
+                    ModDestination destination,
+                    ModSourceBuffers const& sources,
+                    f32* values,
+                    u32 num_frames);
+
 struct VoicePool;
 
+constexpr u8 k_invalid_voice_index = 0xff;
+static_assert(k_num_voices < k_invalid_voice_index);
+
 struct Voice {
     NON_COPYABLE_AND_MOVEABLE(Voice);
 
@@ -76,7 +139,6 @@ struct Voice {
     VoiceSmoothedValueSystem smoothing_system;
 
     VoiceProcessingController* controller = {};
-    u64 age = ~(u64)0;
     u16 id {};
     u32 frames_before_starting {};
     f32 current_gain {};
@@ -84,6 +146,14 @@ struct Voice {
     bool is_active {false};
     bool written_to_buffer_this_block = false;
 
+    // Set when the voice finishes while being processed, possibly on another thread. The voice is ended
+    // afterwards on the audio thread so that only that thread touches the pool's voice lists.
+    bool finished_processing = false;
+
+    // Links into either VoicePool::free_voices or VoicePool::active_voices. Audio-thread only.
+    u8 prev = k_invalid_voice_index;
+    u8 next = k_invalid_voice_index;
+
     u8 num_active_voice_samples = 0;
     Array<VoiceSample, k_max_num_voice_samples> voice_samples {
         MakeInitialisedArray<VoiceSample, k_max_num_voice_samples>(smoothing_system)};
@@ -93,6 +163,8 @@ struct Voice {
     u8 index = 0;
 
     bool filter_changed = false;
+    f32 filter_coeffs_cutoff {}; // the cutoff and resonance that filter_coeffs were calculated with
+    f32 filter_coeffs_resonance {};
     sv_filter::CachedHelpers filter_coeffs = {};
     Array<sv_filter::Data, 2> filters = {};
     VoiceSmoothedValueSystem::FloatId const filter_mix_smoother_id = {smoothing_system.CreateSmoother()};
@@ -137,6 +209,8 @@ concept ShouldSkipVoiceFunction = requires(Type function, Voice const& v) {
 };
 
 struct VoicePool {
+    VoicePool();
+
     template <bool k_early_out_if_none_active, ShouldSkipVoiceFunction Function>
     auto EnumerateVoices(Function&& should_skip_voice) {
         struct IterableWrapper {
@@ -193,12 +267,52 @@ struct VoicePool {
     void PrepareToPlay(ArenaAllocator& arena, AudioProcessingContext const& context);
     void EndAllVoicesInstantly();
 
-    u64 voice_age_counter = 0;
+    // Intrusive doubly-linked list of voice indexes, threaded through Voice::prev and Voice::next.
+    struct VoiceList {
+        void PushBack(VoicePool& pool, Voice& v) {
+            v.prev = last;
+            v.next = k_invalid_voice_index;
+            if (last != k_invalid_voice_index)
+                pool.voices[last].next = v.index;
+            else
+                first = v.index;
+            last = v.index;
+        }
+
+        void Remove(VoicePool& pool, Voice& v) {
+            if (v.prev != k_invalid_voice_index)
+                pool.voices[v.prev].next = v.next;
+            else
+                first = v.next;
+            if (v.next != k_invalid_voice_index)
+                pool.voices[v.next].prev = v.prev;
+            else
+                last = v.prev;
+            v.prev = k_invalid_voice_index;
+            v.next = k_invalid_voice_index;
+        }
+
+        Voice* PopFront(VoicePool& pool) {
+            if (first == k_invalid_voice_index) return nullptr;
+            auto& v = pool.voices[first];
+            Remove(pool, v);
+            return &v;
+        }
+
+        bool Empty() const { return first == k_invalid_voice_index; }
+
+        u8 first = k_invalid_voice_index;
+        u8 last = k_invalid_voice_index;
+    };
+
     u16 voice_id_counter = 0;
     Atomic<u32> num_active_voices = 0;
     Array<Voice, k_num_voices> voices {MakeInitialisedArray<Voice, k_num_voices>(*this)};
     Array<Span<f32>, k_num_voices> buffer_pool {};
 
+    VoiceList free_voices {};
+    VoiceList active_voices {}; // oldest first
+
     // TODO(1.0): hide waveform markers for Waveform instruments, only show them for sampled instrument
     Array<Atomic<VoiceWaveformMarkerForGui>, k_num_voices> voice_waveform_markers_for_gui {};
     Array<Atomic<VoiceEnvelopeMarkerForGui>, k_num_voices> voice_vol_env_markers_for_gui {};
@@ -207,6 +321,10 @@ struct VoicePool {
 
     unsigned int random_seed = FastRandSeedFromTime();
 
+    // Voices with only mono sources are processed in mono until the pan. Only turned off by the tests, to
+    // compare against processing everything in stereo.
+    bool mono_voice_processing = true;
+
     struct {
         u32 num_frames = 0;
     } multithread_processing;
@@ -217,6 +335,9 @@ inline void EndVoiceInstantly(Voice& voice) {
     voice.pool.num_active_voices.FetchSub(1);
     voice.pool.voices_per_midi_note_for_gui[voice.midi_key_trigger.note].FetchSub(1);
     voice.is_active = false;
+    voice.finished_processing = false;
+    voice.pool.active_voices.Remove(voice.pool, voice);
+    voice.pool.free_voices.PushBack(voice.pool, voice);
 }
 void EndVoice(Voice& voice);
 
@@ -236,6 +357,7 @@ struct VoiceStartParams {
             sample_lib::Region const& region;
             AudioData const& audio_data;
             f32 amp {};
+            BakedLoopCrossfade const* baked_loop {};
         };
 
         f32 initial_sample_offset01 {};
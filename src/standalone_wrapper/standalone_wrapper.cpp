@@ -17,6 +17,7 @@
 
 #include "os/misc.hpp"
 #include "utils/debug/debug.hpp"
+#include "utils/logger/logger.hpp"
 
 #include "plugin/plugin.hpp"
 #include "plugin/processing/audio_utils.hpp"
@@ -146,6 +147,14 @@ AudioCallback(ma_device* device, void* output_buffer, void const* input, ma_uint
         called_before = true;
         standalone->audio_thread_id.Store(CurrentThreadID(), MemoryOrder::Relaxed);
         SetThreadName("Audio");
+        // The backend doesn't always give its callback thread real-time priority. CoreAudio does, with a
+        // time constraint that matches the device's period, so we leave that alone.
+        if constexpr (!IS_MACOS) {
+            if (auto const o = SetCurrentThreadSchedulingPolicy({.priority = ThreadPriorityClass::RealTime});
+                o.HasError())
+                g_log_file.WarningLn("Couldn't make the audio thread real-time: {}", o.Error());
+        }
+        g_log_file.InfoLn("Audio thread scheduling: {}", CurrentThreadSchedulingPolicy());
         standalone->plugin.start_processing(&standalone->plugin);
         standalone->audio_stream_state.Store(Standalone::AudioStreamState::Open);
     }
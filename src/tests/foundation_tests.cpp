@@ -2703,6 +2703,107 @@ TEST_CASE(TestArenaAllocatorcursor) {
     return k_success;
 }
 
+TEST_CASE(TestArenaAllocatorUsageStats) {
+    LeakDetectingAllocator leak_detecting_allocator;
+
+    SUBCASE("allocations within the first region") {
+        ArenaUsageStats stats {};
+        ArenaAllocator arena {leak_detecting_allocator, 256};
+        arena.TrackUsage(stats);
+        CHECK_EQ(stats.num_regions, (u64)1);
+        CHECK_EQ(stats.num_arenas, (u64)1);
+
+        for (auto _ : Range(10))
+            arena.AllocateExactSizeUninitialised<u8>(10);
+        CHECK_EQ(stats.num_allocations, (u64)10);
+        CHECK_EQ(stats.peak_used, (usize)100);
+        CHECK_EQ(stats.num_overflow_regions, (u64)0);
+
+        // freeing the last allocation moves the cursor back but the peak stays
+        auto last = arena.AllocateExactSizeUninitialised<u8>(50);
+        arena.Free(last.ToByteSpan());
+        CHECK_EQ(stats.num_frees, (u64)1);
+        CHECK_EQ(stats.peak_used, (usize)150);
+        CHECK_EQ(arena.TotalUsed(), (usize)100);
+
+        auto grown = arena.Resize({.allocation = arena.AllocateExactSizeUninitialised<u8>(10).ToByteSpan(),
+                                   .new_size = 100});
+        CHECK_EQ(stats.num_resizes, (u64)1);
+        CHECK_EQ(stats.peak_used, (usize)200);
+        CHECK_EQ(grown.size, (usize)100);
+    }
+
+    SUBCASE("overflow regions") {
+        ArenaUsageStats stats {};
+        {
+            ArenaAllocator arena {leak_detecting_allocator, 64};
+            arena.TrackUsage(stats);
+            arena.AllocateExactSizeUninitialised<u8>(64);
+            CHECK_EQ(stats.num_overflow_regions, (u64)0);
+            arena.AllocateExactSizeUninitialised<u8>(100);
+            CHECK_EQ(stats.num_overflow_regions, (u64)1);
+            arena.AllocateExactSizeUninitialised<u8>(1000);
+            CHECK_EQ(stats.num_overflow_regions, (u64)2);
+            CHECK_EQ(stats.num_regions, (u64)3);
+            // only what was handed out, not the unused ends of the regions that were left behind
+            CHECK_EQ(stats.peak_used, (usize)1164);
+        }
+
+        // the history tells us a size that would have fit everything into the first region
+        auto const recommended = stats.RecommendedInitialSize(64);
+        CHECK_EQ(recommended, (usize)1164);
+
+        ArenaUsageStats second_stats {};
+        {
+            ArenaAllocator arena {leak_detecting_allocator, recommended};
+            arena.TrackUsage(second_stats);
+            arena.AllocateExactSizeUninitialised<u8>(64);
+            arena.AllocateExactSizeUninitialised<u8>(100);
+            arena.AllocateExactSizeUninitialised<u8>(1000);
+        }
+        CHECK_EQ(second_stats.num_overflow_regions, (u64)0);
+        CHECK_EQ(second_stats.num_regions, (u64)1);
+
+        stats.Merge(second_stats);
+        CHECK_EQ(stats.num_arenas, (u64)2);
+        CHECK_EQ(stats.num_allocations, (u64)6);
+        CHECK_EQ(stats.num_overflow_regions, (u64)2);
+    }
+
+    SUBCASE("consolidating regions") {
+        ArenaUsageStats stats {};
+        ArenaAllocator arena {leak_detecting_allocator, 64};
+        arena.TrackUsage(stats);
+        arena.AllocateExactSizeUninitialised<u8>(64);
+        arena.AllocateExactSizeUninitialised<u8>(100);
+        CHECK_EQ(stats.num_regions, (u64)2);
+
+        arena.ResetCursorAndConsolidateRegions();
+        CHECK_EQ(arena.TotalHandedOut(), (usize)0);
+        CHECK_EQ(stats.num_regions, (u64)3);
+
+        arena.AllocateExactSizeUninitialised<u8>(10);
+        CHECK_EQ(arena.TotalHandedOut(), (usize)10);
+        CHECK_EQ(stats.peak_used, (usize)164);
+    }
+
+    SUBCASE("no history") {
+        ArenaUsageStats const stats {};
+        CHECK_EQ(stats.RecommendedInitialSize(1234), (usize)1234);
+    }
+
+    SUBCASE("lazily created first region is not an overflow") {
+        ArenaUsageStats stats {};
+        ArenaAllocator arena {leak_detecting_allocator};
+        arena.TrackUsage(stats);
+        arena.AllocateExactSizeUninitialised<u8>(10);
+        CHECK_EQ(stats.num_regions, (u64)1);
+        CHECK_EQ(stats.num_overflow_regions, (u64)0);
+    }
+
+    return k_success;
+}
+
 TEST_REGISTRATION(RegisterFoundationTests) {
     REGISTER_TEST(TestAllocatorTypes<FixedSizeAllocator<1>>);
     REGISTER_TEST(TestAllocatorTypes<FixedSizeAllocator<16>>);
@@ -2714,6 +2815,7 @@ TEST_REGISTRATION(RegisterFoundationTests) {
     REGISTER_TEST(TestAllocatorTypes<ArenaAllocatorBigBuf>);
     REGISTER_TEST(TestAllocatorTypes<LeakDetectingAllocator>);
     REGISTER_TEST(TestArenaAllocatorcursor);
+    REGISTER_TEST(TestArenaAllocatorUsageStats);
     REGISTER_TEST(TestParseCommandLineArgs);
     REGISTER_TEST(TestAsciiToUppercase);
     REGISTER_TEST(TestAsciiToLowercase);
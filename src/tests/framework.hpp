@@ -110,6 +110,7 @@ struct Tester {
     Optional<String> test_output_folder;
     Optional<String> test_files_folder;
     Optional<Optional<String>> build_resources_folder;
+    bool update_golden_files {}; // re-record reference renders rather than comparing against them
     ArenaAllocator fixture_arena {PageAllocator::Instance()};
     void* fixture_pointer {};
     DeleteFixturePointer delete_fixture {};
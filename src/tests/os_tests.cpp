@@ -125,6 +125,183 @@ TEST_CASE(TestFileApi) {
     return k_success;
 }
 
+TEST_CASE(TestBatchedFileReads) {
+    auto& a = tester.scratch_arena;
+
+    auto reader_outcome = CreateBatchedFileReader(64);
+    if (reader_outcome.HasError()) {
+        tester.log.DebugLn("Batched file reads aren't available: {}", reader_outcome.Error());
+        return k_success;
+    }
+    auto& reader = *reader_outcome.Value();
+    DEFER { CHECK(DestroyBatchedFileReader(&reader)); };
+
+    auto const folder = path::Join(a, Array {tests::TempFolder(tester), "batched_reads"});
+    TRY(CreateDirectory(folder, {.create_intermediate_directories = true}));
+
+    // Various sizes, so that some reads are split into pieces and some aren't.
+    struct TestFile {
+        String path;
+        Span<u8> contents;
+        Optional<File> file;
+    };
+    constexpr u32 k_num_files = 24;
+    auto files = a.NewMultiple<TestFile>(k_num_files);
+    DEFER {
+        for (auto& f : files)
+            f.file.Clear();
+    };
+    auto seed = SeedFromTime();
+    for (auto [file_index, f] : Enumerate<u32>(files)) {
+        f.path = path::Join(a, Array {folder, fmt::Format(a, "{}.dat", file_index)});
+        f.contents = a.AllocateExactSizeUninitialised<u8>(RandomIntInRange<usize>(seed, 1, Mb(2)));
+        for (auto const [i, byte] : Enumerate(f.contents))
+            byte = (u8)((i * 251) + (file_index * 13) + (i >> 11));
+        TRY(WriteFile(f.path, f.contents));
+        f.file.Emplace(TRY(OpenFile(f.path, FileMode::Read)));
+    }
+
+    auto wait_for_all = [&](BatchedReadCallback callback) -> ErrorCodeOr<void> {
+        while (TRY(WaitForBatchedReads(reader, callback)))
+            ;
+        return k_success;
+    };
+
+    SUBCASE("whole files and sections match") {
+        struct Read {
+            u32 file_index;
+            u64 offset;
+            Span<u8> buffer;
+            u32 num_reports;
+        };
+        DynamicArray<Read> reads {a};
+        for (auto const [file_index, f] : Enumerate<u32>(files)) {
+            dyn::Append(reads, {file_index, 0, a.AllocateExactSizeUninitialised<u8>(f.contents.size), 0});
+            auto const offset = RandomIntInRange<usize>(seed, 0, f.contents.size - 1);
+            auto const size = RandomIntInRange<usize>(seed, 1, f.contents.size - offset);
+            dyn::Append(reads, {file_index, offset, a.AllocateExactSizeUninitialised<u8>(size), 0});
+        }
+        for (auto const [read_index, r] : Enumerate(reads))
+            QueueBatchedRead(reader,
+                             {
+                                 .file = *files[r.file_index].file,
+                                 .offset = r.offset,
+                                 .buffer = r.buffer,
+                                 .user_data = read_index,
+                             });
+
+        TRY(wait_for_all([&](uintptr read_index, ErrorCodeOr<void> result) {
+            CHECK(result.Succeeded());
+            ++reads[read_index].num_reports;
+        }));
+
+        for (auto const& r : reads) {
+            CAPTURE(r.file_index);
+            CAPTURE(r.offset);
+            CHECK_EQ(r.num_reports, 1u);
+            auto const expected = files[r.file_index].contents.SubSpan(r.offset, r.buffer.size);
+            CHECK(MemoryIsEqual(r.buffer.data, expected.data, expected.size));
+        }
+
+        // Nothing is left over.
+        auto const waited = TRY(WaitForBatchedReads(reader, [&](uintptr, ErrorCodeOr<void>) {}));
+        CHECK(!waited);
+    }
+
+    SUBCASE("reading past the end is an error") {
+        auto& f = files[0];
+        auto buffer = a.AllocateExactSizeUninitialised<u8>(f.contents.size + 100);
+        QueueBatchedRead(reader, {.file = *f.file, .offset = 0, .buffer = buffer, .user_data = 1});
+        u32 num_errors = 0;
+        TRY(wait_for_all([&](uintptr user_data, ErrorCodeOr<void> result) {
+            CHECK_EQ(user_data, 1u);
+            if (result.HasError()) ++num_errors;
+        }));
+        CHECK_EQ(num_errors, 1u);
+    }
+
+    SUBCASE("throughput with a cold page cache") {
+        usize total_bytes = 0;
+        for (auto const& f : files)
+            total_bytes += f.contents.size;
+        auto buffers = a.NewMultiple<Span<u8>>(files.size);
+        for (auto const [i, f] : Enumerate(files))
+            buffers[i] = a.AllocateExactSizeUninitialised<u8>(f.contents.size);
+
+        auto const log_throughput = [&](String name, f64 seconds) {
+            tester.log.DebugLn("Reading {} files, {} MB, {}: {.1} MB/s",
+                               files.size,
+                               total_bytes / Mb(1),
+                               name,
+                               ((f64)total_bytes / (f64)Mb(1)) / seconds);
+        };
+
+        // Some filesystems, such as tmpfs, keep the pages anyway.
+        for (auto const& f : files)
+            TRY(EvictFileFromPageCache(f.path));
+        {
+            Stopwatch const stopwatch;
+            for (auto const [i, f] : Enumerate(files)) {
+                TRY(f.file->Seek(0, File::SeekOrigin::Start));
+                TRY(f.file->Read(buffers[i].data, buffers[i].size));
+            }
+            log_throughput("one blocking read at a time", stopwatch.SecondsElapsed());
+        }
+
+        for (auto const& f : files)
+            TRY(EvictFileFromPageCache(f.path));
+        {
+            Stopwatch const stopwatch;
+            for (auto const [i, f] : Enumerate(files)) {
+                QueueBatchedRead(reader,
+                                 {.file = *f.file, .offset = 0, .buffer = buffers[i], .user_data = i});
+            }
+            TRY(wait_for_all([&](uintptr, ErrorCodeOr<void> result) { CHECK(result.Succeeded()); }));
+            log_throughput("batched", stopwatch.SecondsElapsed());
+        }
+
+        for (auto const [i, f] : Enumerate(files))
+            CHECK(MemoryIsEqual(buffers[i].data, f.contents.data, f.contents.size));
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestDiskLocation) {
+    auto& a = tester.scratch_arena;
+    auto const folder = path::Join(a, Array {tests::TempFolder(tester), "disk_location"});
+    TRY(CreateDirectory(folder, {.create_intermediate_directories = true}));
+
+    auto contents = a.AllocateExactSizeUninitialised<u8>(Kb(64));
+    FillMemory(contents, 1);
+    auto const path1 = path::Join(a, Array {folder, "1.dat"_s});
+    auto const path2 = path::Join(a, Array {folder, "2.dat"_s});
+    TRY(WriteFile(path1, contents));
+    TRY(WriteFile(path2, contents));
+    auto file1 = TRY(OpenFile(path1, FileMode::Read));
+    auto file2 = TRY(OpenFile(path2, FileMode::Read));
+
+    auto const start_outcome = DiskLocation(file1, 0);
+    if (start_outcome.HasError()) {
+        tester.log.DebugLn("Disk locations aren't available: {}", start_outcome.Error());
+        return k_success;
+    }
+    auto const start = start_outcome.Value();
+    auto const later = TRY(DiskLocation(file1, Kb(32)));
+    auto const other = TRY(DiskLocation(file2, 0));
+    tester.log.DebugLn("physical offset known: {}", start.physical_offset.HasValue());
+
+    CHECK_EQ(start.device, later.device);
+    CHECK_EQ(start.file_id, later.file_id);
+    CHECK_EQ(later.offset_in_file, (u64)Kb(32));
+    CHECK_NEQ(start.file_id, other.file_id);
+    CHECK(!DiskLocationLessThan(start, start));
+    CHECK_NEQ(DiskLocationLessThan(start, other), DiskLocationLessThan(other, start));
+    if (!start.physical_offset) CHECK(DiskLocationLessThan(start, later));
+
+    return k_success;
+}
+
 TEST_CASE(TestFilesystem) {
     auto& a = tester.scratch_arena;
 
@@ -605,6 +782,212 @@ TEST_CASE(TestThread) {
     return k_success;
 }
 
+TEST_CASE(TestThreadSchedulingPolicy) {
+    struct Result {
+        Optional<ErrorCode> error;
+        ThreadSchedulingPolicy applied;
+    };
+    // A fresh thread each time: lowering a thread's priority can't always be undone without privileges.
+    auto apply_on_new_thread = [](ThreadSchedulingPolicy const& policy) {
+        Result result {};
+        Thread thread;
+        thread.Start(
+            [&]() {
+                auto const outcome = SetCurrentThreadSchedulingPolicy(policy);
+                if (outcome.HasError()) result.error = outcome.Error();
+                result.applied = CurrentThreadSchedulingPolicy();
+            },
+            "sched test");
+        thread.Join();
+        return result;
+    };
+
+    SUBCASE("background classes") {
+        for (auto const priority : Array {ThreadPriorityClass::Background, ThreadPriorityClass::Idle}) {
+            for (auto const low_io_priority : Array {false, true}) {
+                CAPTURE(ToString(priority));
+                CAPTURE(low_io_priority);
+                auto const r = apply_on_new_thread({
+                    .priority = priority,
+                    .low_io_priority = low_io_priority,
+                });
+                if (r.error) tester.log.DebugLn("Error: {}", *r.error);
+                CHECK(!r.error);
+                CHECK(r.applied.priority == priority);
+                CHECK_EQ(r.applied.low_io_priority, low_io_priority);
+            }
+        }
+    }
+
+    if constexpr (!IS_MACOS) {
+        SUBCASE("cpu affinity") {
+            auto const allowed_cpus = CurrentThreadSchedulingPolicy().cpu_affinity_mask;
+            REQUIRE(allowed_cpus != 0);
+            auto const lowest_allowed_cpu = allowed_cpus & (~allowed_cpus + 1);
+            auto const r = apply_on_new_thread({.cpu_affinity_mask = lowest_allowed_cpu});
+            CHECK(!r.error);
+            CHECK_EQ(r.applied.cpu_affinity_mask, lowest_allowed_cpu);
+        }
+    }
+
+    SUBCASE("real-time") {
+        // Usually needs privileges that the test runner won't have, so we only check that success is honest.
+        auto const r = apply_on_new_thread({.priority = ThreadPriorityClass::RealTime});
+        tester.log.DebugLn("Real-time scheduling: {}", r.error ? "not permitted"_s : "applied"_s);
+        if (!r.error) CHECK(r.applied.priority == ThreadPriorityClass::RealTime);
+    }
+
+    return k_success;
+}
+
+TEST_CASE(TestPageCache) {
+    auto const page_size = GetSystemStats().page_size;
+    auto const largest_class =
+        (usize)page_cache::k_size_class_num_pages[page_cache::k_num_size_classes - 1] * page_size;
+
+    SUBCASE("size classes") {
+        CHECK_EQ(page_cache::SpanSize(1), (usize)page_size);
+        CHECK_EQ(page_cache::SpanSize(page_size), (usize)page_size);
+        CHECK_EQ(page_cache::SpanSize(page_size + 1), (usize)page_size * 2);
+        CHECK_EQ(page_cache::SpanSize(page_size * 5), (usize)page_size * 6);
+        CHECK_EQ(page_cache::SpanSize(largest_class + 1), largest_class + page_size);
+    }
+
+    SUBCASE("freed spans are reused") {
+        auto const span_size = page_cache::SpanSize(page_size * 3);
+        auto p1 = page_cache::Allocate(span_size, span_size);
+        REQUIRE(p1);
+        FillMemory({(u8*)p1, span_size}, 0xff);
+        page_cache::Free(p1, span_size);
+        auto const before = page_cache::GetStats();
+        auto const num_used_bytes = (page_size * 2) + 1;
+        auto p2 = page_cache::Allocate(span_size, num_used_bytes);
+        REQUIRE(p2);
+        auto const after = page_cache::GetStats();
+        // like fresh pages from the OS, as far as the caller can see
+        bool all_zero = true;
+        for (auto const b : Span<u8 const> {(u8 const*)p2, num_used_bytes})
+            if (b) all_zero = false;
+        CHECK(all_zero);
+        page_cache::Free(p2, span_size);
+        CHECK_EQ(after.num_cache_hits - before.num_cache_hits, (u64)1);
+        CHECK_EQ(after.num_os_allocations, before.num_os_allocations);
+    }
+
+    SUBCASE("PageAllocator shrink to a smaller size class") {
+        auto& a = PageAllocator::Instance();
+        auto data = a.Allocate({.size = page_size * 6, .alignment = 1, .allow_oversized_result = false});
+        FillMemory(data, 'a');
+        auto const resized = a.Resize({.allocation = data, .new_size = page_size});
+        CHECK_EQ(resized.size, (usize)page_size);
+        CHECK_EQ(resized[page_size - 1], (u8)'a');
+        a.Free(resized);
+    }
+
+    SUBCASE("PageAllocator resize within a span") {
+        auto& a = PageAllocator::Instance();
+        auto data = a.Allocate({.size = 10, .alignment = 1, .allow_oversized_result = false});
+        FillMemory(data, 'a');
+        auto const resized = a.Resize({.allocation = data, .new_size = page_size / 2});
+        CHECK(resized.data == data.data);
+        CHECK_EQ(resized[9], (u8)'a');
+        a.Free(resized);
+    }
+
+    SUBCASE("retained size is bounded") {
+        DynamicArray<void*> ptrs {tester.scratch_arena};
+        for (auto _ : Range(page_cache::k_slots_per_size_class * 2))
+            dyn::Append(ptrs, page_cache::Allocate(largest_class));
+        for (auto p : ptrs)
+            page_cache::Free(p, largest_class);
+        CHECK_LTE(page_cache::GetStats().retained_bytes, page_cache::k_max_retained_bytes);
+        page_cache::ReleaseAll();
+        CHECK_EQ(page_cache::GetStats().retained_bytes, (usize)0);
+    }
+
+    SUBCASE("multithreaded stress") {
+        constexpr usize k_num_threads = 8;
+        constexpr usize k_num_iterations = 5000;
+        Atomic<u32> num_corrupted {0};
+        Thread threads[k_num_threads];
+        for (auto const thread_index : Range(k_num_threads)) {
+            threads[thread_index].Start(
+                [&num_corrupted, thread_index, page_size]() {
+                    struct Allocation {
+                        Span<u8> data;
+                        u8 fill;
+                    };
+                    Allocation allocs[16] {};
+                    u64 seed = SeedFromTime() + thread_index;
+                    auto& a = PageAllocator::Instance();
+                    for (auto const i : Range(k_num_iterations)) {
+                        auto& alloc = allocs[RandomIntInRange<usize>(seed, 0, ArraySize(allocs) - 1)];
+                        if (alloc.data.size) {
+                            for (auto b : alloc.data)
+                                if (b != alloc.fill) {
+                                    num_corrupted.FetchAdd(1);
+                                    break;
+                                }
+                            a.Free(alloc.data);
+                            alloc.data = {};
+                        } else {
+                            auto const size = RandomIntInRange<usize>(seed, 1, page_size * 40);
+                            alloc.data = a.Allocate({.size = size, .alignment = 1});
+                            alloc.fill = (u8)(thread_index * 31 + i);
+                            FillMemory(alloc.data, alloc.fill);
+                        }
+                    }
+                    for (auto& alloc : allocs)
+                        if (alloc.data.size) a.Free(alloc.data);
+                },
+                "page-cache");
+        }
+        for (auto& t : threads)
+            t.Join();
+        CHECK_EQ(num_corrupted.Load(), 0u);
+        CHECK_LTE(page_cache::GetStats().retained_bytes, page_cache::k_max_retained_bytes);
+    }
+
+    SUBCASE("syscalls during preset switching") {
+        // Roughly what happens when switching presets: the loader creates and throws away a scratch arena per
+        // job, and effects reallocate their delay buffers for the new settings.
+        auto const run_workload = [&]() {
+            auto const before = page_cache::GetStats();
+            Stopwatch const stopwatch;
+            for (auto const preset_index : Range(200u)) {
+                {
+                    ArenaAllocator job_arena {PageAllocator::Instance()};
+                    for (auto const i : Range(40u))
+                        job_arena.AllocateExactSizeUninitialised<u8>(Kb(1) + (i * Kb(3)));
+                }
+                for (auto const sample_rate : Array {44100.0f, 48000.0f}) {
+                    auto const num_frames = (usize)((f32)(2 + (preset_index % 4)) / 1000 * sample_rate);
+                    auto buffer = PageAllocator::Instance().AllocateExactSizeUninitialised<f32>(num_frames * 2);
+                    PageAllocator::Instance().Free(buffer.ToByteSpan());
+                }
+            }
+            auto const after = page_cache::GetStats();
+            tester.log.DebugLn(
+                "Preset switching: {} allocations, {} frees, {} syscalls ({} maps, {} unmaps), {}",
+                after.num_allocations - before.num_allocations,
+                after.num_frees - before.num_frees,
+                (after.num_os_allocations - before.num_os_allocations) +
+                    (after.num_os_frees - before.num_os_frees),
+                after.num_os_allocations - before.num_os_allocations,
+                after.num_os_frees - before.num_os_frees,
+                stopwatch);
+            return after.num_os_allocations - before.num_os_allocations;
+        };
+
+        page_cache::ReleaseAll();
+        auto const cold_os_allocations = run_workload();
+        auto const warm_os_allocations = run_workload();
+        CHECK_LT(warm_os_allocations, cold_os_allocations);
+    }
+
+    return k_success;
+}
+
 TEST_REGISTRATION(RegisterOsTests) {
     REGISTER_TEST(TestEpochTime);
     REGISTER_TEST(TestThread);
@@ -612,7 +995,11 @@ TEST_REGISTRATION(RegisterOsTests) {
     REGISTER_TEST(TestMutex);
     REGISTER_TEST(TestFilesystem);
     REGISTER_TEST(TestFileApi);
+    REGISTER_TEST(TestBatchedFileReads);
+    REGISTER_TEST(TestDiskLocation);
     REGISTER_TEST(TestReadingDirectoryChanges);
     REGISTER_TEST(TestFileApi);
     REGISTER_TEST(TestTimer);
+    REGISTER_TEST(TestPageCache);
+    REGISTER_TEST(TestThreadSchedulingPolicy);
 }
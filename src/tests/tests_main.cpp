@@ -21,6 +21,8 @@
     X(RegisterHostingTests)                                                                                  \
     X(RegisterAudioUtilsTests)                                                                               \
     X(RegisterVolumeFadeTests)                                                                               \
+    X(RegisterCoefficientTablesTests)                                                                        \
+    X(RegisterPolyphaseUpsamplerTests)                                                                       \
     X(FloeStateCodingTests)                                                                                  \
     X(FloeAudioFormatTests)                                                                                  \
     X(FloePresetTests)                                                                                       \
@@ -28,16 +30,25 @@
     X(FloeLibraryTests)                                                                                      \
     X(FloeAssetLoaderTests)                                                                                  \
     X(FloeParamStringConversionTests)                                                                        \
+    X(FloeLayerProcessorTests)                                                                               \
+    X(FloeProcessorTests)                                                                                    \
+    X(FloeVoicesTests)                                                                                       \
+    X(FloeGoldenRenderTests)                                                                                 \
     X(FloeSettingsFileTests)
 
 #define WINDOWS_FP_TEST_REGISTER_FUNCTIONS X(RegisterWindowsPlatformTests)
 
+#define GUI_TEST_REGISTER_FUNCTIONS X(FloeGuiPlatformTests)
+
 #define X(fn) void fn(tests::Tester&);
 
 TEST_REGISTER_FUNCTIONS
 #if _WIN32
 WINDOWS_FP_TEST_REGISTER_FUNCTIONS
 #endif
+#if FLOE_GUI
+GUI_TEST_REGISTER_FUNCTIONS
+#endif
 
 #undef X
 
@@ -66,6 +77,8 @@ int main(int argc, char** argv) {
             for (auto [key, value] : opts) {
                 if (key == "filter")
                     filter_pattern = *value;
+                else if (key == "update-golden")
+                    tester.update_golden_files = true;
                 else if (key == "log-level") {
                     if (IsEqualToCaseInsensitiveAscii(*value, "debug"_s))
                         tester.log.max_level_allowed = LogLevel::Debug;
@@ -91,6 +104,9 @@ int main(int argc, char** argv) {
 #if _WIN32
         WINDOWS_FP_TEST_REGISTER_FUNCTIONS
 #endif
+#if FLOE_GUI
+        GUI_TEST_REGISTER_FUNCTIONS
+#endif
 #undef X
 
         result = RunAllTests(tester, filter_pattern);
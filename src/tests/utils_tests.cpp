@@ -4,12 +4,14 @@
 #include "os/filesystem.hpp"
 #include "os/threading.hpp"
 #include "tests/framework.hpp"
+#include "utils/arena_usage.hpp"
 #include "utils/directory_listing/directory_listing.hpp"
 #include "utils/error_notifications.hpp"
 #include "utils/json/json_reader.hpp"
 #include "utils/json/json_writer.hpp"
 #include "utils/leak_detecting_allocator.hpp"
 #include "utils/thread_extra/atomic_queue.hpp"
+#include "utils/thread_extra/atomic_ref_list.hpp"
 
 struct StartingGun {
     void Wait() {
@@ -26,6 +28,37 @@ struct StartingGun {
 };
 
 TEST_CASE(TestErrorNotifications) {
+    {
+        ThreadsafeErrorNotifications n;
+        CHECK(!n.HasErrors());
+        auto const gen = n.Generation();
+
+        n.AddOrUpdateError({.title = "a"_s, .message = {}, .error_code = {}, .id = 10});
+        n.AddOrUpdateError({.title = "b"_s, .message = {}, .error_code = {}, .id = 10});
+        CHECK_EQ(n.NumErrors(), 1u);
+        CHECK(n.Generation() != gen);
+        auto const found = n.Find(10);
+        REQUIRE(found);
+        CHECK_EQ(found->title, "b"_s);
+
+        n.RemoveError(10);
+        CHECK(!n.HasErrors());
+        CHECK(!n.Find(10));
+
+        // fill past capacity, excess errors are dropped
+        for (auto const i : Range<u64>(2, 2 + ThreadsafeErrorNotifications::k_capacity + 4))
+            n.AddOrUpdateError({.title = "x"_s, .message = {}, .error_code = {}, .id = i});
+        CHECK_EQ(n.NumErrors(), ThreadsafeErrorNotifications::k_capacity);
+        CHECK_EQ(n.NumDropped(), 4u);
+        CHECK_EQ(n.TakeNumNewlyDropped(), 4u);
+        CHECK_EQ(n.TakeNumNewlyDropped(), 0u);
+
+        // tombstones are recycled
+        n.RemoveError(2);
+        n.AddOrUpdateError({.title = "y"_s, .message = {}, .error_code = {}, .id = 1000});
+        CHECK(n.Find(1000));
+    }
+
     ThreadsafeErrorNotifications no;
 
     Atomic<u32> iterations {0};
@@ -41,18 +74,16 @@ TEST_CASE(TestErrorNotifications) {
 
                 auto seed = SeedFromTime();
                 while (iterations.Load() < k_num_iterations) {
-                    auto const id = RandomIntInRange<u64>(seed, 0, 20);
+                    auto const id = RandomIntInRange<u64>(seed, 2, 22);
                     if (RandomIntInRange<u32>(seed, 0, 5) == 0) {
                         no.RemoveError(id);
                     } else {
-                        auto item = no.NewError();
-                        item->value = {
+                        no.AddOrUpdateError({
                             .title = "title"_s,
                             .message = "message"_s,
                             .error_code = {},
                             .id = id,
-                        };
-                        no.AddOrUpdateError(item);
+                        });
                     }
 
                     iterations.FetchAdd(1);
@@ -68,24 +99,31 @@ TEST_CASE(TestErrorNotifications) {
     starting_gun.Fire();
     auto seed = SeedFromTime();
     while (iterations.Load() < k_num_iterations) {
-        for (auto& n : no.items) {
-            if (auto error = n.TryRetain()) {
-                DEFER { n.Release(); };
-
-                if (RandomIntInRange<u32>(seed, 0, 20)) {
-                    no.RemoveError(error->id);
-                } else {
-                    CHECK_EQ(error->title, "title"_s);
-                    CHECK_EQ(error->message, "message"_s);
-                }
-            }
-        }
+        no.ForEach([&](ThreadsafeErrorNotifications::Item const& error) {
+            CHECK_EQ(error.title, "title"_s);
+            CHECK_EQ(error.message, "message"_s);
+            CHECK(error.id >= 2 && error.id <= 22);
+            if (RandomIntInRange<u32>(seed, 0, 20)) no.RemoveError(error.id);
+        });
+        CHECK(no.NumErrors() <= ThreadsafeErrorNotifications::k_capacity);
         YieldThisThread();
     }
 
     for (auto& p : producers)
         p.Join();
 
+    // Once everything has settled, each id should occupy at most one slot.
+    {
+        Array<u32, 23> counts {};
+        no.ForEach([&](ThreadsafeErrorNotifications::Item const& error) { ++counts[error.id]; });
+        u32 total = 0;
+        for (auto const c : counts) {
+            CHECK(c <= 1);
+            total += c;
+        }
+        CHECK_EQ(total, no.NumErrors());
+    }
+
     return k_success;
 }
 
@@ -1081,6 +1119,28 @@ TEST_CASE(TestDirectoryListing) {
     return k_success;
 }
 
+TEST_CASE(TestArenaUsageHistory) {
+    auto const name = "test-arena-usage"_s;
+    CHECK_EQ(RecommendedArenaSize(name, 100), (usize)100);
+
+    for (auto const size : Array {(usize)50, (usize)2000, (usize)300}) {
+        ArenaAllocator arena {Malloc::Instance(), RecommendedArenaSize(name, 100)};
+        ScopedArenaUsageRecorder const recorder {name, arena};
+        arena.AllocateExactSizeUninitialised<u8>(size);
+    }
+
+    auto const history = ArenaUsageHistory(name);
+    REQUIRE(history.HasValue());
+    CHECK_EQ(history->num_arenas, (u64)3);
+    CHECK_EQ(history->num_allocations, (u64)3);
+    CHECK_EQ(history->peak_used, (usize)2000); // the first region was left unused
+    CHECK_EQ(history->num_overflow_regions, (u64)1);
+    CHECK_EQ(RecommendedArenaSize(name, 100), (usize)2000);
+
+    LogArenaUsage(tester.log);
+    return k_success;
+}
+
 TEST_REGISTRATION(RegisterutilsTests) {
     REGISTER_TEST(TestDirectoryListing);
     REGISTER_TEST(TestSprintfBuffer);
@@ -1090,4 +1150,5 @@ TEST_REGISTRATION(RegisterutilsTests) {
     REGISTER_TEST(TestAtomicQueue);
     REGISTER_TEST(TestErrorNotifications);
     REGISTER_TEST(TestAtomicRefList);
+    REGISTER_TEST(TestArenaUsageHistory);
 }
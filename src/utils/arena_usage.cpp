@@ -0,0 +1,69 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "arena_usage.hpp"
+
+#include "foundation/foundation.hpp"
+#include "os/threading.hpp"
+#include "utils/debug/debug.hpp"
+
+namespace {
+
+struct Entry {
+    String name;
+    ArenaUsageStats stats;
+};
+
+constexpr usize k_max_entries = 32;
+
+using Entries = DynamicArrayInline<Entry, k_max_entries>;
+
+} // namespace
+
+static MutexProtected<Entries>& History() {
+    [[clang::no_destroy]] static MutexProtected<Entries> history {};
+    return history;
+}
+
+void RecordArenaUsage(String name, ArenaUsageStats const& stats) {
+    History().Use([&](Entries& entries) {
+        for (auto& e : entries) {
+            if (e.name == name) {
+                e.stats.Merge(stats);
+                return;
+            }
+        }
+        if (!dyn::Append(entries, {.name = name, .stats = stats}))
+            DebugLn("too many arena kinds to record usage, increase k_max_entries");
+    });
+}
+
+Optional<ArenaUsageStats> ArenaUsageHistory(String name) {
+    return History().Use([&](Entries& entries) -> Optional<ArenaUsageStats> {
+        for (auto const& e : entries)
+            if (e.name == name) return e.stats;
+        return nullopt;
+    });
+}
+
+usize RecommendedArenaSize(String name, usize guess) {
+    if (auto const stats = ArenaUsageHistory(name)) return stats->RecommendedInitialSize(guess);
+    return guess;
+}
+
+void LogArenaUsage(Logger& logger) {
+    History().Use([&](Entries& entries) {
+        for (auto const& e : entries) {
+            logger.DebugLn(
+                "Arena usage: {}: {} arenas, peak {} bytes, {} allocs, {} frees, {} resizes, {} regions ({} overflow)",
+                e.name,
+                e.stats.num_arenas,
+                e.stats.peak_used,
+                e.stats.num_allocations,
+                e.stats.num_frees,
+                e.stats.num_resizes,
+                e.stats.num_regions,
+                e.stats.num_overflow_regions);
+        }
+    });
+}
@@ -0,0 +1,32 @@
+// Copyright 2018-2024 Sam Windell
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+#include "foundation/foundation.hpp"
+#include "utils/logger/logger.hpp"
+
+// Process-wide history of ArenaUsageStats, keyed by a name for each kind of arena. Arenas that are created over
+// and over (per job, per instance, per window) record into their own ArenaUsageStats and then merge them in here
+// when they're done. Later arenas of the same kind can then pick an initial size from the history rather than a
+// guess. Thread-safe. Names must have static lifetime, e.g. string literals.
+
+void RecordArenaUsage(String name, ArenaUsageStats const& stats);
+Optional<ArenaUsageStats> ArenaUsageHistory(String name);
+usize RecommendedArenaSize(String name, usize guess);
+void LogArenaUsage(Logger& logger);
+
+// Tracks the given arena until the end of the scope, then records into the history.
+struct ScopedArenaUsageRecorder {
+    ScopedArenaUsageRecorder(String name, ArenaAllocator& arena) : name(name), arena(arena) {
+        arena.TrackUsage(stats);
+    }
+    ~ScopedArenaUsageRecorder() {
+        arena.usage_stats = nullptr;
+        RecordArenaUsage(name, stats);
+    }
+    NON_COPYABLE_AND_MOVEABLE(ScopedArenaUsageRecorder);
+
+    String name;
+    ArenaAllocator& arena;
+    ArenaUsageStats stats {};
+};
@@ -5,70 +5,234 @@
 #include "foundation/foundation.hpp"
 #include "os/misc.hpp"
 #include "os/threading.hpp"
-#include "utils/thread_extra/atomic_ref_list.hpp"
 
 // This is for errors that we want to let the user know about.
+//
+// Any number of threads can add, update and remove errors, and any number of threads can read them, all without
+// locks or allocations. It's a fixed-size open-addressing hash table keyed by the error id, so repeated errors
+// with the same id are deduplicated into a single slot and lookups don't need to scan everything. Removed slots
+// are tombstoned and recycled by later errors.
+//
+// Each slot's value is protected by a seqlock: writers briefly take the slot by making the sequence odd, and
+// readers copy the value out and retry if the sequence changed underneath them. Readers therefore get a
+// consistent copy rather than a reference. Nothing waits on a slot for long: if a writer is descheduled while
+// it holds a slot, other writes to it are given up and counted as dropped, and readers skip it for now.
+// Removing only changes the key, so it never waits.
+//
+// The generation counter changes whenever anything is added, updated or removed, so a reader that polls (such
+// as a GUI every frame) can cheaply check if there's anything new.
 struct ThreadsafeErrorNotifications {
     struct Item {
         DynamicArrayInline<char, 64> title;
         DynamicArrayInline<char, 512> message;
         Optional<ErrorCode> error_code;
-        u64 id;
+        u64 id; // usually made with Id(); 0 and 1 are reserved to mark empty and removed slots
     };
-
-    using ItemList = AtomicRefList<Item>;
+    static_assert(TriviallyCopyable<Item>);
 
     static constexpr u64 Id(char const (&data)[5], String string_to_hash) {
         return ((u64)U32FromChars(data) << 32) | Hash32(string_to_hash);
     }
 
+    static constexpr usize k_capacity = 32;
+    static_assert(IsPowerOfTwo(k_capacity));
+
     ThreadsafeErrorNotifications() = default;
     NON_COPYABLE_AND_MOVEABLE(ThreadsafeErrorNotifications);
 
-    ~ThreadsafeErrorNotifications() {
-        writer_mutex.Lock();
-        DEFER { writer_mutex.Unlock(); };
-        items.RemoveAll();
-        items.DeleteRemovedAndUnreferenced();
+    // any thread
+    // If the table is full the error is dropped; there's only so many errors that the user can take in anyway.
+    // Drops are counted, see TakeNumNewlyDropped().
+    void AddOrUpdateError(Item const& item) {
+        ASSERT(item.id != k_empty_key && item.id != k_tombstone_key, "error ids 0 and 1 are reserved");
+        auto const home = HomeSlot(item.id);
+        for (usize probe = 0; probe < k_capacity;) {
+            auto const index = (home + probe) & (k_capacity - 1);
+            auto& slot = m_slots[index];
+            auto key = slot.key.Load(MemoryOrder::Acquire);
+
+            if (key == item.id) {
+                switch (WriteSlot(slot, item)) {
+                    case WriteResult::Written: RemoveDuplicates(item, probe); return;
+                    case WriteResult::SlotBusy: CountDrop(); return;
+                    case WriteResult::SlotNotOurs:
+                        // The slot was removed or recycled for a different id before we could write to it.
+                        probe = 0;
+                        continue;
+                }
+            }
+
+            if (key == k_empty_key || key == k_tombstone_key) {
+                // Count it before we claim it so that a concurrent remove can't take the count below zero.
+                m_num_items.FetchAdd(1, MemoryOrder::Relaxed);
+                if (!slot.key.CompareExchangeStrong(key, item.id, MemoryOrder::AcquireRelease)) {
+                    m_num_items.FetchSub(1, MemoryOrder::Relaxed);
+                    continue; // someone else got it first, look at it again: it might be our id
+                }
+                switch (WriteSlot(slot, item)) {
+                    case WriteResult::Written: RemoveDuplicates(item, probe); return;
+                    case WriteResult::SlotBusy:
+                        // Give the slot back rather than leave it claimed with someone else's value in it.
+                        RemoveSlot(slot, item.id);
+                        CountDrop();
+                        return;
+                    case WriteResult::SlotNotOurs: probe = 0; continue;
+                }
+            }
+
+            ++probe;
+        }
+
+        CountDrop();
     }
 
-    ItemList::Node* NewError() {
-        writer_mutex.Lock();
-        DEFER { writer_mutex.Unlock(); };
+    // any thread
+    void RemoveError(u64 id) {
+        auto const home = HomeSlot(id);
+        for (auto const probe : Range(k_capacity)) {
+            auto& slot = m_slots[(home + probe) & (k_capacity - 1)];
+            auto const key = slot.key.Load(MemoryOrder::Acquire);
+            if (key == k_empty_key) return;
+            if (key == id) RemoveSlot(slot, id);
+        }
+    }
+
+    // any thread
+    // Copies out the item in the given slot, if there is one.
+    Optional<Item> Read(usize slot_index) const {
+        auto const& slot = m_slots[slot_index];
+        for (auto _ : Range(k_max_slot_attempts)) {
+            auto const key = slot.key.Load(MemoryOrder::Acquire);
+            if (key == k_empty_key || key == k_tombstone_key) return nullopt;
+
+            auto const seq_before = slot.seq.Load(MemoryOrder::Acquire);
+            if (seq_before & 1) {
+                SpinLoopPause();
+                continue;
+            }
 
-        return items.AllocateUninitialised();
+            Item result;
+            __builtin_memcpy(&result, &slot.value, sizeof(Item));
+            AtomicThreadFence(MemoryOrder::Acquire);
+
+            if (slot.seq.Load(MemoryOrder::Relaxed) != seq_before) continue;
+            // The value is left behind when a slot is removed, so it only counts if it's for the current key.
+            if (slot.key.Load(MemoryOrder::Relaxed) != result.id) return nullopt;
+            return result;
+        }
+        return nullopt; // a writer is holding the slot for longer than it should, try again later
     }
 
-    void AddOrUpdateError(ItemList::Node* node) {
-        writer_mutex.Lock();
-        DEFER { writer_mutex.Unlock(); };
+    // any thread
+    template <typename Function>
+    void ForEach(Function&& function) const {
+        if (m_num_items.Load(MemoryOrder::Relaxed) == 0) return;
+        for (auto const i : Range(k_capacity))
+            if (auto const item = Read(i)) function(*item);
+    }
 
-        for (auto& i : items) {
-            if (i.value.id == node->value.id) {
-                i.value = node->value;
-                items.DiscardAllocatedInitialised(node);
-                return;
+    // any thread
+    Optional<Item> Find(u64 id) const {
+        auto const home = HomeSlot(id);
+        for (auto const probe : Range(k_capacity)) {
+            auto const index = (home + probe) & (k_capacity - 1);
+            auto const key = m_slots[index].key.Load(MemoryOrder::Acquire);
+            if (key == k_empty_key) return nullopt;
+            if (key == id)
+                if (auto item = Read(index); item && item->id == id) return item;
+        }
+        return nullopt;
+    }
+
+    // any thread
+    u32 Generation() const { return m_generation.Load(MemoryOrder::Acquire); }
+    bool HasErrors() const { return m_num_items.Load(MemoryOrder::Relaxed) != 0; }
+    u32 NumErrors() const { return m_num_items.Load(MemoryOrder::Relaxed); }
+    u64 NumDropped() const { return m_num_dropped.Load(MemoryOrder::Relaxed); }
+
+    // any thread
+    // The number of errors dropped since the last call, so that whoever polls the table can report them once.
+    u64 TakeNumNewlyDropped() { return m_num_unreported_drops.Exchange(0, MemoryOrder::Relaxed); }
+
+  private:
+    static constexpr u64 k_empty_key = 0;
+    static constexpr u64 k_tombstone_key = 1;
+    static constexpr u32 k_max_slot_attempts = 1000;
+
+    struct Slot {
+        Atomic<u64> key {k_empty_key};
+        Atomic<u32> seq {0}; // odd while being written
+        Item value;
+    };
+
+    enum class WriteResult { Written, SlotBusy, SlotNotOurs };
+
+    static usize HomeSlot(u64 id) {
+        return (usize)((id * 0x9e3779b97f4a7c15ull) >> (64 - __builtin_ctzll(k_capacity)));
+    }
+
+    static bool TryLockSlot(Slot& slot) {
+        for (auto _ : Range(k_max_slot_attempts)) {
+            auto seq = slot.seq.Load(MemoryOrder::Relaxed);
+            if (!(seq & 1) &&
+                slot.seq.CompareExchangeWeak(seq, seq + 1, MemoryOrder::Acquire, MemoryOrder::Relaxed)) {
+                AtomicThreadFence(MemoryOrder::Release);
+                return true;
             }
+            SpinLoopPause();
         }
+        return false;
+    }
+
+    static void UnlockSlot(Slot& slot) { slot.seq.FetchAdd(1, MemoryOrder::Release); }
 
-        items.Insert(node);
+    void CountDrop() {
+        m_num_dropped.FetchAdd(1, MemoryOrder::Relaxed);
+        m_num_unreported_drops.FetchAdd(1, MemoryOrder::Relaxed);
     }
 
-    void RemoveError(u64 id) {
-        writer_mutex.Lock();
-        DEFER { writer_mutex.Unlock(); };
+    // A slot that stays busy is held by a writer that was descheduled part-way through. Rather than wait for
+    // it, the write is given up.
+    WriteResult WriteSlot(Slot& slot, Item const& item) {
+        if (!TryLockSlot(slot)) return WriteResult::SlotBusy;
+        DEFER { UnlockSlot(slot); };
+        if (slot.key.Load(MemoryOrder::Relaxed) != item.id) return WriteResult::SlotNotOurs;
+        __builtin_memcpy(&slot.value, &item, sizeof(Item));
+        m_generation.FetchAdd(1, MemoryOrder::Release);
+        return WriteResult::Written;
+    }
 
-        for (auto it = items.begin(); it != items.end();)
-            if (it->value.id == id)
-                it = items.Remove(it);
-            else
-                ++it;
+    void RemoveSlot(Slot& slot, u64 id) {
+        auto expected = id;
+        if (!slot.key.CompareExchangeStrong(expected, k_tombstone_key, MemoryOrder::AcquireRelease)) return;
+        m_num_items.FetchSub(1, MemoryOrder::Relaxed);
+        m_generation.FetchAdd(1, MemoryOrder::Release);
+    }
 
-        items.DeleteRemovedAndUnreferenced();
+    // Two threads adding the same id at the same time can very occasionally end up claiming different slots if
+    // the table changes between their probes. Each of them keeps the slot for the id that comes first in the
+    // probe chain, giving it their item, and removes the others, so whichever order they finish in, one slot
+    // is left.
+    void RemoveDuplicates(Item const& item, usize own_probe) {
+        auto const home = HomeSlot(item.id);
+        bool kept_one = false;
+        for (auto const probe : Range(k_capacity)) {
+            auto& slot = m_slots[(home + probe) & (k_capacity - 1)];
+            auto const key = slot.key.Load(MemoryOrder::Acquire);
+            if (key == k_empty_key) return;
+            if (key != item.id) continue;
+            if (kept_one)
+                RemoveSlot(slot, item.id);
+            else
+                kept_one = probe == own_probe || WriteSlot(slot, item) == WriteResult::Written;
+        }
     }
 
-    Mutex writer_mutex {};
-    AtomicRefList<Item> items {.arena = {PageAllocator::Instance()}};
+    Slot m_slots[k_capacity] {};
+    Atomic<u32> m_generation {0};
+    Atomic<u32> m_num_items {0};
+    Atomic<u64> m_num_dropped {0};
+    Atomic<u64> m_num_unreported_drops {0};
 };
 
 struct ErrorLog {
@@ -6,13 +6,17 @@
 #include "os/misc.hpp"
 #include "os/threading.hpp"
 #include "utils/debug/tracy_wrapped.hpp"
+#include "utils/logger/logger.hpp"
 
 struct ThreadPool {
     using FunctionType = FunctionQueue<>::Function;
 
     ~ThreadPool() { StopAllThreads(); }
 
-    void Init(String pool_name, Optional<u32> num_threads) {
+    // If a scheduling policy is given, each worker applies it when it starts and logs what it ended up with.
+    void Init(String pool_name,
+              Optional<u32> num_threads,
+              Optional<ThreadSchedulingPolicy> scheduling_policy = {}) {
         ZoneScoped;
         ASSERT(m_workers.size == 0);
         if (!num_threads) num_threads = Min(Max(GetSystemStats().num_logical_cpus / 2u, 1u), 4u);
@@ -20,7 +24,13 @@ struct ThreadPool {
         dyn::Resize(m_workers, *num_threads);
         for (auto [i, w] : Enumerate(m_workers)) {
             auto const name = fmt::FormatInline<100>("{}: {}", pool_name, i);
-            w.Start([this]() { WorkerProc(this); }, name, {});
+            w.Start(
+                [this, scheduling_policy]() {
+                    if (scheduling_policy) ApplySchedulingPolicy(*scheduling_policy);
+                    WorkerProc(this);
+                },
+                name,
+                {});
         }
     }
 
@@ -45,6 +55,16 @@ struct ThreadPool {
     }
 
   private:
+    static void ApplySchedulingPolicy(ThreadSchedulingPolicy const& policy) {
+        auto const outcome = SetCurrentThreadSchedulingPolicy(policy);
+        if (outcome.HasError())
+            g_log_file.WarningLn("{}: couldn't fully apply scheduling policy ({}): {}",
+                                 ThreadName(),
+                                 policy,
+                                 outcome.Error());
+        g_log_file.InfoLn("{}: scheduling: {}", ThreadName(), CurrentThreadSchedulingPolicy());
+    }
+
     static void WorkerProc(ThreadPool* thread_pool) {
         ZoneScoped;
         ArenaAllocatorWithInlineStorage<4000> scratch_arena {};
@@ -69,6 +69,23 @@ class FFTConvolver {
         }
     }
 
+    // zero() split into steps so that it can be spread across multiple audio blocks. Call zeroStep() with
+    // every step from 0 to numZeroSteps() - 1. Returns the number of bytes zeroed.
+    size_t numZeroSteps() const { return 1 + _segments.size(); }
+    size_t zeroStep(size_t step) {
+        if (step == 0) {
+            _inputBuffer.setZero();
+            _preMultiplied.setZero();
+            _conv.setZero();
+            _overlap.setZero();
+            _fftBuffer.setZero();
+            return (_inputBuffer.size() + _overlap.size() + _fftBuffer.size() + (_fftComplexSize * 4)) *
+                   sizeof(Sample);
+        }
+        _segments[step - 1]->setZero();
+        return _fftComplexSize * 2 * sizeof(Sample);
+    }
+
   private:
     size_t _blockSize;
     size_t _segSize;
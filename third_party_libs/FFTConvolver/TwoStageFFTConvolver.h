@@ -75,6 +75,27 @@ class TwoStageFFTConvolver {
         _backgroundProcessingInput.setZero();
     }
 
+    // zero() split into steps, see FFTConvolver::zeroStep()
+    size_t numZeroSteps() const {
+        return _headConvolver.numZeroSteps() + _tailConvolver0.numZeroSteps() + _tailConvolver.numZeroSteps() +
+               1;
+    }
+    size_t zeroStep(size_t step) {
+        for (auto c : {&_headConvolver, &_tailConvolver0, &_tailConvolver}) {
+            if (step < c->numZeroSteps()) return c->zeroStep(step);
+            step -= c->numZeroSteps();
+        }
+        _tailOutput0.setZero();
+        _tailPrecalculated0.setZero();
+        _tailOutput.setZero();
+        _tailPrecalculated.setZero();
+        _tailInput.setZero();
+        _backgroundProcessingInput.setZero();
+        return (_tailOutput0.size() + _tailPrecalculated0.size() + _tailOutput.size() +
+                _tailPrecalculated.size() + _tailInput.size() + _backgroundProcessingInput.size()) *
+               sizeof(Sample);
+    }
+
   protected:
     /**
      * @brief Method called by the convolver if work for background processing is available
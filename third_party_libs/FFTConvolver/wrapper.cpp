@@ -47,3 +47,13 @@ void Zero(StereoConvolver& convolver) {
     convolver.convolvers[0].zero();
     convolver.convolvers[1].zero();
 }
+
+int NumZeroSteps(StereoConvolver& convolver) {
+    return (int)(convolver.convolvers[0].numZeroSteps() + convolver.convolvers[1].numZeroSteps());
+}
+
+int ZeroStep(StereoConvolver& convolver, int step) {
+    auto const steps_per_channel = (int)convolver.convolvers[0].numZeroSteps();
+    if (step < steps_per_channel) return (int)convolver.convolvers[0].zeroStep((size_t)step);
+    return (int)convolver.convolvers[1].zeroStep((size_t)(step - steps_per_channel));
+}
@@ -17,3 +17,8 @@ void Process(StereoConvolver& convolver,
              float* output_r,
              int num_frames);
 void Zero(StereoConvolver& convolver);
+
+// Zero split into steps so that it can be spread across multiple audio blocks. Call ZeroStep with every step
+// from 0 to NumZeroSteps() - 1. Returns the number of bytes zeroed.
+int NumZeroSteps(StereoConvolver& convolver);
+int ZeroStep(StereoConvolver& convolver, int step);
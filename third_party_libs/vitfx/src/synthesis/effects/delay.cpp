@@ -25,7 +25,11 @@ namespace vital {
   template<class MemoryType>
   void Delay<MemoryType>::hardReset() {
     memory_->clearAll();
+    hardResetState();
+  }
 
+  template<class MemoryType>
+  void Delay<MemoryType>::hardResetState() {
     filter_gain_ = 0.0f;
     low_pass_.reset(constants::kFullMask);
     high_pass_.reset(constants::kFullMask);
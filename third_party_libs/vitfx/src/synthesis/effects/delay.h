@@ -70,6 +70,13 @@ namespace vital {
       void hardReset() override;
       void setMaxSamples(int max_samples);
 
+      // Floe: hardReset() split into the cheap state reset and the memory clear, see MemoryTemplate::clearAllIncremental
+      void hardResetState();
+      int memoryClearSize() const { return memory_->clearAllSize(); }
+      int clearMemoryIncremental(int position, int max_samples) {
+        return memory_->clearAllIncremental(position, max_samples);
+      }
+
       virtual void process(int num_samples) override;
       virtual void processWithInput(const poly_float* audio_in, int num_samples) override;
 
@@ -358,6 +358,11 @@ namespace vital {
   }
 
   void Reverb::hardReset() {
+    hardResetState();
+    clearMemoryIncremental(0, memoryClearSize());
+  }
+
+  void Reverb::hardResetState() {
     wet_ = 0.0f;
     dry_ = 0.0f;
     low_pre_filter_.reset(constants::kFullMask);
@@ -369,15 +374,31 @@ namespace vital {
       high_shelf_filters_[i].reset(constants::kFullMask);
       decays_[i] = 0.0f;
     }
+  }
 
-    for (int n = 0; n < kNetworkContainers; ++n) {
-      for (int i = 0; i < max_allpass_size_; ++i)
-        allpass_lookups_[n][i] = 0.0f;
-    }
+  int Reverb::memoryClearSize() const {
+    return kNetworkContainers * max_allpass_size_ * poly_float::kSize +
+           kNetworkSize * (max_feedback_size_ + kExtraLookupSample);
+  }
 
-    for (int n = 0; n < kNetworkSize; ++n) {
-      for (int i = 0; i < max_feedback_size_ + kExtraLookupSample; ++i)
-        feedback_memories_[n][i] = 0.0f;
-    }
+  int Reverb::clearMemoryIncremental(int position, int max_samples) {
+    int const end = std::min(position + max_samples, memoryClearSize());
+    int region_start = 0;
+
+    auto clear_region = [&](mono_float* data, int size) {
+      int const start = std::max(position, region_start);
+      int const stop = std::min(end, region_start + size);
+      if (start < stop)
+        memset(data + (start - region_start), 0, (stop - start) * sizeof(mono_float));
+      region_start += size;
+    };
+
+    for (int n = 0; n < kNetworkContainers; ++n)
+      clear_region((mono_float*)allpass_lookups_[n].get(), max_allpass_size_ * poly_float::kSize);
+
+    for (int n = 0; n < kNetworkSize; ++n)
+      clear_region(feedback_memories_[n].get(), max_feedback_size_ + kExtraLookupSample);
+
+    return end;
   }
 } // namespace vital
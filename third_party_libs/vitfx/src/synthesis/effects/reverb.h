@@ -68,6 +68,13 @@ class Reverb : public Processor {
     void setupBuffersForSampleRate(int sample_rate);
     void hardReset() override;
 
+    // Floe: hardReset() split into the cheap state reset and the clearing of the delay memories, so that the
+    // clearing can be spread across multiple audio blocks. clearMemoryIncremental zeros up to max_samples
+    // starting at position, where position runs from 0 to memoryClearSize(). It returns the next position.
+    void hardResetState();
+    int memoryClearSize() const;
+    int clearMemoryIncremental(int position, int max_samples);
+
     force_inline poly_float readFeedback(const mono_float *const *lookups, poly_float offset) {
         poly_float write_offset = poly_float(write_index_) - offset;
         poly_float floored_offset = utils::floor(write_offset);
@@ -75,6 +75,22 @@ namespace vital {
           memset(buffers_[c], 0, 2 * size_ * sizeof(mono_float));
       }
 
+      // Floe: clearAll() split into chunks so that it can be spread across multiple audio blocks. Zeros up to
+      // max_samples starting at position, where position runs from 0 to clearAllSize(). Returns the next position.
+      int clearAllSize() const { return kChannels * 2 * size_; }
+      int clearAllIncremental(int position, int max_samples) {
+        int const channel_size = 2 * size_;
+        int const end = std::min(position + max_samples, clearAllSize());
+        while (position < end) {
+          int const channel = position / channel_size;
+          int const offset = position % channel_size;
+          int const num = std::min(end - position, channel_size - offset);
+          memset(buffers_[channel] + offset, 0, num * sizeof(mono_float));
+          position += num;
+        }
+        return position;
+      }
+
       void readSamples(mono_float* output, int num_samples, int offset, int channel) const {
         mono_float* buffer = buffers_[channel];
         int bitmask = bitmask_;
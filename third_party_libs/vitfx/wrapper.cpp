@@ -8,15 +8,21 @@
 #include "src/synthesis/effects/delay.h"
 #include "src/synthesis/effects/phaser.h"
 #include "src/synthesis/effects/reverb.h"
+#include "src/synthesis/framework/futils.h"
 
 namespace vitfx {
 
+float DryGain(float mix) {
+    return vital::futils::equalPowerFadeInverse(vital::utils::clamp(mix, 0.0f, 1.0f))[0];
+}
+
 namespace reverb {
 
 struct Reverb {
     vital::Reverb reverb;
     vital::Output in_params[(int)Params::Count];
     vital::poly_float in_buffer[vital::kMaxBufferSize];
+    int reset_position;
 };
 
 Reverb* Create() {
@@ -70,6 +76,16 @@ void Process(Reverb& reverb, ProcessReverbArgs args) {
 
 void HardReset(Reverb& reverb) { reverb.reverb.hardReset(); }
 
+void BeginHardReset(Reverb& reverb) {
+    reverb.reverb.hardResetState();
+    reverb.reset_position = 0;
+}
+
+bool ContinueHardReset(Reverb& reverb, int max_samples) {
+    reverb.reset_position = reverb.reverb.clearMemoryIncremental(reverb.reset_position, max_samples);
+    return reverb.reset_position >= reverb.reverb.memoryClearSize();
+}
+
 void SetSampleRate(Reverb& reverb, int sample_rate) { reverb.reverb.setSampleRate(sample_rate); }
 
 } // namespace reverb
@@ -147,6 +163,7 @@ struct Delay {
     vital::StereoDelay delay {0};
     vital::Output in_params[(int)Params::Count];
     vital::poly_float in_buffer[vital::kMaxBufferSize];
+    int reset_position;
 };
 
 Delay* Create() {
@@ -192,6 +209,16 @@ void Process(Delay& delay, ProcessDelayArgs args) {
 
 void HardReset(Delay& delay) { delay.delay.hardReset(); }
 
+void BeginHardReset(Delay& delay) {
+    delay.delay.hardResetState();
+    delay.reset_position = 0;
+}
+
+bool ContinueHardReset(Delay& delay, int max_samples) {
+    delay.reset_position = delay.delay.clearMemoryIncremental(delay.reset_position, max_samples);
+    return delay.reset_position >= delay.delay.memoryClearSize();
+}
+
 void SetSampleRate(Delay& delay, int sample_rate) {
     delay.delay.setSampleRate(sample_rate);
     delay.delay.setMaxSamples(kMaxDelayTime * sample_rate);
@@ -5,6 +5,9 @@
 
 namespace vitfx {
 
+// The gain that the reverb and delay apply to their dry signal for a given Params::Mix value.
+float DryGain(float mix);
+
 namespace reverb {
 
 enum class Params {
@@ -41,6 +44,12 @@ void Process(Reverb& reverb, ProcessReverbArgs args);
 void HardReset(Reverb& reverb);
 void SetSampleRate(Reverb& reverb, int sample_rate);
 
+// HardReset split into steps so that clearing the delay memory can be spread across multiple blocks. Call
+// BeginHardReset, then call ContinueHardReset until it returns true, clearing at most max_samples each time.
+// Don't call Process until the reset is complete.
+void BeginHardReset(Reverb& reverb);
+bool ContinueHardReset(Reverb& reverb, int max_samples);
+
 } // namespace reverb
 
 namespace phaser {
@@ -118,6 +127,10 @@ void Process(Delay& delay, ProcessDelayArgs args);
 void HardReset(Delay& delay);
 void SetSampleRate(Delay& delay, int sample_rate);
 
+// Same as the reverb's BeginHardReset and ContinueHardReset.
+void BeginHardReset(Delay& delay);
+bool ContinueHardReset(Delay& delay, int max_samples);
+
 } // namespace delay
 
 } // namespace vitfx